@@ -9,6 +9,7 @@ QT       += core gui opengl
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 include(../../bial/bial.pri)
+include(core.pri)
 
 TARGET = OpenGLView
 TEMPLATE = app
@@ -0,0 +1,605 @@
+#include "adaptivecontouring.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+  /* Corner or child c of a cell is at offset ( c & 1, ( c >> 1 ) & 1, ( c >> 2 ) & 1 ), in halves for children. */
+  const int cellEdges[ 12 ][ 2 ] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+  };
+
+  /*
+   * The four cells around an edge along axis a, counterclockwise seen from +a: cell k lies on the low or high
+   * side of the edge along b = ( a + 1 ) % 3 and c = ( a + 2 ) % 3 as given by sideB[ k ] and sideC[ k ].
+   */
+  const int sideB[ 4 ] = { 0, 1, 1, 0 };
+  const int sideC[ 4 ] = { 0, 0, 1, 1 };
+
+  class Volume {
+    const Image< int > &img;
+    const Image< int > *mask;
+    float outside;
+
+  public:
+    const size_t xs, ys, zs;
+    const float level;
+
+    Volume( const Image< int > &img, const Image< int > *mask, float isolevel ) : img( img ), mask( mask ),
+      outside( isolevel - 1.0f ), xs( img.size( 0 ) ), ys( img.size( 1 ) ), zs( img.size( 2 ) ), level( isolevel ) {
+    }
+
+    float operator()( size_t x, size_t y, size_t z ) const {
+      size_t pxl = x + xs * ( y + ys * z );
+      if( mask && ( *mask )[ pxl ] == 0 ) {
+        return( outside );
+      }
+      return( static_cast< float >( img[ pxl ] ) );
+    }
+
+    bool Inside( size_t x, size_t y, size_t z ) const {
+      return( ( *this )( x, y, z ) >= level );
+    }
+
+    /* Central differences, falling back to one-sided differences at the borders. */
+    Vector3D Gradient( size_t x, size_t y, size_t z ) const {
+      size_t x0 = x > 0 ? x - 1 : x, x1 = x + 1 < xs ? x + 1 : x;
+      size_t y0 = y > 0 ? y - 1 : y, y1 = y + 1 < ys ? y + 1 : y;
+      size_t z0 = z > 0 ? z - 1 : z, z1 = z + 1 < zs ? z + 1 : z;
+      return( Vector3D( ( ( *this )( x1, y, z ) - ( *this )( x0, y, z ) ) / std::max< double >( 1.0, x1 - x0 ),
+                        ( ( *this )( x, y1, z ) - ( *this )( x, y0, z ) ) / std::max< double >( 1.0, y1 - y0 ),
+                        ( ( *this )( x, y, z1 ) - ( *this )( x, y, z0 ) ) / std::max< double >( 1.0, z1 - z0 ) ) );
+    }
+  };
+
+  /* Solves the 3x3 system a * x = b by Cramer's rule. Returns false if a is singular. */
+  bool Solve3x3( const double a[ 3 ][ 3 ], const double b[ 3 ], double x[ 3 ] ) {
+    double det = a[ 0 ][ 0 ] * ( a[ 1 ][ 1 ] * a[ 2 ][ 2 ] - a[ 1 ][ 2 ] * a[ 2 ][ 1 ] ) -
+                 a[ 0 ][ 1 ] * ( a[ 1 ][ 0 ] * a[ 2 ][ 2 ] - a[ 1 ][ 2 ] * a[ 2 ][ 0 ] ) +
+                 a[ 0 ][ 2 ] * ( a[ 1 ][ 0 ] * a[ 2 ][ 1 ] - a[ 1 ][ 1 ] * a[ 2 ][ 0 ] );
+    if( std::abs( det ) < 1e-12 ) {
+      return( false );
+    }
+    for( size_t col = 0; col < 3; ++col ) {
+      double m[ 3 ][ 3 ];
+      for( size_t row = 0; row < 3; ++row ) {
+        for( size_t c = 0; c < 3; ++c ) {
+          m[ row ][ c ] = ( c == col ) ? b[ row ] : a[ row ][ c ];
+        }
+      }
+      x[ col ] = ( m[ 0 ][ 0 ] * ( m[ 1 ][ 1 ] * m[ 2 ][ 2 ] - m[ 1 ][ 2 ] * m[ 2 ][ 1 ] ) -
+                   m[ 0 ][ 1 ] * ( m[ 1 ][ 0 ] * m[ 2 ][ 2 ] - m[ 1 ][ 2 ] * m[ 2 ][ 0 ] ) +
+                   m[ 0 ][ 2 ] * ( m[ 1 ][ 0 ] * m[ 2 ][ 1 ] - m[ 1 ][ 1 ] * m[ 2 ][ 0 ] ) ) / det;
+    }
+    return( true );
+  }
+
+  /* Crossing planes of a cell, summed so that the planes of merged cells are the sum of those of their children. */
+  struct Qef {
+    double ata[ 3 ][ 3 ] = { { 0.0 } };
+    double atb[ 3 ] = { 0.0 };
+    double btb = 0.0;
+    Vector3D mass;
+    Vector3D grad;
+    size_t crossings = 0;
+    size_t planes = 0;
+
+    void Add( const Vector3D &point, const Vector3D &gradient ) {
+      mass += point;
+      grad += gradient;
+      ++crossings;
+      if( gradient.LengthSquared( ) == 0.0 ) {
+        return;
+      }
+      Vector3D nrm = gradient.Normalized( );
+      double d = Dot( nrm, point );
+      for( int row = 0; row < 3; ++row ) {
+        for( int col = 0; col < 3; ++col ) {
+          ata[ row ][ col ] += nrm[ row ] * nrm[ col ];
+        }
+        atb[ row ] += nrm[ row ] * d;
+      }
+      btb += d * d;
+      ++planes;
+    }
+
+    void Add( const Qef &other ) {
+      for( int row = 0; row < 3; ++row ) {
+        for( int col = 0; col < 3; ++col ) {
+          ata[ row ][ col ] += other.ata[ row ][ col ];
+        }
+        atb[ row ] += other.atb[ row ];
+      }
+      btb += other.btb;
+      mass += other.mass;
+      grad += other.grad;
+      crossings += other.crossings;
+      planes += other.planes;
+    }
+
+    /*
+     * Vertex inside the cube of edge size at lo, biased towards the mass point as in SurfaceNets, and the sum of
+     * its squared distances to the planes.
+     */
+    double Solve( const size_t lo[ 3 ], size_t size, Vector3D &pos ) const {
+      const double qefBias = 0.05;
+      Vector3D center = mass / static_cast< double >( crossings );
+      double a[ 3 ][ 3 ], b[ 3 ], sol[ 3 ];
+      for( int row = 0; row < 3; ++row ) {
+        for( int col = 0; col < 3; ++col ) {
+          a[ row ][ col ] = ata[ row ][ col ] + ( row == col ? qefBias : 0.0 );
+        }
+        b[ row ] = atb[ row ] + qefBias * center[ row ];
+      }
+      pos = center;
+      if( Solve3x3( a, b, sol ) ) {
+        for( int axis = 0; axis < 3; ++axis ) {
+          sol[ axis ] = std::min< double >( lo[ axis ] + size, std::max< double >( lo[ axis ], sol[ axis ] ) );
+        }
+        pos = Vector3D( sol[ 0 ], sol[ 1 ], sol[ 2 ] );
+      }
+      double error = btb;
+      for( int row = 0; row < 3; ++row ) {
+        double sum = 0.0;
+        for( int col = 0; col < 3; ++col ) {
+          sum += ata[ row ][ col ] * pos[ col ];
+        }
+        error += pos[ row ] * ( sum - 2.0 * atb[ row ] );
+      }
+      return( std::max( 0.0, error ) );
+    }
+  };
+
+  /* Octree node. Leaves carry one vertex; empty regions are not stored and show up as children of -1. */
+  struct Node {
+    int32_t child[ 8 ];
+    uint32_t vertex;
+    uint16_t size;
+    uint8_t corners;
+    bool leaf;
+  };
+
+  /* Octree of one maxCell^3 block of cells, with the vertices of its leaves. */
+  struct Block {
+    std::vector< Node > nodes;
+    int32_t root = -1;
+    std::vector< Point3D > p;
+    std::vector< Normal > n;
+    /* Index in the sink of the first vertex of the block. */
+    size_t base = 0;
+    /* Crossed unit cells, before merging. */
+    size_t cells = 0;
+  };
+
+  /* True when both the inside and the outside corners are connected along cube edges, so the cell holds a disk. */
+  bool Manifold( unsigned int corners ) {
+    for( unsigned int set : { corners & 0xffu, ~corners & 0xffu } ) {
+      if( set == 0 ) {
+        return( false );
+      }
+      unsigned int reached = set & ( 0u - set );
+      for( bool grew = true; grew; ) {
+        grew = false;
+        for( size_t e = 0; e < 12; ++e ) {
+          unsigned int c0 = 1u << cellEdges[ e ][ 0 ], c1 = 1u << cellEdges[ e ][ 1 ];
+          if( ( set & c0 ) && ( set & c1 ) && ( ( reached & c0 ) != 0 ) != ( ( reached & c1 ) != 0 ) ) {
+            reached |= c0 | c1;
+            grew = true;
+          }
+        }
+      }
+      if( reached != set ) {
+        return( false );
+      }
+    }
+    return( true );
+  }
+
+  class Builder {
+    const Volume &vol;
+    const size_t cells[ 3 ];
+    const double tolerance;
+    const VolumeStatistics *stats;
+    Block &block;
+
+  public:
+    struct Result {
+      int32_t node = -1;
+      Qef qef;
+      /* Leaves the parent may merge: unit cells holding a disk, and merged cells. */
+      bool mergeable = false;
+    };
+
+    Builder( const Volume &vol, double tolerance, const VolumeStatistics *stats, Block &block ) : vol( vol ),
+      cells{ vol.xs - 1, vol.ys - 1, vol.zs - 1 }, tolerance( tolerance ), stats( stats ), block( block ) {
+    }
+
+    Result Build( size_t x, size_t y, size_t z, size_t size ) {
+      Result res;
+      if( x >= cells[ 0 ] || y >= cells[ 1 ] || z >= cells[ 2 ] ) {
+        return( res );
+      }
+      if( size == 1 ) {
+        return( Cell( x, y, z ) );
+      }
+      if( stats && size == VolumeStatistics::BlockEdge && !stats->MayCross( x, y, z, vol.level ) ) {
+        return( res );
+      }
+      const size_t firstNode = block.nodes.size( ), firstVertex = block.p.size( );
+      const size_t half = size / 2;
+      Result child[ 8 ];
+      bool empty = true, merge = x + size <= cells[ 0 ] && y + size <= cells[ 1 ] && z + size <= cells[ 2 ];
+      for( size_t c = 0; c < 8; ++c ) {
+        child[ c ] = Build( x + half * ( c & 1 ), y + half * ( ( c >> 1 ) & 1 ), z + half * ( ( c >> 2 ) & 1 ), half );
+        if( child[ c ].node >= 0 ) {
+          empty = false;
+          merge = merge && child[ c ].mergeable;
+          res.qef.Add( child[ c ].qef );
+        }
+      }
+      if( empty ) {
+        return( res );
+      }
+      const size_t lo[ 3 ] = { x, y, z };
+      unsigned int corners = 0;
+      merge = merge && Safe( lo, size, corners );
+      Vector3D pos;
+      if( merge && res.qef.Solve( lo, size, pos ) <= tolerance * tolerance * res.qef.planes ) {
+        block.nodes.resize( firstNode );
+        block.p.resize( firstVertex );
+        block.n.resize( firstVertex );
+        res.node = Leaf( pos, res.qef.grad, size, corners );
+        res.mergeable = true;
+        return( res );
+      }
+      Node node;
+      for( size_t c = 0; c < 8; ++c ) {
+        node.child[ c ] = child[ c ].node;
+      }
+      node.leaf = false;
+      node.size = static_cast< uint16_t >( size );
+      block.nodes.push_back( node );
+      res.node = static_cast< int32_t >( block.nodes.size( ) - 1 );
+      return( res );
+    }
+
+  private:
+    Result Cell( size_t x, size_t y, size_t z ) {
+      Result res;
+      std::array< float, 8 > val;
+      unsigned int inside = 0;
+      for( size_t c = 0; c < 8; ++c ) {
+        val[ c ] = vol( x + ( c & 1 ), y + ( ( c >> 1 ) & 1 ), z + ( ( c >> 2 ) & 1 ) );
+        if( val[ c ] >= vol.level ) {
+          inside |= 1u << c;
+        }
+      }
+      if( inside == 0 || inside == 0xff ) {
+        return( res );
+      }
+      for( size_t e = 0; e < 12; ++e ) {
+        int c0 = cellEdges[ e ][ 0 ], c1 = cellEdges[ e ][ 1 ];
+        if( ( ( inside >> c0 ) & 1 ) == ( ( inside >> c1 ) & 1 ) ) {
+          continue;
+        }
+        double t = ( vol.level - val[ c0 ] ) / ( val[ c1 ] - val[ c0 ] );
+        Vector3D p0( x + ( c0 & 1 ), y + ( ( c0 >> 1 ) & 1 ), z + ( ( c0 >> 2 ) & 1 ) );
+        Vector3D p1( x + ( c1 & 1 ), y + ( ( c1 >> 1 ) & 1 ), z + ( ( c1 >> 2 ) & 1 ) );
+        Vector3D g0 = vol.Gradient( x + ( c0 & 1 ), y + ( ( c0 >> 1 ) & 1 ), z + ( ( c0 >> 2 ) & 1 ) );
+        Vector3D g1 = vol.Gradient( x + ( c1 & 1 ), y + ( ( c1 >> 1 ) & 1 ), z + ( ( c1 >> 2 ) & 1 ) );
+        res.qef.Add( p0 + ( p1 - p0 ) * t, g0 + ( g1 - g0 ) * t );
+      }
+      const size_t lo[ 3 ] = { x, y, z };
+      Vector3D pos;
+      res.qef.Solve( lo, 1, pos );
+      res.node = Leaf( pos, res.qef.grad, 1, inside );
+      res.mergeable = Manifold( inside );
+      ++block.cells;
+      return( res );
+    }
+
+    int32_t Leaf( const Vector3D &pos, const Vector3D &grad, size_t size, unsigned int corners ) {
+      Node node;
+      std::fill( node.child, node.child + 8, -1 );
+      node.vertex = static_cast< uint32_t >( block.p.size( ) );
+      node.size = static_cast< uint16_t >( size );
+      node.corners = static_cast< uint8_t >( corners );
+      node.leaf = true;
+      block.p.push_back( Point3D( pos.x, pos.y, pos.z ) );
+      block.n.push_back( grad.LengthSquared( ) > 0.0 ? Normal( grad.Normalized( ) ) : Normal( ) );
+      block.nodes.push_back( node );
+      return( static_cast< int32_t >( block.nodes.size( ) - 1 ) );
+    }
+
+    /*
+     * Topology safety of merging the eight children of a cell: its corners must describe a disk, and the sign at
+     * the middle of every edge, face and of the cell itself must match one of the corners it lies between, so no
+     * fold of the surface is lost inside the merged cell. Sets the corner signs of the merged cell.
+     */
+    bool Safe( const size_t lo[ 3 ], size_t size, unsigned int &corners ) const {
+      const size_t half = size / 2;
+      corners = 0;
+      for( size_t c = 0; c < 8; ++c ) {
+        if( vol.Inside( lo[ 0 ] + size * ( c & 1 ), lo[ 1 ] + size * ( ( c >> 1 ) & 1 ),
+                        lo[ 2 ] + size * ( ( c >> 2 ) & 1 ) ) ) {
+          corners |= 1u << c;
+        }
+      }
+      if( !Manifold( corners ) ) {
+        return( false );
+      }
+      for( size_t i = 0; i < 3; ++i ) {
+        for( size_t j = 0; j < 3; ++j ) {
+          for( size_t k = 0; k < 3; ++k ) {
+            const size_t pos[ 3 ] = { i, j, k };
+            /* Corners of the cell the point lies between: every middle coordinate may go either way. */
+            unsigned int spanned = 0;
+            for( size_t c = 0; c < 8; ++c ) {
+              bool between = true;
+              for( size_t axis = 0; axis < 3; ++axis ) {
+                between = between && ( pos[ axis ] == 1 || pos[ axis ] == 2 * ( ( c >> axis ) & 1 ) );
+              }
+              spanned |= between ? 1u << c : 0u;
+            }
+            if( ( spanned & ( spanned - 1 ) ) == 0 ) {
+              continue;
+            }
+            bool inside = vol.Inside( lo[ 0 ] + half * i, lo[ 1 ] + half * j, lo[ 2 ] + half * k );
+            if( ( inside ? corners & spanned : ~corners & spanned ) == 0 ) {
+              return( false );
+            }
+          }
+        }
+      }
+      return( true );
+    }
+  };
+
+  /* Node of one of the blocks; null when node is negative. */
+  struct Ref {
+    const Block *block;
+    int32_t node;
+
+    bool Null( ) const {
+      return( node < 0 );
+    }
+
+    const Node &operator*( ) const {
+      return( block->nodes[ node ] );
+    }
+
+    /* Child c, or the node itself for leaves, which stand for all of their octants. */
+    Ref Child( int c ) const {
+      const Node &nd = block->nodes[ node ];
+      return( nd.leaf ? *this : Ref{ block, nd.child[ c ] } );
+    }
+  };
+
+  /* Walks the octree cells, faces and edges down to the minimal edges, as in Ju et al., Dual Contouring. */
+  class Contour {
+    std::vector< size_t > &tris;
+
+  public:
+    explicit Contour( std::vector< size_t > &tris ) : tris( tris ) {
+    }
+
+    void Cell( Ref n ) {
+      if( n.Null( ) || ( *n ).leaf ) {
+        return;
+      }
+      for( int c = 0; c < 8; ++c ) {
+        Cell( n.Child( c ) );
+      }
+      for( int d = 0; d < 3; ++d ) {
+        for( int c = 0; c < 8; ++c ) {
+          if( ( ( c >> d ) & 1 ) == 0 ) {
+            Face( n.Child( c ), n.Child( c | 1 << d ), d );
+          }
+        }
+      }
+      for( int a = 0; a < 3; ++a ) {
+        const int b = ( a + 1 ) % 3, c = ( a + 2 ) % 3;
+        for( int h = 0; h < 2; ++h ) {
+          Ref m[ 4 ];
+          for( int k = 0; k < 4; ++k ) {
+            m[ k ] = n.Child( h << a | sideB[ k ] << b | sideC[ k ] << c );
+          }
+          Edge( m, a );
+        }
+      }
+    }
+
+    /* Nodes n0 and n1 meet across a face normal to d, n0 on the low side. */
+    void Face( Ref n0, Ref n1, int d ) {
+      if( n0.Null( ) || n1.Null( ) || ( ( *n0 ).leaf && ( *n1 ).leaf ) ) {
+        return;
+      }
+      const int u = ( d + 1 ) % 3, v = ( d + 2 ) % 3;
+      for( int c = 0; c < 4; ++c ) {
+        const int in = ( c & 1 ) << u | ( c >> 1 ) << v;
+        Face( n0.Child( in | 1 << d ), n1.Child( in ), d );
+      }
+      /*
+       * Edges through the middle of the face: along u, with n0 and n1 on either side along c = d, then along v,
+       * with b = d. Along the other axis the children lie on the side of the edge they are listed for.
+       */
+      for( int h = 0; h < 2; ++h ) {
+        Ref m[ 4 ];
+        for( int k = 0; k < 4; ++k ) {
+          m[ k ] = ( sideC[ k ] ? n1 : n0 ).Child( h << u | sideB[ k ] << v | ( 1 - sideC[ k ] ) << d );
+        }
+        Edge( m, u );
+        for( int k = 0; k < 4; ++k ) {
+          m[ k ] = ( sideB[ k ] ? n1 : n0 ).Child( h << v | ( 1 - sideB[ k ] ) << d | sideC[ k ] << u );
+        }
+        Edge( m, v );
+      }
+    }
+
+    /* Nodes n around an edge along a, in the order of sideB and sideC. */
+    void Edge( const Ref n[ 4 ], int a ) {
+      bool leaves = true;
+      for( int k = 0; k < 4; ++k ) {
+        if( n[ k ].Null( ) ) {
+          return;
+        }
+        leaves = leaves && ( *n[ k ] ).leaf;
+      }
+      const int b = ( a + 1 ) % 3, c = ( a + 2 ) % 3;
+      if( leaves ) {
+        Polygon( n, a, b, c );
+        return;
+      }
+      for( int h = 0; h < 2; ++h ) {
+        Ref m[ 4 ];
+        for( int k = 0; k < 4; ++k ) {
+          m[ k ] = n[ k ].Child( h << a | ( 1 - sideB[ k ] ) << b | ( 1 - sideC[ k ] ) << c );
+        }
+        Edge( m, a );
+      }
+    }
+
+  private:
+    /* Polygon around the minimal edge, the edge of the smallest of the four leaves, if the surface crosses it. */
+    void Polygon( const Ref n[ 4 ], int a, int b, int c ) {
+      int smallest = 0;
+      for( int k = 1; k < 4; ++k ) {
+        if( ( *n[ k ] ).size < ( *n[ smallest ] ).size ) {
+          smallest = k;
+        }
+      }
+      const int c0 = ( 1 - sideB[ smallest ] ) << b | ( 1 - sideC[ smallest ] ) << c;
+      const unsigned int corners = ( *n[ smallest ] ).corners;
+      const unsigned int low = ( corners >> c0 ) & 1, high = ( corners >> ( c0 | 1 << a ) ) & 1;
+      if( low == high ) {
+        return;
+      }
+      /* Counterclockwise seen from +a; flipped when the surface faces -a, so faces point down the gradient. */
+      std::array< size_t, 4 > quad;
+      for( int k = 0; k < 4; ++k ) {
+        quad[ k ] = n[ k ].block->base + ( *n[ k ] ).vertex;
+      }
+      if( !low ) {
+        std::swap( quad[ 1 ], quad[ 3 ] );
+      }
+      /* A leaf larger than the others stands on two consecutive sides of the edge, leaving a triangle. */
+      for( int k = 0; k < 4; ++k ) {
+        if( quad[ k ] == quad[ ( k + 1 ) % 4 ] ) {
+          AddTriangle( quad[ ( k + 1 ) % 4 ], quad[ ( k + 2 ) % 4 ], quad[ ( k + 3 ) % 4 ] );
+          return;
+        }
+      }
+      /* Split along the shorter diagonal. */
+      size_t diag = DistanceSquared( Position( n, quad[ 0 ] ), Position( n, quad[ 2 ] ) ) <=
+                    DistanceSquared( Position( n, quad[ 1 ] ), Position( n, quad[ 3 ] ) ) ? 0 : 1;
+      AddTriangle( quad[ diag ], quad[ diag + 1 ], quad[ diag + 2 ] );
+      AddTriangle( quad[ diag ], quad[ diag + 2 ], quad[ ( diag + 3 ) % 4 ] );
+    }
+
+    void AddTriangle( size_t v0, size_t v1, size_t v2 ) {
+      tris.push_back( v0 );
+      tris.push_back( v1 );
+      tris.push_back( v2 );
+    }
+
+    /* Position of the vertex with sink index vertex, one of those of the leaves n. */
+    static const Point3D &Position( const Ref n[ 4 ], size_t vertex ) {
+      for( int k = 0; k < 3; ++k ) {
+        if( n[ k ].block->base + ( *n[ k ] ).vertex == vertex ) {
+          return( n[ k ].block->p[ ( *n[ k ] ).vertex ] );
+        }
+      }
+      return( n[ 3 ].block->p[ ( *n[ 3 ] ).vertex ] );
+    }
+  };
+
+}
+
+void AdaptiveContouring::exec( const Image< int > &img, float isolevel, MeshSink &sink, const Params &params,
+                               const Image< int > *mask, const VolumeStatistics *stats ) {
+  const Volume vol( img, mask, isolevel );
+  if( vol.xs < 2 || vol.ys < 2 || vol.zs < 2 ) {
+    return;
+  }
+  PROFILE_SCOPE( "AdaptiveContouring" );
+  /* Masked voxels change the values seen by the cells, so the block ranges of img do not apply. */
+  if( mask ) {
+    stats = nullptr;
+  }
+  size_t edge = 1;
+  while( edge * 2 <= std::min< size_t >( params.maxCell, UINT16_MAX ) ) {
+    edge *= 2;
+  }
+  const size_t cells[ 3 ] = { vol.xs - 1, vol.ys - 1, vol.zs - 1 };
+  const size_t blocks[ 3 ] = { ( cells[ 0 ] + edge - 1 ) / edge, ( cells[ 1 ] + edge - 1 ) / edge,
+                               ( cells[ 2 ] + edge - 1 ) / edge };
+  std::vector< Block > octrees( blocks[ 0 ] * blocks[ 1 ] * blocks[ 2 ] );
+  const size_t threads = HardwareThreads( params.threads );
+  {
+    PROFILE_SCOPE( "AdaptiveContouring::Build" );
+    ParallelRanges( 0, octrees.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+      for( size_t b = first; b < last; ++b ) {
+        Builder builder( vol, params.tolerance, stats, octrees[ b ] );
+        const size_t x = b % blocks[ 0 ], y = b / blocks[ 0 ] % blocks[ 1 ], z = b / blocks[ 0 ] / blocks[ 1 ];
+        octrees[ b ].root = builder.Build( x * edge, y * edge, z * edge, edge ).node;
+      }
+    } );
+  }
+  size_t unitCells = 0;
+  for( Block &block : octrees ) {
+    block.base = sink.Vertices( );
+    for( size_t v = 0; v < block.p.size( ); ++v ) {
+      sink.AddVertex( block.p[ v ], block.n[ v ] );
+    }
+    unitCells += block.cells;
+  }
+  std::vector< std::vector< size_t > > parts( threads );
+  {
+    PROFILE_SCOPE( "AdaptiveContouring::Contour" );
+    ParallelRanges( 0, octrees.size( ), threads, [ & ]( size_t first, size_t last, size_t part ) {
+      Contour contour( parts[ part ] );
+      for( size_t b = first; b < last; ++b ) {
+        const size_t pos[ 3 ] = { b % blocks[ 0 ], b / blocks[ 0 ] % blocks[ 1 ], b / blocks[ 0 ] / blocks[ 1 ] };
+        const size_t step[ 3 ] = { 1, blocks[ 0 ], blocks[ 0 ] * blocks[ 1 ] };
+        const Ref root{ &octrees[ b ], octrees[ b ].root };
+        contour.Cell( root );
+        /* Faces and edges shared with the blocks above, which the blocks own from their low side. */
+        for( int d = 0; d < 3; ++d ) {
+          if( pos[ d ] + 1 < blocks[ d ] ) {
+            contour.Face( root, Ref{ &octrees[ b + step[ d ] ], octrees[ b + step[ d ] ].root }, d );
+          }
+        }
+        for( int a = 0; a < 3; ++a ) {
+          const int u = ( a + 1 ) % 3, v = ( a + 2 ) % 3;
+          if( pos[ u ] + 1 < blocks[ u ] && pos[ v ] + 1 < blocks[ v ] ) {
+            Ref m[ 4 ];
+            for( int k = 0; k < 4; ++k ) {
+              const size_t nb = b + sideB[ k ] * step[ u ] + sideC[ k ] * step[ v ];
+              m[ k ] = Ref{ &octrees[ nb ], octrees[ nb ].root };
+            }
+            contour.Edge( m, a );
+          }
+        }
+      }
+    } );
+  }
+  const size_t firstTri = sink.Triangles( );
+  for( const std::vector< size_t > &part : parts ) {
+    for( size_t t = 0; t < part.size( ); t += 3 ) {
+      sink.AddTriangle( part[ t ], part[ t + 1 ], part[ t + 2 ] );
+    }
+  }
+  const size_t leaves = sink.Vertices( ) - octrees.front( ).base;
+  PROFILE_COUNT( "active cells", unitCells );
+  PROFILE_COUNT( "cells merged", unitCells - leaves );
+  PROFILE_COUNT( "triangles emitted", sink.Triangles( ) - firstTri );
+}
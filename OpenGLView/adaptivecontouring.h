@@ -0,0 +1,38 @@
+#ifndef ADAPTIVECONTOURING_H
+#define ADAPTIVECONTOURING_H
+
+#include "meshsink.h"
+
+#include <Common.hpp>
+
+using namespace Bial;
+
+/**
+ * Adaptive dual contouring over an octree of cells. Every crossed cell starts as a leaf with one vertex at the
+ * minimizer of the quadratic error of its crossing planes, as in SurfaceNets::Mode::DualContouring. Going up the
+ * octree, eight siblings are merged into one leaf wherever a single vertex still fits all their crossing planes
+ * within tolerance and the merge cannot change the topology of the surface, so flat regions end in large cells
+ * and curved ones keep the voxel resolution. Polygons are built around the minimal edges of the octree, the
+ * shortest leaf edge at every place where leaves meet, which stitches cells of different sizes without cracks.
+ */
+class AdaptiveContouring {
+public:
+  struct Params {
+    /* Largest root mean square distance, in voxels, from the vertex of a merged cell to its crossing planes. */
+    float tolerance = 0.1f;
+    /* Edge of the largest cells, in voxels; a power of two. */
+    size_t maxCell = 16;
+    /* 0 uses all hardware threads. */
+    size_t threads = 0;
+  };
+
+  /**
+   * Extracts the isosurface of img at isolevel into sink, with coordinates in voxels and normals following the
+   * volume gradient. Voxels where mask is zero are taken as outside the surface. With the statistics of img,
+   * blocks the isosurface cannot cross are skipped; they are ignored with a mask.
+   */
+  static void exec( const Image< int > &img, float isolevel, MeshSink &sink, const Params &params,
+                    const Image< int > *mask = nullptr, const VolumeStatistics *stats = nullptr );
+};
+
+#endif /* ADAPTIVECONTOURING_H */
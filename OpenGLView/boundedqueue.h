@@ -0,0 +1,71 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * Queue between two threads of a pipeline holding at most capacity items. A producer ahead of its consumer
+ * blocks in Push until there is room, so the items in flight, and their memory, stay bounded.
+ */
+template< typename T >
+class BoundedQueue {
+  std::mutex mtx;
+  std::condition_variable changed;
+  std::deque< T > items;
+  size_t capacity;
+  bool closed = false;
+
+public:
+  explicit BoundedQueue( size_t capacity ) : capacity( std::max< size_t >( 1, capacity ) ) {
+  }
+
+  /* Waits for room and appends item. Returns false, dropping item, once the queue is closed. */
+  bool Push( T item ) {
+    std::unique_lock< std::mutex > lock( mtx );
+    changed.wait( lock, [ this ]( ) {
+      return( closed || items.size( ) < capacity );
+    } );
+    if( closed ) {
+      return( false );
+    }
+    items.push_back( std::move( item ) );
+    changed.notify_all( );
+    return( true );
+  }
+
+  /* Waits for an item and takes it. Returns false once the queue is closed and empty. */
+  bool Pop( T &item ) {
+    std::unique_lock< std::mutex > lock( mtx );
+    changed.wait( lock, [ this ]( ) {
+      return( closed || !items.empty( ) );
+    } );
+    if( items.empty( ) ) {
+      return( false );
+    }
+    item = std::move( items.front( ) );
+    items.pop_front( );
+    changed.notify_all( );
+    return( true );
+  }
+
+  /* No more items: Pop returns those left, then false. */
+  void Close( ) {
+    std::lock_guard< std::mutex > lock( mtx );
+    closed = true;
+    changed.notify_all( );
+  }
+
+  /* Closes the queue and drops the items left, to stop both ends after an error. */
+  void Cancel( ) {
+    std::lock_guard< std::mutex > lock( mtx );
+    closed = true;
+    items.clear( );
+    changed.notify_all( );
+  }
+};
+
+#endif /* BOUNDEDQUEUE_H */
@@ -0,0 +1,164 @@
+#include "brickedvolume.h"
+
+#include "cubekernels.h"
+#include "meshsink.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "volumestatistics.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+const size_t BrickedVolume::Edge;
+const size_t BrickedVolume::Stride;
+const size_t BrickedVolume::BrickVoxels;
+
+static_assert( BrickedVolume::Edge == VolumeStatistics::BlockEdge, "Bricks are skipped by statistics block." );
+
+namespace {
+
+  /* Interleaves the low 10 bits of v with two zero bits each. */
+  uint32_t SpreadBits( uint32_t v ) {
+    v &= 0x3ff;
+    v = ( v | ( v << 16 ) ) & 0x030000ff;
+    v = ( v | ( v << 8 ) ) & 0x0300f00f;
+    v = ( v | ( v << 4 ) ) & 0x030c30c3;
+    v = ( v | ( v << 2 ) ) & 0x09249249;
+    return( v );
+  }
+
+  uint32_t Morton( uint32_t x, uint32_t y, uint32_t z ) {
+    return( SpreadBits( x ) | ( SpreadBits( y ) << 1 ) | ( SpreadBits( z ) << 2 ) );
+  }
+
+  /* Corner displacements in the order of Adjacency::MarchingCube( ). */
+  const size_t cubeCorners[ 8 ][ 3 ] = {
+    { 0, 0, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 0, 0, 0 },
+    { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, { 0, 1, 0 }
+  };
+
+}
+
+BrickedVolume::BrickedVolume( const Image< int > &img, size_t threads ) {
+  PROFILE_SCOPE( "BrickedVolume" );
+  for( size_t dim = 0; dim < 3; ++dim ) {
+    dims[ dim ] = img.size( dim );
+    bricks[ dim ] = ( dims[ dim ] + Edge - 1 ) / Edge;
+    if( bricks[ dim ] > 1024 ) {
+      throw std::runtime_error( "Volume too large to be bricked." );
+    }
+  }
+  const size_t count = bricks[ 0 ] * bricks[ 1 ] * bricks[ 2 ];
+  std::vector< uint32_t > order( count );
+  std::iota( order.begin( ), order.end( ), 0 );
+  std::vector< uint32_t > codes( count );
+  for( size_t brk = 0; brk < count; ++brk ) {
+    uint32_t bx = brk % bricks[ 0 ], by = ( brk / bricks[ 0 ] ) % bricks[ 1 ], bz = brk / ( bricks[ 0 ] * bricks[ 1 ] );
+    codes[ brk ] = Morton( bx, by, bz );
+  }
+  std::sort( order.begin( ), order.end( ), [ &codes ]( uint32_t a, uint32_t b ) {
+    return( codes[ a ] < codes[ b ] );
+  } );
+  positions.resize( count );
+  origins.resize( count );
+  for( size_t slot = 0; slot < count; ++slot ) {
+    uint32_t brk = order[ slot ];
+    positions[ brk ] = static_cast< uint32_t >( slot );
+    origins[ slot ] = { { static_cast< uint32_t >( brk % bricks[ 0 ] * Edge ),
+                          static_cast< uint32_t >( ( brk / bricks[ 0 ] ) % bricks[ 1 ] * Edge ),
+                          static_cast< uint32_t >( brk / ( bricks[ 0 ] * bricks[ 1 ] ) * Edge ) } };
+  }
+  data.resize( count * BrickVoxels );
+  if( count == 0 ) {
+    return;
+  }
+  const size_t xs = dims[ 0 ], ys = dims[ 1 ];
+  ParallelRanges( 0, count, HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t slot = first; slot < last; ++slot ) {
+      int *dst = &data[ slot * BrickVoxels ];
+      const std::array< uint32_t, 3 > &org = origins[ slot ];
+      for( size_t z = 0; z < Stride; ++z ) {
+        size_t gz = std::min< size_t >( org[ 2 ] + z, dims[ 2 ] - 1 );
+        for( size_t y = 0; y < Stride; ++y ) {
+          size_t gy = std::min< size_t >( org[ 1 ] + y, ys - 1 );
+          const size_t row = xs * ( gy + ys * gz );
+          for( size_t x = 0; x < Stride; ++x ) {
+            *dst++ = img[ row + std::min< size_t >( org[ 0 ] + x, xs - 1 ) ];
+          }
+        }
+      }
+    }
+  } );
+}
+
+Image< int > BrickedVolume::ToImage( ) const {
+  Image< int > img( dims[ 0 ], dims[ 1 ], dims[ 2 ] );
+  for( size_t slot = 0; slot < Bricks( ); ++slot ) {
+    const int *src = Brick( slot );
+    const std::array< uint32_t, 3 > &org = origins[ slot ];
+    for( size_t z = 0; z < Edge && org[ 2 ] + z < dims[ 2 ]; ++z ) {
+      for( size_t y = 0; y < Edge && org[ 1 ] + y < dims[ 1 ]; ++y ) {
+        for( size_t x = 0; x < Edge && org[ 0 ] + x < dims[ 0 ]; ++x ) {
+          img( org[ 0 ] + x, org[ 1 ] + y, org[ 2 ] + z ) = src[ x + Stride * ( y + Stride * z ) ];
+        }
+      }
+    }
+  }
+  return( img );
+}
+
+void BrickedVolume::ExtractMarchingCubes( const BrickedVolume &vol, float isolevel, MeshSink &sink,
+                                          size_t firstBrick, size_t lastBrick, const VolumeStatistics *stats ) {
+  if( vol.dims[ 0 ] < 2 || vol.dims[ 1 ] < 2 || vol.dims[ 2 ] < 2 ) {
+    return;
+  }
+  PROFILE_SCOPE( "ExtractMarchingCubes bricked" );
+  const size_t firstTri = sink.Triangles( );
+  size_t offsets[ 8 ];
+  for( size_t vtx = 0; vtx < 8; ++vtx ) {
+    offsets[ vtx ] = cubeCorners[ vtx ][ 0 ] + Stride * ( cubeCorners[ vtx ][ 1 ] + Stride * cubeCorners[ vtx ][ 2 ] );
+  }
+  size_t active = 0, scanned = 0;
+  Cell cell;
+  lastBrick = std::min( lastBrick, vol.Bricks( ) );
+  for( size_t brk = firstBrick; brk < lastBrick; ++brk ) {
+    const int *src = vol.Brick( brk );
+    size_t ox, oy, oz;
+    vol.Origin( brk, ox, oy, oz );
+    /* Cells whose last corner would fall outside of the volume are not cells. */
+    const size_t xe = std::min( Edge, vol.dims[ 0 ] - 1 - std::min( ox, vol.dims[ 0 ] - 1 ) );
+    const size_t ye = std::min( Edge, vol.dims[ 1 ] - 1 - std::min( oy, vol.dims[ 1 ] - 1 ) );
+    const size_t ze = std::min( Edge, vol.dims[ 2 ] - 1 - std::min( oz, vol.dims[ 2 ] - 1 ) );
+    /*
+     * A last brick holding only the last voxel plane has no cells, and no statistics block. The other bricks cover
+     * the same cells as the statistics blocks.
+     */
+    if( xe == 0 || ye == 0 || ze == 0 || ( stats && !stats->MayCross( ox, oy, oz, isolevel ) ) ) {
+      continue;
+    }
+    scanned += xe * ye * ze;
+    for( size_t z = 0; z < ze; ++z ) {
+      for( size_t y = 0; y < ye; ++y ) {
+        const int *row = src + Stride * ( y + Stride * z );
+        for( size_t x = 0; x < xe; ++x ) {
+          for( size_t vtx = 0; vtx < 8; ++vtx ) {
+            cell.val[ vtx ] = row[ x + offsets[ vtx ] ];
+          }
+          cell.calcIdx( isolevel );
+          if( CubeKernels::Edges( cell.idx ) != 0 ) {
+            for( size_t vtx = 0; vtx < 8; ++vtx ) {
+              cell.p[ vtx ] = Vector3D( ox + x + cubeCorners[ vtx ][ 0 ], oy + y + cubeCorners[ vtx ][ 1 ],
+                                        oz + z + cubeCorners[ vtx ][ 2 ] );
+            }
+            sink.Polygonize( cell, isolevel );
+            ++active;
+          }
+        }
+      }
+    }
+  }
+  PROFILE_COUNT( "cells scanned", scanned );
+  PROFILE_COUNT( "active cells", active );
+  PROFILE_COUNT( "triangles emitted", sink.Triangles( ) - firstTri );
+}
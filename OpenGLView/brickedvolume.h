@@ -0,0 +1,107 @@
+#ifndef BRICKEDVOLUME_H
+#define BRICKEDVOLUME_H
+
+#include <Common.hpp>
+#include <Draw.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace Bial;
+
+class MeshSink;
+class VolumeStatistics;
+
+/**
+ * Volume stored as 16^3 bricks laid out in Z (Morton) order, so that neighboring voxels in any direction are
+ * usually in the same few cache lines and pages. Every brick also keeps a copy of the first plane of its +x, +y
+ * and +z neighbors (a one voxel halo, replicated at the volume border), so the eight corners of any cell starting
+ * in a brick are read from that brick alone. Costs 1.2x the memory of the Image it was built from.
+ */
+class BrickedVolume {
+public:
+  static const size_t Edge = 16;
+  static const size_t Stride = Edge + 1;
+  static const size_t BrickVoxels = Stride * Stride * Stride;
+
+  explicit BrickedVolume( const Image< int > &img, size_t threads = 1 );
+
+  size_t size( size_t dim ) const {
+    return( dims[ dim ] );
+  }
+
+  /* Number of bricks, also the number of positions in Z order. */
+  size_t Bricks( ) const {
+    return( origins.size( ) );
+  }
+
+  /* Voxel coordinates of the first voxel of the brick at Z order position brick. */
+  void Origin( size_t brick, size_t &x, size_t &y, size_t &z ) const {
+    x = origins[ brick ][ 0 ];
+    y = origins[ brick ][ 1 ];
+    z = origins[ brick ][ 2 ];
+  }
+
+  /* Stride^3 voxels of a brick including its halo, x fastest. */
+  const int* Brick( size_t brick ) const {
+    return( &data[ brick * BrickVoxels ] );
+  }
+
+  int operator()( size_t x, size_t y, size_t z ) const {
+    size_t slot = positions[ x / Edge + bricks[ 0 ] * ( y / Edge + bricks[ 1 ] * ( z / Edge ) ) ];
+    return( data[ slot * BrickVoxels + x % Edge + Stride * ( y % Edge + Stride * ( z % Edge ) ) ] );
+  }
+
+  bool ValidPixel( double x, double y, double z ) const {
+    return( x >= 0.0 && y >= 0.0 && z >= 0.0 && x < dims[ 0 ] && y < dims[ 1 ] && z < dims[ 2 ] );
+  }
+
+  Image< int > ToImage( ) const;
+
+  /*
+   * Nearest neighbor resampling: voxel ( x, y, z ) of the result takes the voxel at outToIn( Point3D( x, y, z ) ),
+   * or stays 0 outside of the volume. The result is walked in 16^3 tiles, so for rotations the reads stay within a
+   * few bricks at a time instead of sweeping whole planes of the source.
+   */
+  template< typename Transform >
+  Image< int > Reslice( const Transform &outToIn, size_t xs, size_t ys, size_t zs ) const;
+
+  /*
+   * Marching cubes over the cells starting in bricks [ firstBrick, lastBrick ) of the Z order, brick by brick.
+   * With the statistics of the volume, bricks the isosurface cannot cross are skipped.
+   */
+  static void ExtractMarchingCubes( const BrickedVolume &vol, float isolevel, MeshSink &sink, size_t firstBrick,
+                                    size_t lastBrick, const VolumeStatistics *stats = nullptr );
+
+private:
+  size_t dims[ 3 ];
+  size_t bricks[ 3 ];
+  /* Z order position of each brick, indexed by brick x + bricks[0] * ( y + bricks[1] * z ). */
+  std::vector< uint32_t > positions;
+  std::vector< std::array< uint32_t, 3 > > origins;
+  std::vector< int > data;
+};
+
+template< typename Transform >
+Image< int > BrickedVolume::Reslice( const Transform &outToIn, size_t xs, size_t ys, size_t zs ) const {
+  Image< int > res( xs, ys, zs );
+  for( size_t tz = 0; tz < zs; tz += Edge ) {
+    for( size_t ty = 0; ty < ys; ty += Edge ) {
+      for( size_t tx = 0; tx < xs; tx += Edge ) {
+        for( size_t z = tz; z < std::min( zs, tz + Edge ); ++z ) {
+          for( size_t y = ty; y < std::min( ys, ty + Edge ); ++y ) {
+            for( size_t x = tx; x < std::min( xs, tx + Edge ); ++x ) {
+              Point3D pos = outToIn( Point3D( x, y, z ) );
+              if( ValidPixel( pos.x, pos.y, pos.z ) ) {
+                res( x, y, z ) = ( *this )( pos.x, pos.y, pos.z );
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return( res );
+}
+
+#endif /* BRICKEDVOLUME_H */
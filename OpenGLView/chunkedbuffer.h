@@ -0,0 +1,81 @@
+#ifndef CHUNKEDBUFFER_H
+#define CHUNKEDBUFFER_H
+
+#include <Common.hpp>
+#include <memory>
+#include <vector>
+
+using namespace Bial;
+
+/**
+ * Append-only buffer made of fixed size chunks. Growing it never moves the elements already stored, so the
+ * extraction loops can append without the reallocation-and-copy cycles of a growing Vector. Flatten copies the
+ * elements into a contiguous Vector of the exact final size, releasing each chunk as soon as it is copied.
+ */
+template< typename T, size_t ChunkBits = 16 >
+class ChunkedBuffer {
+  static const size_t chunkSize = size_t( 1 ) << ChunkBits;
+  static const size_t chunkMask = chunkSize - 1;
+
+  std::vector< std::unique_ptr< T[] > > chunks;
+  size_t count = 0;
+
+public:
+  ChunkedBuffer( ) = default;
+  ChunkedBuffer( ChunkedBuffer &&other ) = default;
+  ChunkedBuffer &operator=( ChunkedBuffer &&other ) = default;
+  ChunkedBuffer( const ChunkedBuffer &other ) = delete;
+  ChunkedBuffer &operator=( const ChunkedBuffer &other ) = delete;
+
+  size_t size( ) const {
+    return( count );
+  }
+
+  bool empty( ) const {
+    return( count == 0 );
+  }
+
+  void push_back( const T &value ) {
+    if( ( count & chunkMask ) == 0 && ( count >> ChunkBits ) == chunks.size( ) ) {
+      chunks.emplace_back( new T[ chunkSize ] );
+    }
+    chunks[ count >> ChunkBits ][ count & chunkMask ] = value;
+    ++count;
+  }
+
+  T &operator[]( size_t idx ) {
+    return( chunks[ idx >> ChunkBits ][ idx & chunkMask ] );
+  }
+
+  const T &operator[]( size_t idx ) const {
+    return( chunks[ idx >> ChunkBits ][ idx & chunkMask ] );
+  }
+
+  void clear( ) {
+    chunks.clear( );
+    count = 0;
+  }
+
+  /* Moves the contents into a contiguous Vector, leaving this buffer empty. */
+  template< typename D = T >
+  Vector< D > Flatten( ) {
+    Vector< D > res( count );
+    for( size_t chk = 0, pos = 0; chk < chunks.size( ); ++chk ) {
+      size_t len = std::min( chunkSize, count - pos );
+      std::copy( chunks[ chk ].get( ), chunks[ chk ].get( ) + len, res.begin( ) + pos );
+      pos += len;
+      chunks[ chk ].reset( );
+    }
+    clear( );
+    return( res );
+  }
+};
+
+/* Flatten passes chunkSize to std::min by reference, which needs a definition. */
+template< typename T, size_t ChunkBits >
+const size_t ChunkedBuffer< T, ChunkBits >::chunkSize;
+
+template< typename T, size_t ChunkBits >
+const size_t ChunkedBuffer< T, ChunkBits >::chunkMask;
+
+#endif /* CHUNKEDBUFFER_H */
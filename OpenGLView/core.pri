@@ -0,0 +1,64 @@
+# Mesh extraction, processing and I/O shared by the viewer, the tests and the command line tools.
+# Nothing here depends on Qt or OpenGL.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/surfacenets.cpp \
+    $$PWD/adaptivecontouring.cpp \
+    $$PWD/brickedvolume.cpp \
+    $$PWD/cubekernels.cpp \
+    $$PWD/meshsink.cpp \
+    $$PWD/meshio.cpp \
+    $$PWD/mappedvolume.cpp \
+    $$PWD/meshwelder.cpp \
+    $$PWD/meshpipeline.cpp \
+    $$PWD/meshstream.cpp \
+    $$PWD/pipelinecache.cpp \
+    $$PWD/meshoptimizer.cpp \
+    $$PWD/meshclusters.cpp \
+    $$PWD/meshmetrics.cpp \
+    $$PWD/meshvoxelizer.cpp \
+    $$PWD/slicecontours.cpp \
+    $$PWD/slicereader.cpp \
+    $$PWD/softwarerenderer.cpp \
+    $$PWD/taskscheduler.cpp \
+    $$PWD/timeseries.cpp \
+    $$PWD/meshsmoother.cpp \
+    $$PWD/volumestatistics.cpp \
+    $$PWD/niftiinfo.cpp \
+    $$PWD/profiler.cpp
+
+HEADERS += \
+    $$PWD/surfacenets.h \
+    $$PWD/adaptivecontouring.h \
+    $$PWD/brickedvolume.h \
+    $$PWD/boundedqueue.h \
+    $$PWD/chunkedbuffer.h \
+    $$PWD/cubekernels.h \
+    $$PWD/meshsink.h \
+    $$PWD/meshdata.h \
+    $$PWD/meshio.h \
+    $$PWD/mappedfile.h \
+    $$PWD/mappedvolume.h \
+    $$PWD/meshwelder.h \
+    $$PWD/meshpipeline.h \
+    $$PWD/meshstream.h \
+    $$PWD/pipelinecache.h \
+    $$PWD/meshoptimizer.h \
+    $$PWD/meshclusters.h \
+    $$PWD/meshmetrics.h \
+    $$PWD/meshvoxelizer.h \
+    $$PWD/slicecontours.h \
+    $$PWD/slicereader.h \
+    $$PWD/softwarerenderer.h \
+    $$PWD/taskscheduler.h \
+    $$PWD/timeseries.h \
+    $$PWD/meshsmoother.h \
+    $$PWD/volumestatistics.h \
+    $$PWD/niftiinfo.h \
+    $$PWD/parallel.h \
+    $$PWD/profiler.h
+
+LIBS += -lz
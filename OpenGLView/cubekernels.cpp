@@ -0,0 +1,433 @@
+#include "cubekernels.h"
+#include "meshsink.h"
+
+namespace {
+
+  /*
+   * Corners of each edge, numbered as in MarchingCubes, the lower one first. Every cell sharing an edge then
+   * interpolates it the same way and gives bitwise the same vertex.
+   */
+  constexpr uint8_t edgeCorners[ 12 ][ 2 ] = {
+    { 0, 1 }, { 2, 1 }, { 3, 2 }, { 3, 0 },
+    { 4, 5 }, { 6, 5 }, { 7, 6 }, { 7, 4 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+  };
+
+  /*
+   * For each corner and axis, the corners one voxel above and below along the axis within the cell, one of them
+   * the corner itself. Corner c is displaced by cubeCorners[ c ] of MeshSink.
+   */
+  constexpr uint8_t axisCorners[ 8 ][ 3 ][ 2 ] = {
+    { { 1, 0 }, { 4, 0 }, { 0, 3 } }, { { 1, 0 }, { 5, 1 }, { 1, 2 } },
+    { { 2, 3 }, { 6, 2 }, { 1, 2 } }, { { 2, 3 }, { 7, 3 }, { 0, 3 } },
+    { { 5, 4 }, { 4, 0 }, { 4, 7 } }, { { 5, 4 }, { 5, 1 }, { 5, 6 } },
+    { { 6, 7 }, { 6, 2 }, { 5, 6 } }, { { 6, 7 }, { 7, 3 }, { 4, 7 } }
+  };
+
+  /*
+   * Triangles of each case as edge triples ended by -1, wound counterclockwise seen from the corners below the
+   * isolevel. On a face with two diagonal corners below the isolevel, every case cuts each of them off, so cells
+   * sharing the face cut it the same way and the surface has no cracks.
+   */
+  constexpr int8_t triangleTable[ 256 ][ 16 ] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 2, 10, 0, 2, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 8, 3, 2, 10, 8, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 11, 2, 8, 11, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 9, 0, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 11, 2, 1, 9, 11, 9, 8, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 10, 1, 11, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 10, 1, 0, 8, 10, 8, 11, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 9, 0, 3, 11, 9, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 3, 0, 7, 3, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 1, 9, 4, 7, 1, 7, 3, 1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 10, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 4, 7, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 2, 10, 9, 0, 2, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 10, 9, 2, 9, 7, 2, 7, 3, 7, 9, 4, -1, -1, -1, -1 },
+    { 8, 4, 7, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 11, 4, 7, 11, 2, 4, 2, 0, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 0, 1, 8, 4, 7, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 7, 11, 9, 4, 11, 9, 11, 2, 9, 2, 1, -1, -1, -1, -1 },
+    { 3, 10, 1, 3, 11, 10, 7, 8, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 11, 10, 1, 4, 11, 1, 0, 4, 7, 11, 4, -1, -1, -1, -1 },
+    { 4, 7, 8, 9, 0, 11, 9, 11, 10, 11, 0, 3, -1, -1, -1, -1 },
+    { 4, 7, 11, 4, 11, 9, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 5, 4, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 5, 4, 1, 5, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 5, 4, 8, 3, 5, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 10, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 0, 8, 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 2, 10, 5, 4, 2, 4, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 10, 5, 3, 2, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1 },
+    { 9, 5, 4, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 11, 2, 0, 8, 11, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 5, 4, 0, 1, 5, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 1, 5, 2, 5, 8, 2, 8, 11, 4, 8, 5, -1, -1, -1, -1 },
+    { 10, 3, 11, 10, 1, 3, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 9, 5, 0, 8, 1, 8, 10, 1, 8, 11, 10, -1, -1, -1, -1 },
+    { 5, 4, 0, 5, 0, 11, 5, 11, 10, 11, 0, 3, -1, -1, -1, -1 },
+    { 5, 4, 8, 5, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 7, 8, 5, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 3, 0, 9, 5, 3, 5, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 7, 8, 0, 1, 7, 1, 5, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 7, 8, 9, 5, 7, 10, 1, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 1, 2, 9, 5, 0, 5, 3, 0, 5, 7, 3, -1, -1, -1, -1 },
+    { 8, 0, 2, 8, 2, 5, 8, 5, 7, 10, 5, 2, -1, -1, -1, -1 },
+    { 2, 10, 5, 2, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 9, 5, 7, 8, 9, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 5, 7, 9, 7, 2, 9, 2, 0, 2, 7, 11, -1, -1, -1, -1 },
+    { 2, 3, 11, 0, 1, 8, 1, 7, 8, 1, 5, 7, -1, -1, -1, -1 },
+    { 11, 2, 1, 11, 1, 7, 7, 1, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 5, 8, 8, 5, 7, 10, 1, 3, 10, 3, 11, -1, -1, -1, -1 },
+    { 5, 7, 0, 5, 0, 9, 7, 11, 0, 1, 0, 10, 11, 10, 0, -1 },
+    { 11, 10, 0, 11, 0, 3, 10, 5, 0, 8, 0, 7, 5, 7, 0, -1 },
+    { 11, 10, 5, 7, 11, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 0, 1, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 8, 3, 1, 9, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 6, 5, 2, 6, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 6, 5, 1, 2, 6, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 6, 5, 9, 0, 6, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 9, 8, 5, 8, 2, 5, 2, 6, 3, 2, 8, -1, -1, -1, -1 },
+    { 2, 3, 11, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 11, 0, 8, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 10, 6, 1, 9, 2, 9, 11, 2, 9, 8, 11, -1, -1, -1, -1 },
+    { 6, 3, 11, 6, 5, 3, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 11, 0, 11, 5, 0, 5, 1, 5, 11, 6, -1, -1, -1, -1 },
+    { 3, 11, 6, 0, 3, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1 },
+    { 6, 5, 9, 6, 9, 11, 11, 9, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 10, 6, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 3, 0, 4, 7, 3, 6, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 9, 0, 5, 10, 6, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 6, 5, 1, 9, 7, 1, 7, 3, 7, 9, 4, -1, -1, -1, -1 },
+    { 6, 1, 2, 6, 5, 1, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 5, 5, 2, 6, 3, 0, 4, 3, 4, 7, -1, -1, -1, -1 },
+    { 8, 4, 7, 9, 0, 5, 0, 6, 5, 0, 2, 6, -1, -1, -1, -1 },
+    { 7, 3, 9, 7, 9, 4, 3, 2, 9, 5, 9, 6, 2, 6, 9, -1 },
+    { 3, 11, 2, 7, 8, 4, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 10, 6, 4, 7, 2, 4, 2, 0, 2, 7, 11, -1, -1, -1, -1 },
+    { 0, 1, 9, 4, 7, 8, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1 },
+    { 9, 2, 1, 9, 11, 2, 9, 4, 11, 7, 11, 4, 5, 10, 6, -1 },
+    { 8, 4, 7, 3, 11, 5, 3, 5, 1, 5, 11, 6, -1, -1, -1, -1 },
+    { 5, 1, 11, 5, 11, 6, 1, 0, 11, 7, 11, 4, 0, 4, 11, -1 },
+    { 0, 5, 9, 0, 6, 5, 0, 3, 6, 11, 6, 3, 8, 4, 7, -1 },
+    { 6, 5, 9, 6, 9, 11, 4, 7, 9, 7, 11, 9, -1, -1, -1, -1 },
+    { 10, 4, 9, 6, 4, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 10, 6, 4, 9, 10, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 0, 1, 10, 6, 0, 6, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 3, 1, 8, 1, 6, 8, 6, 4, 6, 1, 10, -1, -1, -1, -1 },
+    { 1, 4, 9, 1, 2, 4, 2, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 0, 8, 1, 2, 9, 2, 4, 9, 2, 6, 4, -1, -1, -1, -1 },
+    { 0, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 3, 2, 8, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 4, 9, 10, 6, 4, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 2, 2, 8, 11, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1 },
+    { 3, 11, 2, 0, 1, 6, 0, 6, 4, 6, 1, 10, -1, -1, -1, -1 },
+    { 6, 4, 1, 6, 1, 10, 4, 8, 1, 2, 1, 11, 8, 11, 1, -1 },
+    { 9, 6, 4, 9, 3, 6, 9, 1, 3, 11, 6, 3, -1, -1, -1, -1 },
+    { 8, 11, 1, 8, 1, 0, 11, 6, 1, 9, 1, 4, 6, 4, 1, -1 },
+    { 3, 11, 6, 3, 6, 0, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 6, 4, 8, 11, 6, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 10, 6, 7, 8, 10, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 7, 3, 0, 10, 7, 0, 9, 10, 6, 7, 10, -1, -1, -1, -1 },
+    { 10, 6, 7, 1, 10, 7, 1, 7, 8, 1, 8, 0, -1, -1, -1, -1 },
+    { 10, 6, 7, 10, 7, 1, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 6, 1, 6, 8, 1, 8, 9, 8, 6, 7, -1, -1, -1, -1 },
+    { 2, 6, 9, 2, 9, 1, 6, 7, 9, 0, 9, 3, 7, 3, 9, -1 },
+    { 7, 8, 0, 7, 0, 6, 6, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 3, 2, 6, 7, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 3, 11, 10, 6, 8, 10, 8, 9, 8, 6, 7, -1, -1, -1, -1 },
+    { 2, 0, 7, 2, 7, 11, 0, 9, 7, 6, 7, 10, 9, 10, 7, -1 },
+    { 1, 8, 0, 1, 7, 8, 1, 10, 7, 6, 7, 10, 2, 3, 11, -1 },
+    { 11, 2, 1, 11, 1, 7, 10, 6, 1, 6, 7, 1, -1, -1, -1, -1 },
+    { 8, 9, 6, 8, 6, 7, 9, 1, 6, 11, 6, 3, 1, 3, 6, -1 },
+    { 0, 9, 1, 11, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 8, 0, 7, 0, 6, 3, 11, 0, 11, 6, 0, -1, -1, -1, -1 },
+    { 7, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 9, 3, 9, 8, 3, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 10, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 1, 2, 10, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 2, 9, 2, 10, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 10, 3, 10, 9, 3, 9, 8, 3, 6, 11, 7, -1, -1, -1, -1 },
+    { 7, 2, 3, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 7, 0, 8, 7, 6, 0, 6, 2, 0, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 2, 3, 6, 3, 7, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 6, 2, 1, 8, 6, 1, 9, 8, 8, 7, 6, -1, -1, -1, -1 },
+    { 10, 7, 6, 10, 1, 7, 1, 3, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 7, 6, 1, 7, 10, 1, 8, 7, 1, 0, 8, -1, -1, -1, -1 },
+    { 0, 3, 7, 0, 7, 10, 0, 10, 9, 6, 10, 7, -1, -1, -1, -1 },
+    { 7, 6, 10, 7, 10, 8, 8, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+    { 6, 8, 4, 11, 8, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 6, 11, 3, 0, 6, 0, 4, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 4, 6, 8, 6, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 4, 6, 9, 6, 3, 9, 3, 1, 11, 3, 6, -1, -1, -1, -1 },
+    { 1, 2, 10, 4, 6, 8, 6, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 4, 3, 4, 6, 3, 6, 11, 3, 1, 2, 10, -1, -1, -1, -1 },
+    { 0, 2, 9, 2, 10, 9, 4, 6, 8, 6, 11, 8, -1, -1, -1, -1 },
+    { 2, 10, 3, 10, 9, 3, 9, 4, 3, 4, 6, 3, 6, 11, 3, -1 },
+    { 8, 2, 3, 8, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 2, 3, 6, 3, 8, 6, 8, 4, 6, -1, -1, -1, -1 },
+    { 1, 9, 4, 1, 4, 2, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 1, 3, 8, 6, 1, 8, 4, 6, 6, 10, 1, -1, -1, -1, -1 },
+    { 10, 1, 0, 10, 0, 6, 6, 0, 4, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 3, 9, 3, 6, 9, 3, 8, 6, 8, 4, 6, 6, 10, 9, -1 },
+    { 10, 9, 4, 6, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 4, 1, 5, 4, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 5, 3, 5, 4, 3, 4, 8, 3, 6, 11, 7, -1, -1, -1, -1 },
+    { 1, 2, 10, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 1, 2, 10, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1 },
+    { 0, 2, 4, 2, 10, 4, 10, 5, 4, 6, 11, 7, -1, -1, -1, -1 },
+    { 2, 10, 3, 10, 5, 3, 5, 4, 3, 4, 8, 3, 6, 11, 7, -1 },
+    { 2, 3, 6, 3, 7, 6, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 2, 8, 7, 2, 7, 6, 2, 4, 9, 5, -1, -1, -1, -1 },
+    { 0, 1, 4, 1, 5, 4, 2, 3, 6, 3, 7, 6, -1, -1, -1, -1 },
+    { 1, 5, 2, 5, 4, 2, 4, 8, 2, 8, 7, 2, 7, 6, 2, -1 },
+    { 1, 3, 10, 3, 7, 10, 7, 6, 10, 4, 9, 5, -1, -1, -1, -1 },
+    { 0, 8, 1, 8, 7, 1, 7, 6, 1, 6, 10, 1, 4, 9, 5, -1 },
+    { 0, 3, 4, 3, 10, 4, 3, 7, 10, 7, 6, 10, 10, 5, 4, -1 },
+    { 4, 8, 5, 8, 10, 5, 8, 7, 10, 7, 6, 10, -1, -1, -1, -1 },
+    { 6, 9, 5, 6, 11, 9, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 6, 11, 0, 6, 3, 0, 5, 6, 0, 9, 5, -1, -1, -1, -1 },
+    { 0, 11, 8, 0, 5, 11, 0, 1, 5, 5, 6, 11, -1, -1, -1, -1 },
+    { 6, 11, 3, 6, 3, 5, 5, 3, 1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 10, 5, 6, 9, 6, 11, 9, 11, 8, 9, -1, -1, -1, -1 },
+    { 0, 9, 3, 9, 5, 3, 5, 6, 3, 6, 11, 3, 1, 2, 10, -1 },
+    { 0, 2, 8, 2, 10, 8, 10, 5, 8, 5, 6, 8, 6, 11, 8, -1 },
+    { 2, 10, 3, 10, 5, 3, 5, 6, 3, 6, 11, 3, -1, -1, -1, -1 },
+    { 5, 8, 9, 5, 2, 8, 5, 6, 2, 3, 8, 2, -1, -1, -1, -1 },
+    { 9, 5, 6, 9, 6, 0, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 8, 1, 5, 8, 5, 6, 8, 6, 2, 8, 2, 3, 8, -1 },
+    { 1, 5, 6, 2, 1, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 3, 10, 3, 8, 10, 8, 6, 10, 8, 9, 6, 9, 5, 6, -1 },
+    { 0, 6, 1, 0, 9, 6, 9, 5, 6, 6, 10, 1, -1, -1, -1, -1 },
+    { 0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 10, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 11, 5, 10, 7, 5, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 5, 10, 7, 10, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 5, 10, 7, 10, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 9, 3, 9, 8, 3, 5, 10, 7, 10, 11, 7, -1, -1, -1, -1 },
+    { 11, 1, 2, 11, 7, 1, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 1, 2, 5, 2, 11, 5, 11, 7, 5, -1, -1, -1, -1 },
+    { 9, 7, 5, 9, 2, 7, 9, 0, 2, 2, 11, 7, -1, -1, -1, -1 },
+    { 2, 5, 3, 2, 11, 5, 11, 7, 5, 5, 9, 3, 9, 8, 3, -1 },
+    { 2, 5, 10, 2, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 2, 0, 8, 5, 2, 8, 7, 5, 10, 2, 5, -1, -1, -1, -1 },
+    { 0, 1, 9, 2, 3, 10, 3, 7, 10, 7, 5, 10, -1, -1, -1, -1 },
+    { 1, 9, 2, 9, 8, 2, 8, 7, 2, 7, 5, 2, 5, 10, 2, -1 },
+    { 1, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 7, 0, 7, 1, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 0, 3, 9, 3, 5, 5, 3, 7, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 8, 7, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 8, 4, 5, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 5, 0, 4, 5, 11, 0, 5, 10, 11, 11, 3, 0, -1, -1, -1, -1 },
+    { 0, 1, 9, 4, 5, 8, 5, 10, 8, 10, 11, 8, -1, -1, -1, -1 },
+    { 1, 9, 3, 9, 4, 3, 4, 5, 3, 5, 10, 3, 10, 11, 3, -1 },
+    { 2, 5, 1, 2, 8, 5, 2, 11, 8, 4, 5, 8, -1, -1, -1, -1 },
+    { 0, 4, 3, 4, 5, 3, 5, 11, 3, 5, 1, 11, 1, 2, 11, -1 },
+    { 0, 2, 9, 2, 11, 9, 11, 5, 9, 11, 8, 5, 8, 4, 5, -1 },
+    { 9, 4, 5, 2, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 5, 10, 3, 5, 2, 3, 4, 5, 3, 8, 4, -1, -1, -1, -1 },
+    { 5, 10, 2, 5, 2, 4, 4, 2, 0, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 9, 2, 3, 10, 3, 8, 10, 8, 4, 10, 4, 5, 10, -1 },
+    { 1, 9, 2, 9, 4, 2, 4, 5, 2, 5, 10, 2, -1, -1, -1, -1 },
+    { 8, 4, 5, 8, 5, 3, 3, 5, 1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 4, 5, 1, 0, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 3, 9, 3, 5, 9, 3, 8, 5, 8, 4, 5, -1, -1, -1, -1 },
+    { 9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 11, 7, 4, 9, 11, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 3, 4, 9, 7, 9, 10, 7, 10, 11, 7, -1, -1, -1, -1 },
+    { 1, 10, 11, 1, 11, 4, 1, 4, 0, 7, 4, 11, -1, -1, -1, -1 },
+    { 1, 10, 3, 10, 4, 3, 10, 11, 4, 11, 7, 4, 4, 8, 3, -1 },
+    { 4, 11, 7, 9, 11, 4, 9, 2, 11, 9, 1, 2, -1, -1, -1, -1 },
+    { 0, 8, 3, 1, 2, 9, 2, 11, 9, 11, 7, 9, 7, 4, 9, -1 },
+    { 11, 7, 4, 11, 4, 2, 2, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 4, 3, 2, 11, 4, 11, 7, 4, 4, 8, 3, -1, -1, -1, -1 },
+    { 2, 9, 10, 2, 7, 9, 2, 3, 7, 7, 4, 9, -1, -1, -1, -1 },
+    { 0, 8, 2, 8, 7, 2, 7, 4, 2, 4, 9, 2, 9, 10, 2, -1 },
+    { 0, 1, 4, 1, 10, 4, 10, 2, 4, 2, 3, 4, 3, 7, 4, -1 },
+    { 1, 10, 2, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 9, 1, 4, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 8, 1, 8, 7, 1, 7, 4, 1, 4, 9, 1, -1, -1, -1, -1 },
+    { 4, 0, 3, 7, 4, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 0, 9, 3, 9, 11, 11, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 10, 0, 10, 8, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 1, 10, 11, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 2, 11, 1, 11, 9, 9, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 9, 3, 9, 11, 3, 9, 1, 11, 1, 2, 11, -1, -1, -1, -1 },
+    { 0, 2, 11, 8, 0, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 2, 3, 8, 2, 8, 10, 10, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+    { 9, 10, 2, 0, 9, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 8, 1, 10, 8, 10, 2, 8, 2, 3, 8, -1, -1, -1, -1 },
+    { 1, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }
+  };
+
+  constexpr int Entry( unsigned idx, unsigned k ) {
+    return( triangleTable[ idx ][ k ] );
+  }
+
+  constexpr unsigned TriangleCount( unsigned idx, unsigned k = 0 ) {
+    return( k < 15 && Entry( idx, k ) >= 0 ? 1 + TriangleCount( idx, k + 3 ) : 0 );
+  }
+
+  /* Edges used by the triangles of case idx. */
+  constexpr uint16_t UsedEdges( unsigned idx, unsigned k = 0 ) {
+    return( k < 15 && Entry( idx, k ) >= 0 ? ( 1u << Entry( idx, k ) ) | UsedEdges( idx, k + 1 ) : 0 );
+  }
+
+  constexpr bool Uses( unsigned idx, unsigned edge ) {
+    return( edge < 12 && ( UsedEdges( idx ) & ( 1u << edge ) ) != 0 );
+  }
+
+  /* Edges whose corners lie on different sides of the isosurface in case idx. */
+  constexpr uint16_t CrossedEdges( unsigned idx, unsigned edge = 0 ) {
+    return( edge < 12 ? ( ( ( idx >> edgeCorners[ edge ][ 0 ] ^ idx >> edgeCorners[ edge ][ 1 ] ) & 1u ) << edge ) |
+                        CrossedEdges( idx, edge + 1 ) : 0 );
+  }
+
+  constexpr bool UsesCrossedEdges( unsigned idx = 0 ) {
+    return( idx == 256 || ( UsedEdges( idx ) == CrossedEdges( idx ) && UsesCrossedEdges( idx + 1 ) ) );
+  }
+
+  static_assert( UsesCrossedEdges( ), "every case must place a vertex on each crossed edge, and only there" );
+  static_assert( UsedEdges( 12 ) == 0xc0a, "case 12 must match MarchingCubes::edgeTable" );
+  static_assert( TriangleCount( 0 ) == 0 && TriangleCount( 255 ) == 0, "empty cases must have no triangles" );
+
+  /* Gradient at corner c, by differences along the edges of the cell. */
+  template< unsigned Corner >
+  Vector3D CornerGradient( const Cell &cell ) {
+    return( Vector3D( cell.val[ axisCorners[ Corner ][ 0 ][ 0 ] ] - cell.val[ axisCorners[ Corner ][ 0 ][ 1 ] ],
+                      cell.val[ axisCorners[ Corner ][ 1 ][ 0 ] ] - cell.val[ axisCorners[ Corner ][ 1 ][ 1 ] ],
+                      cell.val[ axisCorners[ Corner ][ 2 ][ 0 ] ] - cell.val[ axisCorners[ Corner ][ 2 ][ 1 ] ] ) );
+  }
+
+  template< unsigned Edge >
+  size_t EdgeVertex( const Cell &cell, float isolevel, MeshSink &sink ) {
+    const unsigned a = edgeCorners[ Edge ][ 0 ], b = edgeCorners[ Edge ][ 1 ];
+    const double mu = ( isolevel - cell.val[ a ] ) / ( cell.val[ b ] - cell.val[ a ] );
+    const Vector3D pt = cell.p[ a ] + ( cell.p[ b ] - cell.p[ a ] ) * mu;
+    const Vector3D ga = CornerGradient< edgeCorners[ Edge ][ 0 ] >( cell );
+    const Vector3D grad = ga + ( CornerGradient< edgeCorners[ Edge ][ 1 ] >( cell ) - ga ) * mu;
+    return( sink.AddVertex( Point3D( pt.x, pt.y, pt.z ),
+                            grad.LengthSquared( ) > 0.0 ? Normal( grad.Normalized( ) ) : Normal( ) ) );
+  }
+
+  /* Vertices on the crossed edges from Edge on, unrolled at compile time. */
+  template< unsigned Case, unsigned Edge = 0, bool Crossed = Uses( Case, Edge ) >
+  struct EdgeVertices {
+    static void Run( const Cell &cell, float isolevel, MeshSink &sink, size_t *vertex ) {
+      vertex[ Edge ] = EdgeVertex< Edge >( cell, isolevel, sink );
+      EdgeVertices< Case, Edge + 1 >::Run( cell, isolevel, sink, vertex );
+    }
+  };
+
+  template< unsigned Case, unsigned Edge >
+  struct EdgeVertices< Case, Edge, false > {
+    static void Run( const Cell &cell, float isolevel, MeshSink &sink, size_t *vertex ) {
+      EdgeVertices< Case, Edge + 1 >::Run( cell, isolevel, sink, vertex );
+    }
+  };
+
+  template< unsigned Case >
+  struct EdgeVertices< Case, 12, false > {
+    static void Run( const Cell &, float, MeshSink &, size_t * ) {
+    }
+  };
+
+  template< unsigned Case, unsigned K >
+  struct EdgeAt {
+    static constexpr int value = Entry( Case, K );
+  };
+
+  /* Triangles of the case from Tri on, unrolled at compile time. */
+  template< unsigned Case, unsigned Tri = 0, bool Any = ( Tri < TriangleCount( Case ) ) >
+  struct Triangles {
+    static void Run( MeshSink &sink, const size_t *vertex ) {
+      sink.AddTriangle( vertex[ EdgeAt< Case, 3 * Tri >::value ], vertex[ EdgeAt< Case, 3 * Tri + 1 >::value ],
+                        vertex[ EdgeAt< Case, 3 * Tri + 2 >::value ] );
+      Triangles< Case, Tri + 1 >::Run( sink, vertex );
+    }
+  };
+
+  template< unsigned Case, unsigned Tri >
+  struct Triangles< Case, Tri, false > {
+    static void Run( MeshSink &, const size_t * ) {
+    }
+  };
+
+  template< unsigned Case >
+  size_t Kernel( const Cell &cell, float isolevel, MeshSink &sink ) {
+    size_t vertex[ 12 ];
+    EdgeVertices< Case >::Run( cell, isolevel, sink, vertex );
+    Triangles< Case >::Run( sink, vertex );
+    return( TriangleCount( Case ) );
+  }
+
+  typedef size_t ( *KernelFunction )( const Cell &, float, MeshSink & );
+
+  template< unsigned... Cases >
+  struct CaseList {
+  };
+
+  template< unsigned Count, unsigned... Cases >
+  struct MakeCaseList : MakeCaseList< Count - 1, Count - 1, Cases... > {
+  };
+
+  template< unsigned... Cases >
+  struct MakeCaseList< 0, Cases... > {
+    typedef CaseList< Cases... > type;
+  };
+
+  template< typename List >
+  struct KernelTable;
+
+  /* Function pointers only, so the table is built at compile time, with no static initialization order issue. */
+  template< unsigned... Cases >
+  struct KernelTable< CaseList< Cases... > > {
+    static const KernelFunction kernels[ sizeof...( Cases ) ];
+    static const uint16_t edges[ sizeof...( Cases ) ];
+  };
+
+  template< unsigned... Cases >
+  const KernelFunction KernelTable< CaseList< Cases... > >::kernels[ sizeof...( Cases ) ] = { &Kernel< Cases >... };
+
+  template< unsigned... Cases >
+  const uint16_t KernelTable< CaseList< Cases... > >::edges[ sizeof...( Cases ) ] = { UsedEdges( Cases )... };
+
+  typedef KernelTable< MakeCaseList< 256 >::type > Kernels;
+
+}
+
+uint16_t CubeKernels::Edges( uint8_t idx ) {
+  return( Kernels::edges[ idx ] );
+}
+
+size_t CubeKernels::Polygonize( const Cell &cell, float isolevel, MeshSink &sink ) {
+  return( Kernels::kernels[ cell.idx ]( cell, isolevel, sink ) );
+}
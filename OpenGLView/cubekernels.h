@@ -0,0 +1,32 @@
+#ifndef CUBEKERNELS_H
+#define CUBEKERNELS_H
+
+#include <MarchingCubes.hpp>
+#include <cstddef>
+#include <cstdint>
+
+using namespace Bial;
+
+class MeshSink;
+
+/**
+ * Marching cubes with one straight-line kernel per case, generated at compile time from the triangle table; the
+ * edges a case crosses are those its triangles use. A kernel interpolates only those edges and emits its triangles
+ * with no table walk; a table of 256 kernels is indexed by Cell::idx. Ambiguous faces are always cut the same way,
+ * so neighbouring cells never disagree on their shared face.
+ * Corners and edges are numbered as in MarchingCubes, and cells are laid out as MeshSink::ExtractMarchingCubes
+ * builds them, one voxel apart.
+ */
+class CubeKernels {
+public:
+  /* Edges crossed by the isosurface in case idx, bit e set for edge e, as in MarchingCubes::edgeTable. */
+  static uint16_t Edges( uint8_t idx );
+
+  /**
+   * Appends the triangles of cell into sink, with normals following the volume gradient interpolated along the
+   * edges of the cell. Returns the number of triangles.
+   */
+  static size_t Polygonize( const Cell &cell, float isolevel, MeshSink &sink );
+};
+
+#endif /* CUBEKERNELS_H */
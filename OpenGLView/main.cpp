@@ -1,8 +1,11 @@
 #include "mainwindow.h"
+#include "taskscheduler.h"
 #include <QApplication>
 
 int main( int argc, char *argv[] ) {
   QApplication a( argc, argv );
+  /* Parallel work started from the window runs ahead of any background work sharing the scheduler. */
+  TaskScheduler::PriorityScope interactive( TaskScheduler::Priority::Interactive );
   MainWindow w;
   w.showMaximized();
 
@@ -1,14 +1,15 @@
 #include "mainwindow.h"
+#include "profiler.h"
 #include "ui_mainwindow.h"
 
 #include <QFileDialog>
 #include <QKeyEvent>
 #include <QMessageBox>
 #include <QProgressDialog>
-#include <QtConcurrent/QtConcurrent>
 
 MainWindow::MainWindow( QWidget *parent ) : QMainWindow( parent ), ui( new Ui::MainWindow ) {
   ui->setupUi( this );
+  connect( ui->openGLWidget, &STLViewer::finishedMCubes, this, &MainWindow::updateProfile );
   QStringList args = QApplication::arguments( );
   if( args.size( ) == 2 ) {
     QFileInfo info( args.at( 1 ) );
@@ -51,7 +52,7 @@ void MainWindow::on_actionOpen_files_triggered( ) {
   QString fileName =
     QFileDialog::getOpenFileName( this, "Open STL files.", QDir::homePath( ),
                                   tr(
-                                    "All Supported files (*.nii *.nii.gz *.stl *.stl.gz) ;;STL files (*.stl *.stl.gz);; NIfTI Images (*.nii *.nii.gz) " ) );
+                                    "All Supported files (*.nii *.nii.gz *.stl *.stl.gz *.bmsh) ;;STL files (*.stl *.stl.gz);; Meshes (*.bmsh);; NIfTI Images (*.nii *.nii.gz) " ) );
   ui->openGLWidget->LoadFile( fileName );
 }
 
@@ -60,7 +61,19 @@ void MainWindow::on_pushButton_clicked( ) {
  *  QProgressDialog progress;
  *  connect( ui->openGLWidget, &STLViewer::finishedMCubes, &progress, &QWidget::close );
  */
-  ui->openGLWidget->runMarchingCubes( ui->doubleSpinBox_2->value( ), ui->doubleSpinBox->value( ) );
+  ui->openGLWidget->runMarchingCubes( ui->doubleSpinBox_2->value( ), ui->doubleSpinBox->value( ),
+                                      static_cast< StlModel::Extractor >( ui->comboBox->currentIndex( ) ) );
+}
+
+void MainWindow::on_pushButton_2_clicked( ) {
+  ui->openGLWidget->smoothModel( ui->spinBox->value( ) );
+}
+
+void MainWindow::on_pushButton_3_clicked( ) {
+  const VolumeStatistics *stats = ui->openGLWidget->getStatistics( );
+  if( stats && stats->Maximum( ) > 0 ) {
+    ui->doubleSpinBox_2->setValue( static_cast< double >( stats->OtsuThreshold( ) ) / stats->Maximum( ) );
+  }
 }
 
 void MainWindow::on_checkBox_clicked( bool checked ) {
@@ -69,9 +82,43 @@ void MainWindow::on_checkBox_clicked( bool checked ) {
 
 void MainWindow::on_actionExport_stl_triggered( ) {
   if( ui->openGLWidget->getModel( ) ) {
+    QString filter;
     QString fileName =
       QFileDialog::getSaveFileName( this, "Export STL file", QDir::homePath( ),
-                                    tr( "STL files (*.stl *.stl.gz);;" ) );
-    ui->openGLWidget->getModel( )->save( fileName );
+                                    tr( "STL files (*.stl *.stl.gz);;ASCII STL files (*.stl *.stl.gz);;"
+                                        "Meshes (*.bmsh);;" ), &filter );
+    ui->openGLWidget->getModel( )->save( fileName, filter.startsWith( "ASCII" ) );
+  }
+}
+
+void MainWindow::on_actionExport_profile_triggered( ) {
+  QString fileName =
+    QFileDialog::getSaveFileName( this, "Export profile", QDir::homePath( ),
+                                  tr( "Chrome trace files (*.json);;" ) );
+  if( !fileName.isEmpty( ) ) {
+    try {
+      Profiler::instance( ).WriteChromeTrace( fileName.toStdString( ) );
+    }
+    catch( const std::exception &e ) {
+      QMessageBox::warning( this, "ERROR", e.what( ) );
+    }
+  }
+}
+
+void MainWindow::updateProfile( ) {
+  QString text;
+  const VolumeStatistics *stats = ui->openGLWidget->getStatistics( );
+  if( stats ) {
+    text = QString( "Intensities %1 to %2, mean %3\nPercentiles 1%: %4, 50%: %5, 99%: %6\nOtsu threshold %7\n\n" )
+           .arg( stats->Minimum( ) ).arg( stats->Maximum( ) ).arg( stats->Mean( ) )
+           .arg( stats->Percentile( 0.01 ) ).arg( stats->Percentile( 0.5 ) ).arg( stats->Percentile( 0.99 ) )
+           .arg( stats->OtsuThreshold( ) );
+  }
+  StlModel *model = ui->openGLWidget->getModel( );
+  if( model ) {
+    const MeshMetrics::Report &metrics = model->getMetrics( );
+    text += QString( "Surface area %1, enclosed volume %2, %3 components\n\n" )
+            .arg( metrics.total.area ).arg( metrics.total.volume ).arg( metrics.components.size( ) );
   }
+  ui->profileText->setPlainText( text + QString::fromStdString( Profiler::instance( ).Summary( ) ) );
 }
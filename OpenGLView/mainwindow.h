@@ -23,8 +23,12 @@ protected:
 private slots:
   void on_actionOpen_files_triggered( );
   void on_pushButton_clicked( );
+  void on_pushButton_2_clicked( );
+  void on_pushButton_3_clicked( );
   void on_checkBox_clicked( bool checked );
   void on_actionExport_stl_triggered();
+  void on_actionExport_profile_triggered( );
+  void updateProfile( );
 };
 
 #endif /* MAINWINDOW_H */
@@ -0,0 +1,69 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only private mapping of a whole file. Pages are read from disk the first time they are touched, unless
+ * WillNeed asks for the whole file up front, and Release hands pages already consumed back to the page cache.
+ */
+class MappedFile {
+  void *addr = MAP_FAILED;
+  size_t length = 0;
+
+public:
+  explicit MappedFile( const std::string &fileName ) {
+    int fd = open( fileName.c_str( ), O_RDONLY );
+    if( fd < 0 ) {
+      throw std::runtime_error( "Could not open " + fileName + " for reading." );
+    }
+    struct stat st;
+    if( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+      length = static_cast< size_t >( st.st_size );
+      addr = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    }
+    close( fd );
+    if( addr == MAP_FAILED ) {
+      throw std::runtime_error( "Could not map " + fileName + "." );
+    }
+  }
+
+  MappedFile( const MappedFile &other ) = delete;
+  MappedFile &operator=( const MappedFile &other ) = delete;
+
+  ~MappedFile( ) {
+    munmap( addr, length );
+  }
+
+  const unsigned char* data( ) const {
+    return( static_cast< const unsigned char* >( addr ) );
+  }
+
+  size_t size( ) const {
+    return( length );
+  }
+
+  /* Starts reading the whole file ahead, for callers that are going to touch all of it. */
+  void WillNeed( ) const {
+    madvise( addr, length, MADV_WILLNEED );
+  }
+
+  /* Drops the pages entirely within [ offset, offset + bytes ) from the working set; they read back if touched. */
+  void Release( size_t offset, size_t bytes ) const {
+    const size_t page = static_cast< size_t >( sysconf( _SC_PAGESIZE ) );
+    const size_t first = ( offset + page - 1 ) / page * page;
+    const size_t last = std::min( offset + bytes, length ) / page * page;
+    if( first < last ) {
+      madvise( static_cast< unsigned char* >( addr ) + first, last - first, MADV_DONTNEED );
+    }
+  }
+};
+
+#endif /* MAPPEDFILE_H */
@@ -0,0 +1,69 @@
+#include "mappedvolume.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+  /* Slices converted between releases of the pages behind them. */
+  const size_t slabSlices = 8;
+
+}
+
+NiftiInfo MappedVolume::Header( const std::string &fileName ) {
+  NiftiInfo header;
+  if( !header.Read( fileName ) ) {
+    throw std::runtime_error( fileName + " is not a NIfTI-1 file." );
+  }
+  if( header.compressed ) {
+    throw std::runtime_error( fileName + " is compressed and cannot be mapped." );
+  }
+  if( !header.singleFile ) {
+    throw std::runtime_error( fileName + " keeps its voxels in a separate .img file and cannot be mapped." );
+  }
+  if( !header.Convertible( ) ) {
+    throw std::runtime_error( fileName + " has an unsupported voxel type." );
+  }
+  return( header );
+}
+
+MappedVolume::MappedVolume( const std::string &fileName ) : info( Header( fileName ) ), file( fileName ) {
+  if( file.size( ) < info.voxOffset + info.Voxels( ) * Frames( ) * info.BytesPerVoxel( ) ) {
+    throw std::runtime_error( fileName + " is shorter than its header says." );
+  }
+  PROFILE_COUNT( "bytes mapped", info.Voxels( ) * Frames( ) * info.BytesPerVoxel( ) );
+}
+
+bool MappedVolume::CanMap( const std::string &fileName ) {
+  NiftiInfo header;
+  return( header.Read( fileName ) && !header.compressed && header.singleFile && header.Convertible( ) );
+}
+
+int MappedVolume::operator()( size_t x, size_t y, size_t z ) const {
+  const size_t voxel = x + info.dims[ 0 ] * ( y + info.dims[ 1 ] * z );
+  int value;
+  info.ToInt( file.data( ) + info.voxOffset + voxel * info.BytesPerVoxel( ), 1, &value );
+  return( value );
+}
+
+void MappedVolume::Slices( size_t first, size_t last, int *dst, size_t frame ) const {
+  const size_t slice = info.dims[ 0 ] * info.dims[ 1 ];
+  const size_t offset = info.voxOffset + ( frame * info.Voxels( ) + first * slice ) * info.BytesPerVoxel( );
+  info.ToInt( file.data( ) + offset, ( last - first ) * slice, dst );
+  file.Release( offset, ( last - first ) * slice * info.BytesPerVoxel( ) );
+}
+
+Image< int > MappedVolume::ToImage( size_t threads, size_t frame ) const {
+  PROFILE_SCOPE( "MappedVolume::ToImage" );
+  Image< int > img( info.dims[ 0 ], info.dims[ 1 ], info.dims[ 2 ] );
+  const size_t slice = info.dims[ 0 ] * info.dims[ 1 ];
+  ParallelRanges( 0, info.dims[ 2 ], HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t z = first; z < last; z += slabSlices ) {
+      Slices( z, std::min( z + slabSlices, last ), &img[ z * slice ], frame );
+    }
+  } );
+  return( img );
+}
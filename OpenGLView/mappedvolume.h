@@ -0,0 +1,60 @@
+#ifndef MAPPEDVOLUME_H
+#define MAPPEDVOLUME_H
+
+#include "mappedfile.h"
+#include "niftiinfo.h"
+
+#include <Common.hpp>
+#include <string>
+
+using namespace Bial;
+
+/**
+ * Uncompressed NIfTI-1 volume read in place from a private mapping of the file, in its own voxel type. Nothing is
+ * read until it is touched, so opening is immediate and the working set only holds the pages in use. Voxels are
+ * in the storage order of the file. 4D files hold a series of frames of the same size, one after the other.
+ */
+class MappedVolume {
+  NiftiInfo info;
+  MappedFile file;
+
+  static NiftiInfo Header( const std::string &fileName );
+
+public:
+  /**
+   * Throws if the file is compressed, not a single-file NIfTI-1, of an unsupported voxel type or shorter than its
+   * header says.
+   */
+  explicit MappedVolume( const std::string &fileName );
+
+  /* True for files the constructor accepts: uncompressed .nii, with 8 to 32 bit integer or floating point voxels. */
+  static bool CanMap( const std::string &fileName );
+
+  const NiftiInfo &Info( ) const {
+    return( info );
+  }
+
+  size_t size( size_t dim ) const {
+    return( info.dims[ dim ] );
+  }
+
+  size_t Frames( ) const {
+    return( info.dims[ 3 ] );
+  }
+
+  /* First voxel of the first frame, of Info( ).datatype in the byte order of the file ( Info( ).swapped ). */
+  const void* Voxels( ) const {
+    return( file.data( ) + info.voxOffset );
+  }
+
+  /* Voxel ( x, y, z ) of the first frame converted to int. */
+  int operator()( size_t x, size_t y, size_t z ) const;
+
+  /* Converts slices [ first, last ) of frame to int into dst, then lets their pages go. */
+  void Slices( size_t first, size_t last, int *dst, size_t frame = 0 ) const;
+
+  /* A whole frame converted to int, slab by slab with up to threads threads (0 for all). */
+  Image< int > ToImage( size_t threads = 0, size_t frame = 0 ) const;
+};
+
+#endif /* MAPPEDVOLUME_H */
@@ -0,0 +1,196 @@
+#include "meshclusters.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector< MeshClusters::Cluster > MeshClusters::Build( MeshData &mesh, size_t trianglesPerCluster,
+                                                           size_t threads ) {
+  PROFILE_SCOPE( "MeshClusters::Build" );
+  threads = HardwareThreads( threads );
+  const size_t ntris = mesh.Triangles( );
+  std::vector< Cluster > clusters;
+  if( ntris == 0 ) {
+    return( clusters );
+  }
+  double lo[ 3 ] = { mesh.p[ 0 ].x, mesh.p[ 0 ].y, mesh.p[ 0 ].z }, hi[ 3 ] = { lo[ 0 ], lo[ 1 ], lo[ 2 ] };
+  for( size_t v = 1; v < mesh.p.size( ); ++v ) {
+    const double xyz[ 3 ] = { mesh.p[ v ].x, mesh.p[ v ].y, mesh.p[ v ].z };
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      lo[ axis ] = std::min( lo[ axis ], xyz[ axis ] );
+      hi[ axis ] = std::max( hi[ axis ], xyz[ axis ] );
+    }
+  }
+  /* Surfaces fill about grid^2 of the grid^3 cells. */
+  const size_t cells = std::lround( std::sqrt( double( ntris ) / std::max< size_t >( 1, trianglesPerCluster ) ) );
+  const size_t grid = std::max< size_t >( 1, std::min< size_t >( 64, cells ) );
+  double scale[ 3 ];
+  for( size_t axis = 0; axis < 3; ++axis ) {
+    scale[ axis ] = hi[ axis ] > lo[ axis ] ? grid / ( hi[ axis ] - lo[ axis ] ) : 0.0;
+  }
+  std::vector< uint32_t > cell( ntris );
+  ParallelRanges( 0, ntris, threads, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t t = first; t < last; ++t ) {
+      const Point3D &a = mesh.p[ mesh.tris[ t * 3 ] ], &b = mesh.p[ mesh.tris[ t * 3 + 1 ] ],
+                    &c = mesh.p[ mesh.tris[ t * 3 + 2 ] ];
+      const double centroid[ 3 ] = { ( a.x + b.x + c.x ) / 3.0, ( a.y + b.y + c.y ) / 3.0, ( a.z + b.z + c.z ) / 3.0 };
+      size_t coord[ 3 ];
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        double offset = ( centroid[ axis ] - lo[ axis ] ) * scale[ axis ];
+        coord[ axis ] = std::min( grid - 1, static_cast< size_t >( std::max( 0.0, offset ) ) );
+      }
+      cell[ t ] = static_cast< uint32_t >( ( coord[ 2 ] * grid + coord[ 1 ] ) * grid + coord[ 0 ] );
+    }
+  } );
+  /* Stable counting sort of the triangles by cell. */
+  std::vector< size_t > start( grid * grid * grid + 1, 0 );
+  for( size_t t = 0; t < ntris; ++t ) {
+    ++start[ cell[ t ] + 1 ];
+  }
+  for( size_t c = 1; c < start.size( ); ++c ) {
+    start[ c ] += start[ c - 1 ];
+  }
+  for( size_t c = 0; c + 1 < start.size( ); ++c ) {
+    if( start[ c + 1 ] > start[ c ] ) {
+      Cluster cluster;
+      cluster.first = start[ c ] * 3;
+      cluster.count = ( start[ c + 1 ] - start[ c ] ) * 3;
+      clusters.push_back( cluster );
+    }
+  }
+  Vector< MeshData::Index > sorted( mesh.tris.size( ) );
+  for( size_t t = 0; t < ntris; ++t ) {
+    size_t to = start[ cell[ t ] ]++;
+    std::copy( &mesh.tris[ t * 3 ], &mesh.tris[ t * 3 ] + 3, &sorted[ to * 3 ] );
+  }
+  mesh.tris = std::move( sorted );
+  Bound( mesh, clusters, threads );
+  PROFILE_COUNT( "mesh clusters", clusters.size( ) );
+  return( clusters );
+}
+
+void MeshClusters::Bound( const MeshData &mesh, std::vector< Cluster > &clusters, size_t threads ) {
+  const bool oriented = mesh.n.size( ) == mesh.p.size( );
+  ParallelRanges( 0, clusters.size( ), HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    std::vector< Vector3D > normals;
+    for( size_t idx = first; idx < last; ++idx ) {
+      Cluster &cluster = clusters[ idx ];
+      const MeshData::Index *tris = &mesh.tris[ cluster.first ];
+      const Point3D &p0 = mesh.p[ tris[ 0 ] ];
+      double lo[ 3 ] = { p0.x, p0.y, p0.z }, hi[ 3 ] = { p0.x, p0.y, p0.z };
+      double axis[ 3 ] = { 0.0, 0.0, 0.0 };
+      normals.clear( );
+      for( size_t t = 0; t < cluster.count; t += 3 ) {
+        for( size_t corner = 0; corner < 3; ++corner ) {
+          const Point3D &pt = mesh.p[ tris[ t + corner ] ];
+          const double xyz[ 3 ] = { pt.x, pt.y, pt.z };
+          for( size_t ax = 0; ax < 3; ++ax ) {
+            lo[ ax ] = std::min( lo[ ax ], xyz[ ax ] );
+            hi[ ax ] = std::max( hi[ ax ], xyz[ ax ] );
+          }
+        }
+        const Point3D &a = mesh.p[ tris[ t ] ], &b = mesh.p[ tris[ t + 1 ] ], &c = mesh.p[ tris[ t + 2 ] ];
+        Vector3D nrm = Cross( b - a, c - a );
+        double len = nrm.Length( );
+        if( len == 0.0 ) {
+          continue;
+        }
+        nrm = nrm / len;
+        if( oriented ) {
+          const Normal &na = mesh.n[ tris[ t ] ], &nb = mesh.n[ tris[ t + 1 ] ], &nc = mesh.n[ tris[ t + 2 ] ];
+          if( nrm.x * ( na.x + nb.x + nc.x ) + nrm.y * ( na.y + nb.y + nc.y ) + nrm.z * ( na.z + nb.z + nc.z ) < 0.0 ) {
+            nrm = -nrm;
+          }
+        }
+        normals.push_back( nrm );
+        axis[ 0 ] += nrm.x;
+        axis[ 1 ] += nrm.y;
+        axis[ 2 ] += nrm.z;
+      }
+      std::copy( lo, lo + 3, cluster.lo );
+      std::copy( hi, hi + 3, cluster.hi );
+      double len = std::sqrt( axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ] + axis[ 2 ] * axis[ 2 ] );
+      cluster.cutoff = 2.0;
+      if( len > 0.0 ) {
+        double minDot = 1.0;
+        for( const Vector3D &nrm : normals ) {
+          minDot = std::min( minDot, ( nrm.x * axis[ 0 ] + nrm.y * axis[ 1 ] + nrm.z * axis[ 2 ] ) / len );
+        }
+        if( minDot > 0.0 ) {
+          cluster.cutoff = std::sqrt( 1.0 - minDot * minDot );
+        }
+      }
+      for( size_t ax = 0; ax < 3; ++ax ) {
+        cluster.axis[ ax ] = len > 0.0 ? axis[ ax ] / len : 0.0;
+      }
+    }
+  } );
+}
+
+MeshClusters::View::View( const double *projection, const double *modelview ) {
+  /* clip = projection * modelview; element ( row, col ) is at col * 4 + row. */
+  double clip[ 16 ];
+  for( size_t col = 0; col < 4; ++col ) {
+    for( size_t row = 0; row < 4; ++row ) {
+      double sum = 0.0;
+      for( size_t k = 0; k < 4; ++k ) {
+        sum += projection[ k * 4 + row ] * modelview[ col * 4 + k ];
+      }
+      clip[ col * 4 + row ] = sum;
+    }
+  }
+  /* Planes are the fourth row plus or minus each of the first three. */
+  for( size_t plane = 0; plane < 6; ++plane ) {
+    const size_t row = plane / 2;
+    const double sign = plane % 2 == 0 ? 1.0 : -1.0;
+    for( size_t col = 0; col < 4; ++col ) {
+      planes[ plane ][ col ] = clip[ col * 4 + 3 ] + sign * clip[ col * 4 + row ];
+    }
+  }
+  /* Eye at the origin of eye space: -A^-1 t, for the linear part A and translation t of modelview. */
+  const double *m = modelview;
+  const double a = m[ 0 ], b = m[ 4 ], c = m[ 8 ], d = m[ 1 ], e = m[ 5 ], f = m[ 9 ], g = m[ 2 ], h = m[ 6 ],
+               i = m[ 10 ];
+  const double det = a * ( e * i - f * h ) - b * ( d * i - f * g ) + c * ( d * h - e * g );
+  const double t[ 3 ] = { m[ 12 ], m[ 13 ], m[ 14 ] };
+  if( det == 0.0 ) {
+    eye[ 0 ] = eye[ 1 ] = eye[ 2 ] = 0.0;
+    return;
+  }
+  const double inv[ 9 ] = { ( e * i - f * h ) / det, ( c * h - b * i ) / det, ( b * f - c * e ) / det,
+                            ( f * g - d * i ) / det, ( a * i - c * g ) / det, ( c * d - a * f ) / det,
+                            ( d * h - e * g ) / det, ( b * g - a * h ) / det, ( a * e - b * d ) / det };
+  for( size_t row = 0; row < 3; ++row ) {
+    eye[ row ] = -( inv[ row * 3 ] * t[ 0 ] + inv[ row * 3 + 1 ] * t[ 1 ] + inv[ row * 3 + 2 ] * t[ 2 ] );
+  }
+}
+
+bool MeshClusters::View::Sees( const Cluster &cluster, bool cullBackFaces ) const {
+  for( size_t plane = 0; plane < 6; ++plane ) {
+    const double *pl = planes[ plane ];
+    /* Corner of the box farthest along the plane normal. */
+    double dist = pl[ 3 ];
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      dist += pl[ axis ] * ( pl[ axis ] >= 0.0 ? cluster.hi[ axis ] : cluster.lo[ axis ] );
+    }
+    if( dist < 0.0 ) {
+      return( false );
+    }
+  }
+  if( cullBackFaces && cluster.cutoff <= 1.0 ) {
+    /* Every facet faces away if the eye is behind the cone around the bounding sphere. */
+    double center[ 3 ], radius = 0.0, along = 0.0, distance = 0.0;
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      center[ axis ] = ( cluster.lo[ axis ] + cluster.hi[ axis ] ) / 2.0;
+      radius += ( cluster.hi[ axis ] - center[ axis ] ) * ( cluster.hi[ axis ] - center[ axis ] );
+      along += ( center[ axis ] - eye[ axis ] ) * cluster.axis[ axis ];
+      distance += ( center[ axis ] - eye[ axis ] ) * ( center[ axis ] - eye[ axis ] );
+    }
+    if( along >= cluster.cutoff * std::sqrt( distance ) + std::sqrt( radius ) ) {
+      return( false );
+    }
+  }
+  return( true );
+}
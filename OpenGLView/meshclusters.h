@@ -0,0 +1,48 @@
+#ifndef MESHCLUSTERS_H
+#define MESHCLUSTERS_H
+
+#include "meshdata.h"
+
+#include <vector>
+
+/**
+ * Spatial clusters of a mesh, for culling whole groups of triangles against the view. Triangles are grouped by the
+ * grid cell of their centroid and the index buffer is reordered so that every cluster is a contiguous range, keeping
+ * the triangle order within each cluster. Every cluster has a bounding box and the cone of its facet normals.
+ */
+class MeshClusters {
+public:
+  struct Cluster {
+    /* Range of mesh.tris, in indices. */
+    size_t first;
+    size_t count;
+    double lo[ 3 ];
+    double hi[ 3 ];
+    /* Facet normals are within the cone around axis whose half angle has sine cutoff; > 1 if they are not. */
+    double axis[ 3 ];
+    double cutoff;
+  };
+
+  /* Frustum planes and eye position in model coordinates. */
+  struct View {
+    double planes[ 6 ][ 4 ];
+    double eye[ 3 ];
+
+    /* From the OpenGL projection and modelview matrices, column major as glGetDoublev returns them. */
+    View( const double *projection, const double *modelview );
+
+    /* False if the cluster is outside the frustum or, with cullBackFaces, faces away from the eye entirely. */
+    bool Sees( const Cluster &cluster, bool cullBackFaces ) const;
+  };
+
+  /* Partitions mesh into clusters of about trianglesPerCluster triangles, reordering mesh.tris. */
+  static std::vector< Cluster > Build( MeshData &mesh, size_t trianglesPerCluster = 4096, size_t threads = 0 );
+
+  /*
+   * Recomputes the bounding boxes and normal cones, after the vertices moved. Facets are oriented along the vertex
+   * normals when the mesh has them, so that the cones follow the lit side whatever the winding.
+   */
+  static void Bound( const MeshData &mesh, std::vector< Cluster > &clusters, size_t threads = 0 );
+};
+
+#endif /* MESHCLUSTERS_H */
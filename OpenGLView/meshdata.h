@@ -0,0 +1,69 @@
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+#include <Common.hpp>
+#include <Draw.hpp>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace Bial;
+
+/**
+ * Indexed triangle mesh owned by a single holder at a time. StlModel renders straight from these arrays, so
+ * there is no second converted copy of the mesh while it is being viewed.
+ */
+class MeshData {
+public:
+  typedef uint32_t Index;
+
+  Vector< Point3D > p;
+  Vector< Normal > n;
+  Vector< Index > tris;
+
+  /* Throws unless every one of vertices can be addressed by an Index. */
+  static void CheckVertices( size_t vertices ) {
+    if( vertices > static_cast< size_t >( std::numeric_limits< Index >::max( ) ) + 1 ) {
+      throw std::runtime_error( "Mesh of " + std::to_string( vertices ) + " vertices exceeds the " +
+                                std::to_string( 8 * sizeof( Index ) ) + " bit vertex indices." );
+    }
+  }
+
+  size_t Vertices( ) const {
+    return( p.size( ) );
+  }
+
+  size_t Triangles( ) const {
+    return( tris.size( ) / 3 );
+  }
+
+  /* Appends the triangles of other, offsetting its indices. */
+  void Append( const MeshData &other ) {
+    CheckVertices( p.size( ) + other.p.size( ) );
+    const Index base = static_cast< Index >( p.size( ) );
+    p.insert( p.end( ), other.p.begin( ), other.p.end( ) );
+    n.insert( n.end( ), other.n.begin( ), other.n.end( ) );
+    tris.reserve( tris.size( ) + other.tris.size( ) );
+    for( size_t idx = 0; idx < other.tris.size( ); ++idx ) {
+      tris.push_back( base + other.tris[ idx ] );
+    }
+  }
+
+  /* Builds a Bial TriangleMesh copy, for code that needs one. */
+  TriangleMesh* ToTriangleMesh( ) const {
+    return( new TriangleMesh( new Transform3D( ), new Transform3D( ), false, Vector< size_t >( tris ), p, n ) );
+  }
+
+  static std::unique_ptr< MeshData > FromTriangleMesh( const TriangleMesh &mesh ) {
+    CheckVertices( mesh.getP( ).size( ) );
+    std::unique_ptr< MeshData > data( new MeshData( ) );
+    data->p = mesh.getP( );
+    data->n = mesh.getN( );
+    data->tris = Vector< Index >( mesh.getVertexIndex( ) );
+    return( data );
+  }
+};
+
+#endif /* MESHDATA_H */
@@ -0,0 +1,820 @@
+#include "meshio.h"
+
+#include "mappedfile.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+  bool EndsWith( const std::string &str, const std::string &suffix ) {
+    return( str.size( ) >= suffix.size( ) && str.compare( str.size( ) - suffix.size( ), suffix.size( ), suffix ) == 0 );
+  }
+
+  /* Plain or gzip compressed output file, chosen by the extension. */
+  class OutputFile {
+    FILE *file = nullptr;
+    gzFile gz = nullptr;
+    std::string fileName;
+
+  public:
+    explicit OutputFile( const std::string &fileName ) : fileName( fileName ) {
+      if( EndsWith( fileName, ".gz" ) ) {
+        gz = gzopen( fileName.c_str( ), "wb" );
+      }
+      else {
+        file = fopen( fileName.c_str( ), "wb" );
+      }
+      if( !file && !gz ) {
+        throw std::runtime_error( "Could not open " + fileName + " for writing." );
+      }
+    }
+
+    ~OutputFile( ) {
+      if( file ) {
+        fclose( file );
+      }
+      if( gz ) {
+        gzclose( gz );
+      }
+    }
+
+    void Write( const void *data, size_t bytes ) {
+      bool ok = gz ? gzwrite( gz, data, static_cast< unsigned >( bytes ) ) == static_cast< int >( bytes )
+                   : fwrite( data, 1, bytes, file ) == bytes;
+      if( !ok ) {
+        throw std::runtime_error( "Could not write to " + fileName + "." );
+      }
+    }
+  };
+
+  /*
+   * Layout of the native mesh file. Every section starts at a multiple of 8 bytes: positions, normals when
+   * meshHasNormals is set, the byte offsets of the index blocks ( indexBlocks + 1 of them, relative to the start of
+   * the index stream ) and the index stream itself.
+   */
+  struct MeshHeader {
+    char magic[ 4 ];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t indexBlocks;
+    uint64_t vertices;
+    uint64_t indices;
+    uint64_t indexBytes;
+    double origin[ 3 ];
+    double step[ 3 ];
+  };
+
+  const char meshMagic[ 4 ] = { 'B', 'M', 'S', 'H' };
+  const uint32_t meshVersion = 2;
+  const uint32_t meshHasNormals = 1;
+  const uint32_t meshQuantized = 2;
+  /* Indices per block. Deltas restart at every block, so blocks are coded and decoded independently. */
+  const size_t indexBlockSize = 1 << 16;
+  const int16_t octScale = 32767;
+
+  size_t Padded( size_t bytes ) {
+    return( ( bytes + 7 ) & ~size_t( 7 ) );
+  }
+
+  size_t PositionBytes( const MeshHeader &header ) {
+    return( header.vertices * 3 * ( header.flags & meshQuantized ? sizeof( uint16_t ) : sizeof( double ) ) );
+  }
+
+  size_t NormalBytes( const MeshHeader &header ) {
+    if( !( header.flags & meshHasNormals ) ) {
+      return( 0 );
+    }
+    return( header.vertices * ( header.flags & meshQuantized ? 2 * sizeof( int16_t ) : 3 * sizeof( double ) ) );
+  }
+
+  double SignNotZero( double value ) {
+    return( value < 0.0 ? -1.0 : 1.0 );
+  }
+
+  /* Octahedral mapping of a direction to two coordinates in [ -1, 1 ]. */
+  void OctEncode( const Normal &nrm, int16_t *out ) {
+    double l1 = std::abs( nrm.x ) + std::abs( nrm.y ) + std::abs( nrm.z );
+    if( l1 == 0.0 ) {
+      out[ 0 ] = out[ 1 ] = 0;
+      return;
+    }
+    double u = nrm.x / l1, v = nrm.y / l1;
+    if( nrm.z < 0.0 ) {
+      double pu = u;
+      u = ( 1.0 - std::abs( v ) ) * SignNotZero( pu );
+      v = ( 1.0 - std::abs( pu ) ) * SignNotZero( v );
+    }
+    out[ 0 ] = static_cast< int16_t >( std::lround( u * octScale ) );
+    out[ 1 ] = static_cast< int16_t >( std::lround( v * octScale ) );
+  }
+
+  Normal OctDecode( const int16_t *in ) {
+    double u = std::max( -1.0, in[ 0 ] / double( octScale ) ), v = std::max( -1.0, in[ 1 ] / double( octScale ) );
+    double z = 1.0 - std::abs( u ) - std::abs( v );
+    if( z < 0.0 ) {
+      double pu = u;
+      u = ( 1.0 - std::abs( v ) ) * SignNotZero( pu );
+      v = ( 1.0 - std::abs( pu ) ) * SignNotZero( v );
+    }
+    double len = std::sqrt( u * u + v * v + z * z );
+    return( len > 0.0 ? Normal( u / len, v / len, z / len ) : Normal( 0.0, 0.0, 1.0 ) );
+  }
+
+  /* Zigzag mapped delta from the previous index, in 7 bit groups. */
+  void PutIndices( const MeshData::Index *idx, size_t count, std::string &out ) {
+    int64_t prev = 0;
+    for( size_t i = 0; i < count; ++i ) {
+      int64_t delta = static_cast< int64_t >( idx[ i ] ) - prev;
+      prev = idx[ i ];
+      uint64_t zz = ( static_cast< uint64_t >( delta ) << 1 ) ^ static_cast< uint64_t >( delta >> 63 );
+      while( zz >= 0x80 ) {
+        out.push_back( static_cast< char >( zz | 0x80 ) );
+        zz >>= 7;
+      }
+      out.push_back( static_cast< char >( zz ) );
+    }
+  }
+
+  /* Decodes exactly count indices from [ src, end ), false if the block is malformed or out of range. */
+  bool GetIndices( const unsigned char *src, const unsigned char *end, size_t count, uint64_t vertices,
+                   MeshData::Index *idx ) {
+    int64_t prev = 0;
+    for( size_t i = 0; i < count; ++i ) {
+      uint64_t zz = 0;
+      for( int shift = 0;; shift += 7 ) {
+        if( src == end || shift > 35 ) {
+          return( false );
+        }
+        unsigned char byte = *src++;
+        zz |= static_cast< uint64_t >( byte & 0x7f ) << shift;
+        if( !( byte & 0x80 ) ) {
+          break;
+        }
+      }
+      prev += static_cast< int64_t >( zz >> 1 ) ^ -static_cast< int64_t >( zz & 1 );
+      if( prev < 0 || static_cast< uint64_t >( prev ) >= vertices ) {
+        return( false );
+      }
+      idx[ i ] = static_cast< MeshData::Index >( prev );
+    }
+    return( src == end );
+  }
+
+  void PutFloats( char *dst, float a, float b, float c ) {
+    float v[ 3 ] = { a, b, c };
+    std::memcpy( dst, v, sizeof( v ) );
+  }
+
+  /* Unit facet normal from the triangle winding, as STL readers expect. */
+  Vector3D FacetNormal( const Point3D &p0, const Point3D &p1, const Point3D &p2 ) {
+    Vector3D nrm = Cross( p1 - p0, p2 - p0 );
+    double len = nrm.Length( );
+    return( len > 0.0 ? nrm / len : nrm );
+  }
+
+  const char stlbHeader[ ] = "Binary STL exported by Bial-Rendering";
+
+  /* Facets of every triangle of mesh as binary STL, passed to write( data, bytes ) a block at a time. */
+  template< typename Write >
+  void PutSTLBFacets( const MeshData &mesh, Write write ) {
+    static_assert( sizeof( float ) == 4, "Binary STL needs 32 bit floats." );
+    const size_t facetSize = 50;
+    const size_t facetsPerBlock = 1 << 16;
+    const size_t ntris = mesh.Triangles( );
+    std::vector< char > block( std::min( ntris, facetsPerBlock ) * facetSize, 0 );
+    for( size_t first = 0; first < ntris; first += facetsPerBlock ) {
+      size_t count = std::min< size_t >( facetsPerBlock, ntris - first );
+      for( size_t t = 0; t < count; ++t ) {
+        const MeshData::Index *tri = &mesh.tris[ ( first + t ) * 3 ];
+        const Point3D &p0 = mesh.p[ tri[ 0 ] ], &p1 = mesh.p[ tri[ 1 ] ], &p2 = mesh.p[ tri[ 2 ] ];
+        Vector3D nrm = FacetNormal( p0, p1, p2 );
+        char *dst = &block[ t * facetSize ];
+        PutFloats( dst, nrm.x, nrm.y, nrm.z );
+        PutFloats( dst + 12, p0.x, p0.y, p0.z );
+        PutFloats( dst + 24, p1.x, p1.y, p1.z );
+        PutFloats( dst + 36, p2.x, p2.y, p2.z );
+      }
+      write( &block[ 0 ], count * facetSize );
+    }
+  }
+
+  /* Powers of ten that are exact in a double, so scaling by them rounds only once. */
+  const double exactPowers[ ] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                  1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+  /* value * 10^exponent. */
+  double ScaleDecimal( double value, int exponent ) {
+    if( exponent >= 0 && exponent <= 22 ) {
+      return( value * exactPowers[ exponent ] );
+    }
+    if( exponent < 0 && exponent >= -22 ) {
+      return( value / exactPowers[ -exponent ] );
+    }
+    return( value * std::pow( 10.0, exponent ) );
+  }
+
+  /* Longest text of PutFloat, as in "-0.0000123456789": sign, "0.", four zeros and nine digits. */
+  const size_t maxFloatText = 16;
+
+  /*
+   * Writes value with the fewest significant digits, at most 9, that read back as the same float. Neither printf
+   * nor iostreams are used: they are slow, and the locale may change the decimal point. Returns the end of the text.
+   */
+  char* PutFloat( char *dst, float value ) {
+    if( value == 0.0f ) {
+      *dst++ = '0';
+      return( dst );
+    }
+    if( value < 0.0f ) {
+      *dst++ = '-';
+      value = -value;
+    }
+    if( !std::isfinite( value ) ) {
+      std::memcpy( dst, value > 0.0f ? "inf" : "nan", 3 );
+      return( dst + 3 );
+    }
+    int exp2;
+    std::frexp( value, &exp2 );
+    /* Decimal exponent of the leading digit, possibly one too low; the round trip test below makes up for it. */
+    const int lead = static_cast< int >( std::floor( ( exp2 - 1 ) * 0.30102999566398120 ) );
+    uint64_t digits = 0;
+    int shift = 0;
+    for( int precision = 1; precision <= 10; ++precision ) {
+      shift = precision - 1 - lead;
+      digits = static_cast< uint64_t >( std::floor( ScaleDecimal( value, shift ) + 0.5 ) );
+      if( static_cast< float >( ScaleDecimal( static_cast< double >( digits ), -shift ) ) == value ) {
+        break;
+      }
+    }
+    int exponent = -shift;
+    while( digits % 10 == 0 ) {
+      digits /= 10;
+      ++exponent;
+    }
+    char text[ 24 ];
+    int count = 0;
+    for( uint64_t rest = digits; rest > 0; rest /= 10 ) {
+      text[ 23 - count++ ] = static_cast< char >( '0' + rest % 10 );
+    }
+    const char *first = text + 24 - count;
+    if( exponent >= 0 && count + exponent <= 9 ) {
+      std::memcpy( dst, first, count );
+      dst += count;
+      for( int zero = 0; zero < exponent; ++zero ) {
+        *dst++ = '0';
+      }
+    }
+    else if( exponent < 0 && -exponent < count ) {
+      std::memcpy( dst, first, count + exponent );
+      dst += count + exponent;
+      *dst++ = '.';
+      std::memcpy( dst, first + count + exponent, -exponent );
+      dst += -exponent;
+    }
+    else if( exponent < 0 && -exponent - count <= 4 ) {
+      *dst++ = '0';
+      *dst++ = '.';
+      for( int zero = 0; zero < -exponent - count; ++zero ) {
+        *dst++ = '0';
+      }
+      std::memcpy( dst, first, count );
+      dst += count;
+    }
+    else {
+      *dst++ = *first;
+      if( count > 1 ) {
+        *dst++ = '.';
+        std::memcpy( dst, first + 1, count - 1 );
+        dst += count - 1;
+      }
+      dst += std::sprintf( dst, "e%d", exponent + count - 1 );
+    }
+    return( dst );
+  }
+
+  char* PutLine( char *dst, const char *prefix, size_t length, float x, float y, float z ) {
+    std::memcpy( dst, prefix, length );
+    dst = PutFloat( dst + length, x );
+    *dst++ = ' ';
+    dst = PutFloat( dst, y );
+    *dst++ = ' ';
+    dst = PutFloat( dst, z );
+    *dst++ = '\n';
+    return( dst );
+  }
+
+  /* Parses a decimal number at src, moving src past it. Returns false if there is none. */
+  bool GetFloat( const char *&src, const char *end, float &value ) {
+    const char *pos = src;
+    bool negative = false;
+    if( pos < end && ( *pos == '-' || *pos == '+' ) ) {
+      negative = *pos++ == '-';
+    }
+    if( end - pos >= 3 && ( std::strncmp( pos, "inf", 3 ) == 0 || std::strncmp( pos, "nan", 3 ) == 0 ) ) {
+      value = *pos == 'i' ? std::numeric_limits< float >::infinity( ) : std::numeric_limits< float >::quiet_NaN( );
+      value = negative ? -value : value;
+      src = pos + 3;
+      return( true );
+    }
+    uint64_t mantissa = 0;
+    int significant = 0, exponent = 0;
+    bool any = false;
+    for( ; pos < end && *pos >= '0' && *pos <= '9'; ++pos, any = true ) {
+      if( significant < 19 ) {
+        mantissa = mantissa * 10 + ( *pos - '0' );
+        significant += mantissa > 0;
+      }
+      else {
+        ++exponent;
+      }
+    }
+    if( pos < end && *pos == '.' ) {
+      for( ++pos; pos < end && *pos >= '0' && *pos <= '9'; ++pos, any = true ) {
+        if( significant < 19 ) {
+          mantissa = mantissa * 10 + ( *pos - '0' );
+          significant += mantissa > 0;
+          --exponent;
+        }
+      }
+    }
+    if( !any ) {
+      return( false );
+    }
+    if( pos < end && ( *pos == 'e' || *pos == 'E' ) ) {
+      ++pos;
+      bool negativeExponent = false;
+      if( pos < end && ( *pos == '-' || *pos == '+' ) ) {
+        negativeExponent = *pos++ == '-';
+      }
+      if( pos == end || *pos < '0' || *pos > '9' ) {
+        return( false );
+      }
+      int written = 0;
+      for( ; pos < end && *pos >= '0' && *pos <= '9'; ++pos ) {
+        written = std::min( written * 10 + ( *pos - '0' ), 100000 );
+      }
+      exponent += negativeExponent ? -written : written;
+    }
+    double result = ScaleDecimal( static_cast< double >( mantissa ), std::max( -400, std::min( exponent, 400 ) ) );
+    value = static_cast< float >( negative ? -result : result );
+    src = pos;
+    return( true );
+  }
+
+  bool IsSpace( char chr ) {
+    return( chr == ' ' || chr == '\n' || chr == '\r' || chr == '\t' || chr == '\f' || chr == '\v' );
+  }
+
+  /* Whitespace separated words of an ASCII STL file. */
+  class Tokens {
+    const char *pos, *end;
+
+  public:
+    Tokens( const char *begin, const char *end ) : pos( begin ), end( end ) {
+    }
+
+    const char* position( ) const {
+      return( pos );
+    }
+
+    bool AtEnd( ) {
+      while( pos < end && IsSpace( *pos ) ) {
+        ++pos;
+      }
+      return( pos == end );
+    }
+
+    bool Word( const char *word ) {
+      size_t length = std::strlen( word );
+      if( AtEnd( ) || static_cast< size_t >( end - pos ) < length || std::strncmp( pos, word, length ) != 0 ||
+          ( pos + length < end && !IsSpace( pos[ length ] ) ) ) {
+        return( false );
+      }
+      pos += length;
+      return( true );
+    }
+
+    bool Floats( float *values, size_t count ) {
+      for( size_t idx = 0; idx < count; ++idx ) {
+        if( AtEnd( ) || !GetFloat( pos, end, values[ idx ] ) || ( pos < end && !IsSpace( *pos ) ) ) {
+          return( false );
+        }
+      }
+      return( true );
+    }
+
+    void SkipLine( ) {
+      while( pos < end && *pos != '\n' ) {
+        ++pos;
+      }
+    }
+  };
+
+  /* Start of the first "facet" word at or after pos, or text.size( ). */
+  size_t NextFacet( const std::string &text, size_t pos ) {
+    for( pos = text.find( "facet", pos ); pos != std::string::npos; pos = text.find( "facet", pos + 1 ) ) {
+      if( pos > 0 && IsSpace( text[ pos - 1 ] ) && pos + 5 < text.size( ) && IsSpace( text[ pos + 5 ] ) ) {
+        return( pos );
+      }
+    }
+    return( text.size( ) );
+  }
+
+  /* Whole contents of a plain or gzip compressed file. */
+  std::string ReadAll( const std::string &fileName ) {
+    gzFile gz = gzopen( fileName.c_str( ), "rb" );
+    if( !gz ) {
+      throw std::runtime_error( "Could not open " + fileName + " for reading." );
+    }
+    gzbuffer( gz, 1 << 20 );
+    std::string text;
+    struct stat st;
+    if( stat( fileName.c_str( ), &st ) == 0 ) {
+      text.reserve( static_cast< size_t >( st.st_size ) );
+    }
+    std::vector< char > buffer( 1 << 20 );
+    int bytes;
+    while( ( bytes = gzread( gz, buffer.data( ), static_cast< unsigned >( buffer.size( ) ) ) ) > 0 ) {
+      text.append( buffer.data( ), bytes );
+    }
+    gzclose( gz );
+    if( bytes < 0 ) {
+      throw std::runtime_error( "Could not read " + fileName + "." );
+    }
+    return( text );
+  }
+
+}
+
+void MeshIO::WriteSTLB( const MeshData &mesh, const std::string &fileName ) {
+  OutputFile out( fileName );
+  char header[ 80 ] = { 0 };
+  std::strncpy( header, stlbHeader, sizeof( header ) - 1 );
+  out.Write( header, sizeof( header ) );
+  uint32_t ntris = static_cast< uint32_t >( mesh.Triangles( ) );
+  out.Write( &ntris, sizeof( ntris ) );
+  PutSTLBFacets( mesh, [ &out ]( const char *data, size_t bytes ) {
+    out.Write( data, bytes );
+  } );
+}
+
+MeshIO::STLBWriter::STLBWriter( const std::string &fileName ) : fileName( fileName ) {
+  if( EndsWith( fileName, ".gz" ) ) {
+    throw std::runtime_error( "Cannot stream " + fileName + ": the triangle count of a compressed file is final." );
+  }
+  file = fopen( fileName.c_str( ), "wb" );
+  if( !file ) {
+    throw std::runtime_error( "Could not open " + fileName + " for writing." );
+  }
+  /* The triangle count is left 0 until Close. */
+  char header[ 80 + sizeof( uint32_t ) ] = { 0 };
+  std::strncpy( header, stlbHeader, 79 );
+  if( fwrite( header, 1, sizeof( header ), file ) != sizeof( header ) ) {
+    fclose( file );
+    throw std::runtime_error( "Could not write to " + fileName + "." );
+  }
+}
+
+MeshIO::STLBWriter::~STLBWriter( ) {
+  if( file ) {
+    fclose( file );
+  }
+}
+
+void MeshIO::STLBWriter::Write( const MeshData &mesh ) {
+  if( !file ) {
+    throw std::runtime_error( fileName + " is already closed." );
+  }
+  PutSTLBFacets( mesh, [ this ]( const char *data, size_t bytes ) {
+    if( fwrite( data, 1, bytes, file ) != bytes ) {
+      throw std::runtime_error( "Could not write to " + fileName + "." );
+    }
+  } );
+  triangles += mesh.Triangles( );
+}
+
+size_t MeshIO::STLBWriter::Close( ) {
+  uint32_t ntris = static_cast< uint32_t >( triangles );
+  bool ok = file && fseek( file, 80, SEEK_SET ) == 0 && fwrite( &ntris, sizeof( ntris ), 1, file ) == 1;
+  ok = file && fclose( file ) == 0 && ok;
+  file = nullptr;
+  if( !ok ) {
+    throw std::runtime_error( "Could not write to " + fileName + "." );
+  }
+  return( triangles );
+}
+
+void MeshIO::WriteSTLA( const MeshData &mesh, const std::string &fileName, size_t threads ) {
+  /* Longest facet text: 92 fixed characters and four lines of three numbers, each followed by a separator. */
+  const size_t facetSize = 92 + 12 * ( maxFloatText + 1 );
+  const size_t facetsPerBlock = 1 << 14;
+  threads = HardwareThreads( threads );
+  OutputFile out( fileName );
+  const std::string name = "Bial-Rendering";
+  const std::string solid = "solid " + name + "\n";
+  out.Write( solid.data( ), solid.size( ) );
+  const size_t ntris = mesh.Triangles( );
+  /* Blocks are formatted concurrently a batch at a time, and written in order. */
+  std::vector< std::vector< char > > blocks( threads * 4, std::vector< char >( facetsPerBlock * facetSize ) );
+  std::vector< size_t > used( blocks.size( ) );
+  for( size_t first = 0; first < ntris; first += blocks.size( ) * facetsPerBlock ) {
+    ParallelRanges( 0, blocks.size( ), threads, [ & ]( size_t firstBlock, size_t lastBlock, size_t ) {
+      for( size_t blk = firstBlock; blk < lastBlock; ++blk ) {
+        size_t begin = std::min( ntris, first + blk * facetsPerBlock );
+        size_t end = std::min( ntris, begin + facetsPerBlock );
+        char *dst = blocks[ blk ].data( );
+        for( size_t t = begin; t < end; ++t ) {
+          const MeshData::Index *tri = &mesh.tris[ t * 3 ];
+          const Point3D &p0 = mesh.p[ tri[ 0 ] ], &p1 = mesh.p[ tri[ 1 ] ], &p2 = mesh.p[ tri[ 2 ] ];
+          Vector3D nrm = FacetNormal( p0, p1, p2 );
+          dst = PutLine( dst, "  facet normal ", 15, nrm.x, nrm.y, nrm.z );
+          std::memcpy( dst, "    outer loop\n", 15 );
+          dst += 15;
+          dst = PutLine( dst, "      vertex ", 13, p0.x, p0.y, p0.z );
+          dst = PutLine( dst, "      vertex ", 13, p1.x, p1.y, p1.z );
+          dst = PutLine( dst, "      vertex ", 13, p2.x, p2.y, p2.z );
+          std::memcpy( dst, "    endloop\n  endfacet\n", 23 );
+          dst += 23;
+        }
+        used[ blk ] = dst - blocks[ blk ].data( );
+      }
+    } );
+    for( size_t blk = 0; blk < blocks.size( ); ++blk ) {
+      if( used[ blk ] > 0 ) {
+        out.Write( blocks[ blk ].data( ), used[ blk ] );
+      }
+    }
+  }
+  const std::string endsolid = "endsolid " + name + "\n";
+  out.Write( endsolid.data( ), endsolid.size( ) );
+}
+
+bool MeshIO::IsSTLA( const std::string &fileName ) {
+  gzFile gz = gzopen( fileName.c_str( ), "rb" );
+  if( !gz ) {
+    return( false );
+  }
+  char head[ 1024 ];
+  int bytes = gzread( gz, head, sizeof( head ) );
+  gzclose( gz );
+  if( bytes <= 0 ) {
+    return( false );
+  }
+  std::string text( head, bytes );
+  size_t start = 0;
+  while( start < text.size( ) && IsSpace( text[ start ] ) ) {
+    ++start;
+  }
+  if( text.compare( start, 5, "solid" ) != 0 ) {
+    return( false );
+  }
+  /* Binary files may start with "solid" too, but are not followed by text facets. */
+  size_t line = text.find( '\n', start );
+  return( line == std::string::npos ? bytes < 84 : text.find( "facet", line ) != std::string::npos ||
+          text.find( "endsolid", line ) != std::string::npos );
+}
+
+std::unique_ptr< MeshData > MeshIO::ReadSTLA( const std::string &fileName, size_t threads ) {
+  threads = HardwareThreads( threads );
+  const std::string text = ReadAll( fileName );
+  /* Chunks of whole facets, split at "facet" words after the solid line, parsed concurrently. */
+  const size_t header = std::min( text.size( ), text.find( '\n' ) );
+  std::vector< size_t > bounds( 1, 0 );
+  for( size_t part = 1; part < threads; ++part ) {
+    size_t facet = NextFacet( text, std::max( header, text.size( ) * part / threads ) );
+    bounds.push_back( std::max( bounds.back( ), facet ) );
+  }
+  bounds.push_back( text.size( ) );
+  /* Per chunk, facet normal and vertices as 12 floats per facet. */
+  std::vector< std::vector< float > > facets( bounds.size( ) - 1 );
+  std::vector< size_t > errors( facets.size( ), std::string::npos );
+  ParallelRanges( 0, facets.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t chunk = first; chunk < last; ++chunk ) {
+      Tokens tokens( text.data( ) + bounds[ chunk ], text.data( ) + bounds[ chunk + 1 ] );
+      std::vector< float > &out = facets[ chunk ];
+      out.reserve( ( bounds[ chunk + 1 ] - bounds[ chunk ] ) / 16 );
+      float values[ 12 ];
+      while( !tokens.AtEnd( ) ) {
+        if( tokens.Word( "solid" ) || tokens.Word( "endsolid" ) ) {
+          tokens.SkipLine( );
+          continue;
+        }
+        bool valid = tokens.Word( "facet" ) && tokens.Word( "normal" ) && tokens.Floats( values, 3 ) &&
+                     tokens.Word( "outer" ) && tokens.Word( "loop" );
+        for( size_t v = 1; valid && v <= 3; ++v ) {
+          valid = tokens.Word( "vertex" ) && tokens.Floats( values + v * 3, 3 );
+        }
+        if( !valid || !tokens.Word( "endloop" ) || !tokens.Word( "endfacet" ) ) {
+          errors[ chunk ] = tokens.position( ) - text.data( );
+          break;
+        }
+        out.insert( out.end( ), values, values + 12 );
+      }
+    }
+  } );
+  std::vector< size_t > offsets( 1, 0 );
+  for( size_t chunk = 0; chunk < facets.size( ); ++chunk ) {
+    if( errors[ chunk ] != std::string::npos ) {
+      size_t line = 1 + std::count( text.begin( ), text.begin( ) + errors[ chunk ], '\n' );
+      throw std::runtime_error( fileName + ":" + std::to_string( line ) + ": malformed ASCII STL facet." );
+    }
+    offsets.push_back( offsets.back( ) + facets[ chunk ].size( ) / 12 );
+  }
+  /* Unshared vertices, with the facet normal on each, as the binary reader gives them. */
+  MeshData::CheckVertices( offsets.back( ) * 3 );
+  std::unique_ptr< MeshData > mesh( new MeshData( ) );
+  mesh->p.resize( offsets.back( ) * 3 );
+  mesh->n.resize( offsets.back( ) * 3 );
+  mesh->tris.resize( offsets.back( ) * 3 );
+  ParallelRanges( 0, facets.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t chunk = first; chunk < last; ++chunk ) {
+      const std::vector< float > &in = facets[ chunk ];
+      for( size_t f = 0; f < in.size( ) / 12; ++f ) {
+        const float *values = &in[ f * 12 ];
+        size_t vertex = ( offsets[ chunk ] + f ) * 3;
+        for( size_t corner = 0; corner < 3; ++corner, ++vertex ) {
+          mesh->p[ vertex ] = Point3D( values[ 3 + corner * 3 ], values[ 4 + corner * 3 ], values[ 5 + corner * 3 ] );
+          mesh->n[ vertex ] = Normal( values[ 0 ], values[ 1 ], values[ 2 ] );
+          mesh->tris[ vertex ] = static_cast< MeshData::Index >( vertex );
+        }
+      }
+    }
+  } );
+  return( mesh );
+}
+
+void MeshIO::WriteMesh( const MeshData &mesh, const std::string &fileName, Precision precision ) {
+  const size_t threads = HardwareThreads( );
+  MeshHeader header;
+  std::memset( &header, 0, sizeof( header ) );
+  std::memcpy( header.magic, meshMagic, sizeof( meshMagic ) );
+  header.version = meshVersion;
+  header.vertices = mesh.p.size( );
+  header.indices = mesh.tris.size( );
+  header.flags = ( mesh.n.size( ) == mesh.p.size( ) && !mesh.p.empty( ) ? meshHasNormals : 0 ) |
+                 ( precision == Precision::Compact ? meshQuantized : 0 );
+  header.indexBlocks = static_cast< uint32_t >( ( header.indices + indexBlockSize - 1 ) / indexBlockSize );
+
+  std::vector< std::string > blocks( header.indexBlocks );
+  ParallelRanges( 0, blocks.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t blk = first; blk < last; ++blk ) {
+      size_t begin = blk * indexBlockSize;
+      size_t count = std::min< size_t >( indexBlockSize, header.indices - begin );
+      blocks[ blk ].reserve( count * 2 );
+      PutIndices( &mesh.tris[ begin ], count, blocks[ blk ] );
+    }
+  } );
+  std::vector< uint64_t > offsets( 1, 0 );
+  for( const std::string &block : blocks ) {
+    offsets.push_back( offsets.back( ) + block.size( ) );
+  }
+  header.indexBytes = offsets.back( );
+
+  std::vector< char > positions, normals;
+  if( header.flags & meshQuantized ) {
+    double lo[ 3 ] = { 0.0, 0.0, 0.0 }, hi[ 3 ] = { 0.0, 0.0, 0.0 };
+    for( size_t v = 0; v < mesh.p.size( ); ++v ) {
+      const double xyz[ 3 ] = { mesh.p[ v ].x, mesh.p[ v ].y, mesh.p[ v ].z };
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        lo[ axis ] = v == 0 ? xyz[ axis ] : std::min( lo[ axis ], xyz[ axis ] );
+        hi[ axis ] = v == 0 ? xyz[ axis ] : std::max( hi[ axis ], xyz[ axis ] );
+      }
+    }
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      header.origin[ axis ] = lo[ axis ];
+      header.step[ axis ] = hi[ axis ] > lo[ axis ] ? ( hi[ axis ] - lo[ axis ] ) / 65535.0 : 1.0;
+    }
+    positions.resize( Padded( PositionBytes( header ) ) );
+    normals.resize( Padded( NormalBytes( header ) ) );
+    uint16_t *qp = reinterpret_cast< uint16_t* >( positions.data( ) );
+    int16_t *qn = reinterpret_cast< int16_t* >( normals.data( ) );
+    const bool hasNormals = header.flags & meshHasNormals;
+    ParallelRanges( 0, mesh.p.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+      for( size_t v = first; v < last; ++v ) {
+        const double xyz[ 3 ] = { mesh.p[ v ].x, mesh.p[ v ].y, mesh.p[ v ].z };
+        for( size_t axis = 0; axis < 3; ++axis ) {
+          double q = std::round( ( xyz[ axis ] - header.origin[ axis ] ) / header.step[ axis ] );
+          qp[ v * 3 + axis ] = static_cast< uint16_t >( std::min( 65535.0, std::max( 0.0, q ) ) );
+        }
+        if( hasNormals ) {
+          OctEncode( mesh.n[ v ], qn + v * 2 );
+        }
+      }
+    } );
+  }
+
+  const char zeros[ 8 ] = { 0 };
+  OutputFile out( fileName );
+  out.Write( &header, sizeof( header ) );
+  if( header.flags & meshQuantized ) {
+    out.Write( positions.data( ), positions.size( ) );
+    out.Write( normals.data( ), normals.size( ) );
+  }
+  else {
+    if( header.vertices > 0 ) {
+      out.Write( &mesh.p[ 0 ], PositionBytes( header ) );
+    }
+    if( header.flags & meshHasNormals ) {
+      out.Write( &mesh.n[ 0 ], NormalBytes( header ) );
+    }
+  }
+  out.Write( offsets.data( ), offsets.size( ) * sizeof( uint64_t ) );
+  for( const std::string &block : blocks ) {
+    out.Write( block.data( ), block.size( ) );
+  }
+  out.Write( zeros, Padded( header.indexBytes ) - header.indexBytes );
+}
+
+std::unique_ptr< MeshData > MeshIO::ReadMesh( const std::string &fileName, size_t threads ) {
+  static_assert( sizeof( MeshHeader ) % 8 == 0, "Mesh file sections must stay 8 byte aligned." );
+  threads = HardwareThreads( threads );
+  MappedFile file( fileName );
+  file.WillNeed( );
+  MeshHeader header;
+  if( file.size( ) < sizeof( header ) ) {
+    throw std::runtime_error( fileName + " is not a mesh file." );
+  }
+  std::memcpy( &header, file.data( ), sizeof( header ) );
+  if( std::memcmp( header.magic, meshMagic, sizeof( meshMagic ) ) != 0 ) {
+    throw std::runtime_error( fileName + " is not a mesh file." );
+  }
+  if( header.version != meshVersion ) {
+    throw std::runtime_error( fileName + " has unsupported mesh version " + std::to_string( header.version ) + "." );
+  }
+  /* Bounds every section by the file size before any arithmetic on the counts can overflow. */
+  if( header.vertices > file.size( ) || header.indices > file.size( ) || header.indexBytes > file.size( ) ||
+      header.indices % 3 != 0 ||
+      header.indexBlocks != ( header.indices + indexBlockSize - 1 ) / indexBlockSize ) {
+    throw std::runtime_error( fileName + " has an invalid header." );
+  }
+  const size_t positionsAt = sizeof( header );
+  const size_t normalsAt = positionsAt + Padded( PositionBytes( header ) );
+  const size_t offsetsAt = normalsAt + Padded( NormalBytes( header ) );
+  const size_t indicesAt = offsetsAt + ( header.indexBlocks + size_t( 1 ) ) * sizeof( uint64_t );
+  if( indicesAt + Padded( header.indexBytes ) != file.size( ) ) {
+    throw std::runtime_error( fileName + " is truncated." );
+  }
+  std::vector< uint64_t > offsets( header.indexBlocks + size_t( 1 ) );
+  std::memcpy( offsets.data( ), file.data( ) + offsetsAt, offsets.size( ) * sizeof( uint64_t ) );
+  if( offsets.front( ) != 0 || offsets.back( ) != header.indexBytes ||
+      !std::is_sorted( offsets.begin( ), offsets.end( ) ) ) {
+    throw std::runtime_error( fileName + " has invalid index blocks." );
+  }
+
+  std::unique_ptr< MeshData > mesh( new MeshData( ) );
+  mesh->p.resize( header.vertices );
+  mesh->n.resize( header.flags & meshHasNormals ? header.vertices : 0 );
+  mesh->tris.resize( header.indices );
+  if( header.flags & meshQuantized ) {
+    ParallelRanges( 0, header.vertices, threads, [ & ]( size_t first, size_t last, size_t ) {
+      uint16_t qp[ 3 ];
+      int16_t qn[ 2 ];
+      for( size_t v = first; v < last; ++v ) {
+        std::memcpy( qp, file.data( ) + positionsAt + v * sizeof( qp ), sizeof( qp ) );
+        mesh->p[ v ] = Point3D( header.origin[ 0 ] + qp[ 0 ] * header.step[ 0 ],
+                                header.origin[ 1 ] + qp[ 1 ] * header.step[ 1 ],
+                                header.origin[ 2 ] + qp[ 2 ] * header.step[ 2 ] );
+      }
+      if( !mesh->n.empty( ) ) {
+        for( size_t v = first; v < last; ++v ) {
+          std::memcpy( qn, file.data( ) + normalsAt + v * sizeof( qn ), sizeof( qn ) );
+          mesh->n[ v ] = OctDecode( qn );
+        }
+      }
+    } );
+  }
+  else {
+    if( header.vertices > 0 ) {
+      std::memcpy( &mesh->p[ 0 ], file.data( ) + positionsAt, PositionBytes( header ) );
+    }
+    if( !mesh->n.empty( ) ) {
+      std::memcpy( &mesh->n[ 0 ], file.data( ) + normalsAt, NormalBytes( header ) );
+    }
+  }
+  std::atomic< bool > valid( true );
+  ParallelRanges( 0, header.indexBlocks, threads, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t blk = first; blk < last && valid; ++blk ) {
+      size_t begin = blk * indexBlockSize;
+      size_t count = std::min< size_t >( indexBlockSize, header.indices - begin );
+      const unsigned char *src = file.data( ) + indicesAt;
+      if( !GetIndices( src + offsets[ blk ], src + offsets[ blk + 1 ], count, header.vertices,
+                       &mesh->tris[ begin ] ) ) {
+        valid = false;
+      }
+    }
+  } );
+  if( !valid ) {
+    throw std::runtime_error( fileName + " has corrupt indices." );
+  }
+  return( mesh );
+}
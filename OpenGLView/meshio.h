@@ -0,0 +1,71 @@
+#ifndef MESHIO_H
+#define MESHIO_H
+
+#include "meshdata.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+/**
+ * Mesh file formats read and written directly from MeshData, without going through a TriangleMesh copy.
+ * Errors are reported with std::runtime_error.
+ */
+class MeshIO {
+public:
+  /* Binary STL with facet normals computed from the triangle winding. gzip compressed if fileName ends in .gz. */
+  static void WriteSTLB( const MeshData &mesh, const std::string &fileName );
+
+  /*
+   * Binary STL written in batches of triangles as they are produced, for meshes that are never whole in memory.
+   * The triangle count of the header is filled in by Close, so the file cannot be gzip compressed.
+   */
+  class STLBWriter {
+    std::FILE *file = nullptr;
+    std::string fileName;
+    size_t triangles = 0;
+
+  public:
+    explicit STLBWriter( const std::string &fileName );
+    /* Without Close, the file is left with a count of 0. */
+    ~STLBWriter( );
+    STLBWriter( const STLBWriter & ) = delete;
+    STLBWriter &operator=( const STLBWriter & ) = delete;
+
+    /* Appends the triangles of mesh. */
+    void Write( const MeshData &mesh );
+    /* Fills in the triangle count and closes the file. Returns the count. */
+    size_t Close( );
+  };
+
+  /*
+   * ASCII STL, each number with the fewest digits that read back as the same float. Facets are formatted by up to
+   * threads threads (0 for all). gzip compressed if fileName ends in .gz.
+   */
+  static void WriteSTLA( const MeshData &mesh, const std::string &fileName, size_t threads = 0 );
+
+  /* Whether fileName, plain or gzip compressed, holds ASCII rather than binary STL. */
+  static bool IsSTLA( const std::string &fileName );
+
+  /* Unwelded triangles of an ASCII STL file, parsed by up to threads threads (0 for all). */
+  static std::unique_ptr< MeshData > ReadSTLA( const std::string &fileName, size_t threads = 0 );
+
+  /*
+   * Precision of the native mesh format. Compact stores positions as 16 bit offsets within the bounding box and
+   * normals as 16 bit octahedral coordinates; Exact keeps the doubles, for caches that must give back the very mesh
+   * that was written.
+   */
+  enum class Precision { Compact, Exact };
+
+  /*
+   * Native indexed mesh (.bmsh): the welded vertices and normals followed by the triangle indices, delta and
+   * variable length coded in independent blocks. Compact files are about a fifth of the binary STL of the mesh.
+   */
+  static void WriteMesh( const MeshData &mesh, const std::string &fileName,
+                         Precision precision = Precision::Compact );
+
+  /* Maps fileName and decodes its sections with up to threads threads (0 for all). Throws on malformed files. */
+  static std::unique_ptr< MeshData > ReadMesh( const std::string &fileName, size_t threads = 0 );
+};
+
+#endif /* MESHIO_H */
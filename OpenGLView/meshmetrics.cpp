@@ -0,0 +1,166 @@
+#include "meshmetrics.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+  /* Kahan-Babuska summation: the rounding error of every addition is carried along and added back at the end. */
+  struct Sum {
+    double sum = 0.0;
+    double carry = 0.0;
+
+    void Add( double value ) {
+      double total = sum + value;
+      if( std::abs( sum ) >= std::abs( value ) ) {
+        carry += ( sum - total ) + value;
+      }
+      else {
+        carry += ( value - total ) + sum;
+      }
+      sum = total;
+    }
+
+    void Add( const Sum &other ) {
+      Add( other.sum );
+      Add( other.carry );
+    }
+
+    double Value( ) const {
+      return( sum + carry );
+    }
+  };
+
+  struct Partial {
+    size_t triangles = 0;
+    Sum area, volume, centroid[ 3 ];
+    double lo[ 3 ] = { std::numeric_limits< double >::max( ), std::numeric_limits< double >::max( ),
+                       std::numeric_limits< double >::max( ) };
+    double hi[ 3 ] = { std::numeric_limits< double >::lowest( ), std::numeric_limits< double >::lowest( ),
+                       std::numeric_limits< double >::lowest( ) };
+
+    void Merge( const Partial &other ) {
+      triangles += other.triangles;
+      area.Add( other.area );
+      volume.Add( other.volume );
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        centroid[ axis ].Add( other.centroid[ axis ] );
+        lo[ axis ] = std::min( lo[ axis ], other.lo[ axis ] );
+        hi[ axis ] = std::max( hi[ axis ], other.hi[ axis ] );
+      }
+    }
+
+    MeshMetrics::Metrics Result( size_t vertices ) const {
+      MeshMetrics::Metrics res;
+      res.triangles = triangles;
+      res.vertices = vertices;
+      res.area = area.Value( );
+      res.volume = volume.Value( );
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        res.lo[ axis ] = triangles > 0 ? lo[ axis ] : 0.0;
+        res.hi[ axis ] = triangles > 0 ? hi[ axis ] : 0.0;
+        res.centroid[ axis ] = res.area > 0.0 ? centroid[ axis ].Value( ) / res.area : 0.0;
+      }
+      return( res );
+    }
+  };
+
+  uint32_t Find( std::vector< uint32_t > &parent, uint32_t v ) {
+    while( parent[ v ] != v ) {
+      parent[ v ] = parent[ parent[ v ] ];
+      v = parent[ v ];
+    }
+    return( v );
+  }
+
+}
+
+size_t MeshMetrics::Label( const MeshData &mesh, std::vector< int > &component ) {
+  std::vector< uint32_t > parent( mesh.p.size( ) );
+  for( size_t v = 0; v < parent.size( ); ++v ) {
+    parent[ v ] = static_cast< uint32_t >( v );
+  }
+  for( size_t idx = 0; idx < mesh.tris.size( ); ++idx ) {
+    uint32_t a = Find( parent, mesh.tris[ idx ] );
+    uint32_t b = Find( parent, mesh.tris[ idx - idx % 3 + ( idx + 1 ) % 3 ] );
+    if( a != b ) {
+      parent[ std::max( a, b ) ] = std::min( a, b );
+    }
+  }
+  component.assign( mesh.p.size( ), -1 );
+  std::vector< int > number( mesh.p.size( ), -1 );
+  size_t count = 0;
+  for( MeshData::Index v : mesh.tris ) {
+    if( component[ v ] < 0 ) {
+      uint32_t root = Find( parent, v );
+      if( number[ root ] < 0 ) {
+        number[ root ] = static_cast< int >( count++ );
+      }
+      component[ v ] = number[ root ];
+    }
+  }
+  return( count );
+}
+
+MeshMetrics::Report MeshMetrics::Compute( const MeshData &mesh, size_t threads ) {
+  PROFILE_SCOPE( "MeshMetrics::Compute" );
+  threads = HardwareThreads( threads );
+  std::vector< int > component;
+  const size_t count = Label( mesh, component );
+  std::vector< size_t > vertices( count, 0 );
+  for( int label : component ) {
+    if( label >= 0 ) {
+      ++vertices[ label ];
+    }
+  }
+  /* Volumes are taken about a point of the mesh rather than the origin, which may be far away. */
+  const Point3D origin = mesh.tris.empty( ) ? Point3D( 0.0, 0.0, 0.0 ) : mesh.p[ mesh.tris[ 0 ] ];
+  const size_t ntris = mesh.Triangles( );
+  /* Every thread keeps a partial per component; noisy meshes with many components get fewer threads. */
+  threads = std::max< size_t >( 1, std::min( threads, ( size_t( 16 ) << 20 ) / ( sizeof( Partial ) * count + 1 ) ) );
+  std::vector< std::vector< Partial > > partials( threads, std::vector< Partial >( count ) );
+  ParallelRanges( 0, ntris, threads, [ & ]( size_t first, size_t last, size_t part ) {
+    std::vector< Partial > &acc = partials[ part ];
+    for( size_t t = first; t < last; ++t ) {
+      const MeshData::Index *tri = &mesh.tris[ t * 3 ];
+      Partial &res = acc[ component[ tri[ 0 ] ] ];
+      const Point3D &a = mesh.p[ tri[ 0 ] ], &b = mesh.p[ tri[ 1 ] ], &c = mesh.p[ tri[ 2 ] ];
+      const Vector3D cross = Cross( b - a, c - a );
+      const double area = cross.Length( ) / 2.0;
+      const Vector3D ra = a - origin, rb = b - origin, rc = c - origin;
+      res.volume.Add( ( ra.x * ( rb.y * rc.z - rb.z * rc.y ) + ra.y * ( rb.z * rc.x - rb.x * rc.z ) +
+                        ra.z * ( rb.x * rc.y - rb.y * rc.x ) ) / 6.0 );
+      res.area.Add( area );
+      const double xyz[ 3 ][ 3 ] = { { a.x, a.y, a.z }, { b.x, b.y, b.z }, { c.x, c.y, c.z } };
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        res.centroid[ axis ].Add( area * ( xyz[ 0 ][ axis ] + xyz[ 1 ][ axis ] + xyz[ 2 ][ axis ] ) / 3.0 );
+        res.lo[ axis ] = std::min( { res.lo[ axis ], xyz[ 0 ][ axis ], xyz[ 1 ][ axis ], xyz[ 2 ][ axis ] } );
+        res.hi[ axis ] = std::max( { res.hi[ axis ], xyz[ 0 ][ axis ], xyz[ 1 ][ axis ], xyz[ 2 ][ axis ] } );
+      }
+      ++res.triangles;
+    }
+  } );
+  Report report;
+  Partial total;
+  size_t used = 0;
+  for( size_t label = 0; label < count; ++label ) {
+    Partial merged;
+    for( size_t part = 0; part < threads; ++part ) {
+      merged.Merge( partials[ part ][ label ] );
+    }
+    total.Merge( merged );
+    used += vertices[ label ];
+    report.components.push_back( merged.Result( vertices[ label ] ) );
+  }
+  report.total = total.Result( used );
+  std::stable_sort( report.components.begin( ), report.components.end( ), [ ]( const Metrics &a, const Metrics &b ) {
+    return( a.area > b.area );
+  } );
+  PROFILE_COUNT( "mesh components", count );
+  return( report );
+}
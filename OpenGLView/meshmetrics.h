@@ -0,0 +1,40 @@
+#ifndef MESHMETRICS_H
+#define MESHMETRICS_H
+
+#include "meshdata.h"
+
+#include <vector>
+
+/**
+ * Surface area, enclosed volume, bounds and centroid of an indexed mesh and of each of its connected components.
+ * Components are labeled by union-find over the triangle edges; the sums are then gathered in one parallel pass
+ * over the triangles, with compensated summation so that meshes of millions of triangles lose no precision.
+ */
+class MeshMetrics {
+public:
+  struct Metrics {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    double area = 0.0;
+    /* Signed; positive when the triangles wind counterclockwise seen from outside. Only meaningful if closed. */
+    double volume = 0.0;
+    double lo[ 3 ] = { 0.0, 0.0, 0.0 };
+    double hi[ 3 ] = { 0.0, 0.0, 0.0 };
+    /* Area weighted centroid of the surface. */
+    double centroid[ 3 ] = { 0.0, 0.0, 0.0 };
+  };
+
+  struct Report {
+    Metrics total;
+    /* Largest area first. */
+    std::vector< Metrics > components;
+  };
+
+  /* Metrics of mesh with up to threads threads (0 for all). Vertices used by no triangle are not counted. */
+  static Report Compute( const MeshData &mesh, size_t threads = 0 );
+
+  /* Component of every vertex, -1 for unused ones, numbered in order of first use. Returns the number of them. */
+  static size_t Label( const MeshData &mesh, std::vector< int > &component );
+};
+
+#endif /* MESHMETRICS_H */
@@ -0,0 +1,196 @@
+#include "meshoptimizer.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+  /* Simulated LRU cache of the ordering pass; larger than most hardware caches, which only helps them. */
+  const size_t cacheSize = 32;
+  const size_t maxValence = 32;
+
+  class VertexScore {
+    float cache[ cacheSize ];
+    float valence[ maxValence + 1 ];
+
+  public:
+    VertexScore( ) {
+      /* The three most recent vertices belong to the last triangle, so reusing them at once gains little. */
+      for( size_t pos = 0; pos < cacheSize; ++pos ) {
+        cache[ pos ] = pos < 3 ? 0.75f : std::pow( 1.0f - ( pos - 3 ) / float( cacheSize - 3 ), 1.5f );
+      }
+      /* Vertices with few triangles left are finished first, so they leave the cache for good. */
+      valence[ 0 ] = 0.0f;
+      for( size_t val = 1; val <= maxValence; ++val ) {
+        valence[ val ] = 2.0f / std::sqrt( float( val ) );
+      }
+    }
+
+    float operator()( int pos, uint32_t live ) const {
+      if( live == 0 ) {
+        return( -1.0f );
+      }
+      float score = pos >= 0 ? cache[ pos ] : 0.0f;
+      return( score + ( live <= maxValence ? valence[ live ] : 2.0f / std::sqrt( float( live ) ) ) );
+    }
+  };
+
+}
+
+void MeshOptimizer::Optimize( MeshData &mesh ) {
+  PROFILE_SCOPE( "MeshOptimizer" );
+  OptimizeVertexCache( mesh.tris, mesh.Vertices( ) );
+  OptimizeVertexFetch( mesh );
+}
+
+void MeshOptimizer::OptimizeVertexCache( Vector< MeshData::Index > &tris, size_t numVerts ) {
+  typedef MeshData::Index Index;
+  const size_t ntris = tris.size( ) / 3;
+  if( ntris == 0 ) {
+    return;
+  }
+  static const VertexScore score;
+  /* Triangles of each vertex, as compressed rows. live counts the ones not emitted yet, kept in front. */
+  std::vector< uint32_t > offsets( numVerts + 1, 0 );
+  for( size_t idx = 0; idx < ntris * 3; ++idx ) {
+    ++offsets[ tris[ idx ] + 1 ];
+  }
+  for( size_t vtx = 0; vtx < numVerts; ++vtx ) {
+    offsets[ vtx + 1 ] += offsets[ vtx ];
+  }
+  std::vector< uint32_t > live( numVerts, 0 );
+  std::vector< uint32_t > adjacency( ntris * 3 );
+  for( size_t idx = 0; idx < ntris * 3; ++idx ) {
+    Index vtx = tris[ idx ];
+    adjacency[ offsets[ vtx ] + live[ vtx ]++ ] = static_cast< uint32_t >( idx / 3 );
+  }
+  std::vector< int > cachePos( numVerts, -1 );
+  std::vector< float > vertexScore( numVerts );
+  for( size_t vtx = 0; vtx < numVerts; ++vtx ) {
+    vertexScore[ vtx ] = score( -1, live[ vtx ] );
+  }
+  std::vector< float > triScore( ntris );
+  for( size_t tri = 0; tri < ntris; ++tri ) {
+    triScore[ tri ] = vertexScore[ tris[ 3 * tri ] ] + vertexScore[ tris[ 3 * tri + 1 ] ] +
+                      vertexScore[ tris[ 3 * tri + 2 ] ];
+  }
+  std::vector< bool > emitted( ntris, false );
+  std::vector< Index > cache, next;
+  cache.reserve( cacheSize + 3 );
+  next.reserve( cacheSize + 3 );
+  Vector< Index > result( ntris * 3 );
+  size_t cursor = 0;
+  size_t best = 0;
+  for( size_t out = 0; out < ntris; ++out ) {
+    if( best == ntris ) {
+      /* Nothing in the cache has triangles left: continue with the next one in input order. */
+      while( emitted[ cursor ] ) {
+        ++cursor;
+      }
+      best = cursor;
+    }
+    emitted[ best ] = true;
+    next.clear( );
+    for( size_t corner = 0; corner < 3; ++corner ) {
+      Index vtx = tris[ 3 * best + corner ];
+      result[ 3 * out + corner ] = vtx;
+      next.push_back( vtx );
+      uint32_t *first = &adjacency[ offsets[ vtx ] ];
+      uint32_t *last = first + live[ vtx ] - 1;
+      for( uint32_t *it = first; it <= last; ++it ) {
+        if( *it == best ) {
+          std::swap( *it, *last );
+          break;
+        }
+      }
+      --live[ vtx ];
+    }
+    for( Index vtx : cache ) {
+      if( vtx != next[ 0 ] && vtx != next[ 1 ] && vtx != next[ 2 ] ) {
+        next.push_back( vtx );
+      }
+    }
+    /* Vertices pushed out of the cache lose their cache score. */
+    for( size_t pos = cacheSize; pos < next.size( ); ++pos ) {
+      cachePos[ next[ pos ] ] = -1;
+      vertexScore[ next[ pos ] ] = score( -1, live[ next[ pos ] ] );
+      for( uint32_t adj = 0; adj < live[ next[ pos ] ]; ++adj ) {
+        uint32_t tri = adjacency[ offsets[ next[ pos ] ] + adj ];
+        triScore[ tri ] = vertexScore[ tris[ 3 * tri ] ] + vertexScore[ tris[ 3 * tri + 1 ] ] +
+                          vertexScore[ tris[ 3 * tri + 2 ] ];
+      }
+    }
+    next.resize( std::min( next.size( ), cacheSize ) );
+    for( size_t pos = 0; pos < next.size( ); ++pos ) {
+      cachePos[ next[ pos ] ] = static_cast< int >( pos );
+      vertexScore[ next[ pos ] ] = score( static_cast< int >( pos ), live[ next[ pos ] ] );
+    }
+    /* Only triangles of cached vertices changed score, so the next one is picked among them. */
+    best = ntris;
+    float bestScore = -std::numeric_limits< float >::max( );
+    for( Index vtx : next ) {
+      for( uint32_t adj = 0; adj < live[ vtx ]; ++adj ) {
+        uint32_t tri = adjacency[ offsets[ vtx ] + adj ];
+        float sc = vertexScore[ tris[ 3 * tri ] ] + vertexScore[ tris[ 3 * tri + 1 ] ] +
+                   vertexScore[ tris[ 3 * tri + 2 ] ];
+        triScore[ tri ] = sc;
+        if( sc > bestScore ) {
+          bestScore = sc;
+          best = tri;
+        }
+      }
+    }
+    cache.swap( next );
+  }
+  tris = result;
+}
+
+void MeshOptimizer::OptimizeVertexFetch( MeshData &mesh ) {
+  typedef MeshData::Index Index;
+  const Index unused = std::numeric_limits< Index >::max( );
+  const bool hasNormals = mesh.n.size( ) == mesh.p.size( );
+  std::vector< Index > remap( mesh.Vertices( ), unused );
+  Vector< Point3D > p;
+  Vector< Normal > n;
+  p.reserve( mesh.Vertices( ) );
+  if( hasNormals ) {
+    n.reserve( mesh.Vertices( ) );
+  }
+  for( size_t idx = 0; idx < mesh.tris.size( ); ++idx ) {
+    Index &vtx = mesh.tris[ idx ];
+    if( remap[ vtx ] == unused ) {
+      remap[ vtx ] = static_cast< Index >( p.size( ) );
+      p.push_back( mesh.p[ vtx ] );
+      if( hasNormals ) {
+        n.push_back( mesh.n[ vtx ] );
+      }
+    }
+    vtx = remap[ vtx ];
+  }
+  mesh.p = p;
+  if( hasNormals ) {
+    mesh.n = n;
+  }
+}
+
+double MeshOptimizer::ACMR( const Vector< MeshData::Index > &tris, size_t numVerts, size_t cacheSize ) {
+  const size_t ntris = tris.size( ) / 3;
+  if( ntris == 0 ) {
+    return( 0.0 );
+  }
+  /* A vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded. */
+  std::vector< size_t > loaded( numVerts, 0 );
+  size_t misses = 0;
+  for( size_t idx = 0; idx < ntris * 3; ++idx ) {
+    size_t &stamp = loaded[ tris[ idx ] ];
+    if( stamp == 0 || misses + 1 - stamp > cacheSize ) {
+      ++misses;
+      stamp = misses;
+    }
+  }
+  return( static_cast< double >( misses ) / ntris );
+}
@@ -0,0 +1,23 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "meshdata.h"
+
+/**
+ * Reorders an indexed mesh for rendering. Triangles are sorted for post-transform vertex cache reuse with
+ * Forsyth's linear-speed algorithm, then vertices are renumbered in first-use order so that fetches walk the
+ * vertex arrays forward. Neither pass changes the surface.
+ */
+class MeshOptimizer {
+public:
+  /* Both passes; vertices not referenced by any triangle are dropped. */
+  static void Optimize( MeshData &mesh );
+
+  static void OptimizeVertexCache( Vector< MeshData::Index > &tris, size_t numVerts );
+  static void OptimizeVertexFetch( MeshData &mesh );
+
+  /* Average cache miss ratio: transformed vertices per triangle with a FIFO cache, between 0.5 and 3. */
+  static double ACMR( const Vector< MeshData::Index > &tris, size_t numVerts, size_t cacheSize = 16 );
+};
+
+#endif /* MESHOPTIMIZER_H */
@@ -0,0 +1,219 @@
+#include "meshpipeline.h"
+
+#include "adaptivecontouring.h"
+#include "brickedvolume.h"
+#include "mappedvolume.h"
+#include "meshoptimizer.h"
+#include "meshsink.h"
+#include "meshsmoother.h"
+#include "meshwelder.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "surfacenets.h"
+
+#include <Geometrics.hpp>
+#include <MarchingCubes.hpp>
+#include <sys/stat.h>
+
+namespace {
+
+  int64_t FileSize( const std::string &fileName ) {
+    struct stat st;
+    return( stat( fileName.c_str( ), &st ) == 0 ? static_cast< int64_t >( st.st_size ) : 0 );
+  }
+
+  /* Uncompressed NIfTI files are converted straight from a mapping of the file, the rest go through Bial. */
+  Image< int > ReadImage( const std::string &fileName, size_t threads ) {
+    if( MappedVolume::CanMap( fileName ) ) {
+      return( MappedVolume( fileName ).ToImage( threads ) );
+    }
+    Image< int > img = File::Read< int >( fileName );
+    PROFILE_COUNT( "bytes read", FileSize( fileName ) );
+    return( img );
+  }
+
+  /* Marching cubes over z slabs, one sink per thread, merged in slab order. */
+  std::unique_ptr< MeshData > ParallelMarchingCubes( const Image< int > &img, float level, size_t threads,
+                                                     const VolumeStatistics *stats ) {
+    const size_t cells = img.size( 2 ) > 0 ? img.size( 2 ) - 1 : 0;
+    std::vector< std::unique_ptr< MeshData > > parts( HardwareThreads( threads ) );
+    ParallelRanges( 0, cells, parts.size( ), [ & ]( size_t first, size_t last, size_t part ) {
+      MeshSink sink;
+      MeshSink::ExtractMarchingCubes( img, level, sink, first, last, stats );
+      parts[ part ] = sink.Take( );
+    } );
+    std::unique_ptr< MeshData > mesh( std::move( parts[ 0 ] ) );
+    if( !mesh ) {
+      return( nullptr );
+    }
+    for( size_t part = 1; part < parts.size( ); ++part ) {
+      if( parts[ part ] ) {
+        mesh->Append( *parts[ part ] );
+        parts[ part ].reset( );
+      }
+    }
+    return( mesh );
+  }
+
+  /* Marching cubes brick by brick, over contiguous runs of the Z order. */
+  std::unique_ptr< MeshData > BrickedMarchingCubes( const Image< int > &img, float level, size_t threads,
+                                                    const VolumeStatistics *stats ) {
+    BrickedVolume vol( img, threads );
+    std::vector< std::unique_ptr< MeshData > > parts( HardwareThreads( threads ) );
+    ParallelRanges( 0, vol.Bricks( ), parts.size( ), [ & ]( size_t first, size_t last, size_t part ) {
+      MeshSink sink;
+      BrickedVolume::ExtractMarchingCubes( vol, level, sink, first, last, stats );
+      parts[ part ] = sink.Take( );
+    } );
+    std::unique_ptr< MeshData > mesh( std::move( parts[ 0 ] ) );
+    for( size_t part = 1; part < parts.size( ) && mesh; ++part ) {
+      if( parts[ part ] ) {
+        mesh->Append( *parts[ part ] );
+        parts[ part ].reset( );
+      }
+    }
+    return( mesh );
+  }
+
+}
+
+std::shared_ptr< const MeshPipeline::Volume > MeshPipeline::Read( const Params &params ) {
+  if( params.fileName.empty( ) ) {
+    return( nullptr );
+  }
+  std::shared_ptr< Volume > volume( new Volume( ) );
+  volume->hasMask = !params.maskFileName.empty( );
+  COMMENT( "Loading image " << params.fileName, 0 );
+  {
+    PROFILE_SCOPE( "Read image" );
+    volume->img = ReadImage( params.fileName, params.threads );
+    if( volume->hasMask ) {
+      volume->mask = ReadImage( params.maskFileName, params.threads );
+    }
+  }
+  volume->stats.reset( new VolumeStatistics( volume->img, 1024, params.threads ) );
+  return( volume );
+}
+
+std::shared_ptr< const MeshPipeline::Volume > MeshPipeline::Scale( const Volume &volume, float scale,
+                                                                  size_t threads ) {
+  PROFILE_SCOPE( "Scale image" );
+  COMMENT( "Resizing image.", 0 );
+  std::shared_ptr< Volume > scaled( new Volume( ) );
+  scaled->hasMask = volume.hasMask;
+  scaled->img = Geometrics::Scale( volume.img, scale, true );
+  if( volume.hasMask ) {
+    scaled->mask = Geometrics::Scale( volume.mask, scale, true );
+  }
+  scaled->stats.reset( new VolumeStatistics( scaled->img, 1024, threads ) );
+  return( scaled );
+}
+
+std::shared_ptr< const MeshPipeline::Volume > MeshPipeline::Load( const Params &params ) {
+  std::shared_ptr< const Volume > volume = Read( params );
+  if( !volume || params.scale == 1.0f ) {
+    return( volume );
+  }
+  return( Scale( *volume, params.scale, params.threads ) );
+}
+
+std::unique_ptr< MeshData > MeshPipeline::Extract( const Volume &volume, const Params &params ) {
+  const Image< int > &img = volume.img;
+  const VolumeStatistics *stats = volume.stats.get( );
+  const float level = params.isolevel * stats->Maximum( );
+  COMMENT( "Isolevel " << level << " may cross " << 100.0 * stats->ActiveFraction( level ) << "% of the blocks.", 0 );
+  std::unique_ptr< MeshData > mesh;
+  bool weld = true;
+  if( params.extractor == Extractor::MarchingCubes && volume.hasMask ) {
+    COMMENT( "Binary marching cubes algorithm.", 0 );
+    PROFILE_SCOPE( "MarchingCubes::Binary" );
+    std::unique_ptr< TriangleMesh > tmesh( MarchingCubes::Binary( img, volume.mask, level ) );
+    if( tmesh ) {
+      mesh = MeshData::FromTriangleMesh( *tmesh );
+    }
+  }
+  else if( params.extractor == Extractor::MarchingCubes ) {
+    COMMENT( "Running marching cubes algorithm.", 0 );
+    if( params.bricked ) {
+      mesh = BrickedMarchingCubes( img, level, params.threads, stats );
+    }
+    else {
+      mesh = ParallelMarchingCubes( img, level, params.threads, stats );
+    }
+  }
+  else if( params.extractor == Extractor::Adaptive ) {
+    COMMENT( "Running adaptive dual contouring.", 0 );
+    AdaptiveContouring::Params adaptive;
+    adaptive.tolerance = params.tolerance;
+    adaptive.threads = params.threads;
+    MeshSink sink;
+    AdaptiveContouring::exec( img, level, sink, adaptive, volume.hasMask ? &volume.mask : nullptr, stats );
+    mesh = sink.Take( );
+    weld = false;
+  }
+  else {
+    COMMENT( "Running surface nets algorithm.", 0 );
+    SurfaceNets::Mode mode = SurfaceNets::Mode::Naive;
+    if( params.extractor == Extractor::SmoothSurfaceNets ) {
+      mode = SurfaceNets::Mode::Smooth;
+    }
+    else if( params.extractor == Extractor::DualContouring ) {
+      mode = SurfaceNets::Mode::DualContouring;
+    }
+    MeshSink sink;
+    SurfaceNets::exec( img, level, sink, mode, volume.hasMask ? &volume.mask : nullptr, stats );
+    mesh = sink.Take( );
+    /* Dual methods already share vertices between cells. */
+    weld = false;
+  }
+  if( !mesh || mesh->tris.empty( ) ) {
+    return( nullptr );
+  }
+  if( weld ) {
+    PROFILE_SCOPE( "SimplifyMesh" );
+    size_t nverts = mesh->Vertices( );
+    MeshWelder::SimplifyMesh( mesh->tris, mesh->n, mesh->p );
+    PROFILE_COUNT( "vertices welded", nverts - mesh->Vertices( ) );
+    COMMENT( "SimplifyMesh reduced the number of vertices from " << nverts << " to " << mesh->Vertices( ), 0 );
+  }
+  if( params.smoothing > 0 ) {
+    MeshSmoother::Params smoothing;
+    smoothing.iterations = params.smoothing;
+    smoothing.threads = params.threads;
+    MeshSmoother::Taubin( *mesh, smoothing );
+  }
+  if( params.optimize ) {
+    MeshOptimizer::Optimize( *mesh );
+  }
+  return( mesh );
+}
+
+std::unique_ptr< MeshData > MeshPipeline::Run( const Params &params ) {
+  std::shared_ptr< const Volume > volume = Load( params );
+  if( !volume ) {
+    return( nullptr );
+  }
+  return( Extract( *volume, params ) );
+}
+
+bool MeshPipeline::ParseExtractor( const std::string &name, Extractor &extractor ) {
+  if( name == "mc" ) {
+    extractor = Extractor::MarchingCubes;
+  }
+  else if( name == "nets" ) {
+    extractor = Extractor::SurfaceNets;
+  }
+  else if( name == "smooth-nets" ) {
+    extractor = Extractor::SmoothSurfaceNets;
+  }
+  else if( name == "dc" ) {
+    extractor = Extractor::DualContouring;
+  }
+  else if( name == "adaptive" ) {
+    extractor = Extractor::Adaptive;
+  }
+  else {
+    return( false );
+  }
+  return( true );
+}
@@ -0,0 +1,71 @@
+#ifndef MESHPIPELINE_H
+#define MESHPIPELINE_H
+
+#include "meshdata.h"
+#include "volumestatistics.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Volume to mesh pipeline: read, scale, extract and weld. Used by the viewer and by the batch mesher, and free of
+ * Qt and OpenGL. Normals of the resulting mesh follow the volume gradient.
+ */
+class MeshPipeline {
+public:
+  enum class Extractor {
+    MarchingCubes,
+    SurfaceNets,
+    SmoothSurfaceNets,
+    DualContouring,
+    /* Octree dual contouring, merging cells where the surface is flat (AdaptiveContouring). */
+    Adaptive
+  };
+
+  struct Params {
+    std::string fileName;
+    std::string maskFileName;
+    /* Fraction of the maximum intensity. */
+    float isolevel = 0.1f;
+    float scale = 1.0f;
+    Extractor extractor = Extractor::MarchingCubes;
+    /* Threads used inside the job; 0 uses all hardware threads. */
+    size_t threads = 1;
+    /* Reorders the result for rendering (MeshOptimizer), for meshes written to disk. */
+    bool optimize = false;
+    /* Marching cubes over a BrickedVolume copy, for large volumes. */
+    bool bricked = false;
+    /* Taubin lambda/mu pass pairs after welding; 0 disables smoothing. */
+    size_t smoothing = 0;
+    /* Largest error of merged cells for Extractor::Adaptive, in voxels. */
+    float tolerance = 0.1f;
+  };
+
+  /* Volume read and scaled for extraction, with its statistics. Reused by runs that only change the isolevel. */
+  struct Volume {
+    Image< int > img;
+    Image< int > mask;
+    bool hasMask = false;
+    std::unique_ptr< VolumeStatistics > stats;
+  };
+
+  /* Reads the volume and mask of params at full resolution. Throws on I/O errors. */
+  static std::shared_ptr< const Volume > Read( const Params &params );
+
+  /* Scaled copy of volume, with its own statistics. */
+  static std::shared_ptr< const Volume > Scale( const Volume &volume, float scale, size_t threads );
+
+  /* Read followed by Scale, when params.scale is not 1. */
+  static std::shared_ptr< const Volume > Load( const Params &params );
+
+  /* Extracts, welds and post-processes the surface of volume. Returns nullptr if no surface was found. */
+  static std::unique_ptr< MeshData > Extract( const Volume &volume, const Params &params );
+
+  /* Load followed by Extract. */
+  static std::unique_ptr< MeshData > Run( const Params &params );
+
+  /* Parses the names used on the command line: mc, nets, smooth-nets, dc and adaptive. */
+  static bool ParseExtractor( const std::string &name, Extractor &extractor );
+};
+
+#endif /* MESHPIPELINE_H */
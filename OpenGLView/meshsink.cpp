@@ -0,0 +1,58 @@
+#include "cubekernels.h"
+#include "meshsink.h"
+#include "profiler.h"
+
+namespace {
+
+  /* Corner displacements in the order of Adjacency::MarchingCube( ). */
+  const size_t cubeCorners[ 8 ][ 3 ] = {
+    { 0, 0, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 0, 0, 0 },
+    { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, { 0, 1, 0 }
+  };
+
+}
+
+size_t MeshSink::Polygonize( const Cell &cell, float isolevel ) {
+  return( CubeKernels::Polygonize( cell, isolevel, *this ) );
+}
+
+void MeshSink::ExtractMarchingCubes( const Image< int > &img, float isolevel, MeshSink &sink, size_t zBegin,
+                                     size_t zEnd, const VolumeStatistics *stats ) {
+  const size_t xs = img.size( 0 ), ys = img.size( 1 ), zs = img.size( 2 );
+  if( xs < 2 || ys < 2 || zs < 2 ) {
+    return;
+  }
+  PROFILE_SCOPE( "ExtractMarchingCubes" );
+  const size_t firstTri = sink.Triangles( );
+  size_t active = 0, skipped = 0;
+  Cell cell;
+  zEnd = std::min( zEnd, zs - 1 );
+  for( size_t z = zBegin; z < zEnd; ++z ) {
+    for( size_t y = 0; y + 1 < ys; ++y ) {
+      for( size_t x = 0; x + 1 < xs; ++x ) {
+        if( stats && x % VolumeStatistics::BlockEdge == 0 && !stats->MayCross( x, y, z, isolevel ) ) {
+          const size_t run = std::min( VolumeStatistics::BlockEdge, xs - 1 - x );
+          skipped += run;
+          x += run - 1;
+          continue;
+        }
+        for( size_t vtx = 0; vtx < 8; ++vtx ) {
+          size_t cx = x + cubeCorners[ vtx ][ 0 ];
+          size_t cy = y + cubeCorners[ vtx ][ 1 ];
+          size_t cz = z + cubeCorners[ vtx ][ 2 ];
+          cell.p[ vtx ] = Vector3D( cx, cy, cz );
+          cell.val[ vtx ] = img[ cx + xs * ( cy + ys * cz ) ];
+        }
+        cell.calcIdx( isolevel );
+        if( CubeKernels::Edges( cell.idx ) != 0 ) {
+          sink.Polygonize( cell, isolevel );
+          ++active;
+        }
+      }
+    }
+  }
+  PROFILE_COUNT( "cells scanned", ( xs - 1 ) * ( ys - 1 ) * ( zEnd > zBegin ? zEnd - zBegin : 0 ) - skipped );
+  PROFILE_COUNT( "cells skipped", skipped );
+  PROFILE_COUNT( "active cells", active );
+  PROFILE_COUNT( "triangles emitted", sink.Triangles( ) - firstTri );
+}
@@ -0,0 +1,75 @@
+#ifndef MESHSINK_H
+#define MESHSINK_H
+
+#include "chunkedbuffer.h"
+#include "meshdata.h"
+#include "volumestatistics.h"
+
+#include <Draw.hpp>
+#include <MarchingCubes.hpp>
+#include <limits>
+
+using namespace Bial;
+
+/**
+ * Output of the isosurface extractors. Triangles, vertices and normals are appended into chunked storage and
+ * handed over once, by Take, to whoever owns the final mesh.
+ */
+class MeshSink {
+  ChunkedBuffer< size_t > tris;
+  ChunkedBuffer< Point3D > p;
+  ChunkedBuffer< Normal > n;
+
+public:
+  size_t AddVertex( const Point3D &pt, const Normal &nrm ) {
+    p.push_back( pt );
+    n.push_back( nrm );
+    return( p.size( ) - 1 );
+  }
+
+  void AddTriangle( size_t v0, size_t v1, size_t v2 ) {
+    tris.push_back( v0 );
+    tris.push_back( v1 );
+    tris.push_back( v2 );
+  }
+
+  /* Polygonizes a single cell with the kernel of its case, see CubeKernels. Returns the number of triangles. */
+  size_t Polygonize( const Cell &cell, float isolevel );
+
+  size_t Vertices( ) const {
+    return( p.size( ) );
+  }
+
+  size_t Triangles( ) const {
+    return( tris.size( ) / 3 );
+  }
+
+  ChunkedBuffer< size_t > &getTris( ) {
+    return( tris );
+  }
+
+  ChunkedBuffer< Point3D > &getP( ) {
+    return( p );
+  }
+
+  /* Moves the contents into a MeshData, leaving the sink empty. Throws if there are too many vertices to index. */
+  std::unique_ptr< MeshData > Take( ) {
+    MeshData::CheckVertices( p.size( ) );
+    std::unique_ptr< MeshData > data( new MeshData( ) );
+    data->tris = tris.Flatten< MeshData::Index >( );
+    data->p = p.Flatten( );
+    data->n = n.Flatten( );
+    return( data );
+  }
+
+  /*
+   * Marching cubes over the cells of img whose first z plane is in [ zBegin, zEnd ), with corners in
+   * Adjacency::MarchingCube( ) order. Cells are independent, so disjoint z ranges can be extracted concurrently
+   * into different sinks. With the statistics of img, blocks the isosurface cannot cross are skipped.
+   */
+  static void ExtractMarchingCubes( const Image< int > &img, float isolevel, MeshSink &sink, size_t zBegin = 0,
+                                    size_t zEnd = std::numeric_limits< size_t >::max( ),
+                                    const VolumeStatistics *stats = nullptr );
+};
+
+#endif /* MESHSINK_H */
@@ -0,0 +1,125 @@
+#include "meshsmoother.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+MeshSmoother::Adjacency MeshSmoother::BuildAdjacency( const Vector< MeshData::Index > &tris, size_t numVerts,
+                                                      size_t threads ) {
+  PROFILE_SCOPE( "BuildAdjacency" );
+  /* Each corner lists the other two corners of its triangle; shared edges are listed twice and deduplicated. */
+  std::vector< uint32_t > rawOffsets( numVerts + 1, 0 );
+  for( size_t idx = 0; idx < tris.size( ); ++idx ) {
+    rawOffsets[ tris[ idx ] + 1 ] += 2;
+  }
+  for( size_t vtx = 0; vtx < numVerts; ++vtx ) {
+    rawOffsets[ vtx + 1 ] += rawOffsets[ vtx ];
+  }
+  std::vector< uint32_t > raw( rawOffsets[ numVerts ] );
+  std::vector< uint32_t > fill( rawOffsets.begin( ), rawOffsets.end( ) - 1 );
+  for( size_t tri = 0; tri + 2 < tris.size( ); tri += 3 ) {
+    for( size_t corner = 0; corner < 3; ++corner ) {
+      const MeshData::Index vtx = tris[ tri + corner ];
+      raw[ fill[ vtx ]++ ] = tris[ tri + ( corner + 1 ) % 3 ];
+      raw[ fill[ vtx ]++ ] = tris[ tri + ( corner + 2 ) % 3 ];
+    }
+  }
+  std::vector< uint32_t > unique( numVerts, 0 );
+  ParallelRanges( 0, numVerts, HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t vtx = first; vtx < last; ++vtx ) {
+      auto begin = raw.begin( ) + rawOffsets[ vtx ], end = raw.begin( ) + rawOffsets[ vtx + 1 ];
+      std::sort( begin, end );
+      unique[ vtx ] = static_cast< uint32_t >( std::unique( begin, end ) - begin );
+    }
+  } );
+  Adjacency adj;
+  adj.offsets.resize( numVerts + 1, 0 );
+  for( size_t vtx = 0; vtx < numVerts; ++vtx ) {
+    adj.offsets[ vtx + 1 ] = adj.offsets[ vtx ] + unique[ vtx ];
+  }
+  adj.neighbors.resize( adj.offsets[ numVerts ] );
+  ParallelRanges( 0, numVerts, HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t vtx = first; vtx < last; ++vtx ) {
+      std::copy( raw.begin( ) + rawOffsets[ vtx ], raw.begin( ) + rawOffsets[ vtx ] + unique[ vtx ],
+                 adj.neighbors.begin( ) + adj.offsets[ vtx ] );
+    }
+  } );
+  return( adj );
+}
+
+void MeshSmoother::Taubin( MeshData &mesh, const Params &params ) {
+  const size_t numVerts = mesh.Vertices( );
+  if( numVerts == 0 || mesh.tris.empty( ) ) {
+    return;
+  }
+  PROFILE_SCOPE( "Taubin" );
+  const size_t threads = HardwareThreads( params.threads );
+  const Adjacency adj = BuildAdjacency( mesh.tris, numVerts, threads );
+  Vector< Point3D > next( mesh.p );
+  for( size_t pass = 0; pass < 2 * params.iterations; ++pass ) {
+    const double factor = pass % 2 == 0 ? params.lambda : params.mu;
+    const Vector< Point3D > &src = mesh.p;
+    ParallelRanges( 0, numVerts, threads, [ & ]( size_t first, size_t last, size_t ) {
+      for( size_t vtx = first; vtx < last; ++vtx ) {
+        const uint32_t begin = adj.offsets[ vtx ], end = adj.offsets[ vtx + 1 ];
+        const Point3D &pt = src[ vtx ];
+        Point3D &res = next[ vtx ];
+        if( begin == end ) {
+          res = pt;
+          continue;
+        }
+        double x = 0.0, y = 0.0, z = 0.0;
+        for( uint32_t nbr = begin; nbr < end; ++nbr ) {
+          const Point3D &other = src[ adj.neighbors[ nbr ] ];
+          x += other.x;
+          y += other.y;
+          z += other.z;
+        }
+        const double weight = factor / ( end - begin );
+        res.x = pt.x + weight * ( x - ( end - begin ) * pt.x );
+        res.y = pt.y + weight * ( y - ( end - begin ) * pt.y );
+        res.z = pt.z + weight * ( z - ( end - begin ) * pt.z );
+      }
+    } );
+    std::swap( mesh.p, next );
+  }
+  PROFILE_COUNT( "vertices smoothed", numVerts * 2 * params.iterations );
+  ComputeNormals( mesh );
+}
+
+void MeshSmoother::ComputeNormals( MeshData &mesh ) {
+  PROFILE_SCOPE( "ComputeNormals" );
+  const Vector< Point3D > &p = mesh.p;
+  std::vector< double > acc( 3 * p.size( ), 0.0 );
+  for( size_t tri = 0; tri + 2 < mesh.tris.size( ); tri += 3 ) {
+    const Point3D &a = p[ mesh.tris[ tri ] ], &b = p[ mesh.tris[ tri + 1 ] ], &c = p[ mesh.tris[ tri + 2 ] ];
+    const double ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+    const double vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+    /* The cross product length is twice the area, which gives the area weighting for free. */
+    const double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    for( size_t corner = 0; corner < 3; ++corner ) {
+      double *dst = &acc[ 3 * mesh.tris[ tri + corner ] ];
+      dst[ 0 ] += nx;
+      dst[ 1 ] += ny;
+      dst[ 2 ] += nz;
+    }
+  }
+  const bool hadNormals = mesh.n.size( ) == p.size( );
+  double agreement = 0.0;
+  if( hadNormals ) {
+    for( size_t vtx = 0; vtx < p.size( ); ++vtx ) {
+      agreement += acc[ 3 * vtx ] * mesh.n[ vtx ].x + acc[ 3 * vtx + 1 ] * mesh.n[ vtx ].y +
+                   acc[ 3 * vtx + 2 ] * mesh.n[ vtx ].z;
+    }
+  }
+  const double sign = agreement < 0.0 ? -1.0 : 1.0;
+  mesh.n.resize( p.size( ) );
+  for( size_t vtx = 0; vtx < p.size( ); ++vtx ) {
+    double len = std::sqrt( acc[ 3 * vtx ] * acc[ 3 * vtx ] + acc[ 3 * vtx + 1 ] * acc[ 3 * vtx + 1 ] +
+                            acc[ 3 * vtx + 2 ] * acc[ 3 * vtx + 2 ] );
+    len = len > 0.0 ? sign / len : 0.0;
+    mesh.n[ vtx ] = Normal( acc[ 3 * vtx ] * len, acc[ 3 * vtx + 1 ] * len, acc[ 3 * vtx + 2 ] * len );
+  }
+}
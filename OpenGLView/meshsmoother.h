@@ -0,0 +1,43 @@
+#ifndef MESHSMOOTHER_H
+#define MESHSMOOTHER_H
+
+#include "meshdata.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Taubin lambda/mu smoothing of a welded mesh. Removes the staircase of extracted surfaces without the shrinking
+ * of plain Laplacian smoothing. Vertex neighbors are gathered once into compressed rows, and every pass moves all
+ * vertices in parallel from one position buffer into the other.
+ */
+class MeshSmoother {
+public:
+  struct Params {
+    /* Number of lambda/mu pass pairs. */
+    size_t iterations = 10;
+    float lambda = 0.5f;
+    float mu = -0.53f;
+    /* 0 uses all hardware threads. */
+    size_t threads = 0;
+  };
+
+  /* Vertex neighbors: the neighbors of v are neighbors[ offsets[ v ] ] to neighbors[ offsets[ v + 1 ] - 1 ]. */
+  struct Adjacency {
+    std::vector< uint32_t > offsets;
+    std::vector< uint32_t > neighbors;
+  };
+
+  /* Smooths the vertices of mesh and recomputes its normals. Indices are left untouched. */
+  static void Taubin( MeshData &mesh, const Params &params );
+
+  static Adjacency BuildAdjacency( const Vector< MeshData::Index > &tris, size_t numVerts, size_t threads );
+
+  /*
+   * Area weighted vertex normals from the triangle winding. When the mesh already has normals, the new ones are
+   * flipped if needed to keep the side they were pointing to.
+   */
+  static void ComputeNormals( MeshData &mesh );
+};
+
+#endif /* MESHSMOOTHER_H */
@@ -0,0 +1,193 @@
+#include "meshstream.h"
+
+#include "boundedqueue.h"
+#include "meshio.h"
+#include "meshsink.h"
+#include "niftiinfo.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "slicereader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+
+namespace {
+
+  struct Slab {
+    /* First slice of the slab in the volume. */
+    size_t z = 0;
+    std::unique_ptr< Image< int > > img;
+  };
+
+  bool EndsWith( const std::string &str, const std::string &suffix ) {
+    return( str.size( ) >= suffix.size( ) && str.compare( str.size( ) - suffix.size( ), suffix.size( ), suffix ) == 0 );
+  }
+
+  double Seconds( std::chrono::steady_clock::time_point start ) {
+    return( std::chrono::duration< double >( std::chrono::steady_clock::now( ) - start ).count( ) );
+  }
+
+  /* Largest voxel of the first frame of reader, read slab by slab. */
+  int Maximum( SliceReader &reader, size_t slab, size_t threads ) {
+    PROFILE_SCOPE( "MeshStream maximum" );
+    const NiftiInfo &info = reader.Info( );
+    const size_t slice = info.dims[ 0 ] * info.dims[ 1 ];
+    if( info.Voxels( ) == 0 ) {
+      return( 0 );
+    }
+    std::vector< int > buffer( slab * slice );
+    int res = std::numeric_limits< int >::min( );
+    for( size_t z = 0; z < info.dims[ 2 ]; z += slab ) {
+      const size_t count = std::min( slab, info.dims[ 2 ] - z );
+      reader.Read( count, buffer.data( ), threads );
+      res = ParallelReduce( 0, count * slice, 1 << 16, res, [ &buffer ]( size_t first, size_t last ) {
+        return( *std::max_element( buffer.begin( ) + first, buffer.begin( ) + last ) );
+      }, [ ]( int a, int b ) {
+        return( std::max( a, b ) );
+      } );
+    }
+    return( res );
+  }
+
+}
+
+bool MeshStream::CanStream( const MeshPipeline::Params &params, const std::string &output ) {
+  NiftiInfo info;
+  return( params.extractor == MeshPipeline::Extractor::MarchingCubes && params.maskFileName.empty( ) &&
+          params.scale == 1.0f && params.smoothing == 0 && !params.optimize && EndsWith( output, ".stl" ) &&
+          info.Read( params.fileName ) && info.Convertible( ) );
+}
+
+size_t MeshStream::Memory( const MeshPipeline::Params &params, const Params &stream ) {
+  NiftiInfo info;
+  if( !info.Read( params.fileName ) ) {
+    return( 0 );
+  }
+  /* One slab read, depth queued and one extracted, and as many batches of triangles. */
+  const size_t slabs = 2 * ( stream.depth + 2 );
+  return( slabs * ( std::max< size_t >( 1, stream.slab ) + 1 ) * info.dims[ 0 ] * info.dims[ 1 ] * sizeof( int ) );
+}
+
+size_t MeshStream::Run( const MeshPipeline::Params &params, const std::string &output, const Params &stream,
+                        Statistics *stats ) {
+  PROFILE_SCOPE( "MeshStream::Run" );
+  const auto start = std::chrono::steady_clock::now( );
+  const size_t threads = HardwareThreads( params.threads );
+  const size_t slab = std::max< size_t >( 1, stream.slab );
+  Statistics total;
+  float level = 0.0f;
+  {
+    SliceReader reader( params.fileName );
+    level = params.isolevel * Maximum( reader, slab, threads );
+  }
+  SliceReader reader( params.fileName );
+  const size_t xs = reader.Info( ).dims[ 0 ], ys = reader.Info( ).dims[ 1 ], zs = reader.Info( ).dims[ 2 ];
+  const size_t slice = xs * ys;
+  MeshIO::STLBWriter writer( output );
+  BoundedQueue< Slab > slabs( stream.depth );
+  BoundedQueue< std::unique_ptr< MeshData > > batches( stream.depth );
+  std::exception_ptr readError, extractError, writeError;
+  /* The I/O stages block on the queues, so they get threads of their own rather than scheduler workers. */
+  std::thread readStage( [ & ]( ) {
+    try {
+      /* Consecutive slabs share a slice, which is only read once. */
+      std::vector< int > shared( slice );
+      for( size_t z = 0; slice > 0 && z + 1 < zs; z += slab ) {
+        const auto busy = std::chrono::steady_clock::now( );
+        Slab item;
+        item.z = z;
+        item.img.reset( new Image< int >( xs, ys, std::min( slab + 1, zs - z ) ) );
+        int *dst = &( *item.img )[ 0 ];
+        const size_t planes = item.img->size( 2 );
+        if( z > 0 ) {
+          std::copy( shared.begin( ), shared.end( ), dst );
+        }
+        {
+          PROFILE_SCOPE( "MeshStream read" );
+          reader.Read( z > 0 ? planes - 1 : planes, z > 0 ? dst + slice : dst, 1 );
+        }
+        std::copy( dst + ( planes - 1 ) * slice, dst + planes * slice, shared.begin( ) );
+        total.readSeconds += Seconds( busy );
+        if( !slabs.Push( std::move( item ) ) ) {
+          break;
+        }
+      }
+      slabs.Close( );
+    }
+    catch( ... ) {
+      readError = std::current_exception( );
+      slabs.Cancel( );
+    }
+  } );
+  std::thread writeStage( [ & ]( ) {
+    try {
+      std::unique_ptr< MeshData > batch;
+      while( batches.Pop( batch ) ) {
+        const auto busy = std::chrono::steady_clock::now( );
+        PROFILE_SCOPE( "MeshStream write" );
+        writer.Write( *batch );
+        total.writeSeconds += Seconds( busy );
+      }
+    }
+    catch( ... ) {
+      writeError = std::current_exception( );
+      batches.Cancel( );
+    }
+  } );
+  try {
+    Slab item;
+    while( slabs.Pop( item ) ) {
+      const auto busy = std::chrono::steady_clock::now( );
+      PROFILE_SCOPE( "MeshStream extract" );
+      const Image< int > &img = *item.img;
+      std::vector< std::unique_ptr< MeshData > > parts( threads );
+      ParallelRanges( 0, img.size( 2 ) - 1, threads, [ & ]( size_t first, size_t last, size_t part ) {
+        MeshSink sink;
+        MeshSink::ExtractMarchingCubes( img, level, sink, first, last );
+        parts[ part ] = sink.Take( );
+      } );
+      item.img.reset( );
+      std::unique_ptr< MeshData > batch( std::move( parts[ 0 ] ) );
+      for( size_t part = 1; part < parts.size( ); ++part ) {
+        if( parts[ part ] ) {
+          batch->Append( *parts[ part ] );
+          parts[ part ].reset( );
+        }
+      }
+      for( size_t vtx = 0; vtx < batch->p.size( ); ++vtx ) {
+        batch->p[ vtx ].z += item.z;
+      }
+      ++total.slabs;
+      total.extractSeconds += Seconds( busy );
+      if( !batches.Push( std::move( batch ) ) ) {
+        /* The writer failed; release the reader, which may be waiting for room. */
+        slabs.Cancel( );
+        break;
+      }
+    }
+    batches.Close( );
+  }
+  catch( ... ) {
+    extractError = std::current_exception( );
+    slabs.Cancel( );
+    batches.Cancel( );
+  }
+  readStage.join( );
+  writeStage.join( );
+  for( const std::exception_ptr &error : { readError, extractError, writeError } ) {
+    if( error ) {
+      std::rethrow_exception( error );
+    }
+  }
+  total.triangles = writer.Close( );
+  total.seconds = Seconds( start );
+  PROFILE_COUNT( "triangles streamed", total.triangles );
+  if( stats ) {
+    *stats = total;
+  }
+  return( total.triangles );
+}
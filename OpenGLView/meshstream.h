@@ -0,0 +1,50 @@
+#ifndef MESHSTREAM_H
+#define MESHSTREAM_H
+
+#include "meshpipeline.h"
+
+#include <string>
+
+/**
+ * Marching cubes from a NIfTI file straight to a binary STL file, a slab of slices at a time, for volumes that
+ * need not fit in memory. Three stages overlap: a reader thread decompresses and converts slab k + 1 while the
+ * calling thread extracts slab k on the TaskScheduler and a writer thread writes the triangles of slab k - 1.
+ * Bounded queues between the stages make a stage that runs ahead wait for the next one, so memory depends on the
+ * size of a slab rather than of the volume. The isolevel is a fraction of the maximum intensity, which a first
+ * pass over the file finds. Triangles are the same as those of MeshPipeline, before welding, which binary STL
+ * does not keep.
+ */
+class MeshStream {
+public:
+  struct Params {
+    /* Cells along z extracted together; each slab holds one slice more. */
+    size_t slab = 16;
+    /* Slabs, and triangles of slabs, waiting between two stages. */
+    size_t depth = 2;
+  };
+
+  struct Statistics {
+    size_t slabs = 0;
+    size_t triangles = 0;
+    /* Time each stage was busy, and the whole run; stages overlapped when their sum exceeds seconds. */
+    double readSeconds = 0.0;
+    double extractSeconds = 0.0;
+    double writeSeconds = 0.0;
+    double seconds = 0.0;
+  };
+
+  /*
+   * Whether Run handles params and output: marching cubes of a NIfTI file without mask, scaling, smoothing or
+   * reordering, into an uncompressed binary STL file.
+   */
+  static bool CanStream( const MeshPipeline::Params &params, const std::string &output );
+
+  /* Rough peak memory of Run on the volume of params: the slabs in flight, and triangles as large as them. */
+  static size_t Memory( const MeshPipeline::Params &params, const Params &stream );
+
+  /* Streams the surface of params into output, returning its triangle count. Throws on I/O errors. */
+  static size_t Run( const MeshPipeline::Params &params, const std::string &output, const Params &stream,
+                     Statistics *stats = nullptr );
+};
+
+#endif /* MESHSTREAM_H */
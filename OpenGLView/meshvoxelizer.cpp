@@ -0,0 +1,343 @@
+#include "meshvoxelizer.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+  /* Edge length of the bricks of the distance field, in voxels. */
+  const size_t brickSize = 8;
+
+  struct Vec {
+    double x, y, z;
+  };
+
+  Vec Sub( const Vec &a, const Vec &b ) {
+    return( Vec{ a.x - b.x, a.y - b.y, a.z - b.z } );
+  }
+
+  double Dot( const Vec &a, const Vec &b ) {
+    return( a.x * b.x + a.y * b.y + a.z * b.z );
+  }
+
+  Vec Corner( const MeshData &mesh, size_t index ) {
+    const Point3D &p = mesh.p[ mesh.tris[ index ] ];
+    return( Vec{ p.x, p.y, p.z } );
+  }
+
+  /*
+   * Side of ( u, v ) relative to the line through a and b, in the yz plane. Ties are broken as if the point were
+   * moved by an infinitesimal ( e, e^2 ), and the edge is always evaluated from its lower end, so two triangles
+   * sharing an edge never both claim, or both miss, a ray through it.
+   */
+  int Side( const Vec &a, const Vec &b, double u, double v ) {
+    const bool swap = b.y < a.y || ( b.y == a.y && b.z < a.z );
+    const Vec &s = swap ? b : a;
+    const Vec &t = swap ? a : b;
+    double det = ( t.y - s.y ) * ( v - s.z ) - ( t.z - s.z ) * ( u - s.y );
+    if( det == 0.0 ) {
+      det = t.z != s.z ? s.z - t.z : t.y - s.y;
+    }
+    int side = det > 0.0 ? 1 : det < 0.0 ? -1 : 0;
+    return( swap ? -side : side );
+  }
+
+  /* Where the ray along x through ( u, v ) crosses triangle abc, if it does. */
+  bool Cross( const Vec &a, const Vec &b, const Vec &c, double u, double v, double &x ) {
+    int sa = Side( b, c, u, v );
+    int sb = Side( c, a, u, v );
+    int sc = Side( a, b, u, v );
+    if( sa == 0 || sa != sb || sb != sc ) {
+      return( false );
+    }
+    double wa = ( c.y - b.y ) * ( v - b.z ) - ( c.z - b.z ) * ( u - b.y );
+    double wb = ( a.y - c.y ) * ( v - c.z ) - ( a.z - c.z ) * ( u - c.y );
+    double wc = ( b.y - a.y ) * ( v - a.z ) - ( b.z - a.z ) * ( u - a.y );
+    double sum = wa + wb + wc;
+    if( sum == 0.0 ) {
+      return( false );
+    }
+    x = ( wa * a.x + wb * b.x + wc * c.x ) / sum;
+    return( true );
+  }
+
+  /* Squared distance from p to triangle abc, after Ericson, Real-Time Collision Detection, 5.1.5. */
+  double DistanceSquared( const Vec &p, const Vec &a, const Vec &b, const Vec &c ) {
+    Vec ab = Sub( b, a ), ac = Sub( c, a ), ap = Sub( p, a );
+    double d1 = Dot( ab, ap ), d2 = Dot( ac, ap );
+    if( d1 <= 0.0 && d2 <= 0.0 ) {
+      return( Dot( ap, ap ) );
+    }
+    Vec bp = Sub( p, b );
+    double d3 = Dot( ab, bp ), d4 = Dot( ac, bp );
+    if( d3 >= 0.0 && d4 <= d3 ) {
+      return( Dot( bp, bp ) );
+    }
+    Vec cp = Sub( p, c );
+    double d5 = Dot( ab, cp ), d6 = Dot( ac, cp );
+    if( d6 >= 0.0 && d5 <= d6 ) {
+      return( Dot( cp, cp ) );
+    }
+    Vec q;
+    double vc = d1 * d4 - d3 * d2;
+    double vb = d5 * d2 - d1 * d6;
+    double va = d3 * d6 - d5 * d4;
+    if( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 ) {
+      double t = d1 / ( d1 - d3 );
+      q = Vec{ a.x + t * ab.x, a.y + t * ab.y, a.z + t * ab.z };
+    }
+    else if( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 ) {
+      double t = d2 / ( d2 - d6 );
+      q = Vec{ a.x + t * ac.x, a.y + t * ac.y, a.z + t * ac.z };
+    }
+    else if( va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0 ) {
+      double t = ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) );
+      q = Vec{ b.x + t * ( c.x - b.x ), b.y + t * ( c.y - b.y ), b.z + t * ( c.z - b.z ) };
+    }
+    else {
+      double denom = 1.0 / ( va + vb + vc );
+      double v = vb * denom, w = vc * denom;
+      q = Vec{ a.x + ab.x * v + ac.x * w, a.y + ab.y * v + ac.y * w, a.z + ab.z * v + ac.z * w };
+    }
+    Vec d = Sub( p, q );
+    return( Dot( d, d ) );
+  }
+
+  /* First and last grid index within [ lo, hi ] along axis, false if there is none. */
+  bool Span( const MeshVoxelizer::Grid &grid, size_t axis, double lo, double hi, size_t &first, size_t &last ) {
+    double f = std::ceil( ( lo - grid.origin[ axis ] ) / grid.spacing );
+    double l = std::floor( ( hi - grid.origin[ axis ] ) / grid.spacing );
+    f = std::max( f, 0.0 );
+    l = std::min( l, static_cast< double >( grid.size[ axis ] ) - 1.0 );
+    if( f > l ) {
+      return( false );
+    }
+    first = static_cast< size_t >( f );
+    last = static_cast< size_t >( l );
+    return( true );
+  }
+
+  /* Voxels within margin of the bounding box of triangle abc, false if there are none. */
+  bool Reach( const MeshVoxelizer::Grid &grid, const Vec &a, const Vec &b, const Vec &c, double margin,
+              size_t first[ 3 ], size_t last[ 3 ] ) {
+    const double lo[ 3 ] = { std::min( { a.x, b.x, c.x } ), std::min( { a.y, b.y, c.y } ),
+                             std::min( { a.z, b.z, c.z } ) };
+    const double hi[ 3 ] = { std::max( { a.x, b.x, c.x } ), std::max( { a.y, b.y, c.y } ),
+                             std::max( { a.z, b.z, c.z } ) };
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      if( !Span( grid, axis, lo[ axis ] - margin, hi[ axis ] + margin, first[ axis ], last[ axis ] ) ) {
+        return( false );
+      }
+    }
+    return( true );
+  }
+
+  /* Triangles touching each bin, compressed: those of bin b are members[ first[ b ] ] to members[ first[ b + 1 ] ). */
+  struct Bins {
+    std::vector< size_t > first;
+    std::vector< uint32_t > members;
+  };
+
+  typedef std::function< void( size_t ) > AddBin;
+
+  /* Two passes over the triangles, counting then filling; binsOf( triangle, add ) calls add( bin ) for each bin. */
+  template< typename BinsOf >
+  Bins Gather( size_t triangles, size_t count, BinsOf binsOf ) {
+    Bins bins;
+    bins.first.assign( count + 1, 0 );
+    for( size_t tri = 0; tri < triangles; ++tri ) {
+      binsOf( tri, [ &bins ]( size_t bin ) {
+        ++bins.first[ bin + 1 ];
+      } );
+    }
+    for( size_t bin = 0; bin < count; ++bin ) {
+      bins.first[ bin + 1 ] += bins.first[ bin ];
+    }
+    bins.members.resize( bins.first[ count ] );
+    std::vector< size_t > next( bins.first.begin( ), bins.first.end( ) - 1 );
+    for( size_t tri = 0; tri < triangles; ++tri ) {
+      binsOf( tri, [ &bins, &next, tri ]( size_t bin ) {
+        bins.members[ next[ bin ]++ ] = static_cast< uint32_t >( tri );
+      } );
+    }
+    return( bins );
+  }
+
+  /* Sets every voxel of img to inside or outside by crossing parity along x, slice by slice. */
+  template< typename T >
+  void Fill( const MeshData &mesh, const MeshVoxelizer::Grid &grid, T inside, T outside, Image< T > &img,
+             size_t threads ) {
+    const size_t xs = grid.size[ 0 ], ys = grid.size[ 1 ], zs = grid.size[ 2 ];
+    Bins slices = Gather( mesh.Triangles( ), zs, [ &mesh, &grid ]( size_t tri, const AddBin &add ) {
+      Vec a = Corner( mesh, 3 * tri ), b = Corner( mesh, 3 * tri + 1 ), c = Corner( mesh, 3 * tri + 2 );
+      size_t first, last;
+      if( Span( grid, 2, std::min( { a.z, b.z, c.z } ), std::max( { a.z, b.z, c.z } ), first, last ) ) {
+        for( size_t z = first; z <= last; ++z ) {
+          add( z );
+        }
+      }
+    } );
+    ParallelRanges( 0, zs, HardwareThreads( threads ), [ & ]( size_t firstSlice, size_t lastSlice, size_t ) {
+      std::vector< std::vector< uint32_t > > rows( ys );
+      std::vector< double > crossings;
+      for( size_t z = firstSlice; z < lastSlice; ++z ) {
+        const double v = grid.origin[ 2 ] + grid.spacing * z;
+        for( std::vector< uint32_t > &row : rows ) {
+          row.clear( );
+        }
+        for( size_t member = slices.first[ z ]; member < slices.first[ z + 1 ]; ++member ) {
+          const size_t tri = slices.members[ member ];
+          Vec a = Corner( mesh, 3 * tri ), b = Corner( mesh, 3 * tri + 1 ), c = Corner( mesh, 3 * tri + 2 );
+          size_t first, last;
+          if( Span( grid, 1, std::min( { a.y, b.y, c.y } ), std::max( { a.y, b.y, c.y } ), first, last ) ) {
+            for( size_t y = first; y <= last; ++y ) {
+              rows[ y ].push_back( static_cast< uint32_t >( tri ) );
+            }
+          }
+        }
+        for( size_t y = 0; y < ys; ++y ) {
+          const double u = grid.origin[ 1 ] + grid.spacing * y;
+          crossings.clear( );
+          for( uint32_t tri : rows[ y ] ) {
+            double x;
+            if( Cross( Corner( mesh, 3 * tri ), Corner( mesh, 3 * tri + 1 ), Corner( mesh, 3 * tri + 2 ), u, v,
+                       x ) ) {
+              crossings.push_back( x );
+            }
+          }
+          std::sort( crossings.begin( ), crossings.end( ) );
+          size_t passed = 0;
+          for( size_t x = 0; x < xs; ++x ) {
+            const double position = grid.origin[ 0 ] + grid.spacing * x;
+            while( passed < crossings.size( ) && crossings[ passed ] < position ) {
+              ++passed;
+            }
+            img( x, y, z ) = passed % 2 == 1 ? inside : outside;
+          }
+        }
+      }
+    } );
+  }
+
+}
+
+MeshVoxelizer::Grid MeshVoxelizer::Fit( const MeshData &mesh, double spacing, size_t margin ) {
+  if( !( spacing > 0.0 ) ) {
+    throw std::runtime_error( "Voxel spacing must be positive." );
+  }
+  Grid grid;
+  grid.spacing = spacing;
+  if( mesh.tris.empty( ) ) {
+    return( grid );
+  }
+  double lo[ 3 ] = { std::numeric_limits< double >::max( ), std::numeric_limits< double >::max( ),
+                     std::numeric_limits< double >::max( ) };
+  double hi[ 3 ] = { std::numeric_limits< double >::lowest( ), std::numeric_limits< double >::lowest( ),
+                     std::numeric_limits< double >::lowest( ) };
+  for( MeshData::Index index : mesh.tris ) {
+    const Point3D &p = mesh.p[ index ];
+    const double coords[ 3 ] = { p.x, p.y, p.z };
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      lo[ axis ] = std::min( lo[ axis ], coords[ axis ] );
+      hi[ axis ] = std::max( hi[ axis ], coords[ axis ] );
+    }
+  }
+  for( size_t axis = 0; axis < 3; ++axis ) {
+    grid.origin[ axis ] = lo[ axis ] - spacing * margin;
+    grid.size[ axis ] = static_cast< size_t >( std::ceil( ( hi[ axis ] - lo[ axis ] ) / spacing ) ) + 1 + 2 * margin;
+  }
+  return( grid );
+}
+
+Image< int > MeshVoxelizer::Occupancy( const MeshData &mesh, const Grid &grid, int value, size_t threads ) {
+  PROFILE_SCOPE( "MeshVoxelizer::Occupancy" );
+  Image< int > img( grid.size[ 0 ], grid.size[ 1 ], grid.size[ 2 ] );
+  Fill( mesh, grid, value, 0, img, threads );
+  return( img );
+}
+
+Image< float > MeshVoxelizer::Distance( const MeshData &mesh, const Grid &grid, double band, size_t threads ) {
+  PROFILE_SCOPE( "MeshVoxelizer::Distance" );
+  if( !( band > 0.0 ) ) {
+    throw std::runtime_error( "Distance band must be positive." );
+  }
+  const float limit = static_cast< float >( band );
+  Image< float > img( grid.size[ 0 ], grid.size[ 1 ], grid.size[ 2 ] );
+  Fill( mesh, grid, -limit, limit, img, threads );
+  size_t bricks[ 3 ];
+  for( size_t axis = 0; axis < 3; ++axis ) {
+    bricks[ axis ] = ( grid.size[ axis ] + brickSize - 1 ) / brickSize;
+  }
+  const size_t count = bricks[ 0 ] * bricks[ 1 ] * bricks[ 2 ];
+  Bins near = Gather( mesh.Triangles( ), count, [ & ]( size_t tri, const AddBin &add ) {
+    size_t first[ 3 ], last[ 3 ];
+    if( !Reach( grid, Corner( mesh, 3 * tri ), Corner( mesh, 3 * tri + 1 ), Corner( mesh, 3 * tri + 2 ), band, first,
+                last ) ) {
+      return;
+    }
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      first[ axis ] /= brickSize;
+      last[ axis ] /= brickSize;
+    }
+    for( size_t z = first[ 2 ]; z <= last[ 2 ]; ++z ) {
+      for( size_t y = first[ 1 ]; y <= last[ 1 ]; ++y ) {
+        for( size_t x = first[ 0 ]; x <= last[ 0 ]; ++x ) {
+          add( x + bricks[ 0 ] * ( y + bricks[ 1 ] * z ) );
+        }
+      }
+    }
+  } );
+  PROFILE_COUNT( "voxelizer brick triangles", near.members.size( ) );
+  /* Every brick visits only the voxels near each of its triangles, keeping the closest distances on the side. */
+  ParallelRanges( 0, count, HardwareThreads( threads ), [ & ]( size_t firstBrick, size_t lastBrick, size_t ) {
+    std::vector< double > best( brickSize * brickSize * brickSize );
+    for( size_t brick = firstBrick; brick < lastBrick; ++brick ) {
+      if( near.first[ brick ] == near.first[ brick + 1 ] ) {
+        continue;
+      }
+      const size_t start[ 3 ] = { brick % bricks[ 0 ] * brickSize, brick / bricks[ 0 ] % bricks[ 1 ] * brickSize,
+                                  brick / bricks[ 0 ] / bricks[ 1 ] * brickSize };
+      const size_t end[ 3 ] = { std::min( start[ 0 ] + brickSize, grid.size[ 0 ] ),
+                                std::min( start[ 1 ] + brickSize, grid.size[ 1 ] ),
+                                std::min( start[ 2 ] + brickSize, grid.size[ 2 ] ) };
+      auto cell = [ &start ]( size_t x, size_t y, size_t z ) {
+        return( x - start[ 0 ] + brickSize * ( y - start[ 1 ] + brickSize * ( z - start[ 2 ] ) ) );
+      };
+      std::fill( best.begin( ), best.end( ), band * band );
+      for( size_t member = near.first[ brick ]; member < near.first[ brick + 1 ]; ++member ) {
+        const size_t tri = near.members[ member ];
+        Vec a = Corner( mesh, 3 * tri ), b = Corner( mesh, 3 * tri + 1 ), c = Corner( mesh, 3 * tri + 2 );
+        size_t first[ 3 ], last[ 3 ];
+        Reach( grid, a, b, c, band, first, last );
+        for( size_t z = std::max( first[ 2 ], start[ 2 ] ); z <= std::min( last[ 2 ], end[ 2 ] - 1 ); ++z ) {
+          for( size_t y = std::max( first[ 1 ], start[ 1 ] ); y <= std::min( last[ 1 ], end[ 1 ] - 1 ); ++y ) {
+            for( size_t x = std::max( first[ 0 ], start[ 0 ] ); x <= std::min( last[ 0 ], end[ 0 ] - 1 ); ++x ) {
+              const Vec p{ grid.origin[ 0 ] + grid.spacing * x, grid.origin[ 1 ] + grid.spacing * y,
+                           grid.origin[ 2 ] + grid.spacing * z };
+              double &closest = best[ cell( x, y, z ) ];
+              closest = std::min( closest, DistanceSquared( p, a, b, c ) );
+            }
+          }
+        }
+      }
+      for( size_t z = start[ 2 ]; z < end[ 2 ]; ++z ) {
+        for( size_t y = start[ 1 ]; y < end[ 1 ]; ++y ) {
+          for( size_t x = start[ 0 ]; x < end[ 0 ]; ++x ) {
+            float &voxel = img( x, y, z );
+            const double closest = best[ cell( x, y, z ) ];
+            voxel = std::copysign( static_cast< float >( std::sqrt( closest ) ), voxel );
+          }
+        }
+      }
+    }
+  } );
+  return( img );
+}
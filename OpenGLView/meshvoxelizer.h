@@ -0,0 +1,38 @@
+#ifndef MESHVOXELIZER_H
+#define MESHVOXELIZER_H
+
+#include "meshdata.h"
+
+/**
+ * Mesh to volume: rasterizes a closed mesh onto a voxel grid as an occupancy mask, and optionally as a narrow band
+ * signed distance field. The reverse of the extractors, used to compare a mesh with the segmentation it came from
+ * or to re-extract it at another resolution.
+ */
+class MeshVoxelizer {
+public:
+  /* Voxel ( x, y, z ) is centered at origin + spacing * ( x, y, z ), in mesh units. */
+  struct Grid {
+    size_t size[ 3 ] = { 0, 0, 0 };
+    double origin[ 3 ] = { 0.0, 0.0, 0.0 };
+    double spacing = 1.0;
+  };
+
+  /* Grid with the given spacing covering the bounds of mesh and margin voxels around them. */
+  static Grid Fit( const MeshData &mesh, double spacing, size_t margin = 1 );
+
+  /*
+   * Sets the voxels inside mesh to value and the others to 0. A voxel is inside when a ray from it along x crosses
+   * the surface an odd number of times, so the winding of the triangles does not matter, but holes leak along the
+   * rows through them. Slices are filled in parallel by up to threads threads (0 for all).
+   */
+  static Image< int > Occupancy( const MeshData &mesh, const Grid &grid, int value = 1, size_t threads = 0 );
+
+  /*
+   * Distance from every voxel center to the surface in mesh units, negative inside, exact within band of the
+   * surface and clamped to -band or band beyond it. The grid is split in bricks that gather the triangles near
+   * them, so memory grows with the band and the surface, not with the grid.
+   */
+  static Image< float > Distance( const MeshData &mesh, const Grid &grid, double band, size_t threads = 0 );
+};
+
+#endif /* MESHVOXELIZER_H */
@@ -0,0 +1,131 @@
+#include "Sorting.hpp"
+#include "meshwelder.h"
+
+#include <set>
+
+static bool comparePts( const Point3D &pt1, const Point3D &pt2 ) {
+  if( pt1.x != pt2.x ) {
+    return( pt1.x < pt2.x );
+  }
+  if( pt1.y != pt2.y ) {
+    return( pt1.y < pt2.y );
+  }
+  return( pt1.z < pt2.z );
+}
+
+template< typename T >
+static Vector< std::size_t > sort_permutation( const Vector< T > &vec ) {
+  Vector< std::size_t > p( vec.size( ) );
+  std::iota( p.begin( ), p.end( ), 0 );
+  std::sort( p.begin( ), p.end( ),
+             [ & ]( std::size_t i, std::size_t j ) { return( comparePts( vec[ i ], vec[ j ] ) ); } );
+  return( p );
+}
+
+template< typename T >
+static Vector< T > apply_permutation( const Vector< T > &vec, const Vector< std::size_t > &p ) {
+  Vector< T > sorted_vec( p.size( ) );
+  std::transform( p.begin( ), p.end( ), sorted_vec.begin( ),
+                  [ & ]( std::size_t i ) { return( vec[ i ] ); } );
+  return( sorted_vec );
+}
+
+static void searchTriangles( size_t vtx,
+                             Vector< MeshData::Index > &vertexIndex,
+                             Vector< std::set< size_t > > &accum,
+                             Vector< bool > &visited ) {
+  for( auto it = accum[ vtx ].begin( ); it != accum[ vtx ].end( ); ++it ) {
+    for( size_t v = 0; v < 3; ++v ) {
+      size_t vtx2 = vertexIndex[ *it * 3 + v ];
+      if( !visited[ vtx2 ] ) {
+        visited[ vtx2 ] = true;
+        searchTriangles( vtx2, vertexIndex, accum, visited );
+        accum[ vtx ].insert( accum[ vtx2 ].begin( ), accum[ vtx2 ].end( ) );
+        accum[ vtx2 ].clear( );
+      }
+    }
+  }
+}
+
+void MeshWelder::RemoveLittleComponents( Vector< MeshData::Index > &vertexIndex, size_t numVerts ) {
+  Vector< std::set< size_t > > accum( numVerts );
+  Vector< bool > visited( numVerts, false );
+  for( size_t tris = 0; tris < vertexIndex.size( ); tris++ ) {
+    accum[ vertexIndex[ tris ] ].insert( tris / 3 );
+  }
+  size_t best = 0;
+  for( size_t vtx = 0; vtx < accum.size( ); vtx++ ) {
+    visited[ vtx ] = true;
+    searchTriangles( vtx, vertexIndex, accum, visited );
+    if( accum[ vtx ].size( ) >= vertexIndex.size( ) / 2 ) {
+      best = vtx;
+      break;
+    }
+    else if( accum[ vtx ].size( ) > accum[ best ].size( ) ) {
+      best = vtx;
+    }
+  }
+  Vector< MeshData::Index > vi( accum[ best ].size( ) * 3 );
+  size_t top = 0;
+  for( auto it = accum[ best ].begin( ); it != accum[ best ].end( ); ++it ) {
+    vi[ top++ ] = vertexIndex[ ( *it ) * 3 ];
+    vi[ top++ ] = vertexIndex[ ( *it ) * 3 + 1 ];
+    vi[ top++ ] = vertexIndex[ ( *it ) * 3 + 2 ];
+  }
+  vi.swap( vertexIndex );
+}
+
+void MeshWelder::SimplifyMesh( Vector< MeshData::Index > &vertexIndex, Vector< Normal > &n, Vector< Point3D > &p ) {
+  if( p.empty( ) ) {
+    return;
+  }
+  const bool hasNormals = n.size( ) == p.size( );
+  Vector< size_t > order = sort_permutation( p );
+  /* Aplicando ordenação sobre p e n */
+  p = apply_permutation( p, order );
+  if( hasNormals ) {
+    n = apply_permutation( n, order );
+  }
+  /* Criando o vetor de ordenação inverso */
+  Vector< size_t > invOrder( order.size( ) );
+  for( size_t i = 0; i < order.size( ); ++i ) {
+    invOrder[ order[ i ] ] = i;
+  }
+  /* Reatribuindo os indices. */
+  Vector< MeshData::Index > vi2( vertexIndex.size( ) );
+  for( size_t vtx = 0; vtx < vertexIndex.size( ); ++vtx ) {
+    vi2[ vtx ] = invOrder[ vertexIndex[ vtx ] ];
+  }
+  Vector< Point3D > p2;
+  Vector< Normal > n2;
+  p2.reserve( p.size( ) );
+  n2.reserve( n.size( ) );
+  order = Vector< size_t >( p.size( ) );
+  order[ 0 ] = 0;
+  p2.push_back( p.front( ) );
+  if( hasNormals ) {
+    n2.push_back( n.front( ) );
+  }
+  /* Removendo duplicatas */
+  for( size_t i = 1; i < p.size( ); ++i ) {
+    if( Distance( p[ i - 1 ], p[ i ] ) < 0.001 ) {
+      order[ i ] = order[ i - 1 ];
+    }
+    else {
+      order[ i ] = p2.size( );
+      p2.push_back( p[ i ] );
+      if( hasNormals ) {
+        n2.push_back( n[ i ] );
+      }
+    }
+  }
+  p2.swap( p );
+  if( hasNormals ) {
+    n2.swap( n );
+  }
+  /* Reatribuindo os indices novamente. */
+  for( size_t vtx = 0; vtx < vi2.size( ); ++vtx ) {
+    vi2[ vtx ] = order[ vi2[ vtx ] ];
+  }
+  vi2.swap( vertexIndex );
+}
@@ -0,0 +1,18 @@
+#ifndef MESHWELDER_H
+#define MESHWELDER_H
+
+#include "meshdata.h"
+
+/**
+ * Vertex welding for triangle soups, such as marching cubes output and STL files, where every triangle carries
+ * its own copy of its vertices.
+ */
+class MeshWelder {
+public:
+  /* Merges vertices closer than 0.001 and reindexes the triangles. Vertices end up sorted by position. */
+  static void SimplifyMesh( Vector< MeshData::Index > &vertexIndex, Vector< Normal > &n, Vector< Point3D > &p );
+  /* Keeps only the triangles of the biggest connected component. */
+  static void RemoveLittleComponents( Vector< MeshData::Index > &vertexIndex, size_t numVerts );
+};
+
+#endif /* MESHWELDER_H */
@@ -0,0 +1,133 @@
+#include "niftiinfo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+namespace {
+
+  template< typename T >
+  T Field( const unsigned char *hdr, size_t offset, bool swapped ) {
+    unsigned char bytes[ sizeof( T ) ];
+    std::memcpy( bytes, hdr + offset, sizeof( T ) );
+    if( swapped ) {
+      std::reverse( bytes, bytes + sizeof( T ) );
+    }
+    T val;
+    std::memcpy( &val, bytes, sizeof( T ) );
+    return( val );
+  }
+
+  template< typename T >
+  void Convert( const unsigned char *src, size_t count, bool swapped, int *dst ) {
+    for( size_t voxel = 0; voxel < count; ++voxel ) {
+      unsigned char bytes[ sizeof( T ) ];
+      std::memcpy( bytes, src + voxel * sizeof( T ), sizeof( T ) );
+      if( swapped ) {
+        std::reverse( bytes, bytes + sizeof( T ) );
+      }
+      T value;
+      std::memcpy( &value, bytes, sizeof( T ) );
+      dst[ voxel ] = static_cast< int >( value );
+    }
+  }
+
+  /* NIfTI-1 datatype codes and their sizes in bits, 0 for the ones that cannot be converted to int. */
+  int Bits( int16_t datatype ) {
+    switch( datatype ) {
+      case 2:
+      case 256:
+        return( 8 );
+      case 4:
+      case 512:
+        return( 16 );
+      case 8:
+      case 16:
+      case 768:
+        return( 32 );
+      case 64:
+        return( 64 );
+      default:
+        return( 0 );
+    }
+  }
+
+  void Convert( int16_t datatype, bool swapped, const unsigned char *src, size_t count, int *dst ) {
+    switch( datatype ) {
+      case 2:
+        Convert< uint8_t >( src, count, swapped, dst );
+        break;
+      case 256:
+        Convert< int8_t >( src, count, swapped, dst );
+        break;
+      case 4:
+        Convert< int16_t >( src, count, swapped, dst );
+        break;
+      case 512:
+        Convert< uint16_t >( src, count, swapped, dst );
+        break;
+      case 8:
+        Convert< int32_t >( src, count, swapped, dst );
+        break;
+      case 768:
+        Convert< uint32_t >( src, count, swapped, dst );
+        break;
+      case 16:
+        Convert< float >( src, count, swapped, dst );
+        break;
+      case 64:
+        Convert< double >( src, count, swapped, dst );
+        break;
+    }
+  }
+
+}
+
+bool NiftiInfo::Read( const std::string &fileName ) {
+  const size_t headerSize = 348;
+  unsigned char hdr[ headerSize ];
+  gzFile file = gzopen( fileName.c_str( ), "rb" );
+  if( !file ) {
+    return( false );
+  }
+  compressed = gzdirect( file ) == 0;
+  int got = gzread( file, hdr, headerSize );
+  gzclose( file );
+  if( got != static_cast< int >( headerSize ) ) {
+    return( false );
+  }
+  swapped = false;
+  if( Field< int32_t >( hdr, 0, false ) != static_cast< int32_t >( headerSize ) ) {
+    swapped = true;
+    if( Field< int32_t >( hdr, 0, true ) != static_cast< int32_t >( headerSize ) ) {
+      return( false );
+    }
+  }
+  if( hdr[ 344 ] != 'n' || ( hdr[ 345 ] != '+' && hdr[ 345 ] != 'i' ) || hdr[ 346 ] != '1' ) {
+    return( false );
+  }
+  singleFile = hdr[ 345 ] == '+';
+  int16_t rank = Field< int16_t >( hdr, 40, swapped );
+  if( rank < 1 || rank > 7 ) {
+    return( false );
+  }
+  ndim = static_cast< size_t >( rank );
+  for( size_t dim = 0; dim < 7; ++dim ) {
+    int16_t len = Field< int16_t >( hdr, 42 + 2 * dim, swapped );
+    dims[ dim ] = ( dim < ndim && len > 0 ) ? static_cast< size_t >( len ) : 1;
+    float spacing = Field< float >( hdr, 80 + 4 * dim, swapped );
+    pixdim[ dim ] = ( dim < ndim && spacing > 0.0f ) ? spacing : 1.0f;
+  }
+  datatype = Field< int16_t >( hdr, 70, swapped );
+  bitpix = Field< int16_t >( hdr, 72, swapped );
+  voxOffset = static_cast< size_t >( Field< float >( hdr, 108, swapped ) );
+  return( true );
+}
+
+bool NiftiInfo::Convertible( ) const {
+  return( Bits( datatype ) != 0 && Bits( datatype ) == bitpix );
+}
+
+void NiftiInfo::ToInt( const unsigned char *src, size_t count, int *dst ) const {
+  Convert( datatype, swapped, src, count, dst );
+}
@@ -0,0 +1,45 @@
+#ifndef NIFTIINFO_H
+#define NIFTIINFO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * NIfTI-1 header fields needed to plan work on a volume without decoding it. Reads plain .nii and gzip
+ * compressed .nii.gz files alike, in either byte order.
+ */
+class NiftiInfo {
+public:
+  size_t ndim = 0;
+  size_t dims[ 7 ] = { 1, 1, 1, 1, 1, 1, 1 };
+  float pixdim[ 7 ] = { 1, 1, 1, 1, 1, 1, 1 };
+  int16_t datatype = 0;
+  int16_t bitpix = 0;
+  /* Offset of the voxel data in the uncompressed file. */
+  size_t voxOffset = 0;
+  /* Header is in the opposite byte order of this machine. */
+  bool swapped = false;
+  bool compressed = false;
+  /* Voxel data follows the header in the same file ("n+1"), rather than in the .img of a .hdr/.img pair ("ni1"). */
+  bool singleFile = false;
+
+  /* Returns false if the file is missing or not a NIfTI-1 file. */
+  bool Read( const std::string &fileName );
+
+  size_t Voxels( ) const {
+    return( dims[ 0 ] * dims[ 1 ] * dims[ 2 ] );
+  }
+
+  size_t BytesPerVoxel( ) const {
+    return( static_cast< size_t >( bitpix ) / 8 );
+  }
+
+  /* True for the 8 to 32 bit integer and the floating point voxel types, which ToInt converts. */
+  bool Convertible( ) const;
+
+  /* Converts count voxels of this file's type and byte order at src to int. */
+  void ToInt( const unsigned char *src, size_t count, int *dst ) const;
+};
+
+#endif /* NIFTIINFO_H */
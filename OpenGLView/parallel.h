@@ -0,0 +1,84 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "taskscheduler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Splits [ begin, end ) into one contiguous range per thread and runs fn( first, last, part ) on each,
+ * returning when all are done. Part 0 runs on the calling thread, the others are tasks of the TaskScheduler, so
+ * asking for more parts than it has threads queues them instead of oversubscribing the processors. Parts must
+ * not wait for each other. The first exception thrown by a part is rethrown once all have finished.
+ */
+template< typename Function >
+void ParallelRanges( size_t begin, size_t end, size_t threads, Function fn ) {
+  const size_t count = end > begin ? end - begin : 0;
+  threads = std::max< size_t >( 1, std::min( threads, count ) );
+  TaskScheduler::Group group;
+  for( size_t part = 1; part < threads; ++part ) {
+    group.Run( [ &, part ]( ) {
+      fn( begin + count * part / threads, begin + count * ( part + 1 ) / threads, part );
+    } );
+  }
+  fn( begin, begin + count / threads, size_t( 0 ) );
+  group.Wait( );
+}
+
+/* Runs fn( first, last ) on the second half of [ begin, end ) as a task and recurses on the first. */
+template< typename Function >
+void ParallelSplit( TaskScheduler::Group &group, size_t begin, size_t end, size_t grain, const Function &fn ) {
+  while( end - begin > grain ) {
+    const size_t middle = begin + ( end - begin ) / 2;
+    group.Run( [ &group, &fn, middle, end, grain ]( ) {
+      ParallelSplit( group, middle, end, grain, fn );
+    } );
+    end = middle;
+  }
+  if( begin < end ) {
+    fn( begin, end );
+  }
+}
+
+/**
+ * Runs fn( first, last ) over pieces of [ begin, end ) of at most grain items, returning when all are done. The
+ * range is halved recursively, and idle threads steal the largest halves left, so uneven work balances itself.
+ */
+template< typename Function >
+void ParallelFor( size_t begin, size_t end, size_t grain, const Function &fn ) {
+  TaskScheduler::Group group;
+  ParallelSplit( group, begin, std::max( begin, end ), std::max< size_t >( 1, grain ), fn );
+  group.Wait( );
+}
+
+/**
+ * Folds combine over map( first, last ) of the pieces of [ begin, end ) of grain items, starting from identity.
+ * Pieces are mapped in parallel but combined in order, so the result does not depend on the number of threads.
+ */
+template< typename T, typename Map, typename Combine >
+T ParallelReduce( size_t begin, size_t end, size_t grain, T identity, const Map &map, const Combine &combine ) {
+  grain = std::max< size_t >( 1, grain );
+  const size_t count = end > begin ? end - begin : 0;
+  std::vector< T > pieces( ( count + grain - 1 ) / grain, identity );
+  ParallelFor( 0, pieces.size( ), 1, [ & ]( size_t first, size_t last ) {
+    for( size_t piece = first; piece < last; ++piece ) {
+      pieces[ piece ] = map( begin + piece * grain, std::min( end, begin + ( piece + 1 ) * grain ) );
+    }
+  } );
+  for( const T &piece : pieces ) {
+    identity = combine( identity, piece );
+  }
+  return( identity );
+}
+
+/* Number of threads to use when the caller asks for 0, meaning all of them: those of the TaskScheduler. */
+inline size_t HardwareThreads( size_t requested = 0 ) {
+  if( requested > 0 ) {
+    return( requested );
+  }
+  return( TaskScheduler::instance( ).Threads( ) );
+}
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,198 @@
+#include "pipelinecache.h"
+
+#include "meshio.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+  /* Path, modification time and size, so that a rewritten file gets a new key. */
+  std::string FileKey( const std::string &fileName ) {
+    if( fileName.empty( ) ) {
+      return( "-" );
+    }
+    struct stat st;
+    if( stat( fileName.c_str( ), &st ) != 0 ) {
+      return( fileName + "|missing" );
+    }
+    char buf[ 64 ];
+    std::snprintf( buf, sizeof( buf ), "|%lld|%lld", static_cast< long long >( st.st_mtime ),
+                   static_cast< long long >( st.st_size ) );
+    return( fileName + buf );
+  }
+
+  std::string VolumeKey( const MeshPipeline::Params &params, float scale ) {
+    char buf[ 32 ];
+    std::snprintf( buf, sizeof( buf ), "|%.9g", scale );
+    return( "volume|" + FileKey( params.fileName ) + "|" + FileKey( params.maskFileName ) + buf );
+  }
+
+  /* Every parameter that changes the geometry or the order of the mesh. */
+  std::string MeshKey( const MeshPipeline::Params &params ) {
+    char buf[ 96 ];
+    std::snprintf( buf, sizeof( buf ), "|%.9g|%d|%zu|%d|%d|%.9g", params.isolevel,
+                   static_cast< int >( params.extractor ), params.smoothing, params.optimize ? 1 : 0,
+                   params.bricked ? 1 : 0, params.tolerance );
+    return( "mesh|" + VolumeKey( params, params.scale ) + buf );
+  }
+
+  /* 64 bit FNV-1a, naming the on-disk entries. */
+  std::string HashName( const std::string &key ) {
+    uint64_t hash = 14695981039346656037ull;
+    for( unsigned char c : key ) {
+      hash = ( hash ^ c ) * 1099511628211ull;
+    }
+    char buf[ 32 ];
+    std::snprintf( buf, sizeof( buf ), "%016llx", static_cast< unsigned long long >( hash ) );
+    return( buf );
+  }
+
+  size_t VolumeBytes( const MeshPipeline::Volume &volume ) {
+    size_t voxels = volume.img.size( 0 ) * volume.img.size( 1 ) * volume.img.size( 2 );
+    return( voxels * sizeof( int ) * ( volume.hasMask ? 2 : 1 ) );
+  }
+
+  size_t MeshBytes( const MeshData &mesh ) {
+    return( mesh.p.size( ) * sizeof( Point3D ) + mesh.n.size( ) * sizeof( Normal ) +
+            mesh.tris.size( ) * sizeof( MeshData::Index ) );
+  }
+
+}
+
+PipelineCache::PipelineCache( size_t budget ) : budget( budget ) {
+}
+
+void PipelineCache::setBudget( size_t value ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  budget = value;
+  Evict( );
+}
+
+void PipelineCache::setDirectory( const std::string &dir ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  directory = dir;
+}
+
+size_t PipelineCache::Bytes( ) const {
+  std::lock_guard< std::mutex > lock( mtx );
+  return( bytes );
+}
+
+void PipelineCache::Clear( ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  entries.clear( );
+  index.clear( );
+  bytes = 0;
+}
+
+std::shared_ptr< const void > PipelineCache::Find( const std::string &key ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  auto it = index.find( key );
+  if( it == index.end( ) ) {
+    return( nullptr );
+  }
+  entries.splice( entries.begin( ), entries, it->second );
+  return( it->second->value );
+}
+
+void PipelineCache::Insert( const std::string &key, std::shared_ptr< const void > value, size_t size ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  if( size > budget || index.count( key ) ) {
+    return;
+  }
+  entries.push_front( Entry{ key, std::move( value ), size } );
+  index[ key ] = entries.begin( );
+  bytes += size;
+  Evict( );
+}
+
+void PipelineCache::Evict( ) {
+  /* Evicted values stay alive while someone still holds them. */
+  while( bytes > budget && !entries.empty( ) ) {
+    bytes -= entries.back( ).bytes;
+    index.erase( entries.back( ).key );
+    entries.pop_back( );
+    PROFILE_COUNT( "cache evictions", 1 );
+  }
+}
+
+std::shared_ptr< const MeshPipeline::Volume > PipelineCache::Load( const MeshPipeline::Params &params ) {
+  if( params.fileName.empty( ) ) {
+    return( nullptr );
+  }
+  const std::string key = VolumeKey( params, params.scale );
+  if( std::shared_ptr< const void > hit = Find( key ) ) {
+    PROFILE_COUNT( "volume cache hits", 1 );
+    return( std::static_pointer_cast< const MeshPipeline::Volume >( hit ) );
+  }
+  /* Scaled volumes are derived from the cached full resolution one, when there is one. */
+  const std::string rawKey = VolumeKey( params, 1.0f );
+  std::shared_ptr< const MeshPipeline::Volume > raw =
+    std::static_pointer_cast< const MeshPipeline::Volume >( Find( rawKey ) );
+  if( raw ) {
+    PROFILE_COUNT( "volume cache hits", 1 );
+  }
+  else {
+    raw = MeshPipeline::Read( params );
+    Insert( rawKey, raw, VolumeBytes( *raw ) );
+  }
+  if( params.scale == 1.0f ) {
+    return( raw );
+  }
+  std::shared_ptr< const MeshPipeline::Volume > scaled = MeshPipeline::Scale( *raw, params.scale, params.threads );
+  Insert( key, scaled, VolumeBytes( *scaled ) );
+  return( scaled );
+}
+
+std::unique_ptr< MeshData > PipelineCache::Run( const MeshPipeline::Params &params ) {
+  if( params.fileName.empty( ) ) {
+    return( nullptr );
+  }
+  const std::string key = MeshKey( params );
+  if( std::shared_ptr< const void > hit = Find( key ) ) {
+    PROFILE_COUNT( "mesh cache hits", 1 );
+    return( std::unique_ptr< MeshData >( new MeshData( *std::static_pointer_cast< const MeshData >( hit ) ) ) );
+  }
+  std::string dir;
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    dir = directory;
+  }
+  const std::string cached = dir.empty( ) ? std::string( ) : dir + "/" + HashName( key ) + ".bmsh";
+  std::unique_ptr< MeshData > mesh;
+  if( !cached.empty( ) && access( cached.c_str( ), R_OK ) == 0 ) {
+    try {
+      PROFILE_SCOPE( "Read cached mesh" );
+      mesh = MeshIO::ReadMesh( cached );
+      PROFILE_COUNT( "disk cache hits", 1 );
+    }
+    catch( const std::exception &e ) {
+      COMMENT( "Ignoring cached mesh: " << e.what( ), 0 );
+    }
+  }
+  if( !mesh ) {
+    std::shared_ptr< const MeshPipeline::Volume > volume = Load( params );
+    mesh = MeshPipeline::Extract( *volume, params );
+    if( !mesh ) {
+      return( nullptr );
+    }
+    if( !cached.empty( ) ) {
+      /* Written aside and renamed, so concurrent readers never see a partial file. */
+      const std::string partial = cached + "." + std::to_string( getpid( ) );
+      try {
+        MeshIO::WriteMesh( *mesh, partial, MeshIO::Precision::Exact );
+        std::rename( partial.c_str( ), cached.c_str( ) );
+      }
+      catch( const std::exception &e ) {
+        std::remove( partial.c_str( ) );
+        COMMENT( "Could not cache mesh: " << e.what( ), 0 );
+      }
+    }
+  }
+  /* Insert checks the budget under the lock, and drops meshes larger than it. */
+  Insert( key, std::make_shared< const MeshData >( *mesh ), MeshBytes( *mesh ) );
+  return( mesh );
+}
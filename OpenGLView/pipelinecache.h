@@ -0,0 +1,56 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include "meshpipeline.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Least recently used cache of pipeline results within a memory budget: decoded volumes, their scaled versions
+ * and extracted meshes. Entries are keyed by file path, modification time and size, scale, mask and the extraction
+ * parameters, so edited files are never served stale. Extracted meshes can also be kept on disk, to be reused by
+ * later sessions. Thread safe.
+ */
+class PipelineCache {
+public:
+  explicit PipelineCache( size_t budget = size_t( 1 ) << 30 );
+
+  /* Evicts entries until the cache fits in bytes. 0 disables the memory cache. */
+  void setBudget( size_t bytes );
+
+  /* Directory of the on-disk mesh cache, which must exist; empty disables it. */
+  void setDirectory( const std::string &dir );
+
+  /* Scaled volume of params, reading and scaling only what is not cached. */
+  std::shared_ptr< const MeshPipeline::Volume > Load( const MeshPipeline::Params &params );
+
+  /* Mesh of params from memory, from disk or extracted, in that order. The caller owns the returned copy. */
+  std::unique_ptr< MeshData > Run( const MeshPipeline::Params &params );
+
+  size_t Bytes( ) const;
+  void Clear( );
+
+private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr< const void > value;
+    size_t bytes;
+  };
+
+  std::shared_ptr< const void > Find( const std::string &key );
+  void Insert( const std::string &key, std::shared_ptr< const void > value, size_t bytes );
+  void Evict( );
+
+  mutable std::mutex mtx;
+  std::list< Entry > entries;
+  std::unordered_map< std::string, std::list< Entry >::iterator > index;
+  size_t budget;
+  size_t bytes = 0;
+  std::string directory;
+};
+
+#endif /* PIPELINECACHE_H */
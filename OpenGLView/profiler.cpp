@@ -0,0 +1,182 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+  std::string JsonEscape( const char *str ) {
+    std::string res;
+    for( const char *c = str; *c; ++c ) {
+      if( *c == '"' || *c == '\\' ) {
+        res += '\\';
+      }
+      res += *c;
+    }
+    return( res );
+  }
+
+}
+
+Profiler::Scope::Scope( const char *name ) : name( name ), start( -1 ) {
+  Profiler &prof = Profiler::instance( );
+  if( prof.isEnabled( ) ) {
+    start = prof.Now( );
+  }
+}
+
+Profiler::Scope::~Scope( ) {
+  if( start >= 0 ) {
+    Profiler &prof = Profiler::instance( );
+    prof.Record( name, start, prof.Now( ) - start );
+  }
+}
+
+Profiler::Profiler( ) : enabled( true ), epoch( std::chrono::steady_clock::now( ) ) {
+}
+
+Profiler &Profiler::instance( ) {
+  static Profiler profiler;
+  return( profiler );
+}
+
+void Profiler::setEnabled( bool value ) {
+  enabled.store( value, std::memory_order_relaxed );
+}
+
+int64_t Profiler::Now( ) const {
+  return( std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now( ) - epoch )
+          .count( ) );
+}
+
+Profiler::ThreadLog &Profiler::Local( ) {
+  /* Logs live as long as the profiler, so events of finished threads are kept. */
+  thread_local ThreadLog *local = nullptr;
+  if( !local ) {
+    std::lock_guard< std::mutex > lock( mtx );
+    logs.emplace_back( new ThreadLog( ) );
+    local = logs.back( ).get( );
+    local->thread = static_cast< uint32_t >( logs.size( ) );
+  }
+  return( *local );
+}
+
+void Profiler::Record( const char *name, int64_t start, int64_t duration ) {
+  if( !isEnabled( ) ) {
+    return;
+  }
+  ThreadLog &log = Local( );
+  std::lock_guard< std::mutex > lock( log.mtx );
+  log.events.push_back( Event{ name, start, duration } );
+}
+
+void Profiler::Count( const char *name, int64_t value ) {
+  if( !isEnabled( ) ) {
+    return;
+  }
+  ThreadLog &log = Local( );
+  std::lock_guard< std::mutex > lock( log.mtx );
+  log.counters[ name ] += value;
+}
+
+void Profiler::Reset( ) {
+  std::lock_guard< std::mutex > lock( mtx );
+  for( auto &log : logs ) {
+    std::lock_guard< std::mutex > logLock( log->mtx );
+    log->events.clear( );
+    log->counters.clear( );
+  }
+}
+
+int64_t Profiler::Counter( const std::string &name ) const {
+  int64_t total = 0;
+  std::lock_guard< std::mutex > lock( mtx );
+  for( auto &log : logs ) {
+    std::lock_guard< std::mutex > logLock( log->mtx );
+    for( auto &cnt : log->counters ) {
+      if( name == cnt.first ) {
+        total += cnt.second;
+      }
+    }
+  }
+  return( total );
+}
+
+std::string Profiler::Summary( ) const {
+  struct Stage {
+    size_t calls = 0;
+    int64_t total = 0;
+    int64_t longest = 0;
+    std::vector< uint32_t > threads;
+  };
+  std::map< std::string, Stage > stages;
+  std::map< std::string, int64_t > counters;
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    for( auto &log : logs ) {
+      std::lock_guard< std::mutex > logLock( log->mtx );
+      for( const Event &evt : log->events ) {
+        Stage &stage = stages[ evt.name ];
+        ++stage.calls;
+        stage.total += evt.duration;
+        stage.longest = std::max( stage.longest, evt.duration );
+        if( std::find( stage.threads.begin( ), stage.threads.end( ), log->thread ) == stage.threads.end( ) ) {
+          stage.threads.push_back( log->thread );
+        }
+      }
+      for( auto &cnt : log->counters ) {
+        counters[ cnt.first ] += cnt.second;
+      }
+    }
+  }
+  std::ostringstream out;
+  char line[ 256 ];
+  for( auto &stage : stages ) {
+    std::snprintf( line, sizeof( line ), "%-28s %6zu calls %10.1f ms total %10.1f ms max %3zu threads\n",
+                   stage.first.c_str( ), stage.second.calls, stage.second.total / 1000.0,
+                   stage.second.longest / 1000.0, stage.second.threads.size( ) );
+    out << line;
+  }
+  for( auto &cnt : counters ) {
+    std::snprintf( line, sizeof( line ), "%-28s %lld\n", cnt.first.c_str( ), static_cast< long long >( cnt.second ) );
+    out << line;
+  }
+  return( out.str( ) );
+}
+
+void Profiler::WriteChromeTrace( const std::string &fileName ) const {
+  std::ofstream file( fileName );
+  if( !file ) {
+    throw std::runtime_error( "Could not open " + fileName + " for writing." );
+  }
+  std::map< std::string, int64_t > counters;
+  int64_t last = 0;
+  bool first = true;
+  file << "{\"traceEvents\":[";
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    for( auto &log : logs ) {
+      std::lock_guard< std::mutex > logLock( log->mtx );
+      for( const Event &evt : log->events ) {
+        file << ( first ? "\n" : ",\n" ) << "{\"name\":\"" << JsonEscape( evt.name ) << "\",\"ph\":\"X\",\"pid\":1"
+             << ",\"tid\":" << log->thread << ",\"ts\":" << evt.start << ",\"dur\":" << evt.duration << "}";
+        last = std::max( last, evt.start + evt.duration );
+        first = false;
+      }
+      for( auto &cnt : log->counters ) {
+        counters[ cnt.first ] += cnt.second;
+      }
+    }
+  }
+  /* Counters are totals, reported once at the end of the trace. */
+  for( auto &cnt : counters ) {
+    file << ( first ? "\n" : ",\n" ) << "{\"name\":\"" << JsonEscape( cnt.first.c_str( ) )
+         << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << last << ",\"args\":{\"value\":" << cnt.second << "}}";
+    first = false;
+  }
+  file << "\n]}\n";
+}
@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Pipeline instrumentation. Scoped timers and counters are recorded into per thread logs, so recording only
+ * takes an uncontended lock, and are aggregated on demand into a text summary or a Chrome trace
+ * (chrome://tracing, Perfetto) JSON file. Names must be string literals, as only their pointers are kept.
+ */
+class Profiler {
+public:
+  struct Event {
+    const char *name;
+    int64_t start;
+    int64_t duration;
+  };
+
+  /* Times the enclosing scope. */
+  class Scope {
+    const char *name;
+    int64_t start;
+
+  public:
+    explicit Scope( const char *name );
+    ~Scope( );
+    Scope( const Scope & ) = delete;
+    Scope &operator=( const Scope & ) = delete;
+  };
+
+  static Profiler &instance( );
+
+  bool isEnabled( ) const {
+    return( enabled.load( std::memory_order_relaxed ) );
+  }
+  void setEnabled( bool value );
+
+  /* Microseconds since the profiler was created. */
+  int64_t Now( ) const;
+
+  void Record( const char *name, int64_t start, int64_t duration );
+  void Count( const char *name, int64_t value );
+  void Reset( );
+
+  /* Per stage call count, total and maximum time, followed by the counters. */
+  std::string Summary( ) const;
+  /* Total of a counter over all threads. */
+  int64_t Counter( const std::string &name ) const;
+  void WriteChromeTrace( const std::string &fileName ) const;
+
+private:
+  struct ThreadLog {
+    uint32_t thread;
+    std::mutex mtx;
+    std::vector< Event > events;
+    std::unordered_map< const char*, int64_t > counters;
+  };
+
+  Profiler( );
+  ThreadLog &Local( );
+
+  std::atomic< bool > enabled;
+  std::chrono::steady_clock::time_point epoch;
+  mutable std::mutex mtx;
+  std::vector< std::unique_ptr< ThreadLog > > logs;
+};
+
+#define PROFILE_CONCAT_IMPL( a, b ) a ## b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_IMPL( a, b )
+#define PROFILE_SCOPE( name ) Profiler::Scope PROFILE_CONCAT( profileScope, __LINE__ )( name )
+#define PROFILE_COUNT( name, value ) Profiler::instance( ).Count( name, static_cast< int64_t >( value ) )
+
+#endif /* PROFILER_H */
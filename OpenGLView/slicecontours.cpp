@@ -0,0 +1,233 @@
+#include "slicecontours.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+  typedef std::array< float, 2 > Point2;
+
+  /* Piece of contour from one edge of the grid or mesh to another, inside on its left. */
+  struct Segment {
+    uint64_t from, to;
+    Point2 start, end;
+  };
+
+  /*
+   * Chains segments sharing edges into polylines. Every edge starts at most one segment and ends at most one, so
+   * chains either run from an edge that no segment ends at, at the border of the slice or of an open mesh, or
+   * close on themselves.
+   */
+  SliceContours::Contour Link( std::vector< Segment > &segments ) {
+    std::sort( segments.begin( ), segments.end( ), [ ]( const Segment &a, const Segment &b ) {
+      return( a.from < b.from );
+    } );
+    const size_t none = segments.size( );
+    std::vector< size_t > next( segments.size( ), none );
+    std::vector< bool > continues( segments.size( ), false );
+    for( size_t seg = 0; seg < segments.size( ); ++seg ) {
+      auto found = std::lower_bound( segments.begin( ), segments.end( ), segments[ seg ].to,
+                                     [ ]( const Segment &s, uint64_t key ) {
+        return( s.from < key );
+      } );
+      if( found != segments.end( ) && found->from == segments[ seg ].to ) {
+        next[ seg ] = found - segments.begin( );
+        continues[ next[ seg ] ] = true;
+      }
+    }
+    SliceContours::Contour contour;
+    std::vector< bool > used( segments.size( ), false );
+    /* Open chains first, from their starting segments, then the closed loops that are left. */
+    for( int pass = 0; pass < 2; ++pass ) {
+      for( size_t first = 0; first < segments.size( ); ++first ) {
+        if( used[ first ] || ( pass == 0 && continues[ first ] ) ) {
+          continue;
+        }
+        SliceContours::Polyline line;
+        size_t seg = first;
+        size_t last = seg;
+        while( seg != none && !used[ seg ] ) {
+          used[ seg ] = true;
+          line.points.push_back( segments[ seg ].start );
+          last = seg;
+          seg = next[ seg ];
+        }
+        line.closed = seg == first;
+        if( !line.closed ) {
+          line.points.push_back( segments[ last ].end );
+        }
+        contour.push_back( std::move( line ) );
+      }
+    }
+    return( contour );
+  }
+
+  /*
+   * Marching squares cases. Corners 0 to 3 run counterclockwise from ( u, v ), edge k joins corner k to corner
+   * k + 1. Every edge crossed from an inside to an outside corner starts a segment that ends at the next edge
+   * crossed the other way, counterclockwise when the cell center is inside and clockwise otherwise, which only
+   * matters for the two saddle cases.
+   */
+  struct Cases {
+    /* Start and end edges of up to two segments, per case and center side. */
+    int8_t edges[ 16 ][ 2 ][ 4 ];
+
+    Cases( ) {
+      for( int code = 0; code < 16; ++code ) {
+        for( int center = 0; center < 2; ++center ) {
+          int8_t *out = edges[ code ][ center ];
+          std::fill( out, out + 4, int8_t( -1 ) );
+          int count = 0;
+          for( int edge = 0; edge < 4; ++edge ) {
+            if( !Inside( code, edge ) || Inside( code, edge + 1 ) ) {
+              continue;
+            }
+            for( int step = 1; step < 4; ++step ) {
+              int other = ( center == 1 ? edge + step : edge + 4 - step ) % 4;
+              if( !Inside( code, other ) && Inside( code, other + 1 ) ) {
+                out[ count++ ] = static_cast< int8_t >( edge );
+                out[ count++ ] = static_cast< int8_t >( other );
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    static bool Inside( int code, int corner ) {
+      return( ( code >> ( corner % 4 ) ) & 1 );
+    }
+  };
+
+  /* Pixel ( u, v ) of the slice and the two axes that run along it. */
+  size_t Dims( const Image< int > &img, SliceContours::Axis axis, size_t &us, size_t &vs ) {
+    const size_t normal = static_cast< size_t >( axis );
+    us = img.size( normal == 0 ? 1 : 0 );
+    vs = img.size( normal == 2 ? 1 : 2 );
+    return( img.size( normal ) );
+  }
+
+  /* Marching squares over one slice, copied to values first so that every axis is walked row by row. */
+  SliceContours::Contour Square( const Image< int > &img, SliceContours::Axis axis, size_t index, float isolevel,
+                                 std::vector< float > &values, std::vector< Segment > &segments ) {
+    static const Cases cases;
+    size_t us, vs;
+    Dims( img, axis, us, vs );
+    values.resize( us * vs );
+    for( size_t v = 0; v < vs; ++v ) {
+      for( size_t u = 0; u < us; ++u ) {
+        const int value = axis == SliceContours::Axis::X ? img( index, u, v ) :
+                          axis == SliceContours::Axis::Y ? img( u, index, v ) : img( u, v, index );
+        values[ u + us * v ] = static_cast< float >( value );
+      }
+    }
+    segments.clear( );
+    const size_t cornerU[ 4 ] = { 0, 1, 1, 0 };
+    const size_t cornerV[ 4 ] = { 0, 0, 1, 1 };
+    for( size_t v = 0; v + 1 < vs; ++v ) {
+      for( size_t u = 0; u + 1 < us; ++u ) {
+        float corner[ 4 ];
+        int code = 0;
+        for( int k = 0; k < 4; ++k ) {
+          corner[ k ] = values[ u + cornerU[ k ] + us * ( v + cornerV[ k ] ) ];
+          code |= ( corner[ k ] >= isolevel ) << k;
+        }
+        if( code == 0 || code == 15 ) {
+          continue;
+        }
+        const int center = ( corner[ 0 ] + corner[ 1 ] + corner[ 2 ] + corner[ 3 ] ) / 4.0f >= isolevel;
+        const int8_t *edges = cases.edges[ code ][ center ];
+        Point2 points[ 4 ];
+        uint64_t keys[ 4 ];
+        for( int k = 0; k < 4; ++k ) {
+          const int a = k, b = ( k + 1 ) % 4;
+          if( ( ( code >> a ) & 1 ) == ( ( code >> b ) & 1 ) ) {
+            continue;
+          }
+          const float t = ( isolevel - corner[ a ] ) / ( corner[ b ] - corner[ a ] );
+          points[ k ] = Point2{ { u + cornerU[ a ] + t * ( float( cornerU[ b ] ) - float( cornerU[ a ] ) ),
+                                  v + cornerV[ a ] + t * ( float( cornerV[ b ] ) - float( cornerV[ a ] ) ) } };
+          /* Edges along u are even, edges along v odd, both named after their lower pixel. */
+          const size_t lowU = u + std::min( cornerU[ a ], cornerU[ b ] );
+          const size_t lowV = v + std::min( cornerV[ a ], cornerV[ b ] );
+          keys[ k ] = 2 * ( lowU + us * static_cast< uint64_t >( lowV ) ) + ( k % 2 );
+        }
+        for( int seg = 0; seg < 4 && edges[ seg ] >= 0; seg += 2 ) {
+          segments.push_back( Segment{ keys[ edges[ seg ] ], keys[ edges[ seg + 1 ] ], points[ edges[ seg ] ],
+                                       points[ edges[ seg + 1 ] ] } );
+        }
+      }
+    }
+    return( Link( segments ) );
+  }
+
+}
+
+SliceContours::Contour SliceContours::Extract( const Image< int > &img, Axis axis, size_t index, float isolevel ) {
+  std::vector< float > values;
+  std::vector< Segment > segments;
+  return( Square( img, axis, index, isolevel, values, segments ) );
+}
+
+std::vector< SliceContours::Contour > SliceContours::Stack( const Image< int > &img, Axis axis, float isolevel,
+                                                            size_t threads ) {
+  PROFILE_SCOPE( "SliceContours::Stack" );
+  size_t us, vs;
+  std::vector< Contour > stack( Dims( img, axis, us, vs ) );
+  ParallelRanges( 0, stack.size( ), HardwareThreads( threads ), [ & ]( size_t first, size_t last, size_t ) {
+    std::vector< float > values;
+    std::vector< Segment > segments;
+    for( size_t index = first; index < last; ++index ) {
+      stack[ index ] = Square( img, axis, index, isolevel, values, segments );
+    }
+  } );
+  return( stack );
+}
+
+SliceContours::Contour SliceContours::Cut( const MeshData &mesh, Axis axis, double position ) {
+  const size_t normal = static_cast< size_t >( axis );
+  const size_t u = normal == 0 ? 1 : 0, v = normal == 2 ? 1 : 2;
+  std::vector< Segment > segments;
+  for( size_t tri = 0; tri < mesh.Triangles( ); ++tri ) {
+    MeshData::Index corner[ 3 ];
+    double coords[ 3 ][ 3 ];
+    int code = 0;
+    for( int k = 0; k < 3; ++k ) {
+      corner[ k ] = mesh.tris[ 3 * tri + k ];
+      const Point3D &p = mesh.p[ corner[ k ] ];
+      coords[ k ][ 0 ] = p.x;
+      coords[ k ][ 1 ] = p.y;
+      coords[ k ][ 2 ] = p.z;
+      /* Vertices on the plane count as above it, so that every crossing lies strictly inside an edge. */
+      code |= ( coords[ k ][ normal ] >= position ) << k;
+    }
+    if( code == 0 || code == 7 ) {
+      continue;
+    }
+    /*
+     * One vertex is alone on its side and the cut joins its two edges. Going around the triangle, the segment
+     * runs from the edge leaving the upper side to the one entering it.
+     */
+    const int lone = code == 1 || code == 6 ? 0 : code == 2 || code == 5 ? 1 : 2;
+    const int after = ( lone + 1 ) % 3, before = ( lone + 2 ) % 3;
+    auto crossing = [ & ]( int a, int b, Segment &segment, bool start ) {
+      const double t = ( position - coords[ a ][ normal ] ) / ( coords[ b ][ normal ] - coords[ a ][ normal ] );
+      const Point2 point{ { static_cast< float >( coords[ a ][ u ] + t * ( coords[ b ][ u ] - coords[ a ][ u ] ) ),
+                            static_cast< float >( coords[ a ][ v ] + t * ( coords[ b ][ v ] - coords[ a ][ v ] ) ) } };
+      const uint64_t key = static_cast< uint64_t >( std::min( corner[ a ], corner[ b ] ) ) << 32 |
+                           std::max( corner[ a ], corner[ b ] );
+      ( start ? segment.start : segment.end ) = point;
+      ( start ? segment.from : segment.to ) = key;
+    };
+    Segment segment;
+    const bool above = ( code >> lone ) & 1;
+    crossing( lone, after, segment, above );
+    crossing( before, lone, segment, !above );
+    segments.push_back( segment );
+  }
+  return( Link( segments ) );
+}
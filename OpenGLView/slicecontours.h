@@ -0,0 +1,44 @@
+#ifndef SLICECONTOURS_H
+#define SLICECONTOURS_H
+
+#include "meshdata.h"
+
+#include <array>
+#include <vector>
+
+/**
+ * Isocontours of single slices for 2D overlays, without extracting a 3D surface: marching squares over a slice of
+ * a volume, or the cut of a mesh by an axis aligned plane. Both return connected polylines, oriented so that the
+ * inside (values at or above the isolevel, or the inside of a closed mesh) lies to their left.
+ */
+class SliceContours {
+public:
+  /* Normal of the slices: X gives sagittal, Y coronal and Z axial slices. */
+  enum class Axis {
+    X,
+    Y,
+    Z
+  };
+
+  /*
+   * Points are in the two remaining axes, in increasing order: ( y, z ) for X, ( x, z ) for Y and ( x, y ) for Z,
+   * in voxel units for volumes and mesh units for meshes. The last point of a closed line is not repeated.
+   */
+  struct Polyline {
+    std::vector< std::array< float, 2 > > points;
+    bool closed = false;
+  };
+
+  typedef std::vector< Polyline > Contour;
+
+  /* Contour of slice index of img across axis at isolevel. Saddles are resolved by the mean of the four corners. */
+  static Contour Extract( const Image< int > &img, Axis axis, size_t index, float isolevel );
+
+  /* Contours of every slice of img across axis, extracted in parallel by up to threads threads (0 for all). */
+  static std::vector< Contour > Stack( const Image< int > &img, Axis axis, float isolevel, size_t threads = 0 );
+
+  /* Intersection of mesh with the plane where the axis coordinate equals position. */
+  static Contour Cut( const MeshData &mesh, Axis axis, double position );
+};
+
+#endif /* SLICECONTOURS_H */
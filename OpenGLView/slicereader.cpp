@@ -0,0 +1,75 @@
+#include "slicereader.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SliceReader::SliceReader( const std::string &fileName ) {
+  if( !info.Read( fileName ) ) {
+    throw std::runtime_error( fileName + " is not a NIfTI-1 file." );
+  }
+  if( !info.Convertible( ) ) {
+    throw std::runtime_error( fileName + " has an unsupported voxel type." );
+  }
+  if( !info.singleFile ) {
+    throw std::runtime_error( fileName + " keeps its voxels in a separate .img file and cannot be streamed." );
+  }
+  if( !info.compressed ) {
+    mapped.reset( new MappedVolume( fileName ) );
+    return;
+  }
+  gz = gzopen( fileName.c_str( ), "rb" );
+  if( !gz || gzseek( gz, static_cast< z_off_t >( info.voxOffset ), SEEK_SET ) < 0 ) {
+    if( gz ) {
+      gzclose( gz );
+    }
+    throw std::runtime_error( "Could not open " + fileName + " for reading." );
+  }
+}
+
+SliceReader::~SliceReader( ) {
+  if( gz ) {
+    gzclose( gz );
+  }
+}
+
+void SliceReader::Read( size_t count, int *dst, size_t threads ) {
+  if( count > Remaining( ) ) {
+    throw std::runtime_error( "Reading past the last slice of the volume." );
+  }
+  const size_t slice = info.dims[ 0 ] * info.dims[ 1 ];
+  const size_t zs = info.dims[ 2 ];
+  const size_t first = next;
+  threads = HardwareThreads( threads );
+  if( mapped ) {
+    ParallelRanges( 0, count, threads, [ & ]( size_t begin, size_t end, size_t ) {
+      /* Runs of slices within one frame. */
+      for( size_t idx = begin; idx < end; ) {
+        const size_t z = ( first + idx ) % zs, frame = ( first + idx ) / zs;
+        const size_t run = std::min( end - idx, zs - z );
+        mapped->Slices( z, z + run, dst + idx * slice, frame );
+        idx += run;
+      }
+    } );
+  }
+  else {
+    const size_t bytes = count * slice * info.BytesPerVoxel( );
+    buffer.resize( bytes );
+    for( size_t done = 0; done < bytes; ) {
+      int got = gzread( gz, &buffer[ done ], static_cast< unsigned >( std::min< size_t >( bytes - done, 1 << 30 ) ) );
+      if( got <= 0 ) {
+        throw std::runtime_error( "Slice " + std::to_string( first + done / ( slice * info.BytesPerVoxel( ) ) ) +
+                                  " is truncated." );
+      }
+      done += static_cast< size_t >( got );
+    }
+    PROFILE_COUNT( "bytes read", bytes );
+    ParallelRanges( 0, count, threads, [ & ]( size_t begin, size_t end, size_t ) {
+      info.ToInt( buffer.data( ) + begin * slice * info.BytesPerVoxel( ), ( end - begin ) * slice,
+                  dst + begin * slice );
+    } );
+  }
+  next += count;
+}
@@ -0,0 +1,53 @@
+#ifndef SLICEREADER_H
+#define SLICEREADER_H
+
+#include "mappedvolume.h"
+#include "niftiinfo.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * Slices of a NIfTI-1 file converted to int in file order, a few at a time, frame after frame for 4D files: from a
+ * mapping of the file when uncompressed, through zlib otherwise. Only the slices asked for are held in memory, so
+ * volumes larger than memory can be streamed through it.
+ */
+class SliceReader {
+  NiftiInfo info;
+  std::unique_ptr< MappedVolume > mapped;
+  gzFile gz = nullptr;
+  std::vector< unsigned char > buffer;
+  /* Slices read so far, over all frames. */
+  size_t next = 0;
+
+public:
+  /* Throws if the file cannot be opened, is not a single-file NIfTI-1 or has an unsupported voxel type. */
+  explicit SliceReader( const std::string &fileName );
+  ~SliceReader( );
+  SliceReader( const SliceReader &other ) = delete;
+  SliceReader &operator=( const SliceReader &other ) = delete;
+
+  const NiftiInfo &Info( ) const {
+    return( info );
+  }
+
+  /* Slices of every frame, one after the other. */
+  size_t Slices( ) const {
+    return( info.dims[ 2 ] * info.dims[ 3 ] );
+  }
+
+  /* Slices still to be read. */
+  size_t Remaining( ) const {
+    return( Slices( ) - next );
+  }
+
+  /*
+   * Converts the next count slices into dst, with up to threads threads (0 for all). Throws if fewer are left or
+   * the file is truncated.
+   */
+  void Read( size_t count, int *dst, size_t threads = 1 );
+};
+
+#endif /* SLICEREADER_H */
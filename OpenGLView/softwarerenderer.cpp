@@ -0,0 +1,353 @@
+#include "softwarerenderer.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+  const size_t tileSize = 64;
+
+  /* Column major 4 x 4 matrices, as OpenGL. */
+  struct GLMatrix {
+    double m[ 16 ];
+
+    static GLMatrix Identity( ) {
+      GLMatrix res;
+      for( size_t idx = 0; idx < 16; ++idx ) {
+        res.m[ idx ] = idx % 5 == 0 ? 1.0 : 0.0;
+      }
+      return( res );
+    }
+
+    GLMatrix operator*( const GLMatrix &other ) const {
+      GLMatrix res;
+      for( size_t col = 0; col < 4; ++col ) {
+        for( size_t row = 0; row < 4; ++row ) {
+          double sum = 0.0;
+          for( size_t k = 0; k < 4; ++k ) {
+            sum += m[ k * 4 + row ] * other.m[ col * 4 + k ];
+          }
+          res.m[ col * 4 + row ] = sum;
+        }
+      }
+      return( res );
+    }
+
+    static GLMatrix Translate( double x, double y, double z ) {
+      GLMatrix res = Identity( );
+      res.m[ 12 ] = x;
+      res.m[ 13 ] = y;
+      res.m[ 14 ] = z;
+      return( res );
+    }
+
+    static GLMatrix Scale( double x, double y, double z ) {
+      GLMatrix res = Identity( );
+      res.m[ 0 ] = x;
+      res.m[ 5 ] = y;
+      res.m[ 10 ] = z;
+      return( res );
+    }
+
+    static GLMatrix Rotate( double degrees, size_t axis ) {
+      GLMatrix res = Identity( );
+      const double rad = degrees * M_PI / 180.0, c = std::cos( rad ), s = std::sin( rad );
+      const size_t a = ( axis + 1 ) % 3, b = ( axis + 2 ) % 3;
+      res.m[ a * 4 + a ] = c;
+      res.m[ b * 4 + b ] = c;
+      res.m[ a * 4 + b ] = s;
+      res.m[ b * 4 + a ] = -s;
+      return( res );
+    }
+
+    /* gluPerspective. */
+    static GLMatrix Perspective( double fovy, double aspect, double zNear, double zFar ) {
+      GLMatrix res;
+      std::fill( res.m, res.m + 16, 0.0 );
+      const double f = 1.0 / std::tan( fovy * M_PI / 360.0 );
+      res.m[ 0 ] = f / aspect;
+      res.m[ 5 ] = f;
+      res.m[ 10 ] = ( zFar + zNear ) / ( zNear - zFar );
+      res.m[ 11 ] = -1.0;
+      res.m[ 14 ] = 2.0 * zFar * zNear / ( zNear - zFar );
+      return( res );
+    }
+  };
+
+  /* Vertex after projection and lighting. */
+  struct Projected {
+    float x, y, z;
+    bool visible;
+    float rgb[ 3 ];
+  };
+
+  /*
+   * Fixed function lighting of the viewer: global ambient 0.5 on the white color material, a directional light
+   * along the view axis with diffuse 0.4 and specular 1, and StlModel's specular ( 0.2, 0.4, 0.9 ) with shininess
+   * 25. With the light and the infinite viewer on the same axis, two sided lighting amounts to |n.z|.
+   */
+  void Shade( double nz, float *rgb ) {
+    const double specular[ 3 ] = { 0.2, 0.4, 0.9 };
+    const double facing = std::abs( nz );
+    const double highlight = std::pow( facing, 25.0 );
+    for( size_t c = 0; c < 3; ++c ) {
+      rgb[ c ] = static_cast< float >( std::min( 1.0, 0.5 + 0.4 * facing + specular[ c ] * highlight ) );
+    }
+  }
+
+  void PutChunk( FILE *file, const char *type, const std::vector< uint8_t > &data ) {
+    uint8_t length[ 4 ] = { uint8_t( data.size( ) >> 24 ), uint8_t( data.size( ) >> 16 ), uint8_t( data.size( ) >> 8 ),
+                            uint8_t( data.size( ) ) };
+    uLong crc = crc32( 0L, reinterpret_cast< const Bytef* >( type ), 4 );
+    if( !data.empty( ) ) {
+      crc = crc32( crc, data.data( ), static_cast< uInt >( data.size( ) ) );
+    }
+    uint8_t trailer[ 4 ] = { uint8_t( crc >> 24 ), uint8_t( crc >> 16 ), uint8_t( crc >> 8 ), uint8_t( crc ) };
+    fwrite( length, 1, 4, file );
+    fwrite( type, 1, 4, file );
+    fwrite( data.data( ), 1, data.size( ), file );
+    fwrite( trailer, 1, 4, file );
+  }
+
+}
+
+SoftwareRenderer::Frame SoftwareRenderer::Render( const MeshData &mesh, const Camera &camera, size_t width,
+                                                  size_t height, size_t threads ) {
+  PROFILE_SCOPE( "SoftwareRenderer::Render" );
+  threads = HardwareThreads( threads );
+  Frame frame;
+  frame.width = width;
+  frame.height = height;
+  frame.rgba.assign( width * height * 4, 0 );
+  for( size_t px = 0; px < width * height; ++px ) {
+    frame.rgba[ px * 4 + 3 ] = 255;
+  }
+  frame.depth.assign( width * height, 1.0f );
+  if( mesh.tris.empty( ) || width == 0 || height == 0 ) {
+    return( frame );
+  }
+
+  /* The transforms of STLViewer::resizeGL, STLViewer::paintGL and StlModel::draw. */
+  double lo[ 3 ] = { mesh.p[ 0 ].x, mesh.p[ 0 ].y, mesh.p[ 0 ].z }, hi[ 3 ] = { lo[ 0 ], lo[ 1 ], lo[ 2 ] };
+  for( size_t v = 1; v < mesh.p.size( ); ++v ) {
+    const double xyz[ 3 ] = { mesh.p[ v ].x, mesh.p[ v ].y, mesh.p[ v ].z };
+    for( size_t axis = 0; axis < 3; ++axis ) {
+      lo[ axis ] = std::min( lo[ axis ], xyz[ axis ] );
+      hi[ axis ] = std::max( hi[ axis ], xyz[ axis ] );
+    }
+  }
+  double extent[ 3 ];
+  for( size_t axis = 0; axis < 3; ++axis ) {
+    extent[ axis ] = hi[ axis ] > lo[ axis ] ? hi[ axis ] - lo[ axis ] : 1.0;
+  }
+  const GLMatrix modelview = GLMatrix::Translate( 0.0, 0.0, -1.5 + camera.zoom ) *
+                           GLMatrix::Rotate( camera.rotateX, 0 ) * GLMatrix::Rotate( camera.rotateY, 1 ) *
+                           GLMatrix::Rotate( camera.rotateZ, 2 ) *
+                           GLMatrix::Scale( 1.0 / extent[ 0 ], 1.0 / extent[ 1 ], 1.0 / extent[ 2 ] ) *
+                           GLMatrix::Translate( -( lo[ 0 ] + hi[ 0 ] ) / 2.0, -( lo[ 1 ] + hi[ 1 ] ) / 2.0,
+                                              -( lo[ 2 ] + hi[ 2 ] ) / 2.0 );
+  const double zNear = 0.01;
+  const GLMatrix projection = GLMatrix::Perspective( 60.0, double( width ) / height, zNear, 2.0 );
+  const GLMatrix clip = projection * modelview;
+  /*
+   * Normals go through the inverse transpose of the modelview. Its linear part is a rotation R times the scaling
+   * by 1 / extent, so that is R times the scaling by extent, or the linear part times the scaling by extent^2.
+   */
+  const double *mv = modelview.m;
+  double normalM[ 3 ][ 3 ];
+  for( size_t row = 0; row < 3; ++row ) {
+    for( size_t col = 0; col < 3; ++col ) {
+      normalM[ row ][ col ] = mv[ col * 4 + row ] * extent[ col ] * extent[ col ];
+    }
+  }
+  const bool hasNormals = mesh.n.size( ) == mesh.p.size( );
+
+  std::vector< Projected > verts( mesh.p.size( ) );
+  ParallelRanges( 0, verts.size( ), threads, [ & ]( size_t first, size_t last, size_t ) {
+    const double *c = clip.m;
+    for( size_t v = first; v < last; ++v ) {
+      const Point3D &pt = mesh.p[ v ];
+      const double w = c[ 3 ] * pt.x + c[ 7 ] * pt.y + c[ 11 ] * pt.z + c[ 15 ];
+      Projected &out = verts[ v ];
+      /* Triangles reaching the near plane are dropped rather than clipped. */
+      out.visible = w > zNear;
+      if( out.visible ) {
+        out.x = static_cast< float >( ( ( c[ 0 ] * pt.x + c[ 4 ] * pt.y + c[ 8 ] * pt.z + c[ 12 ] ) / w * 0.5 + 0.5 ) *
+                                      width );
+        out.y = static_cast< float >( ( 0.5 - ( c[ 1 ] * pt.x + c[ 5 ] * pt.y + c[ 9 ] * pt.z + c[ 13 ] ) / w * 0.5 ) *
+                                      height );
+        out.z = static_cast< float >( ( c[ 2 ] * pt.x + c[ 6 ] * pt.y + c[ 10 ] * pt.z + c[ 14 ] ) / w * 0.5 + 0.5 );
+      }
+      double nz = 1.0;
+      if( hasNormals ) {
+        const Normal &nrm = mesh.n[ v ];
+        double eye[ 3 ];
+        for( size_t row = 0; row < 3; ++row ) {
+          eye[ row ] = normalM[ row ][ 0 ] * nrm.x + normalM[ row ][ 1 ] * nrm.y + normalM[ row ][ 2 ] * nrm.z;
+        }
+        double len = std::sqrt( eye[ 0 ] * eye[ 0 ] + eye[ 1 ] * eye[ 1 ] + eye[ 2 ] * eye[ 2 ] );
+        nz = len > 0.0 ? eye[ 2 ] / len : 0.0;
+      }
+      Shade( nz, out.rgb );
+    }
+  } );
+
+  /* Triangles are binned into the tiles their bounding box overlaps, per thread, then rasterized tile by tile. */
+  const size_t tilesX = ( width + tileSize - 1 ) / tileSize, tilesY = ( height + tileSize - 1 ) / tileSize;
+  const size_t ntris = mesh.Triangles( );
+  typedef std::vector< std::vector< uint32_t > > Bins;
+  std::vector< Bins > bins( threads, Bins( tilesX * tilesY ) );
+  ParallelRanges( 0, ntris, threads, [ & ]( size_t first, size_t last, size_t part ) {
+    for( size_t t = first; t < last; ++t ) {
+      const Projected &a = verts[ mesh.tris[ t * 3 ] ], &b = verts[ mesh.tris[ t * 3 + 1 ] ],
+                      &c = verts[ mesh.tris[ t * 3 + 2 ] ];
+      if( !a.visible || !b.visible || !c.visible ) {
+        continue;
+      }
+      const float minX = std::max( 0.0f, std::min( { a.x, b.x, c.x } ) );
+      const float maxX = std::min( float( width ) - 1.0f, std::max( { a.x, b.x, c.x } ) );
+      const float minY = std::max( 0.0f, std::min( { a.y, b.y, c.y } ) );
+      const float maxY = std::min( float( height ) - 1.0f, std::max( { a.y, b.y, c.y } ) );
+      if( minX > maxX || minY > maxY ) {
+        continue;
+      }
+      for( size_t ty = size_t( minY ) / tileSize; ty <= size_t( maxY ) / tileSize; ++ty ) {
+        for( size_t tx = size_t( minX ) / tileSize; tx <= size_t( maxX ) / tileSize; ++tx ) {
+          bins[ part ][ ty * tilesX + tx ].push_back( static_cast< uint32_t >( t ) );
+        }
+      }
+    }
+  } );
+  std::atomic< size_t > nextTile( 0 );
+  ParallelRanges( 0, threads, threads, [ & ]( size_t, size_t, size_t ) {
+    for( size_t tile = nextTile++; tile < tilesX * tilesY; tile = nextTile++ ) {
+      const size_t x0 = ( tile % tilesX ) * tileSize, y0 = ( tile / tilesX ) * tileSize;
+      const size_t x1 = std::min( width, x0 + tileSize ), y1 = std::min( height, y0 + tileSize );
+      for( size_t part = 0; part < bins.size( ); ++part ) {
+        for( uint32_t t : bins[ part ][ tile ] ) {
+          const Projected &a = verts[ mesh.tris[ t * 3 ] ], &b = verts[ mesh.tris[ t * 3 + 1 ] ],
+                          &c = verts[ mesh.tris[ t * 3 + 2 ] ];
+          const float area = ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x );
+          if( area == 0.0f ) {
+            continue;
+          }
+          /* Both windings are drawn, as the viewer does not cull faces. */
+          const float inv = 1.0f / area;
+          const size_t bx0 = std::max< float >( x0, std::floor( std::min( { a.x, b.x, c.x } ) ) );
+          const size_t bx1 = std::min< float >( x1, std::ceil( std::max( { a.x, b.x, c.x } ) ) + 1.0f );
+          const size_t by0 = std::max< float >( y0, std::floor( std::min( { a.y, b.y, c.y } ) ) );
+          const size_t by1 = std::min< float >( y1, std::ceil( std::max( { a.y, b.y, c.y } ) ) + 1.0f );
+          for( size_t y = by0; y < by1; ++y ) {
+            const float py = y + 0.5f;
+            for( size_t x = bx0; x < bx1; ++x ) {
+              const float px = x + 0.5f;
+              const float wa = ( ( b.x - px ) * ( c.y - py ) - ( b.y - py ) * ( c.x - px ) ) * inv;
+              const float wb = ( ( c.x - px ) * ( a.y - py ) - ( c.y - py ) * ( a.x - px ) ) * inv;
+              const float wc = 1.0f - wa - wb;
+              if( wa < 0.0f || wb < 0.0f || wc < 0.0f ) {
+                continue;
+              }
+              const float z = wa * a.z + wb * b.z + wc * c.z;
+              const size_t px1 = y * width + x;
+              if( z < 0.0f || z > 1.0f || z >= frame.depth[ px1 ] ) {
+                continue;
+              }
+              frame.depth[ px1 ] = z;
+              for( size_t ch = 0; ch < 3; ++ch ) {
+                const float value = wa * a.rgb[ ch ] + wb * b.rgb[ ch ] + wc * c.rgb[ ch ];
+                frame.rgba[ px1 * 4 + ch ] = static_cast< uint8_t >( std::lround( value * 255.0f ) );
+              }
+            }
+          }
+        }
+      }
+    }
+  } );
+  return( frame );
+}
+
+void SoftwareRenderer::Write( const Frame &frame, const std::string &fileName ) {
+  std::unique_ptr< FILE, int( * )( FILE* ) > file( fopen( fileName.c_str( ), "wb" ), fclose );
+  if( !file ) {
+    throw std::runtime_error( "Could not open " + fileName + " for writing." );
+  }
+  const bool pgm = fileName.size( ) >= 4 && fileName.compare( fileName.size( ) - 4, 4, ".pgm" ) == 0;
+  if( pgm ) {
+    std::fprintf( file.get( ), "P5\n%zu %zu\n255\n", frame.width, frame.height );
+    std::vector< uint8_t > gray( frame.width * frame.height );
+    for( size_t px = 0; px < gray.size( ); ++px ) {
+      const uint8_t *rgb = &frame.rgba[ px * 4 ];
+      gray[ px ] = static_cast< uint8_t >( ( 299 * rgb[ 0 ] + 587 * rgb[ 1 ] + 114 * rgb[ 2 ] ) / 1000 );
+    }
+    fwrite( gray.data( ), 1, gray.size( ), file.get( ) );
+  }
+  else {
+    /* 8 bit RGBA, no filtering, a single deflate stream. */
+    static const uint8_t signature[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    fwrite( signature, 1, 8, file.get( ) );
+    std::vector< uint8_t > header( 13, 0 );
+    for( size_t byte = 0; byte < 4; ++byte ) {
+      header[ byte ] = static_cast< uint8_t >( frame.width >> ( 24 - 8 * byte ) );
+      header[ 4 + byte ] = static_cast< uint8_t >( frame.height >> ( 24 - 8 * byte ) );
+    }
+    header[ 8 ] = 8;
+    header[ 9 ] = 6;
+    PutChunk( file.get( ), "IHDR", header );
+    const size_t stride = frame.width * 4;
+    std::vector< uint8_t > raw( ( stride + 1 ) * frame.height, 0 );
+    for( size_t row = 0; row < frame.height; ++row ) {
+      std::memcpy( &raw[ row * ( stride + 1 ) + 1 ], &frame.rgba[ row * stride ], stride );
+    }
+    uLongf size = compressBound( static_cast< uLong >( raw.size( ) ) );
+    std::vector< uint8_t > packed( size );
+    if( compress2( packed.data( ), &size, raw.data( ), static_cast< uLong >( raw.size( ) ), 6 ) != Z_OK ) {
+      throw std::runtime_error( "Could not compress " + fileName + "." );
+    }
+    packed.resize( size );
+    PutChunk( file.get( ), "IDAT", packed );
+    PutChunk( file.get( ), "IEND", std::vector< uint8_t >( ) );
+  }
+  if( ferror( file.get( ) ) ) {
+    throw std::runtime_error( "Could not write to " + fileName + "." );
+  }
+}
+
+bool SoftwareRenderer::ParseCamera( const std::string &text, Camera &camera ) {
+  std::istringstream in( text );
+  double values[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  size_t count = 0;
+  std::string item;
+  while( std::getline( in, item, ',' ) ) {
+    if( count == 4 ) {
+      return( false );
+    }
+    try {
+      size_t used;
+      values[ count++ ] = std::stod( item, &used );
+      if( used != item.size( ) ) {
+        return( false );
+      }
+    }
+    catch( const std::exception& ) {
+      return( false );
+    }
+  }
+  if( count < 3 ) {
+    return( false );
+  }
+  camera.rotateX = values[ 0 ];
+  camera.rotateY = values[ 1 ];
+  camera.rotateZ = values[ 2 ];
+  camera.zoom = values[ 3 ];
+  return( true );
+}
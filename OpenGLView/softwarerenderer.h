@@ -0,0 +1,44 @@
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include "meshdata.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * CPU rendering of a mesh as STLViewer shows it, for previews on machines without a GPU or a display. Uses the
+ * viewer's projection, its light and StlModel's material with two sided Gouraud shading, and rasterizes in
+ * 64 x 64 pixel tiles shared among threads.
+ */
+class SoftwareRenderer {
+public:
+  /* View of STLViewer::paintGL: rotations in degrees about x, then y, then z, and the wheel zoom. */
+  struct Camera {
+    double rotateX = 0.0;
+    double rotateY = 0.0;
+    double rotateZ = 0.0;
+    double zoom = 0.0;
+  };
+
+  struct Frame {
+    size_t width = 0;
+    size_t height = 0;
+    /* Rows from the top, 4 bytes per pixel. */
+    std::vector< uint8_t > rgba;
+    /* Window depth in [ 0, 1 ], 1 where nothing was drawn. */
+    std::vector< float > depth;
+  };
+
+  /* Renders mesh fitted to the unit cube, as StlModel::draw does, with up to threads threads (0 for all). */
+  static Frame Render( const MeshData &mesh, const Camera &camera, size_t width, size_t height, size_t threads = 0 );
+
+  /* Color image as PNG, or its luminance as binary PGM when fileName ends in .pgm. Throws on I/O errors. */
+  static void Write( const Frame &frame, const std::string &fileName );
+
+  /* Parses "rx,ry,rz[,zoom]" into camera. */
+  static bool ParseCamera( const std::string &text, Camera &camera );
+};
+
+#endif /* SOFTWARERENDERER_H */
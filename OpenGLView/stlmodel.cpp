@@ -1,166 +1,122 @@
-#include "Geometrics.hpp"
-#include "Sorting.hpp"
+#include "meshclusters.h"
+#include "meshio.h"
+#include "meshmetrics.h"
+#include "meshoptimizer.h"
+#include "meshsmoother.h"
+#include "meshpipeline.h"
+#include "meshwelder.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "stlmodel.h"
+#include "timeseries.h"
 #include <QDebug>
+#include <QFileInfo>
 #include <QOpenGLContext>
-#include <QTime>
-#include <set>
 
 using namespace Bial;
 
-bool comparePts( const Point3D &pt1, const Point3D &pt2 ) {
-  if( pt1.x != pt2.x ) {
-    return( pt1.x < pt2.x );
-  }
-  if( pt1.y != pt2.y ) {
-    return( pt1.y < pt2.y );
-  }
-  return( pt1.z < pt2.z );
-}
-
-template< typename T >
-Vector< std::size_t > sort_permutation( const Vector< T > &vec ) {
-  Vector< std::size_t > p( vec.size( ) );
-  std::iota( p.begin( ), p.end( ), 0 );
-  std::sort( p.begin( ), p.end( ),
-             [ & ]( std::size_t i, std::size_t j ) { return( comparePts( vec[ i ], vec[ j ] ) ); } );
-  return( p );
-}
+static_assert( sizeof( Point3D ) == 3 * sizeof( GLdouble ), "Vertices are handed to OpenGL as packed doubles." );
+static_assert( sizeof( Normal ) == 3 * sizeof( GLdouble ), "Normals are handed to OpenGL as packed doubles." );
+static_assert( sizeof( MeshData::Index ) == sizeof( GLuint ), "Indices are handed to OpenGL as GLuint." );
 
-template< typename T >
-Vector< T > apply_permutation( const Vector< T > &vec, const Vector< std::size_t > &p ) {
-  Vector< T > sorted_vec( p.size( ) );
-  std::transform( p.begin( ), p.end( ), sorted_vec.begin( ),
-                  [ & ]( std::size_t i ) { return( vec[ i ] ); } );
-  return( sorted_vec );
-}
-
-void searchTriangles( size_t vtx,
-                      Vector< size_t > &vertexIndex,
-                      Vector< std::set< size_t > > &accum,
-                      Vector< bool > &visited ) {
-  for( auto it = accum[ vtx ].begin( ); it != accum[ vtx ].end( ); ++it ) {
-    for( size_t v = 0; v < 3; ++v ) {
-      size_t vtx2 = vertexIndex[ *it * 3 + v ];
-      if( !visited[ vtx2 ] ) {
-        visited[ vtx2 ] = true;
-        searchTriangles( vtx2, vertexIndex, accum, visited );
-        accum[ vtx ].insert( accum[ vtx2 ].begin( ), accum[ vtx2 ].end( ) );
-        accum[ vtx2 ].clear( );
-      }
-    }
-  }
+StlModel::StlModel( TriangleMesh *amesh, bool weld ) {
+  std::unique_ptr< TriangleMesh > owner( amesh );
+  /*    amesh->Print( std::cout ); */
+  /* Exportando dados da mesh. */
+  data = MeshData::FromTriangleMesh( *owner );
+  owner.reset( );
+  Build( weld );
 }
 
-void StlModel::RemoveLittleComponents( Vector< size_t > &vertexIndex, size_t numVerts ) {
-  Vector< std::set< size_t > > accum( numVerts );
-  Vector< bool > visited( numVerts, false );
-  for( size_t tris = 0; tris < vertexIndex.size( ); tris++ ) {
-    accum[ vertexIndex[ tris ] ].insert( tris / 3 );
-  }
-  size_t best = 0;
-  for( size_t vtx = 0; vtx < accum.size( ); vtx++ ) {
-    visited[ vtx ] = true;
-    searchTriangles( vtx, vertexIndex, accum, visited );
-    if( accum[ vtx ].size( ) >= vertexIndex.size( ) / 2 ) {
-      best = vtx;
-      break;
-    }
-    else if( accum[ vtx ].size( ) > accum[ best ].size( ) ) {
-      best = vtx;
-    }
-  }
-  Vector< size_t > vi( accum[ best ].size( ) * 3 );
-  size_t top = 0;
-  for( auto it = accum[ best ].begin( ); it != accum[ best ].end( ); ++it ) {
-    vi[ top++ ] = vertexIndex[ ( *it ) * 3 ];
-    vi[ top++ ] = vertexIndex[ ( *it ) * 3 + 1 ];
-    vi[ top++ ] = vertexIndex[ ( *it ) * 3 + 2 ];
-  }
-  vi.swap( vertexIndex );
+StlModel::StlModel( std::unique_ptr< MeshData > mesh, bool weld ) : data( std::move( mesh ) ) {
+  Build( weld );
 }
 
-StlModel::StlModel( TriangleMesh *amesh ) {
-  QTime t;
-  t.start( );
-  mesh = amesh;
-  /*    mesh->Print( std::cout ); */
-  /* Exportando dados da mesh. */
-  Vector< Point3D > p = mesh->getP( );
-  Vector< size_t > vertexIndex = mesh->getVertexIndex( );
-  Vector< Normal > n = mesh->getN( );
-  delete mesh;
+void StlModel::Build( bool weld ) {
+  PROFILE_SCOPE( "StlModel" );
+  Vector< Point3D > &p = data->p;
+  Vector< Normal > &n = data->n;
   int nverts = p.size( );
   /* Simplifica a mesh, removendo as duplicatas. */
-  SimplifyMesh( vertexIndex, n, p );
-  qDebug( ) << "The 3D mesh has" << vertexIndex.size( ) / 3 << "triangles.";
+  if( weld ) {
+    PROFILE_SCOPE( "SimplifyMesh" );
+    MeshWelder::SimplifyMesh( data->tris, n, p );
+    PROFILE_COUNT( "vertices welded", nverts - p.size( ) );
+  }
+  qDebug( ) << "The 3D mesh has" << data->Triangles( ) << "triangles.";
   qDebug( ) << "SimplifyMesh reduced the number of vertices from " << nverts
             << " to " << p.size( )
             << " (" << ( p.size( ) * 100.0 ) / ( ( double ) nverts ) << "%)";
-  qDebug( ) << "Elapsed (SimplifyMesh):" << t.elapsed( ) << "ms";
-  t.start( );
 /*
- *  RemoveLittleComponents( vertexIndex, p.size( ) );
- *  qDebug( ) << "Elapsed (RemoveLittleComponents):" << t.elapsed( ) << "ms";
+ *  {
+ *    PROFILE_SCOPE( "RemoveLittleComponents" );
+ *    MeshWelder::RemoveLittleComponents( data->tris, p.size( ) );
+ *  }
  */
+  qDebug( ) << "The biggest component has" << data->Triangles( ) << "triangles.";
+  /* Triangle and vertex order for the post-transform cache, before the arrays are handed to OpenGL. */
+  double acmr = MeshOptimizer::ACMR( data->tris, p.size( ) );
+  MeshOptimizer::Optimize( *data );
+  qDebug( ) << "Vertex cache miss ratio went from" << acmr << "to" << MeshOptimizer::ACMR( data->tris, p.size( ) );
 
-  tris = Vector< GLuint >( vertexIndex );
-  qDebug( ) << "The biggest component has" << vertexIndex.size( ) / 3 << "triangles.";
+  /* Normals are kept in the orientation used for lighting, opposite to the extraction gradient. */
+  FlipNormals( );
+  UpdateBoundings( );
+  clusters = MeshClusters::Build( *data );
+}
 
-  verts.resize( p.size( ) * 3 );
-  double xs( 0.0 ), ys( 0.0 ), zs( 0.0 );
-  for( size_t i = 0; i < p.size( ); ++i ) {
-    const Point3D &point = p[ i ];
-    verts[ i * 3 ] = static_cast< GLdouble >( point.x );
-    verts[ i * 3 + 1 ] = static_cast< GLdouble >( point.y );
-    verts[ i * 3 + 2 ] = static_cast< GLdouble >( point.z );
-    xs = std::max( xs, point.x );
-    ys = std::max( ys, point.y );
-    zs = std::max( zs, point.z );
+void StlModel::FlipNormals( ) {
+  Vector< Normal > &n = data->n;
+  for( size_t i = 0; i < n.size( ); ++i ) {
+    n[ i ] = -n[ i ];
   }
-  if( !n.empty( ) ) {
-    COMMENT( "Reading normals.", 0 );
-    norms.resize( p.size( ) * 3 );
-    for( size_t i = 0; i < n.size( ); ++i ) {
-      const Normal &norm = n[ i ];
-      norms[ i * 3 ] = 0.0 - static_cast< GLdouble >( norm.x );
-      norms[ i * 3 + 1 ] = 0.0 - static_cast< GLdouble >( norm.y );
-      norms[ i * 3 + 2 ] = 0.0 - static_cast< GLdouble >( norm.z );
-    }
+}
+
+void StlModel::UpdateBoundings( ) {
+  metrics = MeshMetrics::Compute( *data );
+  const MeshMetrics::Metrics &total = metrics.total;
+  for( size_t axis = 0; axis < 3; ++axis ) {
+    double extent = total.hi[ axis ] - total.lo[ axis ];
+    boundings[ axis ] = extent > 0.0 ? extent : 1.0;
+    center[ axis ] = ( total.lo[ axis ] + total.hi[ axis ] ) / 2.0;
   }
-  boundings[ 0 ] = xs;
-  boundings[ 1 ] = ys;
-  boundings[ 2 ] = zs;
-  this->mesh = new TriangleMesh( new Transform3D( ), new Transform3D( ),
-                                 false, vertexIndex, p, n );
+  qDebug( ) << "Surface area" << total.area << ", enclosed volume" << total.volume << "," << metrics.components.size( )
+            << "components.";
 }
 
 StlModel::~StlModel( ) {
-  if( mesh ) {
-    delete mesh;
-  }
+}
+
+const MeshData &StlModel::getData( ) const {
+  return( *data );
+}
+
+void StlModel::shareBounds( const StlModel &other ) {
+  boundings = other.boundings;
+  center = other.center;
+}
+
+const MeshMetrics::Report &StlModel::getMetrics( ) const {
+  return( metrics );
 }
 
 void StlModel::reload( ) {
-  if( !verts.empty( ) ) {
-/*    qDebug( ) << mesh->getNverts( ) << " verts found"; */
+  if( !data->p.empty( ) ) {
     glEnableClientState( GL_VERTEX_ARRAY );
-    glVertexPointer( 3, GL_DOUBLE, 0, &verts[ 0 ] );
+    glVertexPointer( 3, GL_DOUBLE, sizeof( Point3D ), &data->p[ 0 ].x );
     glDisableClientState( GL_VERTEX_ARRAY );
   }
-  if( !norms.empty( ) ) {
-/*    qDebug( ) << mesh->getNverts( ) << " norms found"; */
+  if( data->n.size( ) == data->p.size( ) && !data->n.empty( ) ) {
     glEnableClientState( GL_NORMAL_ARRAY );
-    glNormalPointer( GL_DOUBLE, 0, &norms[ 0 ] );
+    glNormalPointer( GL_DOUBLE, sizeof( Normal ), &data->n[ 0 ].x );
     glDisableClientState( GL_NORMAL_ARRAY );
   }
-/*  qDebug( ) << mesh->getNtris( ) << " triangles found"; */
 /*  qDebug( ) << "Loaded dada to OpenGL."; */
 }
 
 void StlModel::draw( bool drawNorm ) {
 /*  qDebug( ) << "Drawing Model"; */
-  if( mesh ) {
+  if( data ) {
     reload( );
   }
   glPushMatrix( );
@@ -171,15 +127,33 @@ void StlModel::draw( bool drawNorm ) {
   glMaterialfv( GL_FRONT_AND_BACK, GL_SPECULAR, specularCoeff );
   glMaterialf( GL_FRONT_AND_BACK, GL_SHININESS, 25.0 );
   glColor4f( 1, 1, 1, 1 );
-  glTranslated( -boundings[ 0 ] / 2.0, -boundings[ 1 ] / 2.0, -boundings[ 2 ] / 2.0 );
+  glTranslated( -center[ 0 ], -center[ 1 ], -center[ 2 ] );
   glEnable( GL_NORMALIZE );
   glEnableClientState( GL_NORMAL_ARRAY );
   glEnableClientState( GL_VERTEX_ARRAY );
   glEnable( GL_POLYGON_OFFSET_FILL );
   glPolygonOffset( 1, 1 );
-  if( !tris.empty( ) ) {
+  if( !data->tris.empty( ) ) {
 /*    qDebug( ) << "Drawing Triangles."; */
-    glAssert( glDrawElements( GL_TRIANGLES, tris.size( ), GL_UNSIGNED_INT, &tris[ 0 ] ) );
+    GLdouble projection[ 16 ], modelview[ 16 ];
+    glGetDoublev( GL_PROJECTION_MATRIX, projection );
+    glGetDoublev( GL_MODELVIEW_MATRIX, modelview );
+    MeshClusters::View view( projection, modelview );
+    /* Clusters are consecutive in the index buffer, so each run of visible ones is a single call. */
+    size_t first = 0, count = 0;
+    for( const MeshClusters::Cluster &cluster : clusters ) {
+      if( view.Sees( cluster, cullBackFaces ) ) {
+        first = count == 0 ? cluster.first : first;
+        count += cluster.count;
+      }
+      else if( count > 0 ) {
+        glAssert( glDrawElements( GL_TRIANGLES, count, GL_UNSIGNED_INT, &data->tris[ first ] ) );
+        count = 0;
+      }
+    }
+    if( count > 0 ) {
+      glAssert( glDrawElements( GL_TRIANGLES, count, GL_UNSIGNED_INT, &data->tris[ first ] ) );
+    }
 /*    qDebug( ) << "Drawing Normals."; */
     if( drawNorm ) {
       drawNormals( );
@@ -192,106 +166,159 @@ void StlModel::draw( bool drawNorm ) {
 }
 
 void StlModel::drawNormals( ) {
-  if( !norms.empty( ) ) {
-    glBegin( GL_LINES );
-    glColor3f( 1, 0, 0 );
-    for( size_t i = 0; i < norms.size( ) / 3; ++i ) {
-      int x1 = verts[ i * 3 ];
-      int y1 = verts[ i * 3 + 1 ];
-      int z1 = verts[ i * 3 + 2 ];
-      int x2 = x1 + norms[ i * 3 ];
-      int y2 = y1 + norms[ i * 3 + 1 ];
-      int z2 = z1 + norms[ i * 3 + 2 ];
-      glVertex3f( x1, y1, z1 );
-      glVertex3f( x2, y2, z2 );
+  if( normalLines.empty( ) ) {
+    BuildNormalLines( );
+  }
+  if( normalLines.empty( ) ) {
+    return;
+  }
+  glDisableClientState( GL_NORMAL_ARRAY );
+  glDisable( GL_LIGHTING );
+  glColor3f( 1, 0, 0 );
+  glVertexPointer( 3, GL_FLOAT, 0, &normalLines[ 0 ] );
+  glAssert( glDrawArrays( GL_LINES, 0, normalLines.size( ) / 3 ) );
+  glVertexPointer( 3, GL_DOUBLE, sizeof( Point3D ), &data->p[ 0 ].x );
+  glEnable( GL_LIGHTING );
+  glEnableClientState( GL_NORMAL_ARRAY );
+}
 
-    }
-    glEnd( );
+void StlModel::setNormalStyle( double length, size_t maxLines ) {
+  normalLength = length;
+  maxNormalLines = std::max< size_t >( 1, maxLines );
+  normalLines.clear( );
+}
+
+void StlModel::BuildNormalLines( ) {
+  PROFILE_SCOPE( "BuildNormalLines" );
+  const Vector< Point3D > &p = data->p;
+  const Vector< Normal > &n = data->n;
+  if( n.size( ) != p.size( ) ) {
+    return;
   }
+  /* Every stride-th vertex, so that dense meshes stay readable and cheap to draw. */
+  const size_t stride = ( p.size( ) + maxNormalLines - 1 ) / maxNormalLines;
+  const size_t lines = ( p.size( ) + stride - 1 ) / stride;
+  normalLines.resize( lines * 6 );
+  ParallelRanges( 0, lines, HardwareThreads( ), [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t line = first; line < last; ++line ) {
+      const Point3D &pt = p[ line * stride ];
+      const Normal &nrm = n[ line * stride ];
+      double len = std::sqrt( nrm.x * nrm.x + nrm.y * nrm.y + nrm.z * nrm.z );
+      double scale = len > 0.0 ? normalLength / len : 0.0;
+      float *dst = &normalLines[ line * 6 ];
+      dst[ 0 ] = pt.x;
+      dst[ 1 ] = pt.y;
+      dst[ 2 ] = pt.z;
+      dst[ 3 ] = pt.x + nrm.x * scale;
+      dst[ 4 ] = pt.y + nrm.y * scale;
+      dst[ 5 ] = pt.z + nrm.z * scale;
+    }
+  } );
+  PROFILE_COUNT( "normal lines", lines );
 }
 
-void StlModel::save( QString fileName ) {
-  mesh->ExportSTLB( fileName.toStdString( ) );
+void StlModel::setCullBackFaces( bool value ) {
+  cullBackFaces = value;
 }
 
-StlModel* StlModel::loadStl( QString fileName ) {
-  COMMENT( "Loading stl file: " << fileName.toStdString( ), 0 );
-  return( new StlModel( TriangleMesh::ReadSTLB( fileName.trimmed( ).toStdString( ) ) ) );
+bool StlModel::getCullBackFaces( ) const {
+  return( cullBackFaces );
 }
 
-StlModel* StlModel::marchingCubes( QString fileName, QString maskFileName, float isolevel, float scale ) {
-  if( fileName.isEmpty( ) ) {
-    return( nullptr );
+void StlModel::smooth( size_t iterations ) {
+  MeshSmoother::Params params;
+  params.iterations = iterations;
+  MeshSmoother::Taubin( *data, params );
+  UpdateBoundings( );
+  MeshClusters::Bound( *data, clusters );
+  normalLines.clear( );
+}
+
+void StlModel::save( QString fileName, bool ascii ) {
+  if( fileName.endsWith( ".bmsh" ) ) {
+    PROFILE_SCOPE( "WriteMesh" );
+    /* Files keep the extraction orientation of the normals, which Build flips again on loading. */
+    FlipNormals( );
+    try {
+      MeshIO::WriteMesh( *data, fileName.toStdString( ) );
+    }
+    catch( ... ) {
+      FlipNormals( );
+      throw;
+    }
+    FlipNormals( );
+    return;
   }
-  qDebug( ) << "Loading image.";
-  Image< int > img = File::Read< int >( fileName.trimmed( ).toStdString( ) );
-  if( scale != 1.0 ) {
-    qDebug( ) << "Resizing image.";
-    img = Geometrics::Scale( img, scale, true );
+  if( ascii ) {
+    PROFILE_SCOPE( "WriteSTLA" );
+    MeshIO::WriteSTLA( *data, fileName.toStdString( ) );
+    return;
+  }
+  PROFILE_SCOPE( "WriteSTLB" );
+  MeshIO::WriteSTLB( *data, fileName.toStdString( ) );
+}
+
+StlModel* StlModel::loadStl( QString fileName ) {
+  COMMENT( "Loading stl file: " << fileName.toStdString( ), 0 );
+  if( MeshIO::IsSTLA( fileName.trimmed( ).toStdString( ) ) ) {
+    std::unique_ptr< MeshData > data;
+    {
+      PROFILE_SCOPE( "ReadSTLA" );
+      data = MeshIO::ReadSTLA( fileName.trimmed( ).toStdString( ) );
+      PROFILE_COUNT( "bytes read", QFileInfo( fileName.trimmed( ) ).size( ) );
+    }
+    return( new StlModel( std::move( data ) ) );
   }
-  qDebug( ) << "Running marching cubes algorithm.";
   TriangleMesh *mesh;
-  if( maskFileName.isEmpty( ) ) {
-    mesh = MarchingCubes::exec( img, isolevel * img.Maximum( ) );
+  {
+    PROFILE_SCOPE( "ReadSTLB" );
+    mesh = TriangleMesh::ReadSTLB( fileName.trimmed( ).toStdString( ) );
+    PROFILE_COUNT( "bytes read", QFileInfo( fileName.trimmed( ) ).size( ) );
   }
-  else {
-    qDebug( ) << "Binary marching cubes algorithm.";
-    Image< int > img2 = File::Read< int >( fileName.trimmed( ).toStdString( ) );
-    if( scale != 1.0 ) {
-      img2 = Geometrics::Scale( img2, scale, true );
-    }
-    mesh = MarchingCubes::Binary( img, img2, isolevel * img.Maximum( ) );
+  return( new StlModel( mesh ) );
+}
+
+StlModel* StlModel::loadMesh( QString fileName ) {
+  COMMENT( "Loading mesh file: " << fileName.toStdString( ), 0 );
+  std::unique_ptr< MeshData > mesh;
+  {
+    PROFILE_SCOPE( "ReadMesh" );
+    mesh = MeshIO::ReadMesh( fileName.trimmed( ).toStdString( ) );
+    PROFILE_COUNT( "bytes read", QFileInfo( fileName.trimmed( ) ).size( ) );
   }
+  return( new StlModel( std::move( mesh ), false ) );
+}
+
+StlModel* StlModel::marchingCubes( PipelineCache &cache, const MeshPipeline::Params &params ) {
+  std::unique_ptr< MeshData > mesh = cache.Run( params );
   if( !mesh ) {
     qDebug( ) << "Failed to generate model.";
     return( nullptr );
   }
   qDebug( ) << "Returning a new STL Model.";
-  return( new StlModel( mesh ) );
-
+  return( new StlModel( std::move( mesh ), false ) );
 }
 
-void StlModel::SimplifyMesh( Vector< size_t > &vertexIndex, Vector< Normal > &n, Vector< Point3D > &p ) {
-  Vector< size_t > order = sort_permutation( p );
-  /* Aplicando ordenação sobre p e n */
-  p = apply_permutation( p, order );
-  if( n.size( ) == p.size( ) ) {
-    n = apply_permutation( n, order );
+std::vector< StlModel* > StlModel::loadSeries( QString fileName, float isolevel ) {
+  COMMENT( "Loading time series: " << fileName.toStdString( ), 0 );
+  TimeSeries::Params params;
+  params.fileName = fileName.trimmed( ).toStdString( );
+  params.isolevel = isolevel;
+  std::vector< std::unique_ptr< MeshData > > meshes;
+  TimeSeries::Statistics stats;
+  try {
+    meshes = TimeSeries::Extract( params, &stats );
   }
-  /* Criando o vetor de ordenação inverso */
-  Vector< size_t > invOrder( order.size( ) );
-  for( size_t i = 0; i < order.size( ); ++i ) {
-    invOrder[ order[ i ] ] = i;
-  }
-  /* Reatribuindo os indices. */
-  Vector< size_t > vi2( vertexIndex.size( ) );
-  for( size_t vtx = 0; vtx < vertexIndex.size( ); ++vtx ) {
-    vi2[ vtx ] = invOrder[ vertexIndex[ vtx ] ];
-  }
-  Vector< Point3D > p2;
-  Vector< Normal > n2;
-  p2.reserve( p.size( ) );
-  n2.reserve( n.size( ) );
-  order = Vector< size_t >( p.size( ) );
-  order[ 0 ] = 0;
-  p2.push_back( p.front( ) );
-  n2.push_back( n.front( ) );
-  /* Removendo duplicatas */
-  for( size_t i = 1; i < p.size( ); ++i ) {
-    if( Distance( p[ i - 1 ], p[ i ] ) < 0.001 ) {
-      order[ i ] = order[ i - 1 ];
-    }
-    else {
-      order[ i ] = p2.size( );
-      p2.push_back( p[ i ] );
-      n2.push_back( n[ i ] );
-    }
+  catch( const std::exception &e ) {
+    qDebug( ) << "Failed to read time series:" << e.what( );
+    return( std::vector< StlModel* >( ) );
   }
-  p2.swap( p );
-  n2.swap( n );
-  /* Reatribuindo os indices novamente. */
-  for( size_t vtx = 0; vtx < vi2.size( ); ++vtx ) {
-    vi2[ vtx ] = order[ vi2[ vtx ] ];
+  qDebug( ) << stats.frames << "frames," << stats.reused << "of" << stats.reused + stats.extracted
+            << "brick groups reused from the previous frame.";
+  std::vector< StlModel* > frames;
+  for( std::unique_ptr< MeshData > &mesh : meshes ) {
+    frames.push_back( new StlModel( std::move( mesh ), false ) );
+    frames.back( )->shareBounds( *frames.front( ) );
   }
-  vi2.swap( vertexIndex );
+  return( frames );
 }
@@ -4,35 +4,73 @@
 
 #include "MarchingCubes.hpp"
 #include "glassert.h"
+#include "meshclusters.h"
+#include "meshdata.h"
+#include "meshmetrics.h"
+#include "meshpipeline.h"
+#include "pipelinecache.h"
 #include <Draw.hpp>
 #include <GL/glu.h>
 #include <GL/glut.h>
 #include <QOpenGLWidget>
 #include <QString>
 #include <array>
+#include <memory>
 
 using namespace Bial;
 
 class StlModel {
-  TriangleMesh *mesh = nullptr;
-  Vector< GLdouble > verts;
-  Vector< GLdouble > norms;
-  Vector< GLuint > tris;
+  /* Rendered in place: vertex, normal and index arrays are handed to OpenGL directly. */
+  std::unique_ptr< MeshData > data;
+  /* Extent and center of the bounding box, mapped to the unit cube around the origin when drawing. */
   std::array< float, 3 > boundings;
+  std::array< float, 3 > center;
+  MeshMetrics::Report metrics;
+  /* Triangle ranges culled against the view before drawing. */
+  std::vector< MeshClusters::Cluster > clusters;
+  bool cullBackFaces = false;
+  /* Endpoints of the normal lines, built on demand and dropped whenever the vertices change. */
+  std::vector< float > normalLines;
+  double normalLength = 1.0;
+  size_t maxNormalLines = 200000;
 
 public:
-  StlModel(TriangleMesh *amesh );
+  typedef MeshPipeline::Extractor Extractor;
+
+  /* weld = false skips SimplifyMesh, for meshes whose vertices are already shared. */
+  StlModel( TriangleMesh *amesh, bool weld = true );
+  StlModel( std::unique_ptr< MeshData > mesh, bool weld = true );
   ~StlModel( );
+  const MeshData &getData( ) const;
+  /* Area, volume and bounds of the mesh and of its components, as of the last change to the vertices. */
+  const MeshMetrics::Report &getMetrics( ) const;
   void reload( );
   void draw( bool drawNorm );
   void drawNormals( );
-  void save(QString fileName);
+  /* Normal lines of length in model units, subsampled to at most maxLines of them. */
+  void setNormalStyle( double length, size_t maxLines );
+  /* Skips clusters facing away from the eye. Only right for closed surfaces, as lighting is two sided. */
+  void setCullBackFaces( bool value );
+  bool getCullBackFaces( ) const;
+  /* Draws with the bounding box of other, so that frames of a series keep their relative position and size. */
+  void shareBounds( const StlModel &other );
+  /* Taubin smoothing of the welded mesh; normals are recomputed. */
+  void smooth( size_t iterations );
+  /* Binary or ASCII STL, or the native indexed format when fileName ends in .bmsh. */
+  void save( QString fileName, bool ascii = false );
   static StlModel* loadStl( QString fileName );
-  static StlModel* marchingCubes(QString fileName, QString maskFileName, float isolevel, float scale );
+  /* Native indexed mesh, already welded. */
+  static StlModel* loadMesh( QString fileName );
+  /* Mesh of params, through cache so that repeated parameters skip reading and extraction. */
+  static StlModel* marchingCubes( PipelineCache &cache, const MeshPipeline::Params &params );
+  /* One model per frame of a 4D volume, all drawn with the bounds of the first; empty if it cannot be read. */
+  static std::vector< StlModel* > loadSeries( QString fileName, float isolevel );
 
 private:
-  void RemoveLittleComponents( Vector< size_t > &vertexIndex, size_t numVerts );
-  void SimplifyMesh( Vector< size_t > &vertexIndex, Vector< Normal > &n, Vector< Point3D > &p );
+  void Build( bool weld );
+  void UpdateBoundings( );
+  void FlipNormals( );
+  void BuildNormalLines( );
 };
 
 #endif /* STLMODEL_H */
@@ -1,12 +1,16 @@
 #include <QApplication>
 #include <QDebug>
+#include <QDir>
 #include <QKeyEvent>
 #include <QOpenGLFunctions>
+#include <QStandardPaths>
 #include <QTime>
 
 #include "MarchingCubes.hpp"
 #include "glassert.h"
+#include "profiler.h"
 #include "stlviewer.h"
+#include "timeseries.h"
 
 
 StlModel* STLViewer::getModel( ) const {
@@ -14,6 +18,10 @@ StlModel* STLViewer::getModel( ) const {
 }
 
 
+const VolumeStatistics* STLViewer::getStatistics( ) const {
+  return( volume ? volume->stats.get( ) : nullptr );
+}
+
 bool STLViewer::getDrawNormals( ) const {
   return( drawNormals );
 }
@@ -28,9 +36,18 @@ STLViewer::STLViewer( QWidget *parent ) : QOpenGLWidget( parent ) {
   setFocus( );
   setFocusPolicy( Qt::StrongFocus );
   model = nullptr;
+  playTimer = new QTimer( this );
+  playTimer->setInterval( 100 );
+  connect( playTimer, &QTimer::timeout, this, &STLViewer::nextFrame );
+  QString cacheDir = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/meshes";
+  if( QDir( ).mkpath( cacheDir ) ) {
+    cache.setDirectory( cacheDir.toStdString( ) );
+  }
 }
 
 void STLViewer::LoadFile( QString stlFile, QString mask ) {
+  /* The profile shown and exported covers the latest file or extraction only. */
+  Profiler::instance( ).Reset( );
   clear( );
   resetTransform( );
 
@@ -39,10 +56,20 @@ void STLViewer::LoadFile( QString stlFile, QString mask ) {
   if( fileName.endsWith( ".stl" ) || fileName.endsWith( ".stl.gz" ) ) {
     model = StlModel::loadStl( fileName );
   }
+  else if( fileName.endsWith( ".bmsh" ) ) {
+    model = StlModel::loadMesh( fileName );
+  }
+  else if( TimeSeries::Frames( fileName.trimmed( ).toStdString( ) ) > 1 ) {
+    frames = StlModel::loadSeries( fileName, 0.1 );
+    model = frames.empty( ) ? nullptr : frames.front( );
+  }
   else {
+    /* Updates the view and emits finishedMCubes itself. */
     runMarchingCubes( 0.1, 0.05 );
+    return;
   }
   update( );
+  emit finishedMCubes( );
 }
 
 GLfloat ambientLight[] = { 0.5f, 0.5f, 0.5f, 1.0f };
@@ -97,9 +124,31 @@ void STLViewer::drawLines( ) {
 }
 
 void STLViewer::clear( ) {
-  if( model ) {
+  clearModels( );
+  volume.reset( );
+}
+
+void STLViewer::clearModels( ) {
+  playTimer->stop( );
+  if( frames.empty( ) ) {
     delete model;
   }
+  for( StlModel *f : frames ) {
+    delete f;
+  }
+  frames.clear( );
+  frame = 0;
+  model = nullptr;
+}
+
+void STLViewer::nextFrame( ) {
+  if( frames.empty( ) ) {
+    playTimer->stop( );
+    return;
+  }
+  frame = ( frame + 1 ) % frames.size( );
+  model = frames[ frame ];
+  update( );
 }
 
 
@@ -126,6 +175,19 @@ void STLViewer::keyPressEvent( QKeyEvent *evt ) {
       case Qt::Key_Home:
       resetTransform( );
       break;
+      case Qt::Key_B:
+      if( model ) {
+        model->setCullBackFaces( !model->getCullBackFaces( ) );
+      }
+      break;
+      case Qt::Key_P:
+      if( playTimer->isActive( ) ) {
+        playTimer->stop( );
+      }
+      else if( frames.size( ) > 1 ) {
+        playTimer->start( );
+      }
+      break;
   }
   update( );
 }
@@ -183,14 +245,33 @@ void STLViewer::mouseDoubleClickEvent( QMouseEvent *evt ) {
   update( );
 }
 
-void STLViewer::runMarchingCubes( float isolevel, float scale ) {
-  if( model ) {
-    delete model;
-    model = nullptr;
+void STLViewer::runMarchingCubes( float isolevel, float scale, StlModel::Extractor extractor ) {
+  Profiler::instance( ).Reset( );
+  clearModels( );
+  MeshPipeline::Params params;
+  params.fileName = fileName.trimmed( ).toStdString( );
+  params.maskFileName = maskFileName.trimmed( ).toStdString( );
+  params.isolevel = isolevel;
+  params.scale = scale;
+  params.extractor = extractor;
+  params.threads = 0;
+  volume = cache.Load( params );
+  if( volume ) {
+    const VolumeStatistics &stats = *volume->stats;
+    qDebug( ) << "Intensities from" << stats.Minimum( ) << "to" << stats.Maximum( ) << ", Otsu threshold"
+              << stats.OtsuThreshold( );
+    model = StlModel::marchingCubes( cache, params );
   }
-  StlModel *mod = StlModel::marchingCubes( fileName, maskFileName, isolevel, scale );
-  model = mod;
   update( );
+  emit finishedMCubes( );
+}
+
+void STLViewer::smoothModel( size_t iterations ) {
+  if( model ) {
+    model->smooth( iterations );
+    update( );
+    emit finishedMCubes( );
+  }
 }
 
 void STLViewer::paintGL( ) {
@@ -7,6 +7,7 @@
 #include <GL/glu.h>
 #include <GL/glut.h>
 #include <QOpenGLWidget>
+#include <QTimer>
 #include <QWidget>
 
 class Light {
@@ -50,6 +51,13 @@ class STLViewer : public QOpenGLWidget {
   bool dragging = false;
   QPoint lastPoint;
   StlModel *model = nullptr;
+  /* Models of every frame of a 4D volume, owned here; model points to the one shown. Empty for a single model. */
+  std::vector< StlModel* > frames;
+  size_t frame = 0;
+  QTimer *playTimer = nullptr;
+  /* Volumes and meshes already computed, shared by every file opened in the session. */
+  PipelineCache cache;
+  std::shared_ptr< const MeshPipeline::Volume > volume;
   QString fileName, maskFileName;
   bool drawNormals = false;
 
@@ -59,10 +67,17 @@ public:
 
   void drawLines( );
 
-  void runMarchingCubes( float isolevel, float scale );
+  void runMarchingCubes( float isolevel, float scale,
+                         StlModel::Extractor extractor = StlModel::Extractor::MarchingCubes );
+
+  /* Taubin smoothing of the current model, in place. */
+  void smoothModel( size_t iterations );
 
   StlModel* getModel( ) const;
 
+  /* Statistics of the current volume, or nullptr when an STL file is shown. */
+  const VolumeStatistics* getStatistics( ) const;
+
   bool getDrawNormals( ) const;
   void setDrawNormals( bool value );
 
@@ -74,6 +89,9 @@ protected:
   void resizeGL( int w, int h );
   void paintGL( );
   void clear( );
+  /* Deletes the model shown, or every frame of a series. */
+  void clearModels( );
+  void nextFrame( );
 
   /* QWidget interface */
 protected:
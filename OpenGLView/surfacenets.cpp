@@ -0,0 +1,254 @@
+#include "profiler.h"
+#include "surfacenets.h"
+
+#include <array>
+
+namespace {
+
+  /* Corner c of a cell is at offset ( c & 1, ( c >> 1 ) & 1, ( c >> 2 ) & 1 ). */
+  const int cellEdges[ 12 ][ 2 ] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+  };
+
+  class Volume {
+    const Image< int > &img;
+    const Image< int > *mask;
+    float outside;
+
+  public:
+    const size_t xs, ys, zs;
+
+    Volume( const Image< int > &img, const Image< int > *mask, float isolevel ) : img( img ), mask( mask ),
+      outside( isolevel - 1.0f ), xs( img.size( 0 ) ), ys( img.size( 1 ) ), zs( img.size( 2 ) ) {
+    }
+
+    float operator()( size_t x, size_t y, size_t z ) const {
+      size_t pxl = x + xs * ( y + ys * z );
+      if( mask && ( *mask )[ pxl ] == 0 ) {
+        return( outside );
+      }
+      return( static_cast< float >( img[ pxl ] ) );
+    }
+
+    /* Central differences, falling back to one-sided differences at the borders. */
+    Vector3D Gradient( size_t x, size_t y, size_t z ) const {
+      size_t x0 = x > 0 ? x - 1 : x, x1 = x + 1 < xs ? x + 1 : x;
+      size_t y0 = y > 0 ? y - 1 : y, y1 = y + 1 < ys ? y + 1 : y;
+      size_t z0 = z > 0 ? z - 1 : z, z1 = z + 1 < zs ? z + 1 : z;
+      return( Vector3D( ( ( *this )( x1, y, z ) - ( *this )( x0, y, z ) ) / std::max< double >( 1.0, x1 - x0 ),
+                        ( ( *this )( x, y1, z ) - ( *this )( x, y0, z ) ) / std::max< double >( 1.0, y1 - y0 ),
+                        ( ( *this )( x, y, z1 ) - ( *this )( x, y, z0 ) ) / std::max< double >( 1.0, z1 - z0 ) ) );
+    }
+  };
+
+  /* Solves the 3x3 system a * x = b by Cramer's rule. Returns false if a is singular. */
+  bool Solve3x3( const double a[ 3 ][ 3 ], const double b[ 3 ], double x[ 3 ] ) {
+    double det = a[ 0 ][ 0 ] * ( a[ 1 ][ 1 ] * a[ 2 ][ 2 ] - a[ 1 ][ 2 ] * a[ 2 ][ 1 ] ) -
+                 a[ 0 ][ 1 ] * ( a[ 1 ][ 0 ] * a[ 2 ][ 2 ] - a[ 1 ][ 2 ] * a[ 2 ][ 0 ] ) +
+                 a[ 0 ][ 2 ] * ( a[ 1 ][ 0 ] * a[ 2 ][ 1 ] - a[ 1 ][ 1 ] * a[ 2 ][ 0 ] );
+    if( std::abs( det ) < 1e-12 ) {
+      return( false );
+    }
+    for( size_t col = 0; col < 3; ++col ) {
+      double m[ 3 ][ 3 ];
+      for( size_t row = 0; row < 3; ++row ) {
+        for( size_t c = 0; c < 3; ++c ) {
+          m[ row ][ c ] = ( c == col ) ? b[ row ] : a[ row ][ c ];
+        }
+      }
+      x[ col ] = ( m[ 0 ][ 0 ] * ( m[ 1 ][ 1 ] * m[ 2 ][ 2 ] - m[ 1 ][ 2 ] * m[ 2 ][ 1 ] ) -
+                   m[ 0 ][ 1 ] * ( m[ 1 ][ 0 ] * m[ 2 ][ 2 ] - m[ 1 ][ 2 ] * m[ 2 ][ 0 ] ) +
+                   m[ 0 ][ 2 ] * ( m[ 1 ][ 0 ] * m[ 2 ][ 1 ] - m[ 1 ][ 1 ] * m[ 2 ][ 0 ] ) ) / det;
+    }
+    return( true );
+  }
+
+}
+
+TriangleMesh* SurfaceNets::exec( const Image< int > &img, float isolevel, Mode mode, const Image< int > *mask ) {
+  MeshSink sink;
+  exec( img, isolevel, sink, mode, mask );
+  if( sink.Triangles( ) == 0 ) {
+    return( nullptr );
+  }
+  COMMENT( "Surface nets produced " << sink.Triangles( ) << " triangles and " << sink.Vertices( ) << " vertices.", 0 );
+  return( sink.Take( )->ToTriangleMesh( ) );
+}
+
+void SurfaceNets::exec( const Image< int > &img, float isolevel, MeshSink &sink, Mode mode,
+                        const Image< int > *mask, const VolumeStatistics *stats ) {
+  const Volume vol( img, mask, isolevel );
+  if( vol.xs < 2 || vol.ys < 2 || vol.zs < 2 ) {
+    return;
+  }
+  PROFILE_SCOPE( "SurfaceNets" );
+  const size_t firstTri = sink.Triangles( );
+  const size_t cxs = vol.xs - 1, cys = vol.ys - 1, czs = vol.zs - 1;
+  const size_t sliceSize = cxs * cys;
+  /* Vertex index of each cell in the current and previous cell slices. Quads only reach one slice back. */
+  Vector< size_t > slices( 2 * sliceSize, 0 );
+  ChunkedBuffer< Point3D > &p = sink.getP( );
+  ChunkedBuffer< Point3D > cellMin;
+  const size_t first = p.size( );
+  const double qefBias = 0.05;
+  /* Masked voxels change the values seen by the cells, so the block ranges of img do not apply. */
+  if( mask ) {
+    stats = nullptr;
+  }
+  size_t skipped = 0;
+  for( size_t z = 0; z < czs; ++z ) {
+    size_t *curr = &slices[ ( z & 1 ) * sliceSize ];
+    size_t *prev = &slices[ ( ( z + 1 ) & 1 ) * sliceSize ];
+    for( size_t y = 0; y < cys; ++y ) {
+      for( size_t x = 0; x < cxs; ++x ) {
+        /* Cells of skipped blocks are never part of a quad, so their slice entries are not needed. */
+        if( stats && x % VolumeStatistics::BlockEdge == 0 && !stats->MayCross( x, y, z, isolevel ) ) {
+          const size_t run = std::min( VolumeStatistics::BlockEdge, cxs - x );
+          skipped += run;
+          x += run - 1;
+          continue;
+        }
+        std::array< float, 8 > val;
+        unsigned int inside = 0;
+        for( size_t c = 0; c < 8; ++c ) {
+          val[ c ] = vol( x + ( c & 1 ), y + ( ( c >> 1 ) & 1 ), z + ( ( c >> 2 ) & 1 ) );
+          if( val[ c ] >= isolevel ) {
+            inside |= 1u << c;
+          }
+        }
+        if( inside == 0 || inside == 0xff ) {
+          continue;
+        }
+        /* Cell vertex from the crossings on its twelve edges. */
+        Vector3D mass;
+        Vector3D grad;
+        double ata[ 3 ][ 3 ] = { { 0.0 } };
+        double atb[ 3 ] = { 0.0 };
+        size_t crossings = 0;
+        for( size_t e = 0; e < 12; ++e ) {
+          int c0 = cellEdges[ e ][ 0 ], c1 = cellEdges[ e ][ 1 ];
+          if( ( ( inside >> c0 ) & 1 ) == ( ( inside >> c1 ) & 1 ) ) {
+            continue;
+          }
+          double t = ( isolevel - val[ c0 ] ) / ( val[ c1 ] - val[ c0 ] );
+          Vector3D p0( c0 & 1, ( c0 >> 1 ) & 1, ( c0 >> 2 ) & 1 );
+          Vector3D p1( c1 & 1, ( c1 >> 1 ) & 1, ( c1 >> 2 ) & 1 );
+          Vector3D cross = p0 + ( p1 - p0 ) * t;
+          Vector3D g0 = vol.Gradient( x + ( c0 & 1 ), y + ( ( c0 >> 1 ) & 1 ), z + ( ( c0 >> 2 ) & 1 ) );
+          Vector3D g1 = vol.Gradient( x + ( c1 & 1 ), y + ( ( c1 >> 1 ) & 1 ), z + ( ( c1 >> 2 ) & 1 ) );
+          Vector3D g = g0 + ( g1 - g0 ) * t;
+          mass += cross;
+          grad += g;
+          ++crossings;
+          if( mode == Mode::DualContouring && g.LengthSquared( ) > 0.0 ) {
+            Vector3D nrm = g.Normalized( );
+            double d = Dot( nrm, cross );
+            for( int row = 0; row < 3; ++row ) {
+              for( int col = 0; col < 3; ++col ) {
+                ata[ row ][ col ] += nrm[ row ] * nrm[ col ];
+              }
+              atb[ row ] += nrm[ row ] * d;
+            }
+          }
+        }
+        mass = mass / static_cast< double >( crossings );
+        Vector3D pos = mass;
+        if( mode == Mode::DualContouring ) {
+          /* Biasing towards the mass point keeps flat and degenerate configurations stable. */
+          for( int row = 0; row < 3; ++row ) {
+            ata[ row ][ row ] += qefBias;
+            atb[ row ] += qefBias * mass[ row ];
+          }
+          double sol[ 3 ];
+          if( Solve3x3( ata, atb, sol ) ) {
+            pos = Vector3D( std::min( 1.0, std::max( 0.0, sol[ 0 ] ) ),
+                            std::min( 1.0, std::max( 0.0, sol[ 1 ] ) ),
+                            std::min( 1.0, std::max( 0.0, sol[ 2 ] ) ) );
+          }
+        }
+        curr[ x + cxs * y ] = sink.AddVertex( Point3D( x + pos.x, y + pos.y, z + pos.z ),
+                                              grad.LengthSquared( ) > 0.0 ? Normal( grad.Normalized( ) ) : Normal( ) );
+        cellMin.push_back( Point3D( x, y, z ) );
+        /*
+         * Quads around the crossed edges leaving corner 0 of this cell. The other three cells around an edge
+         * along axis a are displaced by -b, -b-c and -c, with ( a, b, c ) cyclic.
+         */
+        for( size_t a = 0; a < 3; ++a ) {
+          int c1 = 1 << a;
+          if( ( inside & 1 ) == ( ( inside >> c1 ) & 1 ) ) {
+            continue;
+          }
+          size_t b = ( a + 1 ) % 3, c = ( a + 2 ) % 3;
+          const size_t coord[ 3 ] = { x, y, z };
+          if( coord[ b ] == 0 || coord[ c ] == 0 ) {
+            continue;
+          }
+          auto cellVertex = [ & ]( bool db, bool dc ) {
+            size_t pos[ 3 ] = { x, y, z };
+            pos[ b ] -= db ? 1 : 0;
+            pos[ c ] -= dc ? 1 : 0;
+            const size_t *slice = ( pos[ 2 ] == z ) ? curr : prev;
+            return( slice[ pos[ 0 ] + cxs * pos[ 1 ] ] );
+          };
+          std::array< size_t, 4 > quad = { {
+            cellVertex( false, false ), cellVertex( true, false ), cellVertex( true, true ), cellVertex( false, true )
+          } };
+          /* Quad winding faces +a; flip it when the surface faces -a, so faces point down the gradient. */
+          if( ( inside & 1 ) == 0 ) {
+            std::swap( quad[ 1 ], quad[ 3 ] );
+          }
+          /* Split along the shorter diagonal. */
+          size_t diag = DistanceSquared( p[ quad[ 0 ] ], p[ quad[ 2 ] ] ) <=
+                        DistanceSquared( p[ quad[ 1 ] ], p[ quad[ 3 ] ] ) ? 0 : 1;
+          sink.AddTriangle( quad[ diag ], quad[ diag + 1 ], quad[ diag + 2 ] );
+          sink.AddTriangle( quad[ diag ], quad[ diag + 2 ], quad[ ( diag + 3 ) % 4 ] );
+        }
+      }
+    }
+  }
+  PROFILE_COUNT( "cells scanned", cxs * cys * czs - skipped );
+  PROFILE_COUNT( "cells skipped", skipped );
+  PROFILE_COUNT( "active cells", p.size( ) - first );
+  PROFILE_COUNT( "triangles emitted", sink.Triangles( ) - firstTri );
+  if( mode == Mode::Smooth ) {
+    PROFILE_SCOPE( "SurfaceNets::Relax" );
+    Relax( sink.getTris( ), cellMin, p, first, 4 );
+  }
+}
+
+void SurfaceNets::Relax( const ChunkedBuffer< size_t > &tris, const ChunkedBuffer< Point3D > &cellMin,
+                         ChunkedBuffer< Point3D > &p, size_t first, size_t iterations ) {
+  /* Only the vertices from first on belong to this extraction, and so do the triangles referencing them. */
+  const size_t nverts = p.size( ) - first;
+  Vector< Vector3D > sum( nverts );
+  Vector< size_t > count( nverts );
+  for( size_t itr = 0; itr < iterations; ++itr ) {
+    std::fill( sum.begin( ), sum.end( ), Vector3D( ) );
+    std::fill( count.begin( ), count.end( ), 0 );
+    for( size_t t = 0; t < tris.size( ); t += 3 ) {
+      if( tris[ t ] < first ) {
+        continue;
+      }
+      for( size_t v = 0; v < 3; ++v ) {
+        size_t v0 = tris[ t + v ], v1 = tris[ t + ( v + 1 ) % 3 ];
+        sum[ v0 - first ] += p[ v1 ].toVector( );
+        sum[ v1 - first ] += p[ v0 ].toVector( );
+        ++count[ v0 - first ];
+        ++count[ v1 - first ];
+      }
+    }
+    /* Each vertex moves to its neighbour average, but never leaves its own cell. */
+    for( size_t vtx = 0; vtx < nverts; ++vtx ) {
+      if( count[ vtx ] == 0 ) {
+        continue;
+      }
+      Vector3D avg = sum[ vtx ] / static_cast< double >( count[ vtx ] );
+      const Point3D &lo = cellMin[ vtx ];
+      p[ first + vtx ] = Point3D( std::min( lo.x + 1.0, std::max( lo.x, avg.x ) ),
+                          std::min( lo.y + 1.0, std::max( lo.y, avg.y ) ),
+                          std::min( lo.z + 1.0, std::max( lo.z, avg.z ) ) );
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef SURFACENETS_H
+#define SURFACENETS_H
+
+#include "meshsink.h"
+
+#include <Common.hpp>
+#include <Draw.hpp>
+
+using namespace Bial;
+
+/**
+ * Dual isosurface extraction. Places one vertex in each cell crossed by the isosurface and connects the four
+ * cells around every crossed grid edge with a quad (split into two triangles). Vertices are shared by
+ * construction, so the resulting mesh does not need to be welded.
+ */
+class SurfaceNets {
+public:
+  enum class Mode {
+    /* Vertex at the mean of the cell edge crossings. */
+    Naive,
+    /* Naive placement followed by a few relaxation steps constrained to each cell. */
+    Smooth,
+    /* Vertex minimizing the quadratic error of the crossing planes given by the volume gradient. */
+    DualContouring
+  };
+
+  /**
+   * Extracts the isosurface of img at isolevel. Voxels where mask is zero are taken as outside the surface.
+   * Coordinates are given in voxels, and normals follow the volume gradient, as in MarchingCubes::exec.
+   * With the statistics of img, blocks the isosurface cannot cross are skipped; they are ignored with a mask.
+   */
+  static TriangleMesh* exec( const Image< int > &img, float isolevel, Mode mode = Mode::Naive,
+                             const Image< int > *mask = nullptr );
+
+  /* Same as above, appending into sink. */
+  static void exec( const Image< int > &img, float isolevel, MeshSink &sink, Mode mode = Mode::Naive,
+                    const Image< int > *mask = nullptr, const VolumeStatistics *stats = nullptr );
+
+private:
+  static void Relax( const ChunkedBuffer< size_t > &tris, const ChunkedBuffer< Point3D > &cellMin,
+                     ChunkedBuffer< Point3D > &p, size_t first, size_t iterations );
+};
+
+#endif /* SURFACENETS_H */
@@ -0,0 +1,350 @@
+#include "taskscheduler.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+  thread_local TaskScheduler::Priority currentPriority = TaskScheduler::Priority::Background;
+
+  /* Processors listed as "0-3,8-11", as in /sys/devices/system/node/node0/cpulist. */
+  std::vector< int > ParseCpuList( const std::string &list ) {
+    std::vector< int > cpus;
+    std::istringstream in( list );
+    std::string range;
+    while( std::getline( in, range, ',' ) ) {
+      int first = 0, last = 0;
+      char dash = 0;
+      std::istringstream numbers( range );
+      if( !( numbers >> first ) ) {
+        continue;
+      }
+      last = first;
+      if( numbers >> dash >> last && dash != '-' ) {
+        continue;
+      }
+      for( int cpu = first; cpu <= last; ++cpu ) {
+        cpus.push_back( cpu );
+      }
+    }
+    return( cpus );
+  }
+
+  /*
+   * Processors of every NUMA node this process may run on. Nodes without such processors are left out; without
+   * NUMA information the result is empty.
+   */
+  std::vector< std::vector< int > > NumaNodes( ) {
+    std::vector< std::vector< int > > nodes;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO( &allowed );
+    if( sched_getaffinity( 0, sizeof( allowed ), &allowed ) != 0 ) {
+      return( nodes );
+    }
+    const std::string root = "/sys/devices/system/node";
+    DIR *dir = opendir( root.c_str( ) );
+    if( !dir ) {
+      return( nodes );
+    }
+    std::vector< int > ids;
+    while( dirent *entry = readdir( dir ) ) {
+      int id = 0;
+      if( std::sscanf( entry->d_name, "node%d", &id ) == 1 ) {
+        ids.push_back( id );
+      }
+    }
+    closedir( dir );
+    std::sort( ids.begin( ), ids.end( ) );
+    for( int id : ids ) {
+      std::ifstream file( root + "/node" + std::to_string( id ) + "/cpulist" );
+      std::string list;
+      std::getline( file, list );
+      std::vector< int > cpus;
+      for( int cpu : ParseCpuList( list ) ) {
+        if( cpu < CPU_SETSIZE && CPU_ISSET( cpu, &allowed ) ) {
+          cpus.push_back( cpu );
+        }
+      }
+      if( !cpus.empty( ) ) {
+        nodes.push_back( cpus );
+      }
+    }
+#endif
+    return( nodes );
+  }
+
+  void PinCurrentThread( const std::vector< int > &cpus ) {
+#ifdef __linux__
+    if( cpus.empty( ) ) {
+      return;
+    }
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    for( int cpu : cpus ) {
+      CPU_SET( cpu, &set );
+    }
+    /* Best effort: the processors may have been taken away from the process meanwhile. */
+    pthread_setaffinity_np( pthread_self( ), sizeof( set ), &set );
+#else
+    ( void ) cpus;
+#endif
+  }
+
+  /* Runs task at priority, which the tasks it spawns inherit. */
+  void Execute( TaskScheduler::Priority priority, const std::function< void( ) > &task ) {
+    TaskScheduler::PriorityScope scope( priority );
+    task( );
+  }
+
+}
+
+thread_local TaskScheduler::Worker *TaskScheduler::current = nullptr;
+
+TaskScheduler::PriorityScope::PriorityScope( Priority priority ) : previous( currentPriority ) {
+  currentPriority = priority;
+}
+
+TaskScheduler::PriorityScope::~PriorityScope( ) {
+  currentPriority = previous;
+}
+
+TaskScheduler::Group::Group( ) : scheduler( TaskScheduler::instance( ) ), priority( currentPriority ) {
+}
+
+TaskScheduler::Group::~Group( ) {
+  try {
+    Wait( );
+  }
+  catch( ... ) {
+  }
+}
+
+void TaskScheduler::Group::Run( std::function< void( ) > task ) {
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    ++pending;
+  }
+  scheduler.Submit( priority, [ this, task ]( ) {
+    std::exception_ptr thrown;
+    try {
+      task( );
+    }
+    catch( ... ) {
+      thrown = std::current_exception( );
+    }
+    /* The waiting thread may destroy the group as soon as the lock is released. */
+    std::lock_guard< std::mutex > lock( mtx );
+    if( thrown && !error ) {
+      error = thrown;
+    }
+    if( --pending == 0 ) {
+      finished.notify_all( );
+    }
+  } );
+}
+
+void TaskScheduler::Group::Wait( ) {
+  for( ; ; ) {
+    {
+      std::lock_guard< std::mutex > lock( mtx );
+      if( pending == 0 ) {
+        break;
+      }
+    }
+    /*
+     * With nothing left in the queues, every task of the group is running on another thread, which finishes it
+     * without help from this one.
+     */
+    if( !scheduler.RunOne( ) ) {
+      std::unique_lock< std::mutex > lock( mtx );
+      finished.wait( lock, [ this ]( ) {
+        return( pending == 0 );
+      } );
+    }
+  }
+  std::exception_ptr thrown;
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    std::swap( thrown, error );
+  }
+  if( thrown ) {
+    std::rethrow_exception( thrown );
+  }
+}
+
+TaskScheduler::TaskScheduler( ) : started( false ), queued( 0 ) {
+}
+
+TaskScheduler::~TaskScheduler( ) {
+  Stop( );
+}
+
+TaskScheduler &TaskScheduler::instance( ) {
+  static TaskScheduler scheduler;
+  return( scheduler );
+}
+
+void TaskScheduler::Configure( const Params &params ) {
+  TaskScheduler &scheduler = instance( );
+  scheduler.Stop( );
+  std::lock_guard< std::mutex > lock( scheduler.control );
+  scheduler.params = params;
+}
+
+size_t TaskScheduler::Threads( ) const {
+  if( params.threads > 0 ) {
+    return( params.threads );
+  }
+  return( std::max( 1u, std::thread::hardware_concurrency( ) ) );
+}
+
+void TaskScheduler::Start( ) {
+  std::lock_guard< std::mutex > lock( control );
+  if( started.load( std::memory_order_relaxed ) ) {
+    return;
+  }
+  const size_t count = Threads( ) - 1;
+  std::vector< std::vector< int > > nodes;
+  if( params.pin ) {
+    nodes = NumaNodes( );
+  }
+  const size_t nodeCount = std::max< size_t >( 1, nodes.size( ) );
+  for( size_t index = 0; index < count; ++index ) {
+    workers.emplace_back( new Worker( ) );
+  }
+  for( size_t index = 0; index < count; ++index ) {
+    /* Nearest first: workers of the same node, then the others, each starting after this worker. */
+    for( size_t pass = 0; pass < 2; ++pass ) {
+      for( size_t step = 1; step < count; ++step ) {
+        const size_t victim = ( index + step ) % count;
+        if( ( victim % nodeCount == index % nodeCount ) == ( pass == 0 ) ) {
+          workers[ index ]->victims.push_back( victim );
+        }
+      }
+    }
+  }
+  for( size_t index = 0; index < count; ++index ) {
+    const std::vector< int > cpus = nodes.empty( ) ? std::vector< int >( ) : nodes[ index % nodes.size( ) ];
+    workers[ index ]->thread = std::thread( &TaskScheduler::Loop, this, index, cpus );
+  }
+  started.store( true, std::memory_order_release );
+}
+
+void TaskScheduler::Stop( ) {
+  std::lock_guard< std::mutex > lock( control );
+  {
+    std::lock_guard< std::mutex > sleepLock( sleepMtx );
+    stopping = true;
+  }
+  wake.notify_all( );
+  for( std::unique_ptr< Worker > &worker : workers ) {
+    worker->thread.join( );
+  }
+  workers.clear( );
+  stopping = false;
+  started.store( false, std::memory_order_release );
+}
+
+void TaskScheduler::Loop( size_t index, const std::vector< int > &cpus ) {
+  PinCurrentThread( cpus );
+  current = workers[ index ].get( );
+  for( ; ; ) {
+    if( RunOne( ) ) {
+      continue;
+    }
+    std::unique_lock< std::mutex > lock( sleepMtx );
+    wake.wait( lock, [ this ]( ) {
+      return( stopping || queued.load( ) > 0 );
+    } );
+    if( stopping ) {
+      break;
+    }
+  }
+  current = nullptr;
+}
+
+void TaskScheduler::Submit( Priority priority, std::function< void( ) > task ) {
+  if( !started.load( std::memory_order_acquire ) ) {
+    Start( );
+  }
+  const size_t queue = static_cast< size_t >( priority );
+  /* Workers push to their own deques; tasks from any other thread are shared. */
+  Worker *self = current;
+  if( self ) {
+    std::lock_guard< std::mutex > lock( self->mtx );
+    self->tasks[ queue ].push_back( std::move( task ) );
+    ++queued;
+  }
+  else {
+    std::lock_guard< std::mutex > lock( sharedMtx );
+    shared[ queue ].push_back( std::move( task ) );
+    ++queued;
+  }
+  /* Taking the lock orders the new task before the check of a worker about to sleep. */
+  {
+    std::lock_guard< std::mutex > lock( sleepMtx );
+  }
+  wake.notify_one( );
+}
+
+bool TaskScheduler::Take( Priority priority, std::function< void( ) > &task ) {
+  const size_t queue = static_cast< size_t >( priority );
+  Worker *self = current;
+  if( self ) {
+    std::lock_guard< std::mutex > lock( self->mtx );
+    if( !self->tasks[ queue ].empty( ) ) {
+      task = std::move( self->tasks[ queue ].back( ) );
+      self->tasks[ queue ].pop_back( );
+      --queued;
+      return( true );
+    }
+  }
+  {
+    std::lock_guard< std::mutex > lock( sharedMtx );
+    if( !shared[ queue ].empty( ) ) {
+      task = std::move( shared[ queue ].front( ) );
+      shared[ queue ].pop_front( );
+      --queued;
+      return( true );
+    }
+  }
+  const size_t victims = self ? self->victims.size( ) : workers.size( );
+  for( size_t index = 0; index < victims; ++index ) {
+    Worker &victim = *workers[ self ? self->victims[ index ] : index ];
+    std::lock_guard< std::mutex > lock( victim.mtx );
+    if( !victim.tasks[ queue ].empty( ) ) {
+      task = std::move( victim.tasks[ queue ].front( ) );
+      victim.tasks[ queue ].pop_front( );
+      --queued;
+      PROFILE_COUNT( "tasks stolen", 1 );
+      return( true );
+    }
+  }
+  return( false );
+}
+
+bool TaskScheduler::RunOne( ) {
+  if( queued.load( ) == 0 ) {
+    return( false );
+  }
+  std::function< void( ) > task;
+  for( Priority priority : { Priority::Interactive, Priority::Background } ) {
+    if( Take( priority, task ) ) {
+      Execute( priority, task );
+      return( true );
+    }
+  }
+  return( false );
+}
@@ -0,0 +1,116 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The one pool of worker threads of the process, shared by every parallel stage, so the viewer and a background
+ * extraction running together never keep more threads busy than configured. Each worker has a deque of tasks per
+ * priority: tasks spawned on a worker go to the back of its own deque and it runs them newest first, while idle
+ * workers steal the oldest, usually largest, tasks from the front of the others' deques, from workers of their
+ * own NUMA node first. Tasks submitted by other threads wait in a shared queue. Interactive tasks are always taken
+ * before background ones. Threads are started by the first task, so a process may fork before using the pool.
+ */
+class TaskScheduler {
+public:
+  enum class Priority {
+    Interactive, Background
+  };
+
+  struct Params {
+    /* Threads running tasks, the waiting caller included; 0 uses all hardware threads. */
+    size_t threads = 0;
+    /* Binds each worker to the processors of one NUMA node, spreading the workers over the nodes. Linux only. */
+    bool pin = false;
+  };
+
+  /* Priority of the tasks submitted by this thread, and by the tasks it spawns, while the scope lives. */
+  class PriorityScope {
+    Priority previous;
+
+  public:
+    explicit PriorityScope( Priority priority );
+    ~PriorityScope( );
+    PriorityScope( const PriorityScope & ) = delete;
+    PriorityScope &operator=( const PriorityScope & ) = delete;
+  };
+
+  /*
+   * Tasks waited for together, at the priority of the thread that created the group. Waiting runs queued tasks
+   * instead of blocking, so tasks may themselves wait for nested groups.
+   */
+  class Group {
+  public:
+    Group( );
+    /* Waits for the tasks still running; their exceptions are dropped. */
+    ~Group( );
+    Group( const Group & ) = delete;
+    Group &operator=( const Group & ) = delete;
+
+    void Run( std::function< void( ) > task );
+    /* Returns when every task has finished, rethrowing the first exception thrown by one of them. */
+    void Wait( );
+
+  private:
+    TaskScheduler &scheduler;
+    Priority priority;
+    std::mutex mtx;
+    std::condition_variable finished;
+    size_t pending = 0;
+    std::exception_ptr error;
+  };
+
+  static TaskScheduler &instance( );
+
+  /* Replaces the workers of the pool. Call it at start up, or while no task is running. */
+  static void Configure( const Params &params );
+
+  /* Threads running tasks, the caller of Group::Wait included. */
+  size_t Threads( ) const;
+
+  ~TaskScheduler( );
+
+private:
+  struct Worker {
+    std::mutex mtx;
+    std::deque< std::function< void( ) > > tasks[ 2 ];
+    /* Other workers, those of the same NUMA node first. */
+    std::vector< size_t > victims;
+    std::thread thread;
+  };
+
+  TaskScheduler( );
+
+  void Start( );
+  void Stop( );
+  void Loop( size_t index, const std::vector< int > &cpus );
+  void Submit( Priority priority, std::function< void( ) > task );
+  bool Take( Priority priority, std::function< void( ) > &task );
+  /* Runs one queued task, if any, on the calling thread. */
+  bool RunOne( );
+
+  static thread_local Worker *current;
+
+  Params params;
+  std::mutex control;
+  std::atomic< bool > started;
+  std::vector< std::unique_ptr< Worker > > workers;
+  std::mutex sharedMtx;
+  std::deque< std::function< void( ) > > shared[ 2 ];
+  /* Tasks in all the queues, which idle workers sleep on. */
+  std::atomic< size_t > queued;
+  std::mutex sleepMtx;
+  std::condition_variable wake;
+  bool stopping = false;
+};
+
+#endif /* TASKSCHEDULER_H */
@@ -0,0 +1,124 @@
+#include "timeseries.h"
+
+#include "brickedvolume.h"
+#include "meshsink.h"
+#include "meshwelder.h"
+#include "niftiinfo.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "slicereader.h"
+#include "volumestatistics.h"
+
+#include <algorithm>
+#include <exception>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+  /* Consecutive bricks of the Z order extracted and reused together, a 32^3 block of voxels when aligned. */
+  const size_t groupBricks = 8;
+
+  /* The next frame of reader. */
+  std::unique_ptr< Image< int > > ReadFrame( SliceReader &reader, size_t threads ) {
+    const NiftiInfo &info = reader.Info( );
+    std::unique_ptr< Image< int > > img( new Image< int >( info.dims[ 0 ], info.dims[ 1 ], info.dims[ 2 ] ) );
+    if( info.Voxels( ) > 0 ) {
+      reader.Read( info.dims[ 2 ], &( *img )[ 0 ], threads );
+    }
+    return( img );
+  }
+
+}
+
+size_t TimeSeries::Frames( const std::string &fileName ) {
+  NiftiInfo info;
+  return( info.Read( fileName ) ? info.dims[ 3 ] : 0 );
+}
+
+std::vector< std::unique_ptr< MeshData > > TimeSeries::Extract( const Params &params, Statistics *stats ) {
+  PROFILE_SCOPE( "TimeSeries::Extract" );
+  const size_t threads = HardwareThreads( params.threads );
+  SliceReader reader( params.fileName );
+  std::vector< std::unique_ptr< MeshData > > meshes( reader.Info( ).dims[ 3 ] );
+  Statistics total;
+  total.frames = meshes.size( );
+  std::unique_ptr< Image< int > > img = ReadFrame( reader, threads );
+  const float level = params.isolevel * VolumeStatistics( *img, 1024, threads ).Maximum( );
+  std::unique_ptr< BrickedVolume > previous;
+  std::vector< std::shared_ptr< const MeshData > > groups, previousGroups;
+  for( size_t frame = 0; frame < meshes.size( ); ++frame ) {
+    /* The next frame is read while this one is extracted. */
+    std::unique_ptr< Image< int > > next;
+    std::exception_ptr error;
+    std::thread loader;
+    if( frame + 1 < meshes.size( ) ) {
+      loader = std::thread( [ &reader, &next, &error ]( ) {
+        try {
+          next = ReadFrame( reader, 1 );
+        }
+        catch( ... ) {
+          error = std::current_exception( );
+        }
+      } );
+    }
+    try {
+      std::unique_ptr< BrickedVolume > vol( new BrickedVolume( *img, threads ) );
+      img.reset( );
+      groups.assign( ( vol->Bricks( ) + groupBricks - 1 ) / groupBricks, nullptr );
+      std::vector< size_t > reused( threads, 0 );
+      ParallelRanges( 0, groups.size( ), threads, [ & ]( size_t first, size_t last, size_t part ) {
+        MeshSink sink;
+        for( size_t group = first; group < last; ++group ) {
+          const size_t firstBrick = group * groupBricks;
+          const size_t lastBrick = std::min( firstBrick + groupBricks, vol->Bricks( ) );
+          const size_t voxels = ( lastBrick - firstBrick ) * BrickedVolume::BrickVoxels;
+          if( previous && std::equal( vol->Brick( firstBrick ), vol->Brick( firstBrick ) + voxels,
+                                      previous->Brick( firstBrick ) ) ) {
+            groups[ group ] = previousGroups[ group ];
+            ++reused[ part ];
+            continue;
+          }
+          BrickedVolume::ExtractMarchingCubes( *vol, level, sink, firstBrick, lastBrick );
+          if( sink.Triangles( ) > 0 ) {
+            groups[ group ] = sink.Take( );
+          }
+        }
+      } );
+      const size_t reusedGroups = std::accumulate( reused.begin( ), reused.end( ), size_t( 0 ) );
+      total.reused += reusedGroups;
+      total.extracted += groups.size( ) - reusedGroups;
+      PROFILE_COUNT( "groups reused", reusedGroups );
+      std::unique_ptr< MeshData > mesh( new MeshData( ) );
+      for( const std::shared_ptr< const MeshData > &group : groups ) {
+        if( group ) {
+          mesh->Append( *group );
+        }
+      }
+      if( !mesh->tris.empty( ) ) {
+        PROFILE_SCOPE( "SimplifyMesh" );
+        MeshWelder::SimplifyMesh( mesh->tris, mesh->n, mesh->p );
+      }
+      meshes[ frame ] = std::move( mesh );
+      previous = std::move( vol );
+      previousGroups.swap( groups );
+    }
+    catch( ... ) {
+      if( loader.joinable( ) ) {
+        loader.join( );
+      }
+      throw;
+    }
+    if( loader.joinable( ) ) {
+      loader.join( );
+    }
+    if( error ) {
+      std::rethrow_exception( error );
+    }
+    img = std::move( next );
+  }
+  if( stats ) {
+    *stats = total;
+  }
+  return( meshes );
+}
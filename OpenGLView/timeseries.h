@@ -0,0 +1,43 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include "meshdata.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Isosurfaces of every frame of a 4D NIfTI series, such as cardiac or perfusion studies. Frames are read one
+ * ahead of the extraction, and extracted with marching cubes over a BrickedVolume. Groups of bricks whose voxels,
+ * halo included, are the same as in the previous frame produce the same triangles, which are reused instead of
+ * extracted again; in a series where only part of the field of view moves, most of every frame is reused.
+ */
+class TimeSeries {
+public:
+  struct Params {
+    std::string fileName;
+    /* Fraction of the maximum intensity of the first frame, the same level for every frame. */
+    float isolevel = 0.1f;
+    /* Threads used by each frame; 0 uses all hardware threads. */
+    size_t threads = 0;
+  };
+
+  struct Statistics {
+    size_t frames = 0;
+    /* Groups of bricks extracted, and reused from the previous frame, over the whole series. */
+    size_t extracted = 0;
+    size_t reused = 0;
+  };
+
+  /* Number of frames of a NIfTI file, 1 for 3D files and 0 if it cannot be read. */
+  static size_t Frames( const std::string &fileName );
+
+  /*
+   * Welded mesh of every frame, empty for frames without a surface. Compressed and uncompressed files alike;
+   * throws on I/O errors.
+   */
+  static std::vector< std::unique_ptr< MeshData > > Extract( const Params &params, Statistics *stats = nullptr );
+};
+
+#endif /* TIMESERIES_H */
@@ -0,0 +1,149 @@
+#include "volumestatistics.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const size_t VolumeStatistics::BlockEdge;
+
+VolumeStatistics::VolumeStatistics( const Image< int > &img, size_t bins, size_t threads ) {
+  PROFILE_SCOPE( "VolumeStatistics" );
+  const size_t dims[ 3 ] = { img.size( 0 ), img.size( 1 ), img.size( 2 ) };
+  const size_t voxels = dims[ 0 ] * dims[ 1 ] * dims[ 2 ];
+  if( voxels == 0 ) {
+    histogram.assign( 1, 0 );
+    return;
+  }
+  /* Blocks of cells: block b spans voxels 16 b to 16 b + 16, the last plane being shared with block b + 1. */
+  for( size_t dim = 0; dim < 3; ++dim ) {
+    blocks[ dim ] = std::max< size_t >( 1, ( dims[ dim ] - 1 + BlockEdge - 1 ) / BlockEdge );
+  }
+  blockMin.assign( blocks[ 0 ] * blocks[ 1 ] * blocks[ 2 ], std::numeric_limits< int >::max( ) );
+  blockMax.assign( blockMin.size( ), std::numeric_limits< int >::min( ) );
+  threads = HardwareThreads( threads );
+  /* Block ranges, which also give the volume range and sum. Block planes are independent units of work. */
+  std::vector< int64_t > sums( threads, 0 );
+  ParallelRanges( 0, blocks[ 2 ], threads, [ & ]( size_t first, size_t last, size_t part ) {
+    int64_t sum = 0;
+    for( size_t bz = first; bz < last; ++bz ) {
+      const size_t z0 = bz * BlockEdge, z1 = std::min( dims[ 2 ] - 1, z0 + BlockEdge );
+      for( size_t z = z0; z <= z1; ++z ) {
+        for( size_t y = 0; y < dims[ 1 ]; ++y ) {
+          const int *row = &img[ dims[ 0 ] * ( y + dims[ 1 ] * z ) ];
+          /* Shared planes are summed by the block that starts on them, and the last plane by the last block. */
+          const bool counted = z < z1 || z1 == dims[ 2 ] - 1;
+          for( size_t bx = 0; bx < blocks[ 0 ]; ++bx ) {
+            const size_t x0 = bx * BlockEdge, x1 = std::min( dims[ 0 ] - 1, x0 + BlockEdge );
+            int lo = row[ x0 ], hi = row[ x0 ];
+            for( size_t x = x0; x <= x1; ++x ) {
+              lo = std::min( lo, row[ x ] );
+              hi = std::max( hi, row[ x ] );
+              if( counted && ( x < x1 || x1 == dims[ 0 ] - 1 ) ) {
+                sum += row[ x ];
+              }
+            }
+            /* A row starting a block is also the last row of the block before it. */
+            const size_t byFirst = y % BlockEdge == 0 && y > 0 ? y / BlockEdge - 1 : y / BlockEdge;
+            const size_t byLast = std::min( blocks[ 1 ] - 1, y / BlockEdge );
+            for( size_t by = byFirst; by <= byLast; ++by ) {
+              const size_t block = bx + blocks[ 0 ] * ( by + blocks[ 1 ] * bz );
+              blockMin[ block ] = std::min( blockMin[ block ], lo );
+              blockMax[ block ] = std::max( blockMax[ block ], hi );
+            }
+          }
+        }
+      }
+    }
+    sums[ part ] = sum;
+  } );
+  minimum = *std::min_element( blockMin.begin( ), blockMin.end( ) );
+  maximum = *std::max_element( blockMax.begin( ), blockMax.end( ) );
+  int64_t total = 0;
+  for( int64_t sum : sums ) {
+    total += sum;
+  }
+  mean = static_cast< double >( total ) / voxels;
+  /* Histogram, one per thread, merged. */
+  const int64_t range = static_cast< int64_t >( maximum ) - minimum + 1;
+  bins = static_cast< size_t >( std::min< int64_t >( std::max< size_t >( 1, bins ), range ) );
+  binWidth = static_cast< double >( range ) / bins;
+  std::vector< std::vector< uint64_t > > partial( threads );
+  ParallelRanges( 0, voxels, threads, [ & ]( size_t first, size_t last, size_t part ) {
+    std::vector< uint64_t > &hist = partial[ part ];
+    hist.assign( bins, 0 );
+    const double scale = 1.0 / binWidth;
+    for( size_t pxl = first; pxl < last; ++pxl ) {
+      size_t bin = static_cast< size_t >( ( static_cast< int64_t >( img[ pxl ] ) - minimum ) * scale );
+      ++hist[ std::min( bin, bins - 1 ) ];
+    }
+  } );
+  histogram.assign( bins, 0 );
+  for( const std::vector< uint64_t > &hist : partial ) {
+    for( size_t bin = 0; bin < hist.size( ); ++bin ) {
+      histogram[ bin ] += hist[ bin ];
+    }
+  }
+  /* One pass for the range and one for the histogram. */
+  PROFILE_COUNT( "voxels read", 2 * voxels );
+}
+
+int VolumeStatistics::BinValue( size_t bin ) const {
+  return( static_cast< int >( minimum + std::ceil( bin * binWidth ) ) );
+}
+
+int VolumeStatistics::Percentile( double fraction ) const {
+  uint64_t total = 0;
+  for( uint64_t count : histogram ) {
+    total += count;
+  }
+  const double target = std::min( 1.0, std::max( 0.0, fraction ) ) * total;
+  uint64_t seen = 0;
+  for( size_t bin = 0; bin < histogram.size( ); ++bin ) {
+    seen += histogram[ bin ];
+    if( seen >= target && seen > 0 ) {
+      return( BinValue( bin ) );
+    }
+  }
+  return( maximum );
+}
+
+int VolumeStatistics::OtsuThreshold( ) const {
+  double total = 0.0, weighted = 0.0;
+  for( size_t bin = 0; bin < histogram.size( ); ++bin ) {
+    total += histogram[ bin ];
+    weighted += static_cast< double >( bin ) * histogram[ bin ];
+  }
+  double below = 0.0, belowWeighted = 0.0, best = -1.0;
+  size_t threshold = 0;
+  for( size_t bin = 0; bin + 1 < histogram.size( ); ++bin ) {
+    below += histogram[ bin ];
+    belowWeighted += static_cast< double >( bin ) * histogram[ bin ];
+    const double above = total - below;
+    if( below == 0.0 || above == 0.0 ) {
+      continue;
+    }
+    const double diff = belowWeighted / below - ( weighted - belowWeighted ) / above;
+    const double variance = below * above * diff * diff;
+    if( variance > best ) {
+      best = variance;
+      threshold = bin + 1;
+    }
+  }
+  return( BinValue( threshold ) );
+}
+
+double VolumeStatistics::ActiveFraction( float level ) const {
+  if( blockMin.empty( ) ) {
+    return( 0.0 );
+  }
+  size_t active = 0;
+  for( size_t block = 0; block < blockMin.size( ); ++block ) {
+    if( blockMin[ block ] < level && blockMax[ block ] >= level ) {
+      ++active;
+    }
+  }
+  return( static_cast< double >( active ) / blockMin.size( ) );
+}
@@ -0,0 +1,68 @@
+#ifndef VOLUMESTATISTICS_H
+#define VOLUMESTATISTICS_H
+
+#include <Common.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace Bial;
+
+/**
+ * Intensity statistics of a volume: range, mean, histogram and the value range of every 16^3 block of cells.
+ * Computed once, in parallel, when a volume is loaded. The block ranges let the extractors skip blocks that the
+ * isosurface cannot cross, and the histogram gives threshold suggestions.
+ */
+class VolumeStatistics {
+public:
+  /* Block edge in cells; matches the bricks of BrickedVolume. */
+  static const size_t BlockEdge = 16;
+
+  /* Uses at most bins histogram bins, fewer if the intensity range is narrower. 0 threads uses all of them. */
+  explicit VolumeStatistics( const Image< int > &img, size_t bins = 1024, size_t threads = 0 );
+
+  int Minimum( ) const {
+    return( minimum );
+  }
+
+  int Maximum( ) const {
+    return( maximum );
+  }
+
+  double Mean( ) const {
+    return( mean );
+  }
+
+  const std::vector< uint64_t > &Histogram( ) const {
+    return( histogram );
+  }
+
+  /* Lowest intensity counted in bin. */
+  int BinValue( size_t bin ) const;
+
+  /* Intensity below which lie fraction ( 0 to 1 ) of the voxels, to the resolution of the histogram. */
+  int Percentile( double fraction ) const;
+
+  /* Threshold maximizing the between-class variance (Otsu), a good first guess for the isolevel. */
+  int OtsuThreshold( ) const;
+
+  /* False when no cell of the block holding cell ( x, y, z ) has corners on both sides of level. */
+  bool MayCross( size_t x, size_t y, size_t z, float level ) const {
+    const size_t block = x / BlockEdge + blocks[ 0 ] * ( y / BlockEdge + blocks[ 1 ] * ( z / BlockEdge ) );
+    return( blockMin[ block ] < level && blockMax[ block ] >= level );
+  }
+
+  /* Fraction of the blocks that level may cross. */
+  double ActiveFraction( float level ) const;
+
+private:
+  int minimum = 0;
+  int maximum = 0;
+  double mean = 0.0;
+  double binWidth = 1.0;
+  std::vector< uint64_t > histogram;
+  size_t blocks[ 3 ] = { 0, 0, 0 };
+  std::vector< int > blockMin;
+  std::vector< int > blockMax;
+};
+
+#endif /* VOLUMESTATISTICS_H */
@@ -0,0 +1,15 @@
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle qt
+TARGET = Bial_Render_Batch
+TEMPLATE = app
+
+include(../../bial/bial.pri)
+include(../OpenGLView/core.pri)
+
+SOURCES += \
+    main.cpp \
+    jobscheduler.cpp
+
+HEADERS += \
+    jobscheduler.h
@@ -0,0 +1,97 @@
+#include "jobscheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+JobScheduler::JobScheduler( size_t threads, size_t memory ) : threads( std::max< size_t >( 1, threads ) ),
+  memory( memory ) {
+}
+
+void JobScheduler::Add( Job job ) {
+  job.threads = std::max< size_t >( 1, std::min( job.threads, threads ) );
+  jobs.push_back( std::move( job ) );
+}
+
+size_t JobScheduler::Run( std::function< void( const Result& ) > done ) {
+  struct Running {
+    size_t job;
+    std::chrono::steady_clock::time_point start;
+  };
+  /* Largest first, so small jobs fill the gaps left next to the big ones. */
+  std::vector< size_t > pending( jobs.size( ) );
+  for( size_t job = 0; job < jobs.size( ); ++job ) {
+    pending[ job ] = job;
+  }
+  std::stable_sort( pending.begin( ), pending.end( ), [ this ]( size_t a, size_t b ) {
+    return( jobs[ a ].memory > jobs[ b ].memory );
+  } );
+  std::map< pid_t, Running > running;
+  size_t freeThreads = threads;
+  size_t freeMemory = memory;
+  size_t failed = 0;
+  while( !pending.empty( ) || !running.empty( ) ) {
+    auto next = pending.end( );
+    if( running.empty( ) ) {
+      next = pending.begin( );
+    }
+    else {
+      next = std::find_if( pending.begin( ), pending.end( ), [ & ]( size_t job ) {
+        return( jobs[ job ].threads <= freeThreads && ( memory == 0 || jobs[ job ].memory <= freeMemory ) );
+      } );
+    }
+    if( next != pending.end( ) ) {
+      const size_t job = *next;
+      pending.erase( next );
+      /* Otherwise the child would print the parent's buffered output again. */
+      std::fflush( stdout );
+      std::fflush( stderr );
+      pid_t pid = fork( );
+      if( pid < 0 ) {
+        throw std::runtime_error( "Could not fork a process for " + jobs[ job ].name + "." );
+      }
+      if( pid == 0 ) {
+        int status = 1;
+        try {
+          status = jobs[ job ].run( );
+        }
+        catch( const std::exception &e ) {
+          std::fprintf( stderr, "%s: %s\n", jobs[ job ].name.c_str( ), e.what( ) );
+        }
+        std::fflush( stdout );
+        std::fflush( stderr );
+        _exit( status );
+      }
+      running[ pid ] = Running{ job, std::chrono::steady_clock::now( ) };
+      freeThreads -= std::min( freeThreads, jobs[ job ].threads );
+      freeMemory -= std::min( freeMemory, jobs[ job ].memory );
+      continue;
+    }
+    int status = 0;
+    pid_t pid = waitpid( -1, &status, 0 );
+    if( pid < 0 ) {
+      throw std::runtime_error( "Lost track of the running jobs." );
+    }
+    auto it = running.find( pid );
+    if( it == running.end( ) ) {
+      continue;
+    }
+    const Job &job = jobs[ it->second.job ];
+    Result res;
+    res.name = job.name;
+    res.status = WIFEXITED( status ) ? WEXITSTATUS( status ) : 128 + WTERMSIG( status );
+    res.seconds = std::chrono::duration< double >( std::chrono::steady_clock::now( ) - it->second.start ).count( );
+    freeThreads = std::min( threads, freeThreads + job.threads );
+    freeMemory = std::min( memory, freeMemory + job.memory );
+    running.erase( it );
+    if( res.status != 0 ) {
+      ++failed;
+    }
+    done( res );
+  }
+  return( failed );
+}
@@ -0,0 +1,43 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Runs jobs in forked child processes, keeping the sum of their threads and estimated memory within a budget.
+ * A job that alone exceeds the budget runs by itself. Children are isolated, so a crash or an allocation failure
+ * in one job does not take down the others.
+ */
+class JobScheduler {
+public:
+  struct Job {
+    std::string name;
+    size_t threads = 1;
+    size_t memory = 0;
+    /* Runs in the child; the return value is its exit status. */
+    std::function< int( ) > run;
+  };
+
+  struct Result {
+    std::string name;
+    int status = 0;
+    double seconds = 0.0;
+  };
+
+  JobScheduler( size_t threads, size_t memory );
+
+  void Add( Job job );
+
+  /* Runs every job, calling done as each one finishes. Returns the number of failed jobs. */
+  size_t Run( std::function< void( const Result& ) > done );
+
+private:
+  size_t threads;
+  size_t memory;
+  std::vector< Job > jobs;
+};
+
+#endif /* JOBSCHEDULER_H */
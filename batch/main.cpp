@@ -0,0 +1,470 @@
+#include "jobscheduler.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "meshio.h"
+#include "meshmetrics.h"
+#include "meshpipeline.h"
+#include "meshstream.h"
+#include "meshvoxelizer.h"
+#include "niftiinfo.h"
+#include "pipelinecache.h"
+#include "profiler.h"
+#include "softwarerenderer.h"
+#include "taskscheduler.h"
+
+/*
+ * Headless mesher. Reads a manifest with one job per line,
+ *
+ *   input output [isolevel=0.1] [scale=1] [extractor=mc|nets|smooth-nets|dc|adaptive] [mask=file] [threads=n]
+ *                [optimize=0|1] [bricked=0|1] [smooth=iterations] [tolerance=voxels] [ascii=0|1]
+ *                [compare=segmentation]
+ *
+ * ('#' starts a comment) and meshes the jobs concurrently, each in its own process. Small volumes run one per
+ * core; volumes large enough to benefit from threaded extraction get several threads. The number of busy threads
+ * and the estimated memory of the running jobs are kept within the given limits. Outputs ending in .bmsh are
+ * written in the native indexed format, any other as binary STL, or ASCII STL with ascii=1.
+ *
+ * With --views, every mesh is also rendered in software from each of the given orientations, as the viewer shows
+ * it, into output_1.png, output_2.png and so on (or .pgm with --preview-format pgm). Orientations are rx,ry,rz in
+ * degrees with an optional zoom, separated by ';'.
+ *
+ * With compare, the mesh is voxelized back onto the grid of the given segmentation, which must have the size of
+ * the unscaled input, and the Dice overlap of the two is printed for quality control.
+ *
+ * The adaptive extractor merges cells wherever the surface stays within tolerance voxels of a single vertex,
+ * 0.1 by default.
+ *
+ * Every job meshes on a task scheduler of its own threads. With --pin, those threads are bound to the NUMA nodes
+ * of the machine, spread over them, and steal work within their node first.
+ *
+ * With --stream, jobs the streaming mesher handles (marching cubes of a NIfTI file without mask, scaling,
+ * smoothing, optimization, comparison or views, into binary STL) are read, extracted and written a slab at a time
+ * with the three overlapping, in memory that does not grow with the volume. Their meshes are not welded, so no
+ * vertex count or metrics are printed for them.
+ *
+ * With --cache, extracted meshes are kept in the given directory and jobs whose input and parameters did not
+ * change since a previous run are read back from it instead of being meshed again.
+ *
+ * Usage: Bial_Render_Batch manifest [--threads N] [--memory MB] [--isolevel L] [--scale S]
+ *                          [--extractor mc] [--smooth N] [--tolerance T] [--optimize] [--bricked] [--ascii]
+ *                          [--cache DIR] [--pin] [--stream]
+ *                          [--views "rx,ry,rz;..."] [--preview WxH] [--preview-format png|pgm]
+ *                          [--profile] [--dry-run]
+ */
+
+namespace {
+
+  /* Volumes below this many voxels are meshed single threaded, as thread start up would dominate. */
+  const size_t voxelsPerThread = 8 * 1024 * 1024;
+
+  struct Options {
+    std::string manifest;
+    size_t threads = 0;
+    size_t memoryMb = 0;
+    bool profile = false;
+    bool dryRun = false;
+    bool ascii = false;
+    bool pin = false;
+    bool stream = false;
+    std::string cacheDir;
+    std::vector< SoftwareRenderer::Camera > views;
+    size_t previewWidth = 256;
+    size_t previewHeight = 256;
+    std::string previewFormat = "png";
+    MeshPipeline::Params defaults;
+  };
+
+  struct Entry {
+    MeshPipeline::Params params;
+    std::string output;
+    /* Threads requested in the manifest; 0 chooses from the volume size. */
+    size_t threads = 0;
+    size_t line = 0;
+    bool ascii = false;
+    /* Segmentation the mesh is compared against, if any. */
+    std::string compare;
+  };
+
+  void Usage( ) {
+    std::fprintf( stderr, "Usage: Bial_Render_Batch manifest [--threads N] [--memory MB] [--isolevel L] "
+                  "[--scale S] [--extractor mc|nets|smooth-nets|dc|adaptive] [--smooth N] [--tolerance T] "
+                  "[--optimize] [--bricked] "
+                  "[--ascii] [--cache DIR] [--pin] [--stream] [--views \"rx,ry,rz;...\"] [--preview WxH] "
+                  "[--preview-format png|pgm] [--profile] [--dry-run]\n" );
+  }
+
+  size_t FileSize( const std::string &fileName ) {
+    struct stat st;
+    return( stat( fileName.c_str( ), &st ) == 0 ? static_cast< size_t >( st.st_size ) : 0 );
+  }
+
+  /* Voxels of the volume after scaling, from its header when it is NIfTI, from the file size otherwise. */
+  size_t ScaledVoxels( const MeshPipeline::Params &params ) {
+    NiftiInfo info;
+    double voxels = info.Read( params.fileName ) ? info.Voxels( ) : FileSize( params.fileName ) / 2.0;
+    return( static_cast< size_t >( voxels * std::pow( std::max( params.scale, 1.0f ), 3.0f ) ) );
+  }
+
+  /*
+   * Peak memory estimate of a job: the input and scaled images as int, the same again for the mask, and about
+   * as much again for the extracted and welded mesh.
+   */
+  size_t EstimateMemory( const MeshPipeline::Params &params, size_t voxels ) {
+    size_t images = params.maskFileName.empty( ) ? 1 : 2;
+    return( voxels * sizeof( int ) * ( 2 * images + 1 ) );
+  }
+
+  bool ParseEntry( const std::string &line, const Options &opt, Entry &entry, std::string &error ) {
+    std::istringstream in( line );
+    entry.params = opt.defaults;
+    entry.ascii = opt.ascii;
+    if( !( in >> entry.params.fileName >> entry.output ) ) {
+      error = "expected an input and an output file";
+      return( false );
+    }
+    std::string option;
+    while( in >> option ) {
+      size_t eq = option.find( '=' );
+      std::string key = option.substr( 0, eq );
+      std::string value = eq == std::string::npos ? std::string( ) : option.substr( eq + 1 );
+      try {
+        if( key == "isolevel" ) {
+          entry.params.isolevel = std::stof( value );
+        }
+        else if( key == "scale" ) {
+          entry.params.scale = std::stof( value );
+        }
+        else if( key == "mask" ) {
+          entry.params.maskFileName = value;
+        }
+        else if( key == "threads" ) {
+          entry.threads = std::stoul( value );
+        }
+        else if( key == "optimize" ) {
+          entry.params.optimize = std::stoi( value ) != 0;
+        }
+        else if( key == "smooth" ) {
+          entry.params.smoothing = std::stoul( value );
+        }
+        else if( key == "tolerance" ) {
+          entry.params.tolerance = std::stof( value );
+        }
+        else if( key == "bricked" ) {
+          entry.params.bricked = std::stoi( value ) != 0;
+        }
+        else if( key == "ascii" ) {
+          entry.ascii = std::stoi( value ) != 0;
+        }
+        else if( key == "compare" ) {
+          entry.compare = value;
+        }
+        else if( key == "extractor" ) {
+          if( !MeshPipeline::ParseExtractor( value, entry.params.extractor ) ) {
+            error = "unknown extractor " + value;
+            return( false );
+          }
+        }
+        else {
+          error = "unknown option " + key;
+          return( false );
+        }
+      }
+      catch( const std::exception& ) {
+        error = "bad value for " + key;
+        return( false );
+      }
+    }
+    return( true );
+  }
+
+  bool ParseArgs( int argc, char **argv, Options &opt ) {
+    for( int arg = 1; arg < argc; ++arg ) {
+      std::string name = argv[ arg ];
+      if( name == "--profile" ) {
+        opt.profile = true;
+        continue;
+      }
+      if( name == "--optimize" ) {
+        opt.defaults.optimize = true;
+        continue;
+      }
+      if( name == "--bricked" ) {
+        opt.defaults.bricked = true;
+        continue;
+      }
+      if( name == "--ascii" ) {
+        opt.ascii = true;
+        continue;
+      }
+      if( name == "--stream" ) {
+        opt.stream = true;
+        continue;
+      }
+      if( name == "--pin" ) {
+        opt.pin = true;
+        continue;
+      }
+      if( name == "--dry-run" ) {
+        opt.dryRun = true;
+        continue;
+      }
+      if( name.compare( 0, 2, "--" ) != 0 ) {
+        if( !opt.manifest.empty( ) ) {
+          return( false );
+        }
+        opt.manifest = name;
+        continue;
+      }
+      if( arg + 1 >= argc ) {
+        return( false );
+      }
+      std::string value = argv[ ++arg ];
+      try {
+        if( name == "--threads" ) {
+          opt.threads = std::stoul( value );
+        }
+        else if( name == "--memory" ) {
+          opt.memoryMb = std::stoul( value );
+        }
+        else if( name == "--isolevel" ) {
+          opt.defaults.isolevel = std::stof( value );
+        }
+        else if( name == "--scale" ) {
+          opt.defaults.scale = std::stof( value );
+        }
+        else if( name == "--smooth" ) {
+          opt.defaults.smoothing = std::stoul( value );
+        }
+        else if( name == "--tolerance" ) {
+          opt.defaults.tolerance = std::stof( value );
+        }
+        else if( name == "--cache" ) {
+          opt.cacheDir = value;
+        }
+        else if( name == "--views" ) {
+          std::istringstream views( value );
+          std::string view;
+          while( std::getline( views, view, ';' ) ) {
+            SoftwareRenderer::Camera camera;
+            if( !SoftwareRenderer::ParseCamera( view, camera ) ) {
+              return( false );
+            }
+            opt.views.push_back( camera );
+          }
+        }
+        else if( name == "--preview" ) {
+          size_t x = value.find( 'x' );
+          if( x == std::string::npos ) {
+            return( false );
+          }
+          opt.previewWidth = std::stoul( value.substr( 0, x ) );
+          opt.previewHeight = std::stoul( value.substr( x + 1 ) );
+          if( opt.previewWidth == 0 || opt.previewHeight == 0 ) {
+            return( false );
+          }
+        }
+        else if( name == "--preview-format" ) {
+          if( value != "png" && value != "pgm" ) {
+            return( false );
+          }
+          opt.previewFormat = value;
+        }
+        else if( name == "--extractor" ) {
+          if( !MeshPipeline::ParseExtractor( value, opt.defaults.extractor ) ) {
+            return( false );
+          }
+        }
+        else {
+          return( false );
+        }
+      }
+      catch( const std::exception& ) {
+        return( false );
+      }
+    }
+    return( !opt.manifest.empty( ) );
+  }
+
+  /* Output without its extension, gzip suffix included. */
+  std::string Stem( const std::string &fileName ) {
+    std::string stem = fileName;
+    if( stem.size( ) > 3 && stem.compare( stem.size( ) - 3, 3, ".gz" ) == 0 ) {
+      stem.resize( stem.size( ) - 3 );
+    }
+    size_t dot = stem.rfind( '.' );
+    size_t slash = stem.rfind( '/' );
+    if( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) ) {
+      stem.resize( dot );
+    }
+    return( stem );
+  }
+
+  /* Whether the job is meshed by MeshStream: nothing it asks for needs the whole mesh in memory. */
+  bool Streams( const Entry &entry, const Options &opt ) {
+    return( opt.stream && !entry.ascii && entry.compare.empty( ) && opt.views.empty( ) && opt.cacheDir.empty( ) &&
+            MeshStream::CanStream( entry.params, entry.output ) );
+  }
+
+  int StreamJob( const Entry &entry, const Options &opt ) {
+    MeshStream::Statistics stats;
+    const size_t triangles = MeshStream::Run( entry.params, entry.output, MeshStream::Params( ), &stats );
+    if( triangles == 0 ) {
+      std::remove( entry.output.c_str( ) );
+      std::fprintf( stderr, "%s: no surface at isolevel %g\n", entry.params.fileName.c_str( ),
+                    entry.params.isolevel );
+      return( 2 );
+    }
+    std::printf( "%s: %zu triangles streamed in %zu slabs, reading %.2f s, extracting %.2f s, writing %.2f s\n",
+                 entry.output.c_str( ), triangles, stats.slabs, stats.readSeconds, stats.extractSeconds,
+                 stats.writeSeconds );
+    if( opt.profile ) {
+      std::printf( "%s", Profiler::instance( ).Summary( ).c_str( ) );
+    }
+    return( 0 );
+  }
+
+  int RunJob( const Entry &entry, const Options &opt ) {
+    Profiler::instance( ).setEnabled( opt.profile );
+    /* The parent never starts the scheduler, so each child starts its own workers, as many as the job was given. */
+    TaskScheduler::Params scheduling;
+    scheduling.threads = entry.params.threads;
+    scheduling.pin = opt.pin;
+    TaskScheduler::Configure( scheduling );
+    if( Streams( entry, opt ) ) {
+      return( StreamJob( entry, opt ) );
+    }
+    /* Each job runs in its own process, so only the on-disk part of the cache is of use. */
+    PipelineCache cache( 0 );
+    cache.setDirectory( opt.cacheDir );
+    std::unique_ptr< MeshData > mesh = cache.Run( entry.params );
+    if( !mesh ) {
+      std::fprintf( stderr, "%s: no surface at isolevel %g\n", entry.params.fileName.c_str( ),
+                    entry.params.isolevel );
+      return( 2 );
+    }
+    if( entry.output.size( ) > 5 && entry.output.compare( entry.output.size( ) - 5, 5, ".bmsh" ) == 0 ) {
+      PROFILE_SCOPE( "WriteMesh" );
+      MeshIO::WriteMesh( *mesh, entry.output );
+    }
+    else if( entry.ascii ) {
+      PROFILE_SCOPE( "WriteSTLA" );
+      MeshIO::WriteSTLA( *mesh, entry.output, entry.params.threads );
+    }
+    else {
+      PROFILE_SCOPE( "WriteSTLB" );
+      MeshIO::WriteSTLB( *mesh, entry.output );
+    }
+    const MeshMetrics::Report metrics = MeshMetrics::Compute( *mesh, entry.params.threads );
+    std::printf( "%s: %zu triangles, %zu vertices, area %g, volume %g, %zu components\n", entry.output.c_str( ),
+                 mesh->Triangles( ), mesh->Vertices( ), metrics.total.area, metrics.total.volume,
+                 metrics.components.size( ) );
+    if( !entry.compare.empty( ) ) {
+      PROFILE_SCOPE( "Compare" );
+      Image< int > reference = File::Read< int >( entry.compare );
+      MeshVoxelizer::Grid grid;
+      grid.spacing = entry.params.scale;
+      for( size_t axis = 0; axis < 3; ++axis ) {
+        grid.size[ axis ] = reference.size( axis );
+      }
+      Image< int > occupancy = MeshVoxelizer::Occupancy( *mesh, grid, 1, entry.params.threads );
+      size_t both = 0, total = 0;
+      for( size_t voxel = 0; voxel < reference.Size( ); ++voxel ) {
+        both += reference[ voxel ] > 0 && occupancy[ voxel ] > 0;
+        total += ( reference[ voxel ] > 0 ) + occupancy[ voxel ];
+      }
+      std::printf( "%s: Dice %.4f against %s\n", entry.output.c_str( ), total > 0 ? 2.0 * both / total : 1.0,
+                   entry.compare.c_str( ) );
+    }
+    for( size_t view = 0; view < opt.views.size( ); ++view ) {
+      SoftwareRenderer::Frame frame = SoftwareRenderer::Render( *mesh, opt.views[ view ], opt.previewWidth,
+                                                                opt.previewHeight, entry.params.threads );
+      const std::string preview = Stem( entry.output ) + "_" + std::to_string( view + 1 ) + "." + opt.previewFormat;
+      PROFILE_SCOPE( "Write preview" );
+      SoftwareRenderer::Write( frame, preview );
+    }
+    if( opt.profile ) {
+      std::printf( "%s", Profiler::instance( ).Summary( ).c_str( ) );
+    }
+    return( 0 );
+  }
+
+}
+
+int main( int argc, char **argv ) {
+  Options opt;
+  if( !ParseArgs( argc, argv, opt ) ) {
+    Usage( );
+    return( 1 );
+  }
+  std::ifstream manifest( opt.manifest );
+  if( !manifest ) {
+    std::fprintf( stderr, "Could not open %s.\n", opt.manifest.c_str( ) );
+    return( 1 );
+  }
+  std::vector< Entry > entries;
+  std::string line;
+  size_t lineNumber = 0;
+  bool valid = true;
+  while( std::getline( manifest, line ) ) {
+    ++lineNumber;
+    line = line.substr( 0, line.find( '#' ) );
+    if( line.find_first_not_of( " \t\r" ) == std::string::npos ) {
+      continue;
+    }
+    Entry entry;
+    std::string error;
+    if( !ParseEntry( line, opt, entry, error ) ) {
+      std::fprintf( stderr, "%s:%zu: %s\n", opt.manifest.c_str( ), lineNumber, error.c_str( ) );
+      valid = false;
+      continue;
+    }
+    entry.line = lineNumber;
+    entries.push_back( entry );
+  }
+  if( !valid ) {
+    return( 1 );
+  }
+  const size_t threads = opt.threads > 0 ? opt.threads : std::max( 1u, std::thread::hardware_concurrency( ) );
+  JobScheduler scheduler( threads, opt.memoryMb * 1024 * 1024 );
+  for( Entry &entry : entries ) {
+    const size_t voxels = ScaledVoxels( entry.params );
+    JobScheduler::Job job;
+    job.name = entry.params.fileName;
+    job.threads = entry.threads > 0 ? entry.threads : std::max< size_t >( 1, voxels / voxelsPerThread );
+    job.memory = Streams( entry, opt ) ? MeshStream::Memory( entry.params, MeshStream::Params( ) )
+                                       : EstimateMemory( entry.params, voxels );
+    entry.params.threads = std::min( job.threads, threads );
+    std::printf( "%-40s %3zu threads %8.1f MB\n", job.name.c_str( ), entry.params.threads,
+                 job.memory / ( 1024.0 * 1024.0 ) );
+    const Entry copy = entry;
+    job.run = [ copy, &opt ]( ) {
+      return( RunJob( copy, opt ) );
+    };
+    scheduler.Add( job );
+  }
+  if( opt.dryRun ) {
+    return( 0 );
+  }
+  if( !opt.cacheDir.empty( ) && mkdir( opt.cacheDir.c_str( ), 0755 ) != 0 && errno != EEXIST ) {
+    std::fprintf( stderr, "Could not create %s.\n", opt.cacheDir.c_str( ) );
+    return( 1 );
+  }
+  auto start = std::chrono::steady_clock::now( );
+  size_t failed = scheduler.Run( [ ]( const JobScheduler::Result &res ) {
+    std::printf( "[%s] %s (%.2f s)\n", res.status == 0 ? "done" : "FAILED", res.name.c_str( ), res.seconds );
+    std::fflush( stdout );
+  } );
+  double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now( ) - start ).count( );
+  std::printf( "%zu of %zu jobs succeeded in %.2f s.\n", entries.size( ) - failed, entries.size( ), seconds );
+  return( failed == 0 ? 0 : 1 );
+}
@@ -0,0 +1,15 @@
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle qt
+TARGET = Bial_Render_Bench
+TEMPLATE = app
+
+include(../../bial/bial.pri)
+include(../OpenGLView/core.pri)
+
+SOURCES += \
+    main.cpp \
+    volumegenerator.cpp
+
+HEADERS += \
+    volumegenerator.h
@@ -0,0 +1,615 @@
+#include "volumegenerator.h"
+
+#include <Draw.hpp>
+#include <Geometrics.hpp>
+#include <MarchingCubes.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "adaptivecontouring.h"
+#include "brickedvolume.h"
+#include "mappedvolume.h"
+#include "meshio.h"
+#include "meshmetrics.h"
+#include "meshoptimizer.h"
+#include "meshsmoother.h"
+#include "meshstream.h"
+#include "meshsink.h"
+#include "meshvoxelizer.h"
+#include "meshwelder.h"
+#include "parallel.h"
+#include "slicecontours.h"
+#include "softwarerenderer.h"
+#include "surfacenets.h"
+#include "taskscheduler.h"
+
+using namespace Bial;
+
+/*
+ * Throughput benchmarks for the extraction, welding, I/O, reslicing and scaling hot paths on synthetic volumes.
+ * Every case runs in a forked child that generates its own volume, so the reported peak RSS is that of the case and
+ * its input, not of volumes the parent or earlier cases held.
+ *
+ * Usage: Bial_Render_Bench [--volumes sphere,gyroid,noise] [--sizes 128,256] [--threads 1,2,4]
+ *                          [--repeat 3] [--only substring] [--json results.json] [--tmp /tmp]
+ */
+
+namespace {
+
+  const float isolevel = 500.0f;
+
+  struct Sample {
+    double seconds = 0.0;
+    size_t voxels = 0;
+    size_t triangles = 0;
+  };
+
+  struct Case {
+    std::string name;
+    bool threaded;
+    std::function< Sample( const Image< int >&, size_t ) > run;
+  };
+
+  struct Result {
+    std::string name, volume;
+    size_t size = 0, threads = 1;
+    Sample sample;
+    long peakRssKb = 0;
+  };
+
+  struct Options {
+    Vector< std::string > volumes = { "sphere", "gyroid", "noise" };
+    Vector< size_t > sizes = { 128, 256 };
+    Vector< size_t > threads;
+    size_t repeat = 3;
+    std::string only, json, tmp = "/tmp";
+  };
+
+  double Seconds( std::chrono::steady_clock::time_point start ) {
+    return( std::chrono::duration< double >( std::chrono::steady_clock::now( ) - start ).count( ) );
+  }
+
+  Vector< std::string > Split( const std::string &str ) {
+    Vector< std::string > res;
+    std::stringstream ss( str );
+    std::string item;
+    while( std::getline( ss, item, ',' ) ) {
+      if( !item.empty( ) ) {
+        res.push_back( item );
+      }
+    }
+    return( res );
+  }
+
+  Vector< size_t > SplitSizes( const std::string &str ) {
+    Vector< size_t > res;
+    for( const std::string &item : Split( str ) ) {
+      res.push_back( std::stoul( item ) );
+    }
+    return( res );
+  }
+
+  std::unique_ptr< MeshData > Soup( const Image< int > &img ) {
+    MeshSink sink;
+    MeshSink::ExtractMarchingCubes( img, isolevel, sink );
+    return( sink.Take( ) );
+  }
+
+  size_t Voxels( const Image< int > &img ) {
+    return( img.size( 0 ) * img.size( 1 ) * img.size( 2 ) );
+  }
+
+  Vector< Case > Cases( const Options &opt ) {
+    Vector< Case > cases;
+    cases.push_back( Case{ "MarchingCubes::exec", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      std::unique_ptr< TriangleMesh > mesh( MarchingCubes::exec( img, isolevel ) );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      res.triangles = mesh ? mesh->getNtris( ) : 0;
+      return( res );
+    } } );
+    cases.push_back( Case{ "MarchingCubes::Binary", false, [ ]( const Image< int > &img, size_t ) {
+      Image< int > mask( img.size( 0 ), img.size( 1 ), img.size( 2 ) );
+      for( size_t pxl = 0; pxl < Voxels( img ); ++pxl ) {
+        mask[ pxl ] = img[ pxl ] >= isolevel ? 1 : 0;
+      }
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      std::unique_ptr< TriangleMesh > mesh( MarchingCubes::Binary( img, mask, isolevel ) );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      res.triangles = mesh ? mesh->getNtris( ) : 0;
+      return( res );
+    } } );
+    /* Independent z slabs, one sink per thread. */
+    cases.push_back( Case{ "ExtractMarchingCubes", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      std::vector< MeshSink > sinks( threads );
+      auto start = std::chrono::steady_clock::now( );
+      ParallelRanges( 0, img.size( 2 ) - 1, threads, [ & ]( size_t first, size_t last, size_t part ) {
+        MeshSink::ExtractMarchingCubes( img, isolevel, sinks[ part ], first, last );
+      } );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      for( MeshSink &sink : sinks ) {
+        res.triangles += sink.Triangles( );
+      }
+      return( res );
+    } } );
+    cases.push_back( Case{ "BrickedVolume", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      BrickedVolume vol( img, threads );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    /* Contiguous runs of the brick Z order, one sink per thread; the conversion is not timed. */
+    cases.push_back( Case{ "ExtractMarchingCubes bricked", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      BrickedVolume vol( img, threads );
+      std::vector< MeshSink > sinks( threads );
+      auto start = std::chrono::steady_clock::now( );
+      ParallelRanges( 0, vol.Bricks( ), threads, [ & ]( size_t first, size_t last, size_t part ) {
+        BrickedVolume::ExtractMarchingCubes( vol, isolevel, sinks[ part ], first, last );
+      } );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      for( MeshSink &sink : sinks ) {
+        res.triangles += sink.Triangles( );
+      }
+      return( res );
+    } } );
+    cases.push_back( Case{ "VolumeStatistics", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      VolumeStatistics stats( img, 1024, threads );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    /* Skips the blocks the surface cannot cross; the statistics are not timed. */
+    cases.push_back( Case{ "ExtractMarchingCubes skipping", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      VolumeStatistics stats( img );
+      MeshSink sink;
+      auto start = std::chrono::steady_clock::now( );
+      MeshSink::ExtractMarchingCubes( img, isolevel, sink, 0, img.size( 2 ), &stats );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      res.triangles = sink.Triangles( );
+      return( res );
+    } } );
+    const std::pair< const char*, SurfaceNets::Mode > nets[ ] = {
+      { "SurfaceNets", SurfaceNets::Mode::Naive }, { "DualContouring", SurfaceNets::Mode::DualContouring }
+    };
+    for( auto &net : nets ) {
+      SurfaceNets::Mode mode = net.second;
+      cases.push_back( Case{ net.first, false, [ mode ]( const Image< int > &img, size_t ) {
+        Sample res;
+        MeshSink sink;
+        auto start = std::chrono::steady_clock::now( );
+        SurfaceNets::exec( img, isolevel, sink, mode );
+        res.seconds = Seconds( start );
+        res.voxels = Voxels( img );
+        res.triangles = sink.Triangles( );
+        return( res );
+      } } );
+    }
+    cases.push_back( Case{ "AdaptiveContouring", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      AdaptiveContouring::Params params;
+      params.threads = threads;
+      MeshSink sink;
+      auto start = std::chrono::steady_clock::now( );
+      AdaptiveContouring::exec( img, isolevel, sink, params );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      res.triangles = sink.Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "SimplifyMesh", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      std::unique_ptr< MeshData > mesh = Soup( img );
+      auto start = std::chrono::steady_clock::now( );
+      MeshWelder::SimplifyMesh( mesh->tris, mesh->n, mesh->p );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshOptimizer::Optimize", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      auto start = std::chrono::steady_clock::now( );
+      MeshOptimizer::Optimize( *mesh );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshSmoother::Taubin", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      MeshSmoother::Params params;
+      params.threads = threads;
+      auto start = std::chrono::steady_clock::now( );
+      MeshSmoother::Taubin( *mesh, params );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "SoftwareRenderer::Render", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      SoftwareRenderer::Camera camera;
+      camera.rotateX = 30.0;
+      camera.rotateY = 40.0;
+      auto start = std::chrono::steady_clock::now( );
+      SoftwareRenderer::Render( *mesh, camera, 1024, 1024, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshMetrics::Compute", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      auto start = std::chrono::steady_clock::now( );
+      MeshMetrics::Compute( *mesh, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshVoxelizer::Occupancy", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      MeshVoxelizer::Grid grid = MeshVoxelizer::Fit( *mesh, 1.0 );
+      auto start = std::chrono::steady_clock::now( );
+      MeshVoxelizer::Occupancy( *mesh, grid, 1, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshVoxelizer::Distance", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      MeshVoxelizer::Grid grid = MeshVoxelizer::Fit( *mesh, 1.0, 3 );
+      auto start = std::chrono::steady_clock::now( );
+      MeshVoxelizer::Distance( *mesh, grid, 3.0, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "SliceContours::Stack axial", true, [ ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      SliceContours::Stack( img, SliceContours::Axis::Z, isolevel, threads );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    const std::string stlFile = opt.tmp + "/bial_render_bench.stl";
+    cases.push_back( Case{ "TriangleMesh::ExportSTLB", false, [ stlFile ]( const Image< int > &img, size_t ) {
+      Sample res;
+      std::unique_ptr< MeshData > data = Soup( img );
+      std::unique_ptr< TriangleMesh > mesh( data->ToTriangleMesh( ) );
+      auto start = std::chrono::steady_clock::now( );
+      mesh->ExportSTLB( stlFile );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->getNtris( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "TriangleMesh::ReadSTLB", false, [ stlFile ]( const Image< int > &img, size_t ) {
+      Sample res;
+      MeshIO::WriteSTLB( *Soup( img ), stlFile );
+      auto start = std::chrono::steady_clock::now( );
+      std::unique_ptr< TriangleMesh > mesh( TriangleMesh::ReadSTLB( stlFile ) );
+      res.seconds = Seconds( start );
+      res.triangles = mesh ? mesh->getNtris( ) : 0;
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshIO::WriteSTLB", false, [ stlFile ]( const Image< int > &img, size_t ) {
+      Sample res;
+      std::unique_ptr< MeshData > mesh = Soup( img );
+      auto start = std::chrono::steady_clock::now( );
+      MeshIO::WriteSTLB( *mesh, stlFile );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    const std::string meshFile = opt.tmp + "/bial_render_bench.bmsh";
+    cases.push_back( Case{ "MeshIO::WriteMesh", false, [ meshFile ]( const Image< int > &img, size_t ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      MeshOptimizer::Optimize( *mesh );
+      auto start = std::chrono::steady_clock::now( );
+      MeshIO::WriteMesh( *mesh, meshFile );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshIO::ReadMesh", true, [ meshFile ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshSink sink;
+      SurfaceNets::exec( img, isolevel, sink );
+      std::unique_ptr< MeshData > mesh = sink.Take( );
+      MeshOptimizer::Optimize( *mesh );
+      MeshIO::WriteMesh( *mesh, meshFile );
+      auto start = std::chrono::steady_clock::now( );
+      mesh = MeshIO::ReadMesh( meshFile, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshIO::WriteSTLA", true, [ stlFile ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      std::unique_ptr< MeshData > mesh = Soup( img );
+      auto start = std::chrono::steady_clock::now( );
+      MeshIO::WriteSTLA( *mesh, stlFile, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MeshIO::ReadSTLA", true, [ stlFile ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      MeshIO::WriteSTLA( *Soup( img ), stlFile, threads );
+      auto start = std::chrono::steady_clock::now( );
+      std::unique_ptr< MeshData > mesh = MeshIO::ReadSTLA( stlFile, threads );
+      res.seconds = Seconds( start );
+      res.triangles = mesh->Triangles( );
+      return( res );
+    } } );
+    /* Axial reslice of every plane, as in TestGeometrics::testImageTransform. */
+    const std::string niftiFile = opt.tmp + "/bial_render_bench.nii";
+    cases.push_back( Case{ "File::Read nii", false, [ niftiFile ]( const Image< int > &img, size_t ) {
+      Sample res;
+      File::Write( img, niftiFile );
+      auto start = std::chrono::steady_clock::now( );
+      Image< int > read = File::Read< int >( niftiFile );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( read );
+      return( res );
+    } } );
+    cases.push_back( Case{ "MappedVolume::ToImage", true, [ niftiFile ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      File::Write( img, niftiFile );
+      auto start = std::chrono::steady_clock::now( );
+      Image< int > read = MappedVolume( niftiFile ).ToImage( threads );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( read );
+      return( res );
+    } } );
+    /* Read, extract and write overlapped a slab at a time; the first pass for the maximum is timed too. */
+    cases.push_back( Case{ "MeshStream", true, [ niftiFile, stlFile ]( const Image< int > &img, size_t threads ) {
+      Sample res;
+      File::Write( img, niftiFile );
+      MeshPipeline::Params params;
+      params.fileName = niftiFile;
+      params.isolevel = isolevel / std::max( 1, *std::max_element( &img[ 0 ], &img[ 0 ] + Voxels( img ) ) );
+      params.threads = threads;
+      auto start = std::chrono::steady_clock::now( );
+      res.triangles = MeshStream::Run( params, stlFile, MeshStream::Params( ) );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    cases.push_back( Case{ "Reslice axial", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      FastTransform axialTransform;
+      axialTransform.Rotate( 90.0, FastTransform::X ).Rotate( 90.0, FastTransform::Y );
+      Point3D first, last( img.size( 0 ), img.size( 1 ), img.size( 2 ) );
+      axialTransform( first, &first );
+      axialTransform( last, &last );
+      BBox box( first, last );
+      axialTransform = axialTransform.Inverse( );
+      axialTransform.Translate( box.pMin.x, box.pMin.y, box.pMin.z );
+      box = box.Normalized( );
+      Image< int > axial( ( size_t ) std::abs( std::round( box.pMax.x ) ),
+                          ( size_t ) std::abs( std::round( box.pMax.y ) ) );
+      for( size_t z = 0; z < ( size_t ) std::abs( std::round( box.pMax.z ) ); ++z ) {
+        for( size_t y = 0; y < axial.size( 1 ); ++y ) {
+          for( size_t x = 0; x < axial.size( 0 ); ++x ) {
+            Point3D pos = axialTransform( Point3D( x, y, z ) );
+            if( img.ValidPixel( pos.x, pos.y, pos.z ) ) {
+              axial( x, y ) = img( pos.x, pos.y, pos.z );
+            }
+          }
+        }
+      }
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    cases.push_back( Case{ "Reslice axial bricked", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      BrickedVolume vol( img );
+      auto start = std::chrono::steady_clock::now( );
+      FastTransform axialTransform;
+      axialTransform.Rotate( 90.0, FastTransform::X ).Rotate( 90.0, FastTransform::Y );
+      Point3D first, last( img.size( 0 ), img.size( 1 ), img.size( 2 ) );
+      axialTransform( first, &first );
+      axialTransform( last, &last );
+      BBox box( first, last );
+      axialTransform = axialTransform.Inverse( );
+      axialTransform.Translate( box.pMin.x, box.pMin.y, box.pMin.z );
+      box = box.Normalized( );
+      Image< int > axial = vol.Reslice( axialTransform, ( size_t ) std::abs( std::round( box.pMax.x ) ),
+                                        ( size_t ) std::abs( std::round( box.pMax.y ) ),
+                                        ( size_t ) std::abs( std::round( box.pMax.z ) ) );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    cases.push_back( Case{ "Geometrics::Scale 0.5", false, [ ]( const Image< int > &img, size_t ) {
+      Sample res;
+      auto start = std::chrono::steady_clock::now( );
+      Image< int > scaled = Geometrics::Scale( img, 0.5, true );
+      res.seconds = Seconds( start );
+      res.voxels = Voxels( img );
+      return( res );
+    } } );
+    return( cases );
+  }
+
+  /* Runs the case on a volume generated in a child process. Returns false if the child failed. */
+  bool RunIsolated( const Case &cs, const std::string &volume, size_t size, size_t threads, size_t repeat,
+                    Result &result ) {
+    int fds[ 2 ];
+    if( pipe( fds ) != 0 ) {
+      return( false );
+    }
+    pid_t pid = fork( );
+    if( pid == 0 ) {
+      close( fds[ 0 ] );
+      /* The scheduler of the child gets exactly the threads measured. */
+      TaskScheduler::Params scheduling;
+      scheduling.threads = threads;
+      TaskScheduler::Configure( scheduling );
+      Sample best;
+      best.seconds = -1.0;
+      try {
+        const Image< int > img = VolumeGenerator::Generate( volume, size );
+        for( size_t rep = 0; rep < repeat; ++rep ) {
+          Sample smp = cs.run( img, threads );
+          if( best.seconds < 0.0 || smp.seconds < best.seconds ) {
+            best = smp;
+          }
+        }
+      }
+      catch( const std::exception &e ) {
+        std::cerr << e.what( ) << std::endl;
+        _exit( 1 );
+      }
+      struct rusage usage;
+      getrusage( RUSAGE_SELF, &usage );
+      long rss = usage.ru_maxrss;
+      ssize_t ok = write( fds[ 1 ], &best, sizeof( best ) ) + write( fds[ 1 ], &rss, sizeof( rss ) );
+      _exit( ok == static_cast< ssize_t >( sizeof( best ) + sizeof( rss ) ) ? 0 : 1 );
+    }
+    close( fds[ 1 ] );
+    bool ok = pid > 0 &&
+              read( fds[ 0 ], &result.sample, sizeof( result.sample ) ) == sizeof( result.sample ) &&
+              read( fds[ 0 ], &result.peakRssKb, sizeof( result.peakRssKb ) ) == sizeof( result.peakRssKb );
+    close( fds[ 0 ] );
+    int status = 0;
+    if( pid > 0 ) {
+      waitpid( pid, &status, 0 );
+    }
+    return( ok && WIFEXITED( status ) && WEXITSTATUS( status ) == 0 );
+  }
+
+  void WriteJson( const Vector< Result > &results, const std::string &fileName ) {
+    std::ofstream file( fileName );
+    file << "[\n";
+    for( size_t res = 0; res < results.size( ); ++res ) {
+      const Result &r = results[ res ];
+      file << "  {\"case\":\"" << r.name << "\",\"volume\":\"" << r.volume << "\",\"size\":" << r.size
+           << ",\"threads\":" << r.threads << ",\"seconds\":" << r.sample.seconds
+           << ",\"voxels\":" << r.sample.voxels << ",\"triangles\":" << r.sample.triangles
+           << ",\"peak_rss_kb\":" << r.peakRssKb << "}" << ( res + 1 < results.size( ) ? "," : "" ) << "\n";
+    }
+    file << "]\n";
+  }
+
+}
+
+int main( int argc, char **argv ) {
+  Options opt;
+  const size_t hw = std::max( 1u, std::thread::hardware_concurrency( ) );
+  for( size_t thd = 1; thd < hw; thd *= 2 ) {
+    opt.threads.push_back( thd );
+  }
+  opt.threads.push_back( hw );
+  for( int arg = 1; arg + 1 < argc; arg += 2 ) {
+    std::string key = argv[ arg ], val = argv[ arg + 1 ];
+    if( key == "--volumes" ) {
+      opt.volumes = Split( val );
+    }
+    else if( key == "--sizes" ) {
+      opt.sizes = SplitSizes( val );
+    }
+    else if( key == "--threads" ) {
+      opt.threads = SplitSizes( val );
+    }
+    else if( key == "--repeat" ) {
+      opt.repeat = std::max< size_t >( 1, std::stoul( val ) );
+    }
+    else if( key == "--only" ) {
+      opt.only = val;
+    }
+    else if( key == "--json" ) {
+      opt.json = val;
+    }
+    else if( key == "--tmp" ) {
+      opt.tmp = val;
+    }
+    else {
+      std::cerr << "Unknown option " << key << std::endl;
+      return( 1 );
+    }
+  }
+  Vector< Case > cases = Cases( opt );
+  Vector< Result > results;
+  std::printf( "%-26s %-7s %5s %4s %10s %12s %12s %8s %10s\n", "case", "volume", "size", "thds", "ms",
+               "Mvoxels/s", "Mtris/s", "speedup", "peak MB" );
+  for( const std::string &volume : opt.volumes ) {
+    for( size_t size : opt.sizes ) {
+      for( const Case &cs : cases ) {
+        if( !opt.only.empty( ) && cs.name.find( opt.only ) == std::string::npos ) {
+          continue;
+        }
+        double serial = 0.0;
+        Vector< size_t > threadCounts = cs.threaded ? opt.threads : Vector< size_t >( 1, 1 );
+        for( size_t threads : threadCounts ) {
+          Result res;
+          res.name = cs.name;
+          res.volume = volume;
+          res.size = size;
+          res.threads = threads;
+          if( !RunIsolated( cs, volume, size, threads, opt.repeat, res ) ) {
+            std::printf( "%-26s %-7s %5zu %4zu failed\n", cs.name.c_str( ), volume.c_str( ), size, threads );
+            continue;
+          }
+          const double secs = std::max( res.sample.seconds, 1e-9 );
+          if( threads == threadCounts.front( ) ) {
+            serial = secs;
+          }
+          std::printf( "%-26s %-7s %5zu %4zu %10.2f %12.2f %12.2f %8.2f %10.1f\n", cs.name.c_str( ),
+                       volume.c_str( ), size, threads, secs * 1000.0, res.sample.voxels / secs / 1e6,
+                       res.sample.triangles / secs / 1e6, serial / secs, res.peakRssKb / 1024.0 );
+          std::fflush( stdout );
+          results.push_back( res );
+        }
+      }
+    }
+  }
+  if( !opt.json.empty( ) ) {
+    WriteJson( results, opt.json );
+  }
+  return( 0 );
+}
@@ -0,0 +1,81 @@
+#include "volumegenerator.h"
+
+#include <random>
+#include <stdexcept>
+
+Image< int > VolumeGenerator::Sphere( size_t size ) {
+  Image< int > img( size, size, size );
+  const double center = ( size - 1 ) / 2.0, radius = 0.4 * size;
+  for( size_t z = 0; z < size; ++z ) {
+    for( size_t y = 0; y < size; ++y ) {
+      for( size_t x = 0; x < size; ++x ) {
+        double dist = std::sqrt( ( x - center ) * ( x - center ) + ( y - center ) * ( y - center ) +
+                                 ( z - center ) * ( z - center ) );
+        /* Linear ramp of 100 intensity units per voxel across the surface. */
+        img( x, y, z ) = static_cast< int >( std::max( 0.0, std::min( 1000.0, 500.0 + 100.0 * ( radius - dist ) ) ) );
+      }
+    }
+  }
+  return( img );
+}
+
+Image< int > VolumeGenerator::Gyroid( size_t size, double periods ) {
+  Image< int > img( size, size, size );
+  const double freq = 2.0 * M_PI * periods / size;
+  for( size_t z = 0; z < size; ++z ) {
+    for( size_t y = 0; y < size; ++y ) {
+      for( size_t x = 0; x < size; ++x ) {
+        double val = std::sin( x * freq ) * std::cos( y * freq ) + std::sin( y * freq ) * std::cos( z * freq ) +
+                     std::sin( z * freq ) * std::cos( x * freq );
+        img( x, y, z ) = static_cast< int >( 500.0 + 333.0 * val / 1.5 );
+      }
+    }
+  }
+  return( img );
+}
+
+Image< int > VolumeGenerator::Noise( size_t size, uint32_t seed, size_t cell ) {
+  const size_t lattice = size / cell + 2;
+  std::mt19937 rng( seed );
+  std::uniform_real_distribution< double > dist( 0.0, 1000.0 );
+  Vector< double > knots( lattice * lattice * lattice );
+  for( size_t k = 0; k < knots.size( ); ++k ) {
+    knots[ k ] = dist( rng );
+  }
+  auto knot = [ & ]( size_t x, size_t y, size_t z ) {
+    return( knots[ x + lattice * ( y + lattice * z ) ] );
+  };
+  Image< int > img( size, size, size );
+  for( size_t z = 0; z < size; ++z ) {
+    size_t kz = z / cell;
+    double fz = static_cast< double >( z % cell ) / cell;
+    for( size_t y = 0; y < size; ++y ) {
+      size_t ky = y / cell;
+      double fy = static_cast< double >( y % cell ) / cell;
+      for( size_t x = 0; x < size; ++x ) {
+        size_t kx = x / cell;
+        double fx = static_cast< double >( x % cell ) / cell;
+        double val = 0.0;
+        for( size_t c = 0; c < 8; ++c ) {
+          double w = ( ( c & 1 ) ? fx : 1.0 - fx ) * ( ( c & 2 ) ? fy : 1.0 - fy ) * ( ( c & 4 ) ? fz : 1.0 - fz );
+          val += w * knot( kx + ( c & 1 ), ky + ( ( c >> 1 ) & 1 ), kz + ( ( c >> 2 ) & 1 ) );
+        }
+        img( x, y, z ) = static_cast< int >( val );
+      }
+    }
+  }
+  return( img );
+}
+
+Image< int > VolumeGenerator::Generate( const std::string &name, size_t size ) {
+  if( name == "sphere" ) {
+    return( Sphere( size ) );
+  }
+  if( name == "gyroid" ) {
+    return( Gyroid( size ) );
+  }
+  if( name == "noise" ) {
+    return( Noise( size ) );
+  }
+  throw std::runtime_error( "Unknown volume " + name + "." );
+}
@@ -0,0 +1,26 @@
+#ifndef VOLUMEGENERATOR_H
+#define VOLUMEGENERATOR_H
+
+#include <Common.hpp>
+#include <cstdint>
+#include <string>
+
+using namespace Bial;
+
+/**
+ * Deterministic synthetic volumes for the benchmarks. Intensities range from 0 to 1000, and the surfaces of
+ * interest are at isolevel 500.
+ */
+class VolumeGenerator {
+public:
+  /* Single ball of radius 0.4 * size. */
+  static Image< int > Sphere( size_t size );
+  /* Gyroid with the given number of periods along each axis; a dense, genus heavy surface. */
+  static Image< int > Gyroid( size_t size, double periods = 4.0 );
+  /* Smooth value noise on a lattice of cell voxels, seeded. Many small components. */
+  static Image< int > Noise( size_t size, uint32_t seed = 1, size_t cell = 8 );
+  /* One of "sphere", "gyroid" or "noise". */
+  static Image< int > Generate( const std::string &name, size_t size );
+};
+
+#endif /* VOLUMEGENERATOR_H */
@@ -1,5 +1,7 @@
 TEMPLATE = subdirs
 CONFIG+=ordered
 SUBDIRS = test \
+    bench \
+    batch \
     OpenGLView
 
@@ -3,6 +3,7 @@ TARGET = Bial_Render_Test
 CONFIG += console
 
 include(../../bial/bial.pri)
+include(../OpenGLView/core.pri)
 
 
 SOURCES += \
@@ -4,12 +4,136 @@
 #include <Draw.hpp>
 #include <MarchingCubes.hpp>
 #include <QProcess>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <set>
+#include <zlib.h>
+
+#include "adaptivecontouring.h"
+#include "brickedvolume.h"
+#include "cubekernels.h"
+#include "mappedvolume.h"
+#include "meshclusters.h"
+#include "meshio.h"
+#include "meshmetrics.h"
+#include "meshoptimizer.h"
+#include "meshsink.h"
+#include "meshsmoother.h"
+#include "meshstream.h"
+#include "meshvoxelizer.h"
+#include "meshwelder.h"
+#include "parallel.h"
+#include "slicecontours.h"
+#include "slicereader.h"
+#include "softwarerenderer.h"
+#include "surfacenets.h"
+#include "taskscheduler.h"
+#include "timeseries.h"
+#include "volumestatistics.h"
 
 using namespace Bial;
 
+namespace {
+
+  /* Binary ball of a size^3 volume: 100 within squared distance r2 of ( centre, centre, centre ), 0 elsewhere. */
+  Image< int > MakeBall( size_t size, double centre, double r2 ) {
+    Image< int > img( size, size, size );
+    for( size_t z = 0; z < size; ++z ) {
+      for( size_t y = 0; y < size; ++y ) {
+        for( size_t x = 0; x < size; ++x ) {
+          img( x, y, z ) = 100 * ( ( x - centre ) * ( x - centre ) + ( y - centre ) * ( y - centre ) +
+                                   ( z - centre ) * ( z - centre ) < r2 );
+        }
+      }
+    }
+    return( img );
+  }
+
+  /* Appends an axis aligned cube with its lowest corner at ( offset, offset, offset ), wound counterclockwise. */
+  void AddCube( MeshData &mesh, double offset, double size ) {
+    const int faces[ 12 ][ 3 ] = { { 0, 2, 1 }, { 0, 3, 2 }, { 4, 5, 6 }, { 4, 6, 7 }, { 0, 1, 5 }, { 0, 5, 4 },
+                                   { 2, 3, 7 }, { 2, 7, 6 }, { 1, 2, 6 }, { 1, 6, 5 }, { 0, 4, 7 }, { 0, 7, 3 } };
+    const MeshData::Index base = static_cast< MeshData::Index >( mesh.p.size( ) );
+    for( int corner = 0; corner < 8; ++corner ) {
+      double x = ( ( corner + 1 ) >> 1 ) & 1, y = ( corner >> 1 ) & 1, z = corner >> 2;
+      mesh.p.push_back( Point3D( x * size + offset, y * size + offset, z * size + offset ) );
+      mesh.n.push_back( Normal( 0.0, 0.0, 1.0 ) );
+    }
+    for( const int *face : faces ) {
+      for( int k = 0; k < 3; ++k ) {
+        mesh.tris.push_back( base + face[ k ] );
+      }
+    }
+  }
+
+  template< typename T >
+  void Put( std::vector< unsigned char > &bytes, size_t offset, T value, bool swapped ) {
+    unsigned char *dst = &bytes[ offset ];
+    std::memcpy( dst, &value, sizeof( T ) );
+    if( swapped ) {
+      std::reverse( dst, dst + sizeof( T ) );
+    }
+  }
+
+  /* Minimal uncompressed NIfTI-1 file of 16 bit voxels, in the opposite byte order if swapped. */
+  void WriteNifti( const std::string &fileName, const size_t dims[ 3 ], const std::vector< int16_t > &voxels,
+                   bool swapped, size_t frames = 1 ) {
+    std::vector< unsigned char > bytes( 352 + 2 * voxels.size( ), 0 );
+    Put< int32_t >( bytes, 0, 348, swapped );
+    Put< int16_t >( bytes, 40, frames > 1 ? 4 : 3, swapped );
+    for( size_t dim = 0; dim < 3; ++dim ) {
+      Put< int16_t >( bytes, 42 + 2 * dim, static_cast< int16_t >( dims[ dim ] ), swapped );
+      Put< float >( bytes, 80 + 4 * dim, 1.0f, swapped );
+    }
+    Put< int16_t >( bytes, 48, static_cast< int16_t >( frames ), swapped );
+    Put< int16_t >( bytes, 70, 4, swapped );
+    Put< int16_t >( bytes, 72, 16, swapped );
+    Put< float >( bytes, 108, 352.0f, swapped );
+    std::memcpy( &bytes[ 344 ], "n+1", 4 );
+    for( size_t voxel = 0; voxel < voxels.size( ); ++voxel ) {
+      Put< int16_t >( bytes, 352 + 2 * voxel, voxels[ voxel ], swapped );
+    }
+    std::ofstream( fileName, std::ios::binary ).write( reinterpret_cast< const char* >( bytes.data( ) ),
+                                                       bytes.size( ) );
+  }
+
+  /* Signed area enclosed by a closed polyline, positive when counterclockwise. */
+  double Area( const SliceContours::Polyline &line ) {
+    double area = 0.0;
+    for( size_t k = 0; k < line.points.size( ); ++k ) {
+      const std::array< float, 2 > &a = line.points[ k ], &b = line.points[ ( k + 1 ) % line.points.size( ) ];
+      area += ( a[ 0 ] * b[ 1 ] - b[ 0 ] * a[ 1 ] ) / 2.0;
+    }
+    return( area );
+  }
+
+  /* Every directed edge belongs to one triangle and its reverse to another. */
+  bool ClosedAndOriented( const MeshData &mesh ) {
+    std::map< std::pair< size_t, size_t >, int > edges;
+    for( size_t t = 0; t < mesh.tris.size( ); t += 3 ) {
+      for( size_t v = 0; v < 3; ++v ) {
+        ++edges[ std::make_pair( mesh.tris[ t + v ], mesh.tris[ t + ( v + 1 ) % 3 ] ) ];
+      }
+    }
+    for( auto it = edges.begin( ); it != edges.end( ); ++it ) {
+      if( it->second != 1 || edges.count( std::make_pair( it->first.second, it->first.first ) ) != 1 ) {
+        return( false );
+      }
+    }
+    return( true );
+  }
+
+}
+
 void TestMarchingCubes::testMarchingCube( ) {
-  QTime time;
-  time.start( );
   Image<int> img = Geometrics::Scale(File::Read<int>("res/0.nii.gz"),0.25,true);
 //  Image< int > img = File::Read<int>( "res/0.nii.gz" );
 
@@ -18,7 +142,6 @@ void TestMarchingCubes::testMarchingCube( ) {
   // mesh->Print(std::cout);
   // std::cout << std::endl << "STL: " << std::endl;
   // mesh->ExportSTLA(std::cout);
-  time.restart( );
 
   mesh->ExportSTLB( "/tmp/marching2.stl" );
 }
@@ -81,3 +204,881 @@ void TestMarchingCubes::testBoxAdj( ) {
     QCOMPARE( img[ *( itr++ ) ], vtx );
   }
 }
+
+void TestMarchingCubes::testSurfaceNets( ) {
+  Image< int > img = MakeBall( 16, 7.5, 20.25 );
+  std::shared_ptr< TriangleMesh > mesh( SurfaceNets::exec( img, 50.f ) );
+  QVERIFY( mesh != nullptr );
+  const Vector< size_t > &tris = mesh->getVertexIndex( );
+  QVERIFY( tris.size( ) > 0 );
+  QVERIFY( mesh->getP( ).size( ) < tris.size( ) );
+  /* Closed and consistently oriented: every directed edge has exactly one opposite twin. */
+  std::map< std::pair< size_t, size_t >, int > edges;
+  for( size_t t = 0; t < tris.size( ); t += 3 ) {
+    for( size_t v = 0; v < 3; ++v ) {
+      ++edges[ std::make_pair( tris[ t + v ], tris[ t + ( v + 1 ) % 3 ] ) ];
+    }
+  }
+  for( auto it = edges.begin( ); it != edges.end( ); ++it ) {
+    QCOMPARE( it->second, 1 );
+    QVERIFY( edges.count( std::make_pair( it->first.second, it->first.first ) ) == 1 );
+  }
+}
+
+void TestMarchingCubes::testMeshOptimizer( ) {
+  Image< int > img = MakeBall( 32, 15.5, 144.0 );
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  const size_t ntris = mesh->Triangles( );
+  std::multiset< std::array< double, 9 > > before, after;
+  for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+    const Point3D &a = mesh->p[ mesh->tris[ t ] ], &b = mesh->p[ mesh->tris[ t + 1 ] ],
+                  &c = mesh->p[ mesh->tris[ t + 2 ] ];
+    before.insert( { { a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z } } );
+  }
+  double acmr = MeshOptimizer::ACMR( mesh->tris, mesh->Vertices( ) );
+  MeshOptimizer::Optimize( *mesh );
+  QCOMPARE( mesh->Triangles( ), ntris );
+  QVERIFY( MeshOptimizer::ACMR( mesh->tris, mesh->Vertices( ) ) < std::min( acmr, 0.8 ) );
+  /* Same triangles with the same winding, and vertices numbered in first-use order. */
+  MeshData::Index next = 0;
+  for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+    const Point3D &a = mesh->p[ mesh->tris[ t ] ], &b = mesh->p[ mesh->tris[ t + 1 ] ],
+                  &c = mesh->p[ mesh->tris[ t + 2 ] ];
+    after.insert( { { a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z } } );
+    for( size_t v = 0; v < 3; ++v ) {
+      QVERIFY( mesh->tris[ t + v ] <= next );
+      if( mesh->tris[ t + v ] == next ) {
+        ++next;
+      }
+    }
+  }
+  QVERIFY( before == after );
+  QCOMPARE( static_cast< size_t >( next ), mesh->Vertices( ) );
+}
+
+void TestMarchingCubes::testBrickedVolume( ) {
+  /* Sizes that are not multiples of the brick edge, so partial bricks and the border halo are exercised. */
+  Image< int > img( 37, 20, 45 );
+  for( size_t z = 0; z < img.size( 2 ); ++z ) {
+    for( size_t y = 0; y < img.size( 1 ); ++y ) {
+      for( size_t x = 0; x < img.size( 0 ); ++x ) {
+        img( x, y, z ) = static_cast< int >( 100 * ( 9.0 - std::sqrt( ( x - 18.0 ) * ( x - 18.0 ) +
+                                                                       ( y - 9.5 ) * ( y - 9.5 ) +
+                                                                       ( z - 22.0 ) * ( z - 22.0 ) ) ) );
+      }
+    }
+  }
+  BrickedVolume vol( img, 2 );
+  for( size_t z = 0; z < img.size( 2 ); ++z ) {
+    for( size_t y = 0; y < img.size( 1 ); ++y ) {
+      for( size_t x = 0; x < img.size( 0 ); ++x ) {
+        QCOMPARE( vol( x, y, z ), img( x, y, z ) );
+      }
+    }
+  }
+  Image< int > back = vol.ToImage( );
+  for( size_t pxl = 0; pxl < img.size( 0 ) * img.size( 1 ) * img.size( 2 ); ++pxl ) {
+    QCOMPARE( back[ pxl ], img[ pxl ] );
+  }
+  MeshSink flat, bricked;
+  MeshSink::ExtractMarchingCubes( img, 0.f, flat );
+  BrickedVolume::ExtractMarchingCubes( vol, 0.f, bricked, 0, vol.Bricks( ) );
+  QVERIFY( flat.Triangles( ) > 0 );
+  QCOMPARE( bricked.Triangles( ), flat.Triangles( ) );
+  QCOMPARE( bricked.Vertices( ), flat.Vertices( ) );
+  /* One voxel past a multiple of the edge, the last bricks have no cells and no statistics blocks. */
+  Image< int > odd = MakeBall( 17, 8.0, 36.0 );
+  VolumeStatistics stats( odd, 1024, 2 );
+  BrickedVolume oddVol( odd, 2 );
+  MeshSink oddFlat, oddBricked;
+  MeshSink::ExtractMarchingCubes( odd, 50.f, oddFlat );
+  BrickedVolume::ExtractMarchingCubes( oddVol, 50.f, oddBricked, 0, oddVol.Bricks( ), &stats );
+  QVERIFY( oddFlat.Triangles( ) > 0 );
+  QCOMPARE( oddBricked.Triangles( ), oddFlat.Triangles( ) );
+}
+
+void TestMarchingCubes::testMeshSmoother( ) {
+  /* A binary ball: the surface nets mesh is a staircase around a sphere of radius 12. */
+  Image< int > img = MakeBall( 32, 15.5, 144.0 );
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  auto deviation = [ &mesh ]( double &mean ) {
+    std::vector< double > radii;
+    for( const Point3D &pt : mesh->p ) {
+      radii.push_back( std::sqrt( ( pt.x - 15.5 ) * ( pt.x - 15.5 ) + ( pt.y - 15.5 ) * ( pt.y - 15.5 ) +
+                                  ( pt.z - 15.5 ) * ( pt.z - 15.5 ) ) );
+    }
+    mean = std::accumulate( radii.begin( ), radii.end( ), 0.0 ) / radii.size( );
+    double var = 0.0;
+    for( double rad : radii ) {
+      var += ( rad - mean ) * ( rad - mean );
+    }
+    return( std::sqrt( var / radii.size( ) ) );
+  };
+  double before, after;
+  double rough = deviation( before );
+  MeshSmoother::Params params;
+  params.threads = 2;
+  MeshSmoother::Taubin( *mesh, params );
+  QVERIFY( deviation( after ) < 0.8 * rough );
+  /* Taubin smoothing must not shrink the surface noticeably. */
+  QVERIFY( std::abs( after - before ) < 0.1 );
+  QCOMPARE( mesh->n.size( ), mesh->p.size( ) );
+  /* Normals keep following the gradient, into the ball. */
+  for( size_t vtx = 0; vtx < mesh->p.size( ); ++vtx ) {
+    const Point3D &pt = mesh->p[ vtx ];
+    QVERIFY( ( pt.x - 15.5 ) * mesh->n[ vtx ].x + ( pt.y - 15.5 ) * mesh->n[ vtx ].y +
+             ( pt.z - 15.5 ) * mesh->n[ vtx ].z < 0.0 );
+  }
+}
+
+void TestMarchingCubes::testVolumeStatistics( ) {
+  /* Background of 10 with a 20^3 cube of 200 in a volume whose sizes are not multiples of the block edge. */
+  Image< int > img( 50, 40, 35 );
+  for( size_t z = 0; z < img.size( 2 ); ++z ) {
+    for( size_t y = 0; y < img.size( 1 ); ++y ) {
+      for( size_t x = 0; x < img.size( 0 ); ++x ) {
+        img( x, y, z ) = ( x >= 5 && x < 25 && y >= 5 && y < 25 && z >= 5 && z < 25 ) ? 200 : 10;
+      }
+    }
+  }
+  img( 49, 39, 34 ) = -5;
+  VolumeStatistics stats( img, 1024, 2 );
+  QCOMPARE( stats.Minimum( ), -5 );
+  QCOMPARE( stats.Maximum( ), 200 );
+  const double voxels = 50.0 * 40.0 * 35.0;
+  QVERIFY( std::abs( stats.Mean( ) - ( 8000.0 * 200.0 + ( voxels - 8001.0 ) * 10.0 - 5.0 ) / voxels ) < 1e-9 );
+  QCOMPARE( std::accumulate( stats.Histogram( ).begin( ), stats.Histogram( ).end( ), uint64_t( 0 ) ),
+            static_cast< uint64_t >( voxels ) );
+  QCOMPARE( stats.Percentile( 0.5 ), 10 );
+  QCOMPARE( stats.Percentile( 1.0 ), 200 );
+  QVERIFY( stats.OtsuThreshold( ) > 10 && stats.OtsuThreshold( ) <= 200 );
+  /* Skipping blocks must not lose any cell. */
+  QVERIFY( stats.ActiveFraction( 100.f ) < 0.5 );
+  MeshSink full, skipping;
+  MeshSink::ExtractMarchingCubes( img, 100.f, full );
+  MeshSink::ExtractMarchingCubes( img, 100.f, skipping, 0, img.size( 2 ), &stats );
+  QVERIFY( full.Triangles( ) > 0 );
+  QCOMPARE( skipping.Triangles( ), full.Triangles( ) );
+  MeshSink nets, netsSkipping;
+  SurfaceNets::exec( img, 100.f, nets );
+  SurfaceNets::exec( img, 100.f, netsSkipping, SurfaceNets::Mode::Naive, nullptr, &stats );
+  QCOMPARE( netsSkipping.Triangles( ), nets.Triangles( ) );
+}
+
+void TestMarchingCubes::testMeshFile( ) {
+  /* Welded, fetch ordered mesh of a sphere, as extraction produces them. */
+  MeshSink sink;
+  Image< int > img = MakeBall( 40, 19.5, 225.0 );
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  MeshOptimizer::Optimize( *mesh );
+  QVERIFY( mesh->Triangles( ) > 0 );
+
+  QTemporaryDir dir;
+  QVERIFY( dir.isValid( ) );
+  const std::string stlName = dir.filePath( "testmeshfile.stl" ).toStdString( );
+  const std::string exactName = dir.filePath( "testmeshfile.exact.bmsh" ).toStdString( );
+  const std::string compactName = dir.filePath( "testmeshfile.bmsh" ).toStdString( );
+  MeshIO::WriteSTLB( *mesh, stlName );
+  MeshIO::WriteMesh( *mesh, exactName, MeshIO::Precision::Exact );
+  MeshIO::WriteMesh( *mesh, compactName );
+  std::ifstream stl( stlName, std::ios::binary | std::ios::ate );
+  std::ifstream compact( compactName, std::ios::binary | std::ios::ate );
+  QVERIFY( compact.tellg( ) * 3 < stl.tellg( ) );
+
+  std::unique_ptr< MeshData > exact = MeshIO::ReadMesh( exactName, 2 );
+  QVERIFY( exact->tris == mesh->tris );
+  QCOMPARE( exact->n.size( ), mesh->n.size( ) );
+  for( size_t i = 0; i < mesh->p.size( ); ++i ) {
+    QCOMPARE( exact->p[ i ].x, mesh->p[ i ].x );
+    QCOMPARE( exact->p[ i ].y, mesh->p[ i ].y );
+    QCOMPARE( exact->p[ i ].z, mesh->p[ i ].z );
+  }
+  /* Compact positions are within half a step of 1 / 65535 of the extent, normals keep their direction. */
+  std::unique_ptr< MeshData > read = MeshIO::ReadMesh( compactName );
+  QVERIFY( read->tris == mesh->tris );
+  QCOMPARE( read->n.size( ), mesh->n.size( ) );
+  for( size_t i = 0; i < mesh->p.size( ); ++i ) {
+    QVERIFY( ( read->p[ i ] - mesh->p[ i ] ).Length( ) < 1e-3 );
+    const Normal &a = read->n[ i ], &b = mesh->n[ i ];
+    double len = std::sqrt( b.x * b.x + b.y * b.y + b.z * b.z );
+    QVERIFY( len == 0.0 || a.x * b.x + a.y * b.y + a.z * b.z > 0.999 * len );
+  }
+
+  /* A partially written file must be rejected, not returned short. */
+  std::ifstream in( exactName, std::ios::binary );
+  std::string bytes( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >( ) );
+  in.close( );
+  std::ofstream( exactName, std::ios::binary ).write( bytes.data( ), bytes.size( ) - 8 );
+  bool rejected = false;
+  try {
+    MeshIO::ReadMesh( exactName );
+  }
+  catch( const std::exception& ) {
+    rejected = true;
+  }
+  QVERIFY( rejected );
+}
+
+void TestMarchingCubes::testAsciiStl( ) {
+  /* Values that need every digit, tiny and huge magnitudes, and exact integers. */
+  const double values[] = { 0.1, -1.0 / 3.0, 1e-7, 3.4028235e38, 1.17549435e-38, 123456789.0, -0.5, 100.0, 1e10,
+                            0.00012345, 16777216.0, 7e-5 };
+  MeshData mesh;
+  for( size_t i = 0; i < 12; ++i ) {
+    mesh.p.push_back( Point3D( values[ i ], -values[ ( i + 1 ) % 12 ], i * 0.25 ) );
+    mesh.tris.push_back( MeshData::Index( 11 - i ) );
+  }
+  QTemporaryDir dir;
+  QVERIFY( dir.isValid( ) );
+  const std::string fileName = dir.filePath( "testasciistl.stl" ).toStdString( );
+  const std::string binaryName = dir.filePath( "testasciistl.binary.stl" ).toStdString( );
+  MeshIO::WriteSTLA( mesh, fileName, 2 );
+  MeshIO::WriteSTLB( mesh, binaryName );
+  QVERIFY( MeshIO::IsSTLA( fileName ) );
+  QVERIFY( !MeshIO::IsSTLA( binaryName ) );
+  std::unique_ptr< MeshData > read = MeshIO::ReadSTLA( fileName, 3 );
+  QCOMPARE( read->Triangles( ), mesh.Triangles( ) );
+  QCOMPARE( read->p.size( ), mesh.tris.size( ) );
+  for( size_t i = 0; i < mesh.tris.size( ); ++i ) {
+    const Point3D &a = read->p[ read->tris[ i ] ], &b = mesh.p[ mesh.tris[ i ] ];
+    QCOMPARE( static_cast< float >( a.x ), static_cast< float >( b.x ) );
+    QCOMPARE( static_cast< float >( a.y ), static_cast< float >( b.y ) );
+    QCOMPARE( static_cast< float >( a.z ), static_cast< float >( b.z ) );
+  }
+  /* Full blocks of facets with numbers of nearly the longest text: tiny negative coordinates, oblique normals. */
+  MeshData tiny;
+  for( size_t t = 0; t < ( size_t( 1 ) << 15 ); ++t ) {
+    const double x = -1.23456789e-5 - t * 1.7e-12, y = -2.3456789e-5 - t * 1.3e-12, z = -3.456789e-5 - t * 1.1e-12;
+    tiny.p.push_back( Point3D( x, y, z ) );
+    tiny.p.push_back( Point3D( 1.5 * x, y, 1.25 * z ) );
+    tiny.p.push_back( Point3D( x, 1.5 * y, 1.125 * z ) );
+    for( size_t v = 0; v < 3; ++v ) {
+      tiny.tris.push_back( MeshData::Index( 3 * t + v ) );
+    }
+  }
+  MeshIO::WriteSTLA( tiny, fileName, 2 );
+  read = MeshIO::ReadSTLA( fileName, 2 );
+  QCOMPARE( read->Triangles( ), tiny.Triangles( ) );
+  for( size_t i = 0; i < tiny.tris.size( ); ++i ) {
+    const Point3D &a = read->p[ read->tris[ i ] ], &b = tiny.p[ tiny.tris[ i ] ];
+    QVERIFY( static_cast< float >( a.x ) == static_cast< float >( b.x ) &&
+             static_cast< float >( a.y ) == static_cast< float >( b.y ) &&
+             static_cast< float >( a.z ) == static_cast< float >( b.z ) );
+  }
+  /* A facet with a missing coordinate is reported, not skipped. */
+  std::ofstream( fileName ) << "solid broken\n  facet normal 0 0 1\n    outer loop\n      vertex 0 0 0\n"
+                               "      vertex 1 0\n      vertex 0 1 0\n    endloop\n  endfacet\nendsolid broken\n";
+  bool rejected = false;
+  try {
+    MeshIO::ReadSTLA( fileName );
+  }
+  catch( const std::exception& ) {
+    rejected = true;
+  }
+  QVERIFY( rejected );
+}
+
+void TestMarchingCubes::testMeshClusters( ) {
+  Image< int > img = MakeBall( 48, 23.5, 400.0 );
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  MeshSmoother::ComputeNormals( *mesh );
+  std::multiset< std::array< MeshData::Index, 3 > > before, after;
+  for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+    before.insert( { { mesh->tris[ t ], mesh->tris[ t + 1 ], mesh->tris[ t + 2 ] } } );
+  }
+  std::vector< MeshClusters::Cluster > clusters = MeshClusters::Build( *mesh, 256, 2 );
+  QVERIFY( clusters.size( ) > 4 );
+  for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+    after.insert( { { mesh->tris[ t ], mesh->tris[ t + 1 ], mesh->tris[ t + 2 ] } } );
+  }
+  QVERIFY( before == after );
+  /* Clusters tile the index buffer and bound their triangles. */
+  size_t next = 0;
+  for( const MeshClusters::Cluster &cluster : clusters ) {
+    QCOMPARE( cluster.first, next );
+    next += cluster.count;
+    for( size_t idx = cluster.first; idx < cluster.first + cluster.count; ++idx ) {
+      const Point3D &pt = mesh->p[ mesh->tris[ idx ] ];
+      QVERIFY( pt.x >= cluster.lo[ 0 ] && pt.x <= cluster.hi[ 0 ] && pt.z >= cluster.lo[ 2 ] &&
+               pt.z <= cluster.hi[ 2 ] );
+    }
+  }
+  QCOMPARE( next, mesh->tris.size( ) );
+
+  /* Orthographic view of x in [ 0, 24 ], eye at +infinity along z: culls the other half. */
+  const double projection[ 16 ] = { 2.0 / 24.0, 0, 0, 0, 0, 2.0 / 48.0, 0, 0, 0, 0, -2.0 / 200.0, 0,
+                                    -1.0, -1.0, 0, 1 };
+  const double modelview[ 16 ] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, -100, 1 };
+  MeshClusters::View view( projection, modelview );
+  size_t seen = 0, front = 0;
+  for( const MeshClusters::Cluster &cluster : clusters ) {
+    bool sees = view.Sees( cluster, false );
+    seen += sees;
+    QVERIFY( sees || cluster.lo[ 0 ] > 24.0 );
+    if( cluster.hi[ 0 ] < 24.0 ) {
+      QVERIFY( sees );
+    }
+    if( sees && !view.Sees( cluster, true ) ) {
+      /* Every facet, on the side of its vertex normals, faces away from the eye. */
+      for( size_t idx = cluster.first; idx < cluster.first + cluster.count; idx += 3 ) {
+        const MeshData::Index *tri = &mesh->tris[ idx ];
+        const Point3D &a = mesh->p[ tri[ 0 ] ], &b = mesh->p[ tri[ 1 ] ], &c = mesh->p[ tri[ 2 ] ];
+        Vector3D nrm = Cross( b - a, c - a );
+        const Normal &na = mesh->n[ tri[ 0 ] ];
+        double side = nrm.x * na.x + nrm.y * na.y + nrm.z * na.z < 0.0 ? -1.0 : 1.0;
+        QVERIFY( side * ( nrm.x * ( view.eye[ 0 ] - a.x ) + nrm.y * ( view.eye[ 1 ] - a.y ) +
+                          nrm.z * ( view.eye[ 2 ] - a.z ) ) <= 1e-9 );
+      }
+    }
+    else {
+      front += sees;
+    }
+  }
+  QVERIFY( seen < clusters.size( ) );
+  QVERIFY( front < seen );
+}
+
+void TestMarchingCubes::testSoftwareRenderer( ) {
+  Image< int > img = MakeBall( 32, 15.5, 144.0 );
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  SoftwareRenderer::Camera camera;
+  camera.rotateY = 30.0;
+  SoftwareRenderer::Frame one = SoftwareRenderer::Render( *mesh, camera, 100, 80, 1 );
+  SoftwareRenderer::Frame many = SoftwareRenderer::Render( *mesh, camera, 100, 80, 3 );
+  /* The sphere covers the center, not the corners, and tiling does not change the picture. */
+  QVERIFY( one.depth[ 40 * 100 + 50 ] < 1.0f );
+  QCOMPARE( one.depth[ 0 ], 1.0f );
+  QCOMPARE( one.rgba[ 3 ], uint8_t( 255 ) );
+  QVERIFY( one.rgba[ ( 40 * 100 + 50 ) * 4 ] > 128 );
+  QVERIFY( one.rgba == many.rgba );
+  QVERIFY( one.depth == many.depth );
+  /* Facing the light in the middle, grazing at the silhouette. */
+  size_t left = 50;
+  while( left > 0 && one.depth[ 40 * 100 + left - 1 ] < 1.0f ) {
+    --left;
+  }
+  QVERIFY( one.rgba[ ( 40 * 100 + left ) * 4 + 1 ] < one.rgba[ ( 40 * 100 + 50 ) * 4 + 1 ] );
+}
+
+void TestMarchingCubes::testMeshMetrics( ) {
+  /* Two unit cubes, one of them entirely at negative coordinates, wound counterclockwise from outside. */
+  MeshData mesh;
+  AddCube( mesh, -3.0, 1.0 );
+  AddCube( mesh, 1.0, 1.0 );
+  for( size_t threads : { size_t( 1 ), size_t( 3 ) } ) {
+    MeshMetrics::Report report = MeshMetrics::Compute( mesh, threads );
+    QCOMPARE( report.components.size( ), size_t( 2 ) );
+    QCOMPARE( report.total.triangles, size_t( 24 ) );
+    QCOMPARE( report.total.vertices, size_t( 16 ) );
+    QVERIFY( std::abs( report.total.area - 12.0 ) < 1e-12 );
+    QVERIFY( std::abs( report.total.volume - 2.0 ) < 1e-12 );
+    QCOMPARE( report.total.lo[ 0 ], -3.0 );
+    QCOMPARE( report.total.hi[ 2 ], 2.0 );
+    QVERIFY( std::abs( report.total.centroid[ 1 ] + 0.5 ) < 1e-12 );
+    for( const MeshMetrics::Metrics &part : report.components ) {
+      QVERIFY( std::abs( part.volume - 1.0 ) < 1e-12 );
+      QVERIFY( std::abs( part.centroid[ 0 ] - ( part.lo[ 0 ] + 0.5 ) ) < 1e-12 );
+      QCOMPARE( part.hi[ 0 ] - part.lo[ 0 ], 1.0 );
+    }
+  }
+  /* An extracted ball encloses about the volume of the thresholded voxels. */
+  Image< int > img = MakeBall( 40, 19.5, 225.0 );
+  size_t inside = 0;
+  for( size_t pxl = 0; pxl < img.Size( ); ++pxl ) {
+    inside += img[ pxl ] > 0;
+  }
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > ball = sink.Take( );
+  MeshMetrics::Report report = MeshMetrics::Compute( *ball, 2 );
+  QCOMPARE( report.components.size( ), size_t( 1 ) );
+  QVERIFY( std::abs( std::abs( report.total.volume ) - inside ) < 0.05 * inside );
+  QVERIFY( std::abs( report.total.centroid[ 0 ] - 19.5 ) < 0.1 );
+}
+
+void TestMarchingCubes::testMeshVoxelizer( ) {
+  /* Cube faces run exactly through rows of voxel centers; each of them must be counted once. */
+  MeshData cube;
+  AddCube( cube, 0.0, 4.0 );
+  MeshVoxelizer::Grid grid = MeshVoxelizer::Fit( cube, 1.0, 1 );
+  QCOMPARE( grid.size[ 0 ], size_t( 7 ) );
+  QCOMPARE( grid.origin[ 2 ], -1.0 );
+  for( size_t threads : { size_t( 1 ), size_t( 3 ) } ) {
+    Image< int > occupancy = MeshVoxelizer::Occupancy( cube, grid, 7, threads );
+    size_t inside = 0;
+    for( size_t voxel = 0; voxel < occupancy.Size( ); ++voxel ) {
+      inside += occupancy[ voxel ] == 7;
+    }
+    QCOMPARE( inside, size_t( 64 ) );
+    QCOMPARE( occupancy( 3, 3, 3 ), 7 );
+    QCOMPARE( occupancy( 0, 3, 3 ), 0 );
+  }
+  Image< float > distance = MeshVoxelizer::Distance( cube, grid, 1.5, 2 );
+  QCOMPARE( distance( 3, 3, 3 ), -1.5f );
+  QVERIFY( std::abs( distance( 0, 3, 3 ) - 1.0f ) < 1e-6f );
+  QVERIFY( std::abs( distance( 2, 3, 3 ) + 1.0f ) < 1e-6f );
+  QCOMPARE( distance( 0, 0, 0 ), 1.5f );
+  distance = MeshVoxelizer::Distance( cube, grid, 2.0, 1 );
+  QVERIFY( std::abs( distance( 0, 0, 0 ) - std::sqrt( 3.0f ) ) < 1e-6f );
+  /* A ball meshed and voxelized back onto its own grid gives the segmentation back, up to the boundary voxels. */
+  Image< int > img = MakeBall( 40, 19.5, 225.0 );
+  MeshSink sink;
+  SurfaceNets::exec( img, 50.f, sink );
+  std::unique_ptr< MeshData > ball = sink.Take( );
+  MeshVoxelizer::Grid same;
+  same.size[ 0 ] = same.size[ 1 ] = same.size[ 2 ] = 40;
+  Image< int > back = MeshVoxelizer::Occupancy( *ball, same, 100, 2 );
+  size_t both = 0, either = 0;
+  for( size_t voxel = 0; voxel < img.Size( ); ++voxel ) {
+    both += img[ voxel ] > 0 && back[ voxel ] > 0;
+    either += img[ voxel ] > 0 || back[ voxel ] > 0;
+  }
+  QVERIFY( both > 0.95 * either );
+}
+
+void TestMarchingCubes::testSliceContours( ) {
+  /* A ball with a hole along z: two nested loops on axial slices, the inner one turning the other way. */
+  Image< int > img( 40, 40, 40 );
+  for( size_t z = 0; z < 40; ++z ) {
+    for( size_t y = 0; y < 40; ++y ) {
+      for( size_t x = 0; x < 40; ++x ) {
+        double r = ( x - 19.5 ) * ( x - 19.5 ) + ( y - 19.5 ) * ( y - 19.5 );
+        img( x, y, z ) = 100 * ( r + ( z - 19.5 ) * ( z - 19.5 ) < 225.0 && r > 16.0 );
+      }
+    }
+  }
+  SliceContours::Contour axial = SliceContours::Extract( img, SliceContours::Axis::Z, 20, 50.f );
+  QCOMPARE( axial.size( ), size_t( 2 ) );
+  double area = 0.0;
+  for( const SliceContours::Polyline &line : axial ) {
+    QVERIFY( line.closed );
+    area += Area( line );
+  }
+  /* Pixel counts of the ring, give or take the boundary. */
+  QVERIFY( std::abs( area - 3.14159 * ( 225.0 - 16.0 ) ) < 20.0 );
+  std::vector< SliceContours::Contour > stack = SliceContours::Stack( img, SliceContours::Axis::Y, 50.f, 3 );
+  QCOMPARE( stack.size( ), size_t( 40 ) );
+  QVERIFY( stack[ 0 ].empty( ) );
+  SliceContours::Contour coronal = SliceContours::Extract( img, SliceContours::Axis::Y, 25, 50.f );
+  QCOMPARE( stack[ 25 ].size( ), coronal.size( ) );
+  QVERIFY( stack[ 25 ][ 0 ].points == coronal[ 0 ].points );
+  /* A half space ends at the borders of the slice. */
+  Image< int > half( 8, 8, 2 );
+  for( size_t voxel = 0; voxel < half.Size( ); ++voxel ) {
+    half[ voxel ] = voxel % 8 >= 3 ? 10 : 0;
+  }
+  SliceContours::Contour open = SliceContours::Extract( half, SliceContours::Axis::Z, 1, 5.f );
+  QCOMPARE( open.size( ), size_t( 1 ) );
+  QVERIFY( !open[ 0 ].closed );
+  QCOMPARE( open[ 0 ].points.size( ), size_t( 8 ) );
+  QCOMPARE( open[ 0 ].points.front( )[ 0 ], 2.5f );
+  /* Inside on the left: going up the slice, with the inside towards increasing x. */
+  QVERIFY( open[ 0 ].points.front( )[ 1 ] > open[ 0 ].points.back( )[ 1 ] );
+  /* Mesh cuts close into counterclockwise loops around closed meshes. */
+  MeshData cube;
+  AddCube( cube, 0.0, 4.0 );
+  SliceContours::Contour cut = SliceContours::Cut( cube, SliceContours::Axis::Z, 1.0 );
+  QCOMPARE( cut.size( ), size_t( 1 ) );
+  QVERIFY( cut[ 0 ].closed );
+  QVERIFY( std::abs( Area( cut[ 0 ] ) - 16.0 ) < 1e-5 );
+  QVERIFY( SliceContours::Cut( cube, SliceContours::Axis::X, 5.0 ).empty( ) );
+}
+
+void TestMarchingCubes::testMappedVolume( ) {
+  const size_t dims[ 3 ] = { 5, 4, 20 };
+  std::vector< int16_t > voxels( dims[ 0 ] * dims[ 1 ] * dims[ 2 ] );
+  for( size_t voxel = 0; voxel < voxels.size( ); ++voxel ) {
+    voxels[ voxel ] = static_cast< int16_t >( static_cast< int >( voxel * 37 ) % 2000 - 1000 );
+  }
+  QTemporaryDir dir;
+  QVERIFY( dir.isValid( ) );
+  const std::string fileName = dir.filePath( "testmappedvolume.nii" ).toStdString( );
+  for( bool swapped : { false, true } ) {
+    WriteNifti( fileName, dims, voxels, swapped );
+    QVERIFY( MappedVolume::CanMap( fileName ) );
+    MappedVolume volume( fileName );
+    QCOMPARE( volume.Info( ).swapped, swapped );
+    QCOMPARE( volume.size( 2 ), size_t( 20 ) );
+    QCOMPARE( volume( 3, 2, 11 ), int( voxels[ 3 + 5 * ( 2 + 4 * 11 ) ] ) );
+    Image< int > img = volume.ToImage( 3 );
+    QCOMPARE( img.size( 0 ), size_t( 5 ) );
+    bool same = true;
+    for( size_t voxel = 0; voxel < voxels.size( ); ++voxel ) {
+      same = same && img[ voxel ] == voxels[ voxel ];
+    }
+    QVERIFY( same );
+  }
+  /* A truncated file is refused rather than read past its end. */
+  WriteNifti( fileName, dims, std::vector< int16_t >( 10 ), false );
+  QVERIFY( MappedVolume::CanMap( fileName ) );
+  bool rejected = false;
+  try {
+    MappedVolume volume( fileName );
+  }
+  catch( const std::exception& ) {
+    rejected = true;
+  }
+  QVERIFY( rejected );
+  /* The header of a .hdr/.img pair holds no voxels, so it is neither mapped nor streamed. */
+  WriteNifti( fileName, dims, voxels, false );
+  std::fstream( fileName, std::ios::binary | std::ios::in | std::ios::out ).seekp( 345 ).put( 'i' );
+  QVERIFY( !MappedVolume::CanMap( fileName ) );
+  rejected = false;
+  try {
+    SliceReader reader( fileName );
+  }
+  catch( const std::exception& ) {
+    rejected = true;
+  }
+  QVERIFY( rejected );
+}
+
+void TestMarchingCubes::testTimeSeries( ) {
+  /* A ball moving in one corner and another standing still in the opposite one, over three frames. */
+  const size_t dims[ 3 ] = { 64, 64, 64 };
+  const size_t frames = 3;
+  std::vector< int16_t > voxels( dims[ 0 ] * dims[ 1 ] * dims[ 2 ] * frames );
+  for( size_t frame = 0; frame < frames; ++frame ) {
+    for( size_t z = 0; z < dims[ 2 ]; ++z ) {
+      for( size_t y = 0; y < dims[ 1 ]; ++y ) {
+        for( size_t x = 0; x < dims[ 0 ]; ++x ) {
+          const double moving = std::hypot( std::hypot( x - 12.0 - frame, y - 12.0 ), z - 12.0 );
+          const double still = std::hypot( std::hypot( x - 46.0, y - 46.0 ), z - 46.0 );
+          voxels[ x + dims[ 0 ] * ( y + dims[ 1 ] * ( z + dims[ 2 ] * frame ) ) ] =
+            static_cast< int16_t >( std::max( 0.0, 100.0 - 10.0 * std::min( moving, still ) ) );
+        }
+      }
+    }
+  }
+  QTemporaryDir dir;
+  QVERIFY( dir.isValid( ) );
+  const std::string fileName = dir.filePath( "testtimeseries.nii" ).toStdString( );
+  WriteNifti( fileName, dims, voxels, false, frames );
+  QCOMPARE( TimeSeries::Frames( fileName ), frames );
+  TimeSeries::Params params;
+  params.fileName = fileName;
+  params.isolevel = 0.25f;
+  params.threads = 3;
+  TimeSeries::Statistics stats;
+  std::vector< std::unique_ptr< MeshData > > meshes = TimeSeries::Extract( params, &stats );
+  QCOMPARE( meshes.size( ), frames );
+  QCOMPARE( stats.frames, frames );
+  /* Only the group of bricks around the moving ball is extracted again after the first frame. */
+  QCOMPARE( stats.extracted + stats.reused, size_t( 8 * frames ) );
+  QCOMPARE( stats.reused, size_t( 7 * ( frames - 1 ) ) );
+  /* Every frame matches an extraction of that frame on its own. */
+  for( size_t frame = 0; frame < frames; ++frame ) {
+    Image< int > img( dims[ 0 ], dims[ 1 ], dims[ 2 ] );
+    for( size_t voxel = 0; voxel < img.Size( ); ++voxel ) {
+      img[ voxel ] = voxels[ voxel + img.Size( ) * frame ];
+    }
+    BrickedVolume vol( img, 1 );
+    MeshSink sink;
+    BrickedVolume::ExtractMarchingCubes( vol, 25.f, sink, 0, vol.Bricks( ) );
+    std::unique_ptr< MeshData > alone = sink.Take( );
+    MeshWelder::SimplifyMesh( alone->tris, alone->n, alone->p );
+    QCOMPARE( meshes[ frame ]->Triangles( ), alone->Triangles( ) );
+    QCOMPARE( meshes[ frame ]->Vertices( ), alone->Vertices( ) );
+  }
+  QVERIFY( meshes[ 1 ]->Triangles( ) > 0 );
+  /* Compressed series are read frame by frame and give the same meshes. */
+  std::ifstream in( fileName, std::ios::binary );
+  std::vector< char > bytes( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >( ) );
+  gzFile gz = gzopen( ( fileName + ".gz" ).c_str( ), "wb" );
+  gzwrite( gz, bytes.data( ), static_cast< unsigned >( bytes.size( ) ) );
+  gzclose( gz );
+  params.fileName = fileName + ".gz";
+  std::vector< std::unique_ptr< MeshData > > compressed = TimeSeries::Extract( params );
+  QCOMPARE( compressed.size( ), frames );
+  QCOMPARE( compressed[ 2 ]->Triangles( ), meshes[ 2 ]->Triangles( ) );
+}
+
+void TestMarchingCubes::testAdaptiveContouring( ) {
+  /* A smooth ball of radius 20 and a box, one flat face of which crosses block borders. */
+  Image< int > ball( 64, 64, 64 ), box( 64, 64, 64 );
+  for( size_t z = 0; z < 64; ++z ) {
+    for( size_t y = 0; y < 64; ++y ) {
+      for( size_t x = 0; x < 64; ++x ) {
+        const double dist = std::sqrt( ( x - 31.3 ) * ( x - 31.3 ) + ( y - 32.1 ) * ( y - 32.1 ) +
+                                       ( z - 30.7 ) * ( z - 30.7 ) );
+        ball( x, y, z ) = static_cast< int >( std::max( 0.0, 1000.0 - 40.0 * dist ) );
+        box( x, y, z ) = ( x > 5 && x < 50 && y > 8 && y < 40 && z > 10 && z < 57 ) ? 100 : 0;
+      }
+    }
+  }
+  for( const Image< int > *img : { &ball, &box } ) {
+    const float level = img == &ball ? 200.f : 50.f;
+    MeshSink uniform;
+    SurfaceNets::exec( *img, level, uniform, SurfaceNets::Mode::DualContouring );
+    AdaptiveContouring::Params params;
+    params.tolerance = 0.1f;
+    params.threads = 3;
+    MeshSink sink;
+    AdaptiveContouring::exec( *img, level, sink, params );
+    std::unique_ptr< MeshData > mesh = sink.Take( );
+    /* Fewer triangles where the surface is flat enough. */
+    QVERIFY( mesh->Triangles( ) > 0 );
+    QVERIFY( mesh->Triangles( ) * 2 < uniform.Triangles( ) );
+    /* No cracks between cells of different sizes: closed and consistently oriented. */
+    std::map< std::pair< size_t, size_t >, int > edges;
+    for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+      for( size_t v = 0; v < 3; ++v ) {
+        ++edges[ std::make_pair( mesh->tris[ t + v ], mesh->tris[ t + ( v + 1 ) % 3 ] ) ];
+      }
+    }
+    bool closed = true;
+    for( auto it = edges.begin( ); it != edges.end( ); ++it ) {
+      closed = closed && it->second == 1 && edges.count( std::make_pair( it->first.second, it->first.first ) ) == 1;
+    }
+    QVERIFY( closed );
+    /* Still a sphere, enclosing about as much as the uniform surface. */
+    QCOMPARE( static_cast< long >( mesh->Vertices( ) ) - static_cast< long >( edges.size( ) / 2 ) +
+              static_cast< long >( mesh->Triangles( ) ), 2L );
+    MeshMetrics::Report report = MeshMetrics::Compute( *mesh, 1 );
+    MeshMetrics::Report reference = MeshMetrics::Compute( *uniform.Take( ), 1 );
+    QVERIFY( std::abs( report.total.volume / reference.total.volume - 1.0 ) < 0.01 );
+  }
+  /* No tolerance only merges cells whose planes meet exactly, as on the faces of the box. */
+  AdaptiveContouring::Params exact;
+  exact.tolerance = 0.f;
+  MeshSink sink;
+  AdaptiveContouring::exec( box, 50.f, sink, exact );
+  QVERIFY( sink.Triangles( ) > 0 );
+}
+
+void TestMarchingCubes::testTaskScheduler( ) {
+  TaskScheduler::Params params;
+  params.threads = 4;
+  params.pin = true;
+  TaskScheduler::Configure( params );
+  QCOMPARE( HardwareThreads( ), size_t( 4 ) );
+  /* Ordered reduction, the same for any grain. */
+  const size_t count = 100000;
+  for( size_t grain : { size_t( 1000 ), size_t( 777 ), count } ) {
+    const uint64_t sum = ParallelReduce( 0, count, grain, uint64_t( 0 ), [ ]( size_t first, size_t last ) {
+      uint64_t res = 0;
+      for( size_t idx = first; idx < last; ++idx ) {
+        res += idx;
+      }
+      return( res );
+    }, [ ]( uint64_t a, uint64_t b ) {
+      return( a + b );
+    } );
+    QCOMPARE( sum, uint64_t( count ) * ( count - 1 ) / 2 );
+  }
+  /* Nested loops, more parts than threads: every item is visited exactly once. */
+  std::vector< int > visits( 64 * 64, 0 );
+  ParallelRanges( 0, 64, 16, [ & ]( size_t first, size_t last, size_t ) {
+    for( size_t row = first; row < last; ++row ) {
+      ParallelFor( 0, 64, 3, [ & ]( size_t begin, size_t end ) {
+        for( size_t col = begin; col < end; ++col ) {
+          ++visits[ row * 64 + col ];
+        }
+      } );
+    }
+  } );
+  QVERIFY( std::all_of( visits.begin( ), visits.end( ), [ ]( int hits ) {
+    return( hits == 1 );
+  } ) );
+  /* Exceptions reach the caller once every part has finished. */
+  bool thrown = false;
+  try {
+    ParallelRanges( 0, 8, 8, [ ]( size_t first, size_t, size_t ) {
+      if( first == 5 ) {
+        throw std::runtime_error( "part 5" );
+      }
+    } );
+  }
+  catch( const std::runtime_error &e ) {
+    thrown = std::string( e.what( ) ) == "part 5";
+  }
+  QVERIFY( thrown );
+  /* With the caller alone, queued interactive tasks run before the background ones submitted earlier. */
+  params.threads = 1;
+  params.pin = false;
+  TaskScheduler::Configure( params );
+  std::vector< int > order;
+  {
+    TaskScheduler::Group background;
+    background.Run( [ &order ]( ) {
+      order.push_back( 2 );
+    } );
+    TaskScheduler::PriorityScope scope( TaskScheduler::Priority::Interactive );
+    TaskScheduler::Group interactive;
+    interactive.Run( [ &order ]( ) {
+      order.push_back( 1 );
+    } );
+    background.Wait( );
+    interactive.Wait( );
+  }
+  QVERIFY( order == std::vector< int >( { 1, 2 } ) );
+  TaskScheduler::Configure( TaskScheduler::Params( ) );
+}
+
+void TestMarchingCubes::testMeshStream( ) {
+  /* A ball cut by the x border, in a volume whose depth is no multiple of the slab. */
+  const size_t dims[ 3 ] = { 40, 36, 45 };
+  std::vector< int16_t > voxels( dims[ 0 ] * dims[ 1 ] * dims[ 2 ] );
+  Image< int > img( dims[ 0 ], dims[ 1 ], dims[ 2 ] );
+  for( size_t voxel = 0; voxel < voxels.size( ); ++voxel ) {
+    const size_t x = voxel % dims[ 0 ], y = voxel / dims[ 0 ] % dims[ 1 ], z = voxel / dims[ 0 ] / dims[ 1 ];
+    const double dist = std::hypot( std::hypot( x - 30.5, y - 17.2 ), z - 21.9 );
+    voxels[ voxel ] = static_cast< int16_t >( std::max( 0.0, 100.0 - 6.0 * dist ) );
+    img[ voxel ] = voxels[ voxel ];
+  }
+  QTemporaryDir dir;
+  QVERIFY( dir.isValid( ) );
+  const std::string fileName = dir.filePath( "testmeshstream.nii" ).toStdString( );
+  const std::string output = dir.filePath( "testmeshstream.stl" ).toStdString( );
+  WriteNifti( fileName, dims, voxels, false );
+  MeshPipeline::Params params;
+  params.fileName = fileName;
+  params.isolevel = 0.25f;
+  params.threads = 3;
+  QVERIFY( MeshStream::CanStream( params, output ) );
+  QVERIFY( !MeshStream::CanStream( params, output + ".gz" ) );
+  MeshStream::Params stream;
+  stream.slab = 7;
+  stream.depth = 1;
+  MeshStream::Statistics stats;
+  const size_t triangles = MeshStream::Run( params, output, stream, &stats );
+  QCOMPARE( stats.slabs, size_t( 7 ) );
+  QCOMPARE( stats.triangles, triangles );
+  /* The same facets as the whole volume extracted at once, in the same order. */
+  MeshSink sink;
+  MeshSink::ExtractMarchingCubes( img, 0.25f * *std::max_element( voxels.begin( ), voxels.end( ) ), sink );
+  QCOMPARE( triangles, sink.Triangles( ) );
+  const std::string reference = dir.filePath( "testmeshstream_ref.stl" ).toStdString( );
+  MeshIO::WriteSTLB( *sink.Take( ), reference );
+  auto ReadAll = [ ]( const std::string &name ) {
+    std::ifstream in( name, std::ios::binary );
+    return( std::vector< char >( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >( ) ) );
+  };
+  const std::vector< char > streamed = ReadAll( output ), whole = ReadAll( reference );
+  QCOMPARE( streamed.size( ), whole.size( ) );
+  QCOMPARE( streamed.size( ), 84 + 50 * triangles );
+  float maxDiff = 0.f;
+  for( size_t facet = 0; facet < triangles; ++facet ) {
+    for( size_t value = 3; value < 12; ++value ) {
+      float a, b;
+      std::memcpy( &a, &streamed[ 84 + 50 * facet + 4 * value ], sizeof( a ) );
+      std::memcpy( &b, &whole[ 84 + 50 * facet + 4 * value ], sizeof( b ) );
+      maxDiff = std::max( maxDiff, std::abs( a - b ) );
+    }
+  }
+  QVERIFY( maxDiff < 1e-4f );
+  /* Compressed input streams through zlib into the same file. */
+  std::ifstream in( fileName, std::ios::binary );
+  std::vector< char > bytes( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >( ) );
+  gzFile gz = gzopen( ( fileName + ".gz" ).c_str( ), "wb" );
+  gzwrite( gz, bytes.data( ), static_cast< unsigned >( bytes.size( ) ) );
+  gzclose( gz );
+  params.fileName = fileName + ".gz";
+  stream.slab = 16;
+  stream.depth = 3;
+  QCOMPARE( MeshStream::Run( params, output, stream ), triangles );
+  QVERIFY( ReadAll( output ) == streamed );
+  bool thrown = false;
+  try {
+    MeshIO::STLBWriter writer( output + ".gz" );
+  }
+  catch( const std::runtime_error & ) {
+    thrown = true;
+  }
+  QVERIFY( thrown );
+#ifdef __linux__
+  /* A failing writer stops the reader and the extraction, and its error reaches the caller. */
+  stream.slab = 1;
+  stream.depth = 1;
+  thrown = false;
+  try {
+    MeshStream::Run( params, "/dev/full", stream );
+  }
+  catch( const std::runtime_error & ) {
+    thrown = true;
+  }
+  QVERIFY( thrown );
+#endif
+}
+
+void TestMarchingCubes::testCubeKernels( ) {
+  /* Each case, with corners at 0 inside and 100 outside, places one vertex at the middle of every crossed edge. */
+  for( size_t idx = 0; idx < 256; ++idx ) {
+    QCOMPARE( static_cast< int >( CubeKernels::Edges( static_cast< uint8_t >( idx ) ) ),
+              MarchingCubes::edgeTable[ idx ] );
+    Cell cell;
+    for( size_t vtx = 0; vtx < 8; ++vtx ) {
+      const size_t x = vtx == 1 || vtx == 2 || vtx == 5 || vtx == 6, y = vtx >= 4, z = vtx % 4 < 2;
+      cell.p[ vtx ] = Vector3D( x, y, z );
+      cell.val[ vtx ] = ( idx >> vtx ) & 1 ? 0.f : 100.f;
+    }
+    cell.calcIdx( 50.f );
+    QCOMPARE( static_cast< size_t >( cell.idx ), idx );
+    MeshSink sink;
+    const size_t triangles = sink.Polygonize( cell, 50.f );
+    QCOMPARE( sink.Triangles( ), triangles );
+    QCOMPARE( sink.Vertices( ), std::bitset< 12 >( CubeKernels::Edges( cell.idx ) ).count( ) );
+    QCOMPARE( triangles == 0, idx == 0 || idx == 255 );
+    std::unique_ptr< MeshData > mesh = sink.Take( );
+    for( const Point3D &pt : mesh->p ) {
+      const int halves = ( pt.x == 0.5 ) + ( pt.y == 0.5 ) + ( pt.z == 0.5 );
+      QCOMPARE( halves, 1 );
+    }
+    for( size_t t = 0; t < mesh->tris.size( ); t += 3 ) {
+      QVERIFY( mesh->tris[ t ] != mesh->tris[ t + 1 ] && mesh->tris[ t + 1 ] != mesh->tris[ t + 2 ] &&
+               mesh->tris[ t ] != mesh->tris[ t + 2 ] );
+    }
+  }
+  /* A smooth ball gives a closed, consistently oriented sphere, with normals along the gradient. */
+  Image< int > ball( 48, 48, 48 );
+  for( size_t z = 0; z < 48; ++z ) {
+    for( size_t y = 0; y < 48; ++y ) {
+      for( size_t x = 0; x < 48; ++x ) {
+        const double dist = std::sqrt( ( x - 23.6 ) * ( x - 23.6 ) + ( y - 24.2 ) * ( y - 24.2 ) +
+                                       ( z - 23.3 ) * ( z - 23.3 ) );
+        ball( x, y, z ) = static_cast< int >( 1000.0 - 40.0 * dist );
+      }
+    }
+  }
+  /* Off the integer values, so no vertex falls on a corner and makes degenerate triangles. */
+  MeshSink sink;
+  MeshSink::ExtractMarchingCubes( ball, 200.5f, sink );
+  std::unique_ptr< MeshData > mesh = sink.Take( );
+  MeshWelder::SimplifyMesh( mesh->tris, mesh->n, mesh->p );
+  QVERIFY( ClosedAndOriented( *mesh ) );
+  QCOMPARE( static_cast< long >( mesh->Vertices( ) ) - static_cast< long >( mesh->Triangles( ) * 3 / 2 ) +
+            static_cast< long >( mesh->Triangles( ) ), 2L );
+  const double volume = MeshMetrics::Compute( *mesh, 1 ).total.volume;
+  QVERIFY( std::abs( std::abs( volume ) / ( 4.0 / 3.0 * M_PI * 20.0 * 20.0 * 20.0 ) - 1.0 ) < 0.02 );
+  for( size_t vtx = 0; vtx < mesh->Vertices( ); ++vtx ) {
+    const Vector3D out = mesh->p[ vtx ] - Point3D( 23.6, 24.2, 23.3 );
+    QVERIFY( Dot( Vector3D( mesh->n[ vtx ].x, mesh->n[ vtx ].y, mesh->n[ vtx ].z ), out.Normalized( ) ) < -0.99 );
+  }
+  /* Noise crosses ambiguous faces everywhere; neighbouring cells must cut them alike. */
+  Image< int > noise( 24, 24, 24 );
+  uint32_t state = 12345;
+  for( size_t z = 0; z < 24; ++z ) {
+    for( size_t y = 0; y < 24; ++y ) {
+      for( size_t x = 0; x < 24; ++x ) {
+        state = state * 1664525u + 1013904223u;
+        const bool border = x == 0 || y == 0 || z == 0 || x == 23 || y == 23 || z == 23;
+        noise( x, y, z ) = border ? 100 : static_cast< int >( ( state >> 16 ) % 101 );
+      }
+    }
+  }
+  MeshSink noisy;
+  MeshSink::ExtractMarchingCubes( noise, 50.5f, noisy );
+  mesh = noisy.Take( );
+  MeshWelder::SimplifyMesh( mesh->tris, mesh->n, mesh->p );
+  QVERIFY( mesh->Triangles( ) > 10000 );
+  QVERIFY( ClosedAndOriented( *mesh ) );
+}
@@ -13,6 +13,42 @@ private slots:
 
   void testBoxAdj();
 
+  void testSurfaceNets();
+
+  void testMeshOptimizer();
+
+  void testBrickedVolume();
+
+  void testMeshSmoother();
+
+  void testVolumeStatistics();
+
+  void testMeshFile();
+
+  void testAsciiStl();
+
+  void testMeshClusters();
+
+  void testSoftwareRenderer();
+
+  void testMeshMetrics();
+
+  void testMeshVoxelizer();
+
+  void testSliceContours();
+
+  void testMappedVolume();
+
+  void testTimeSeries();
+
+  void testAdaptiveContouring();
+
+  void testTaskScheduler();
+
+  void testMeshStream();
+
+  void testCubeKernels();
+
 };
 
 #endif // TESTMARCHINGCUBES_H